@@ -0,0 +1,304 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Benchmarks of adaptyst_region_start() and adaptyst_region_end() as
+// called by a workflow. The Adaptyst side of the communication is
+// emulated by a thread of the benchmark process, which answers every
+// request immediately and drains region rings, so that the results
+// reflect the overhead of the injection library only.
+
+#include "region_ring.hpp"
+#include "adaptyst/socket.hpp"
+#include "adaptyst/inject.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#define BENCH_RING_CAPACITY 4096
+
+namespace adaptyst {
+  class InjectionBench {
+  public:
+    int (*init)();
+    int (*region_start)(const char *);
+    int (*region_end)(const char *);
+    int (*region_register)(const char *, adaptyst_region_t *);
+    int (*region_start_h)(adaptyst_region_t);
+    int (*region_end_h)(adaptyst_region_t);
+    int (*region_set_policy)(adaptyst_region_t, const adaptyst_region_policy *);
+    void (*close)();
+
+    static InjectionBench &instance() {
+      static InjectionBench bench;
+      return bench;
+    }
+
+    void configure(unsigned int modules, bool ring) {
+      this->close();
+      this->modules = modules;
+      this->ring_capacity = ring ? BENCH_RING_CAPACITY : 0;
+
+      int code = this->init();
+
+      if (code != 0) {
+        throw std::runtime_error("adaptyst_init() returned " +
+                                 std::to_string(code));
+      }
+    }
+
+  private:
+    int adaptyst_in[2];
+    int adaptyst_out[2];
+    int module_fd[2];
+    std::unique_ptr<FileDescriptor> fd;
+    std::atomic<unsigned int> modules;
+    std::atomic<unsigned int> ring_capacity;
+    std::vector<std::unique_ptr<RegionRing> > rings;
+    std::mutex rings_mutex;
+
+    InjectionBench() {
+      if (pipe(this->adaptyst_in) == -1 || pipe(this->adaptyst_out) == -1 ||
+          pipe(this->module_fd) == -1) {
+        throw std::runtime_error("pipe() failed");
+      }
+
+      // The injection library reads the variables when it is loaded,
+      // so they must be set before dlopen()
+      setenv("ADAPTYST_READ_FD1", std::to_string(this->adaptyst_in[0]).c_str(), 1);
+      setenv("ADAPTYST_READ_FD2", std::to_string(this->adaptyst_in[1]).c_str(), 1);
+      setenv("ADAPTYST_WRITE_FD1", std::to_string(this->adaptyst_out[0]).c_str(), 1);
+      setenv("ADAPTYST_WRITE_FD2", std::to_string(this->adaptyst_out[1]).c_str(), 1);
+
+      // RTLD_DEEPBIND makes the library use its own definitions of
+      // symbols which libadaptyst also exports (e.g. adaptyst_get_timestamp())
+      void *handle = dlopen(ADAPTYST_BENCH_INJECT_LIB,
+                            RTLD_NOW | RTLD_LOCAL | RTLD_DEEPBIND);
+
+      if (!handle) {
+        throw std::runtime_error(dlerror());
+      }
+
+      this->init = (int (*)())dlsym(handle, "adaptyst_init");
+      this->region_start = (int (*)(const char *))dlsym(handle, "adaptyst_region_start");
+      this->region_end = (int (*)(const char *))dlsym(handle, "adaptyst_region_end");
+      this->region_register =
+        (int (*)(const char *, adaptyst_region_t *))dlsym(handle, "adaptyst_region_register");
+      this->region_start_h = (int (*)(adaptyst_region_t))dlsym(handle, "adaptyst_region_start_h");
+      this->region_end_h = (int (*)(adaptyst_region_t))dlsym(handle, "adaptyst_region_end_h");
+      this->region_set_policy =
+        (int (*)(adaptyst_region_t, const adaptyst_region_policy *))
+        dlsym(handle, "adaptyst_region_set_policy");
+      this->close = (void (*)())dlsym(handle, "adaptyst_close");
+
+      if (!this->init || !this->region_start || !this->region_end ||
+          !this->region_register || !this->region_start_h || !this->region_end_h ||
+          !this->region_set_policy || !this->close) {
+        throw std::runtime_error("The injection library lacks the required functions");
+      }
+
+      this->modules = 0;
+      this->ring_capacity = 0;
+      this->fd = std::make_unique<FileDescriptor>(this->adaptyst_in,
+                                                  this->adaptyst_out, 1024,
+                                                  false);
+
+      std::thread(&InjectionBench::respond, this).detach();
+      std::thread(&InjectionBench::drain, this).detach();
+    }
+
+    void respond() {
+      std::string module_fds = std::to_string(this->module_fd[0]) + " " +
+        std::to_string(this->module_fd[1]) + " " +
+        std::to_string(this->module_fd[0]) + " " +
+        std::to_string(this->module_fd[1]);
+
+      while (true) {
+        std::string msg = this->fd->read();
+
+        if (msg.empty()) {
+          return;
+        }
+
+        if (msg == "init ring") {
+          {
+            std::unique_lock lock(this->rings_mutex);
+            this->rings.clear();
+          }
+
+          unsigned int capacity = this->ring_capacity;
+          this->fd->write(capacity > 0 ? "ack ring " + std::to_string(capacity) :
+                          std::string("ack"), true);
+
+          for (unsigned int i = 0; i < this->modules; i++) {
+            this->fd->write("bench" + std::to_string(i) + " " + std::to_string(i) +
+                            " " + module_fds + " " + ADAPTYST_BENCH_MODULE_LIB, true);
+          }
+
+          this->fd->write("<STOP>", true);
+        } else if (msg.starts_with("ring ")) {
+          std::string::size_type sep = msg.find(' ', 5);
+          std::unique_ptr<RegionRing> ring =
+            RegionRing::open(msg.substr(sep + 1));
+
+          {
+            std::unique_lock lock(this->rings_mutex);
+            this->rings.push_back(std::move(ring));
+          }
+
+          this->fd->write("ack", true);
+        } else if (!msg.starts_with("overhead ")) {
+          this->fd->write("ack", true);
+        }
+      }
+    }
+
+    void drain() {
+      RegionRecord record;
+
+      while (true) {
+        bool consumed = false;
+
+        {
+          std::unique_lock lock(this->rings_mutex);
+
+          for (auto &ring : this->rings) {
+            while (ring->pop(record)) {
+              consumed = true;
+            }
+          }
+        }
+
+        if (!consumed) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  };
+};
+
+using namespace adaptyst;
+
+static void BM_RegionStartEnd(benchmark::State &state) {
+  InjectionBench &bench = InjectionBench::instance();
+
+  try {
+    bench.configure(state.range(0), state.range(1));
+  } catch (std::exception &e) {
+    state.SkipWithError(e.what());
+    return;
+  }
+
+  for (auto _ : state) {
+    if (bench.region_start("bench") != 0 ||
+        bench.region_end("bench") != 0) {
+      state.SkipWithError("The region could not be switched");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(2 * state.iterations());
+  bench.close();
+}
+
+// The injection library is set up and closed by the Setup() and
+// Teardown() callbacks, which run before and after all threads of
+// a multi-threaded benchmark rather than concurrently with them
+static std::string configure_error;
+
+static void configure_threaded(const benchmark::State &state) {
+  try {
+    configure_error.clear();
+    InjectionBench::instance().configure(state.range(0), state.range(1));
+  } catch (std::exception &e) {
+    configure_error = e.what();
+  }
+}
+
+static void close_threaded(const benchmark::State &) {
+  InjectionBench::instance().close();
+}
+
+// Every thread marks its own instances of the same region
+static void BM_RegionHandleStartEnd(benchmark::State &state) {
+  InjectionBench &bench = InjectionBench::instance();
+  adaptyst_region_t region;
+
+  if (!configure_error.empty()) {
+    state.SkipWithError(configure_error.c_str());
+    return;
+  }
+
+  if (bench.region_register("bench", &region) != 0) {
+    state.SkipWithError("The region could not be registered");
+    return;
+  }
+
+  for (auto _ : state) {
+    if (bench.region_start_h(region) != 0 ||
+        bench.region_end_h(region) != 0) {
+      state.SkipWithError("The region could not be switched");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(2 * state.iterations());
+}
+
+// policy: 0 for sampling every 100th instance, 1 for aggregation
+static void BM_RegionPolicyStartEnd(benchmark::State &state) {
+  InjectionBench &bench = InjectionBench::instance();
+  adaptyst_region_t region;
+  adaptyst_region_policy policy{0, 0, false, 1000};
+
+  if (state.range(1) == 0) {
+    policy.sample_every = 100;
+  } else {
+    policy.aggregate = true;
+  }
+
+  try {
+    bench.configure(state.range(0), true);
+  } catch (std::exception &e) {
+    state.SkipWithError(e.what());
+    return;
+  }
+
+  if (bench.region_register("bench_policy", &region) != 0 ||
+      bench.region_set_policy(region, &policy) != 0) {
+    state.SkipWithError("The region could not be registered");
+    return;
+  }
+
+  for (auto _ : state) {
+    if (bench.region_start_h(region) != 0 ||
+        bench.region_end_h(region) != 0) {
+      state.SkipWithError("The region could not be switched");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(2 * state.iterations());
+  bench.close();
+}
+
+BENCHMARK(BM_RegionStartEnd)
+  ->ArgNames({"modules", "ring"})
+  ->ArgsProduct({{0, 1, 4}, {0, 1}});
+
+BENCHMARK(BM_RegionHandleStartEnd)
+  ->ArgNames({"modules", "ring"})
+  ->ArgsProduct({{0, 1}, {0, 1}})
+  ->ThreadRange(1, 8)
+  ->Setup(configure_threaded)
+  ->Teardown(close_threaded)
+  ->UseRealTime();
+
+BENCHMARK(BM_RegionPolicyStartEnd)
+  ->ArgNames({"modules", "policy"})
+  ->ArgsProduct({{0, 1}, {0, 1}});
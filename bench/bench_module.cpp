@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// A module injection library doing nothing, so that benchmarks
+// measure only the overhead of Adaptyst itself.
+
+#include <adaptyst/amod_t.h>
+#include <adaptyst/hw_inject.h>
+
+extern "C" {
+  int adaptyst_init(amod_t id) {
+    return ADAPTYST_MODULE_OK;
+  }
+
+  void adaptyst_close(amod_t id) { }
+
+  int adaptyst_region_start(amod_t id, const char *part_id,
+                            const char *name, const char *timestamp) {
+    return ADAPTYST_MODULE_OK;
+  }
+
+  int adaptyst_region_end(amod_t id, const char *part_id,
+                          const char *name, const char *timestamp) {
+    return ADAPTYST_MODULE_OK;
+  }
+}
@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Benchmarks of writing analysis results: appending elements to
+// Array and BinaryArray, appending rows to a Table and adding files
+// to an Archive.
+
+#include "adaptyst/output.hpp"
+#include "archive.hpp"
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace adaptyst {
+  static fs::path get_bench_dir() {
+    static fs::path dir = fs::temp_directory_path() /
+      ("adaptyst_bench_" + std::to_string(getpid()));
+    fs::create_directories(dir);
+    return dir;
+  }
+
+  static void remove_bench_file(std::string filename) {
+    fs::remove(get_bench_dir() / filename);
+  }
+};
+
+using namespace adaptyst;
+
+static void BM_ArrayPushBack(benchmark::State &state) {
+  remove_bench_file("array.dat");
+  Path path(get_bench_dir());
+  Array<unsigned long long> array(path, "array");
+  unsigned long long value = 0;
+
+  for (auto _ : state) {
+    array.push_back(value++);
+  }
+
+  array.flush();
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ArrayPushBackPair(benchmark::State &state) {
+  remove_bench_file("array_pair.dat");
+  Path path(get_bench_dir());
+  Array<std::pair<unsigned long long, double> > array(path, "array_pair");
+  unsigned long long value = 0;
+
+  for (auto _ : state) {
+    array.push_back(std::make_pair(value, value * 0.5));
+    value++;
+  }
+
+  array.flush();
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_BinaryArrayPushBack(benchmark::State &state) {
+  remove_bench_file("binary_array.bin");
+  Path path(get_bench_dir());
+  BinaryArray<unsigned long long> array(path, "binary_array");
+  unsigned long long value = 0;
+
+  for (auto _ : state) {
+    array.push_back(value++);
+  }
+
+  array.flush();
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_TableAppend(benchmark::State &state) {
+  remove_bench_file("table.tbl");
+  remove_bench_file("meta_table.json");
+  Path path(get_bench_dir());
+  Table table(path, "table", {{"timestamp", Table::UINT64},
+                              {"thread", Table::INT64},
+                              {"region", Table::STRING},
+                              {"value", Table::DOUBLE}});
+  unsigned long long value = 0;
+
+  for (auto _ : state) {
+    table.append(value, 1, "region", value * 0.5);
+    value++;
+  }
+
+  table.flush();
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ArchiveAddFile(benchmark::State &state) {
+  unsigned int size = state.range(0);
+  ArchiveCompression::Type type = (ArchiveCompression::Type)state.range(1);
+  fs::path input = get_bench_dir() / "archive_input";
+
+  {
+    std::ofstream stream(input, std::ios_base::binary);
+
+    // The data are only moderately compressible, as it is
+    // the case for most analysis results
+    for (unsigned int i = 0; i < size; i++) {
+      stream.put((char)((i * 2654435761U) >> (i % 24)));
+    }
+  }
+
+  remove_bench_file("archive");
+  Archive archive(get_bench_dir() / "archive", ARCHIVE_BUFFER_SIZE,
+                  ArchiveCompression(type, type == ArchiveCompression::ZSTD ? 3 : 6));
+  unsigned long long index = 0;
+
+  try {
+    for (auto _ : state) {
+      archive.add_file("file" + std::to_string(index++), input);
+    }
+
+    archive.close();
+  } catch (std::exception &e) {
+    state.SkipWithError(e.what());
+  }
+
+  state.SetBytesProcessed(state.iterations() * size);
+}
+
+BENCHMARK(BM_ArrayPushBack);
+BENCHMARK(BM_ArrayPushBackPair);
+BENCHMARK(BM_BinaryArrayPushBack);
+BENCHMARK(BM_TableAppend);
+BENCHMARK(BM_ArchiveAddFile)
+  ->ArgNames({"size", "compression"})
+  ->ArgsProduct({{4096, 1048576},
+                 {ArchiveCompression::STORE, ArchiveCompression::DEFLATE,
+                  ArchiveCompression::ZSTD}});
@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Benchmarks of spawning processes with Process, measured from
+// the construction of a Process object until the process exits.
+
+#include "adaptyst/process.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace adaptyst;
+
+static void BM_ProcessStartCommand(benchmark::State &state) {
+  std::vector<std::string> command = {"true"};
+
+  for (auto _ : state) {
+    Process process(command);
+    process.start(false, CPUConfig(""), false);
+
+    if (process.join() != 0) {
+      state.SkipWithError("The command has failed");
+      break;
+    }
+  }
+}
+
+static void BM_ProcessStartFunction(benchmark::State &state) {
+  for (auto _ : state) {
+    Process process([]() { return 0; });
+    process.start(false, CPUConfig(""), false);
+
+    if (process.join() != 0) {
+      state.SkipWithError("The function has failed");
+      break;
+    }
+  }
+}
+
+BENCHMARK(BM_ProcessStartCommand)->UseRealTime();
+BENCHMARK(BM_ProcessStartFunction)->UseRealTime();
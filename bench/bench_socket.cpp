@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Benchmarks of the throughput of FileDescriptor and TCPSocket for
+// newline-terminated strings, raw binary data and framed messages,
+// across message sizes and buffer sizes. Messages are sent by
+// the benchmark thread and received by a separate thread.
+
+#include "adaptyst/socket.hpp"
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+namespace adaptyst {
+  enum class BenchMode {
+    STRING,
+    BINARY,
+    FRAMED
+  };
+
+  static void receive_all(Connection &conn, BenchMode mode, unsigned int size) {
+    if (mode == BenchMode::BINARY) {
+      std::unique_ptr<char[]> buf(new char[size]);
+
+      while (conn.read(buf.get(), size, NO_TIMEOUT) > 0) { }
+    } else if (mode == BenchMode::FRAMED) {
+      while (!conn.read_view().empty()) { }
+    } else {
+      while (!conn.read().empty()) { }
+    }
+  }
+
+  static void send_all(benchmark::State &state, Connection &conn,
+                       BenchMode mode, unsigned int size) {
+    std::string msg(size, 'x');
+
+    for (auto _ : state) {
+      if (mode == BenchMode::BINARY) {
+        conn.write(size, msg.data());
+      } else if (mode == BenchMode::FRAMED) {
+        conn.write_message(msg.data(), size);
+      } else {
+        conn.write(msg, true);
+      }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+  }
+
+  static void bench_fd(benchmark::State &state, BenchMode mode) {
+    unsigned int size = state.range(0);
+    unsigned int buf_size = state.range(1);
+    int fd[2];
+
+    if (pipe(fd) == -1) {
+      state.SkipWithError("pipe() failed");
+      return;
+    }
+
+    FileDescriptor sender(nullptr, fd, buf_size, false);
+    FileDescriptor receiver(fd, nullptr, buf_size, false);
+
+    std::thread thread(receive_all, std::ref(receiver), mode, size);
+
+    try {
+      send_all(state, sender, mode, size);
+    } catch (std::exception &e) {
+      state.SkipWithError(e.what());
+    }
+
+    ::close(fd[1]);
+    thread.join();
+    ::close(fd[0]);
+  }
+
+  static void bench_tcp(benchmark::State &state, BenchMode mode) {
+    unsigned int size = state.range(0);
+    unsigned int buf_size = state.range(1);
+
+    TCPAcceptor::Factory factory("127.0.0.1", 0);
+    std::unique_ptr<Acceptor> acceptor = factory.make_acceptor(1);
+
+    // The connection instructions are "<address>_<port>"
+    std::string instructions = acceptor->get_connection_instructions();
+    unsigned short port = std::stoi(instructions.substr(instructions.rfind('_') + 1));
+
+    net::StreamSocket socket;
+    socket.connect(net::SocketAddress("127.0.0.1", port));
+    socket.setNoDelay(true);
+
+    std::unique_ptr<Connection> sender = std::make_unique<TCPSocket>(socket, buf_size);
+    std::unique_ptr<Connection> receiver = acceptor->accept(buf_size);
+
+    std::thread thread(receive_all, std::ref(*receiver), mode, size);
+
+    try {
+      send_all(state, *sender, mode, size);
+    } catch (std::exception &e) {
+      state.SkipWithError(e.what());
+    }
+
+    // Destroying the sender closes the connection, which makes
+    // the receiving thread finish
+    sender.reset();
+    thread.join();
+  }
+};
+
+using namespace adaptyst;
+
+static void BM_FileDescriptorString(benchmark::State &state) {
+  bench_fd(state, BenchMode::STRING);
+}
+
+static void BM_FileDescriptorBinary(benchmark::State &state) {
+  bench_fd(state, BenchMode::BINARY);
+}
+
+static void BM_FileDescriptorFramed(benchmark::State &state) {
+  bench_fd(state, BenchMode::FRAMED);
+}
+
+static void BM_TCPSocketString(benchmark::State &state) {
+  bench_tcp(state, BenchMode::STRING);
+}
+
+static void BM_TCPSocketBinary(benchmark::State &state) {
+  bench_tcp(state, BenchMode::BINARY);
+}
+
+static void BM_TCPSocketFramed(benchmark::State &state) {
+  bench_tcp(state, BenchMode::FRAMED);
+}
+
+#define SOCKET_ARGS                             \
+  ArgNames({"size", "buf_size"})                \
+  ->ArgsProduct({{16, 256, 4096, 65536},        \
+                 {1024, 65536}})                \
+  ->UseRealTime()
+
+BENCHMARK(BM_FileDescriptorString)->SOCKET_ARGS;
+BENCHMARK(BM_FileDescriptorBinary)->SOCKET_ARGS;
+BENCHMARK(BM_FileDescriptorFramed)->SOCKET_ARGS;
+BENCHMARK(BM_TCPSocketString)->SOCKET_ARGS;
+BENCHMARK(BM_TCPSocketBinary)->SOCKET_ARGS;
+BENCHMARK(BM_TCPSocketFramed)->SOCKET_ARGS;
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef ADAPTYST_CHANNEL_H_
+#define ADAPTYST_CHANNEL_H_
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+     Handle of a channel, i.e. a queue of messages in memory shared
+     by the Adaptyst and injection parts of a module, meant for data
+     too bulky for adaptyst_send_data() and its relatives.
+
+     A channel is created by the Adaptyst part of a module with
+     adaptyst_create_channel() and obtained by both parts with
+     adaptyst_get_channel(). Any number of threads and processes
+     can push and pop messages at the same time, without any system
+     calls unless a consumer waits with adaptyst_channel_wait().
+  */
+  typedef struct adaptyst_channel *adaptyst_channel_t;
+
+  /**
+     Appends a message to a channel. This never blocks, so it is
+     safe to be called by profiled threads.
+
+     @param channel Channel handle.
+     @param buf     Message to append.
+     @param n       Size of the message in bytes.
+
+     @return Whether the message has been appended. If the channel
+             is full or n is larger than the slot size of the channel,
+             the message is dropped and counted (the number of dropped
+             messages is saved in the module metadata).
+  */
+  bool adaptyst_channel_push(adaptyst_channel_t channel, const void *buf,
+                             unsigned int n);
+
+  /**
+     Removes the oldest message from a channel without waiting.
+
+     @param channel  Channel handle.
+     @param buf      Buffer where the message should be stored.
+     @param buf_size Size of the buffer. If it's smaller than the message,
+                     the message is truncated.
+     @param n        Pointer to a variable where the size of the message
+                     (before truncation) should be stored.
+
+     @return Whether a message has been removed (false means that
+             the channel is empty).
+  */
+  bool adaptyst_channel_pop(adaptyst_channel_t channel, void *buf,
+                            unsigned int buf_size, unsigned int *n);
+
+  /**
+     Waits until a channel has a message to pop.
+
+     @param channel    Channel handle.
+     @param timeout_ms Timeout in milliseconds, negative for no timeout.
+
+     @return Whether the channel has a message to pop. Another consumer
+             may still pop it first.
+  */
+  bool adaptyst_channel_wait(adaptyst_channel_t channel, long timeout_ms);
+
+  /**
+     Gets the maximum size of a message in a channel in bytes.
+
+     @param channel Channel handle.
+  */
+  unsigned int adaptyst_channel_slot_size(adaptyst_channel_t channel);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
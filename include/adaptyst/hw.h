@@ -9,6 +9,8 @@
 #endif
 
 #include <adaptyst/amod_t.h>
+#include <adaptyst/region.h>
+#include <adaptyst/channel.h>
 
 /**
    \def ADAPTYST_OK
@@ -58,6 +60,16 @@
    \def ADAPTYST_ERR_WORKFLOW_RUNNING
    Error indicating that the workflow is still running.
    Numerical value: 10
+
+   \def ADAPTYST_ERR_CHANNEL_NOT_FOUND
+   Error indicating that a module doesn't have a channel with
+   the specified name.
+   Numerical value: 11
+
+   \def ADAPTYST_ERR_REGION_NOT_FOUND
+   Error indicating that no instances of the specified region
+   have ended yet.
+   Numerical value: 12
 */
 #define ADAPTYST_OK 0
 #define ADAPTYST_ERR_MODULE_NOT_FOUND 1
@@ -70,6 +82,8 @@
 #define ADAPTYST_ERR_WORKFLOW_NOT_STARTED 8
 #define ADAPTYST_ERR_TIMESTAMP 9
 #define ADAPTYST_ERR_WORKFLOW_RUNNING 10
+#define ADAPTYST_ERR_CHANNEL_NOT_FOUND 11
+#define ADAPTYST_ERR_REGION_NOT_FOUND 12
 
 /**
    \def ADAPTYST_IR_MLIR
@@ -83,9 +97,27 @@
    split into Unix-command-line-specific parts (e.g.
    "ls -a /abc" is represented as ["ls", "-a", "/abc", NULL]).
    Numerical value: 101
+
+   \def ADAPTYST_IR_PIPELINE
+   Several commands are run at the same time, with the standard output
+   of every command connected to the standard input of the next one
+   (like "cmd1 | cmd2" in a shell). The workflow process is a shell
+   running the commands as its children. The data pointer is of type
+   adaptyst_ir_pipeline*.
+   Numerical value: 102
 */
 #define ADAPTYST_IR_MLIR 100
 #define ADAPTYST_IR_SINGLE_CMD 101
+#define ADAPTYST_IR_PIPELINE 102
+
+/**
+   \def ADAPTYST_MODULE_VTABLE_VERSION
+   The version of adaptyst_module_vtable supported by this
+   version of Adaptyst. Tables of version 1 (i.e. without
+   region_summary and iteration) and version 2 (i.e. without
+   iteration) are accepted as well.
+*/
+#define ADAPTYST_MODULE_VTABLE_VERSION 3
 
 #ifdef __cplusplus
 extern "C" {
@@ -116,10 +148,28 @@ extern "C" {
        // ir workflow = ...;
        XYZ* ir_data = (XYZ*) workflow.data;
        ```
+
+       The data are built once and shared by all modules, so they must
+       not be modified. They are guaranteed to stay valid until
+       adaptyst_module_process() returns.
     */
     void *data;
   } ir;
 
+  /**
+     Struct describing the data of the ADAPTYST_IR_PIPELINE IR.
+  */
+  typedef struct {
+    /** Number of commands in the pipeline. */
+    unsigned int command_count;
+
+    /**
+       Array of command_count commands in the order of the pipeline,
+       each in the same format as the data of ADAPTYST_IR_SINGLE_CMD.
+    */
+    char ***commands;
+  } adaptyst_ir_pipeline;
+
   /**
      Enum describing a value type of a module option.
   */
@@ -321,6 +371,123 @@ extern "C" {
   bool adaptyst_receive_string_timeout(amod_t id, const char **str,
                                        long timeout_seconds);
 
+  /**
+     Sends a message of arbitrary bytes (including newline and null
+     characters) to the injection part of the module in a workflow.
+
+     The first call switches the connection towards the injection part
+     to length-prefixed frames, which is negotiated automatically
+     with the recipient. From then on, strings sent with
+     adaptyst_send_string() are also framed and can be received by
+     both adaptyst_receive_message() and adaptyst_receive_string().
+
+     @param id  The module ID (use module_id).
+     @param buf Message to send.
+     @param n   Number of bytes of the message.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_send_message(amod_t id, const char *buf, unsigned int n);
+
+  /**
+     Receives a message from the injection part of the module
+     in a workflow, with no timeout. Unlike adaptyst_receive_string(),
+     the message is not copied.
+
+     @param id  The module ID (use module_id).
+     @param buf Pointer to a variable where the pointer to the received
+                message should be stored. The message is valid until
+                data are received again from the injection part.
+     @param n   Pointer to a variable where the number of bytes of the
+                message should be stored. If it's 0, the connection
+                has been closed.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_receive_message(amod_t id, const char **buf, unsigned int *n);
+
+  /**
+     Receives a message from the injection part of the module
+     in a workflow, with a specific timeout. Unlike
+     adaptyst_receive_string_timeout(), the message is not copied.
+
+     @param id              The module ID (use module_id).
+     @param buf             Pointer to a variable where the pointer to
+                            the received message should be stored. The
+                            message is valid until data are received
+                            again from the injection part.
+     @param n               Pointer to a variable where the number of bytes
+                            of the message should be stored. If it's 0,
+                            the connection has been closed.
+     @param timeout_seconds Timeout in seconds.
+
+     @return Whether the operation has been successful (it's false with
+             adaptyst_get_internal_error_code() returning ADAPTYST_ERR_TIMEOUT
+             in case of timeout).
+  */
+  bool adaptyst_receive_message_timeout(amod_t id, const char **buf,
+                                        unsigned int *n, long timeout_seconds);
+
+  /**
+     Sends the contents of a file to the injection part of the module
+     in a workflow. The file is moved inside the kernel where possible,
+     without being copied through user space.
+
+     The recipient must know the number of bytes to be received
+     beforehand, e.g. by receiving a message with the file size first.
+
+     @param id   The module ID (use module_id).
+     @param path Path to a file to send.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_send_file(amod_t id, const char *path);
+
+  /**
+     Receives a given number of bytes from the injection part of
+     the module in a workflow and writes them to a file (e.g.
+     in the directory returned by adaptyst_get_module_dir()), with
+     no timeout. Data are moved inside the kernel where possible,
+     without being copied through user space.
+
+     @param id       The module ID (use module_id).
+     @param path     Path to a file to write. If it exists, it's truncated.
+     @param n        Number of bytes to receive.
+     @param received Pointer to a variable where the number of bytes
+                     received should be stored. It's smaller than n only
+                     if the connection has been closed.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_receive_file(amod_t id, const char *path,
+                             unsigned long long n,
+                             unsigned long long *received);
+
+  /**
+     Receives a given number of bytes from the injection part of
+     the module in a workflow and writes them to a file (e.g.
+     in the directory returned by adaptyst_get_module_dir()), with
+     a specific timeout. Data are moved inside the kernel where
+     possible, without being copied through user space.
+
+     @param id              The module ID (use module_id).
+     @param path            Path to a file to write. If it exists, it's
+                            truncated.
+     @param n               Number of bytes to receive.
+     @param received        Pointer to a variable where the number of
+                            bytes received should be stored. It's smaller
+                            than n only if the connection has been closed.
+     @param timeout_seconds Timeout in seconds for waiting for any data.
+
+     @return Whether the operation has been successful (it's false with
+             adaptyst_get_internal_error_code() returning ADAPTYST_ERR_TIMEOUT
+             in case of timeout).
+  */
+  bool adaptyst_receive_file_timeout(amod_t id, const char *path,
+                                     unsigned long long n,
+                                     unsigned long long *received,
+                                     long timeout_seconds);
+
   /**
      Gets the name of a node a module is attached to.
 
@@ -342,6 +509,33 @@ extern "C" {
   */
   bool adaptyst_log(amod_t id, const char *msg, const char *type);
 
+  /**
+     Gets a handle to Adaptyst logs of a given type, which can be used
+     with adaptyst_log_h() to log messages without looking up the log type
+     every time. Handles of the types declared in log_types are prepared
+     before adaptyst_module_init() is called, so getting them there
+     is cheap.
+
+     @param id   The module ID (use module_id).
+     @param type Log type (use one of the types declared in log_types).
+
+     @return The handle or a negative number if the operation hasn't
+             been successful.
+  */
+  int adaptyst_get_log_handle(amod_t id, const char *type);
+
+  /**
+     Prints an unformatted message to Adaptyst logs identified by
+     a handle obtained from adaptyst_get_log_handle().
+
+     @param id     The module ID (use module_id).
+     @param handle The log handle.
+     @param msg    Message to log.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_log_h(amod_t id, int handle, const char *msg);
+
   /**
      Prints a formatted message of a given type to Adaptyst logs, i.e.
      with a specific prefix indicating whether a message is a main one
@@ -456,6 +650,19 @@ extern "C" {
   */
   const char *adaptyst_get_cpu_mask(amod_t id);
 
+  /**
+     Returns whether processes started by a module should allocate
+     memory only from the NUMA nodes of the cores they run on, as
+     requested by "bind_memory" in the system definition. Modules
+     using CPUConfig can call CPUConfig::bind_memory() in this case.
+
+     @param id The module ID (use module_id).
+
+     @return Whether memory should be bound. If the operation hasn't
+             been successful, false is returned.
+  */
+  bool adaptyst_is_memory_bound(amod_t id);
+
   /**
      Gets the path to a temporary directory.
 
@@ -491,6 +698,43 @@ extern "C" {
   */
   bool adaptyst_set_will_profile(amod_t id, bool will_profile);
 
+  /**
+     Creates a channel shared with the injection part of a module
+     (see adaptyst_channel_t). The channel exists until the module
+     is closed and is emptied before every run of the workflow.
+
+     This method can be called inside adaptyst_module_init() ONLY.
+     Otherwise, an error will be thrown.
+
+     @param id         The module ID (use module_id).
+     @param name       Name of the channel, unique within the module and
+                       without whitespace characters.
+     @param slot_size  Maximum size of a message in bytes.
+     @param slot_count Maximum number of messages in the channel. Must be
+                       a power of 2.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_create_channel(amod_t id, const char *name,
+                               unsigned int slot_size,
+                               unsigned int slot_count);
+
+  /**
+     Gets a channel created with adaptyst_create_channel().
+
+     @param id      The module ID (use module_id).
+     @param name    Name of the channel.
+     @param channel Pointer to a variable where the channel handle
+                    should be stored. The handle is valid until
+                    the module is closed.
+
+     @return Whether the operation has been successful (it's false with
+             adaptyst_get_internal_error_code() returning
+             ADAPTYST_ERR_CHANNEL_NOT_FOUND if there is no such channel).
+  */
+  bool adaptyst_get_channel(amod_t id, const char *name,
+                            adaptyst_channel_t *channel);
+
   /**
      Checks whether any nodes connected to a node a module is
      attached to (i.e. any nodes with an edge *to* the module
@@ -516,6 +760,126 @@ extern "C" {
   */
   bool adaptyst_has_out_tag(amod_t id, const char *tag);
 
+  /**
+     Handle of a record, i.e. a piece of data published by a module
+     for modules of the nodes its node has edges to while a workflow
+     is processed.
+
+     A published record is shared by all of its consumers rather than
+     copied, so its data must not be modified after publishing.
+  */
+  typedef struct adaptyst_record *adaptyst_record_t;
+
+  /**
+     Allocates a record to be filled and published with
+     adaptyst_publish_record().
+
+     @param id   The module ID (use module_id).
+     @param size Size of the record data in bytes.
+
+     @return Record handle or a null pointer if the operation hasn't
+             been successful.
+  */
+  adaptyst_record_t adaptyst_record_alloc(amod_t id, unsigned int size);
+
+  /**
+     Gets the data of a record. The data of a consumed record
+     are read-only.
+
+     @param record Record handle.
+  */
+  void *adaptyst_record_data(adaptyst_record_t record);
+
+  /**
+     Gets the size of the data of a record in bytes.
+
+     @param record Record handle.
+  */
+  unsigned int adaptyst_record_size(adaptyst_record_t record);
+
+  /**
+     Gets the tag a record has been published with (an empty string
+     for a record which hasn't been published yet).
+
+     @param record Record handle.
+  */
+  const char *adaptyst_record_tag(adaptyst_record_t record);
+
+  /**
+     Publishes a record with a specific tag. The record is delivered
+     to every module which has the tag and is attached to a node
+     the module node has an edge to (see also adaptyst_has_out_tag()).
+
+     If the queue of any recipient is full, the call waits until
+     the recipient has consumed some records (the queue size can be set
+     with "queue_capacity" of an edge in the system YAML file). Records
+     are dropped for recipients which have already finished processing.
+
+     The handle is released by the call regardless of its result and must
+     not be used afterwards.
+
+     @param id     The module ID (use module_id).
+     @param tag    Tag of the record.
+     @param record Record handle returned by adaptyst_record_alloc().
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_publish_record(amod_t id, const char *tag,
+                               adaptyst_record_t record);
+
+  /**
+     Publishes a copy of a buffer as a record with a specific tag.
+     See adaptyst_publish_record() for the details.
+
+     @param id  The module ID (use module_id).
+     @param tag Tag of the record.
+     @param buf Buffer to be published.
+     @param n   Size of the buffer in bytes.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_publish(amod_t id, const char *tag, const void *buf,
+                        unsigned int n);
+
+  /**
+     Consumes the next record published for a module, waiting until
+     one is available. The consumed record must be released with
+     adaptyst_record_release().
+
+     @param id     The module ID (use module_id).
+     @param record Pointer to a variable where the record handle should
+                   be stored. It is set to a null pointer when all modules
+                   which may publish records for the module have finished
+                   processing and there are no records left.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_consume_record(amod_t id, adaptyst_record_t *record);
+
+  /**
+     Consumes the next record published for a module, with a specific
+     timeout. See adaptyst_consume_record() for the details.
+
+     @param id              The module ID (use module_id).
+     @param record          Pointer to a variable where the record handle
+                            should be stored.
+     @param timeout_seconds Timeout in seconds.
+
+     @return Whether the operation has been successful (it's false with
+             adaptyst_get_internal_error_code() returning ADAPTYST_ERR_TIMEOUT
+             in case of timeout).
+  */
+  bool adaptyst_consume_record_timeout(amod_t id, adaptyst_record_t *record,
+                                       long timeout_seconds);
+
+  /**
+     Releases a record handle. Its data are freed once all consumers
+     have released the record.
+
+     @param record Record handle.
+  */
+  void adaptyst_record_release(adaptyst_record_t record);
+
   /**
      Gets the error code set by any of the Adaptyst API calls.
 
@@ -602,7 +966,98 @@ extern "C" {
   */
   bool adaptyst_is_workflow_running(amod_t id);
 
+  /**
+     Gets the statistics of durations of a region in the entity
+     a module belongs to, as maintained by Adaptyst from the region
+     events and summaries reported by the workflow so far. The statistics
+     are cleared before every run of the workflow.
+
+     @param id      The module ID (use module_id).
+     @param name    Name of the region.
+     @param part_id Workflow part ID (see adaptyst_module_vtable) or
+                    a null pointer for the statistics across all parts.
+     @param stats   Pointer to a struct where the statistics should
+                    be stored.
+
+     @return Whether the operation has been successful (it's false with
+             adaptyst_get_internal_error_code() returning
+             ADAPTYST_ERR_REGION_NOT_FOUND if no instances of the region
+             have ended yet).
+  */
+  bool adaptyst_get_region_stats(amod_t id, const char *name,
+                                 const char *part_id,
+                                 adaptyst_region_stats *stats);
+
+  /**
+     Gets an arbitrary percentile of durations of a region. See
+     adaptyst_get_region_stats() for the details.
+
+     @param id         The module ID (use module_id).
+     @param name       Name of the region.
+     @param part_id    Workflow part ID or a null pointer for all parts.
+     @param percentile Percentile between 0 and 100.
+     @param ns         Pointer to a variable where the duration in
+                       nanoseconds should be stored.
+
+     @return Whether the operation has been successful.
+  */
+  bool adaptyst_get_region_percentile(amod_t id, const char *name,
+                                      const char *part_id, double percentile,
+                                      unsigned long long *ns);
+
+  /**
+     A table of module entry points which a module can supply
+     directly by defining adaptyst_module_get_vtable().
+
+     Adaptyst resolves the entry points only once, when the module is
+     loaded: if adaptyst_module_get_vtable() is defined and returns a table
+     whose version is ADAPTYST_MODULE_VTABLE_VERSION, the table is used
+     as is. Otherwise, the entry points are looked up by their names
+     (adaptyst_module_init(), adaptyst_module_process() etc.).
+
+     init, process and close must be set, region_start, region_end
+     and region_summary may be NULL if the module doesn't handle regions.
+     iteration may be NULL if the module doesn't need to know about
+     repeated runs of the workflow.
+  */
+  typedef struct {
+    /** Must be set to ADAPTYST_MODULE_VTABLE_VERSION. */
+    unsigned int version;
+
+    /** Equivalent of adaptyst_module_init(). */
+    bool (*init)(amod_t module_id);
+
+    /** Equivalent of adaptyst_module_process(). */
+    bool (*process)(amod_t module_id, ir workflow);
+
+    /** Equivalent of adaptyst_module_close(). */
+    void (*close)(amod_t module_id);
+
+    /** Equivalent of adaptyst_region_start(). */
+    bool (*region_start)(amod_t module_id, const char *name,
+                         const char *part_id, const char *timestamp_str);
+
+    /** Equivalent of adaptyst_region_end(). */
+    bool (*region_end)(amod_t module_id, const char *name,
+                       const char *part_id, const char *timestamp_str);
+
+    /** Equivalent of adaptyst_region_summary(). */
+    bool (*region_summary)(amod_t module_id, const char *name,
+                           const char *part_id,
+                           const adaptyst_region_summary *summary);
+
+    /** Equivalent of adaptyst_module_iteration(). */
+    bool (*iteration)(amod_t module_id, unsigned int iteration, bool warmup);
+  } adaptyst_module_vtable;
+
 #ifdef ADAPTYST_MODULE_ENTRYPOINT
+  /**
+     Optional. Returns the table of entry points of the module, see
+     adaptyst_module_vtable. The returned table must stay valid
+     as long as the module is loaded.
+  */
+  const adaptyst_module_vtable *adaptyst_module_get_vtable(void);
+
   bool adaptyst_module_init(amod_t module_id);
   bool adaptyst_module_process(amod_t module_id, ir workflow);
   void adaptyst_module_close(amod_t module_id);
@@ -611,6 +1066,31 @@ extern "C" {
                              const char *part_id, const char *timestamp_str);
   bool adaptyst_region_end(amod_t module_id, const char *name,
                            const char *part_id, const char *timestamp_str);
+
+  /**
+     Optional. Receives a summary of instances of a region aggregated
+     by the workflow (see adaptyst_region_policy) instead of their
+     start and end events.
+  */
+  bool adaptyst_region_summary(amod_t module_id, const char *name,
+                               const char *part_id,
+                               const adaptyst_region_summary *summary);
+
+  /**
+     Optional. Called when the workflow is run several times with
+     the module kept initialised (see the --runs and --warmup-runs
+     options of Adaptyst), before adaptyst_module_process() of every run.
+     At that point, adaptyst_get_module_dir() already returns the
+     directory of the run.
+
+     @param iteration The 0-based index of the run, counted separately
+                      for warm-up and measured runs.
+     @param warmup    Whether the run is a warm-up one, whose results
+                      are discarded.
+     @return Whether the module is ready for the run.
+  */
+  bool adaptyst_module_iteration(amod_t module_id, unsigned int iteration,
+                                 bool warmup);
 #endif
 #ifdef __cplusplus
 }
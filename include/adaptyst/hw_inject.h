@@ -6,6 +6,8 @@
 
 #include <adaptyst/amod_t.h>
 #include <adaptyst/inject_errors.h>
+#include <adaptyst/channel.h>
+#include <adaptyst/send_queue.h>
 
 #define ADAPTYST_MODULE_OK 0
 #define ADAPTYST_MODULE_ERR 1
@@ -29,6 +31,46 @@ int adaptyst_receive_data_timeout_nl(amod_t id, char *buf, unsigned int buf_size
 int adaptyst_send_string_nl(amod_t id, const char *str);
 int adaptyst_receive_string_nl(amod_t id, const char **str);
 int adaptyst_receive_string_timeout_nl(amod_t id, const char **str, long timeout_seconds);
+int adaptyst_send_message(amod_t id, const char *buf, unsigned int n);
+int adaptyst_receive_message(amod_t id, const char **buf, unsigned int *n);
+int adaptyst_receive_message_timeout(amod_t id, const char **buf, unsigned int *n,
+                                     long timeout_seconds);
+int adaptyst_send_message_nl(amod_t id, const char *buf, unsigned int n);
+int adaptyst_receive_message_nl(amod_t id, const char **buf, unsigned int *n);
+int adaptyst_receive_message_timeout_nl(amod_t id, const char **buf, unsigned int *n,
+                                        long timeout_seconds);
+int adaptyst_send_file(amod_t id, const char *path);
+int adaptyst_receive_file(amod_t id, const char *path, unsigned long long n,
+                          unsigned long long *received);
+int adaptyst_receive_file_timeout(amod_t id, const char *path, unsigned long long n,
+                                  unsigned long long *received, long timeout_seconds);
+int adaptyst_send_file_nl(amod_t id, const char *path);
+int adaptyst_receive_file_nl(amod_t id, const char *path, unsigned long long n,
+                             unsigned long long *received);
+int adaptyst_receive_file_timeout_nl(amod_t id, const char *path, unsigned long long n,
+                                     unsigned long long *received, long timeout_seconds);
+int adaptyst_send_data_async(amod_t id, const char *buf, unsigned int n,
+                             int *queued);
+int adaptyst_send_string_async(amod_t id, const char *str, int *queued);
+int adaptyst_send_message_async(amod_t id, const char *buf, unsigned int n,
+                                int *queued);
+int adaptyst_send_flush(amod_t id);
+int adaptyst_set_send_policy(amod_t id, unsigned long long high_water_mark,
+                             adaptyst_send_policy policy);
+int adaptyst_get_send_stats(amod_t id, adaptyst_send_stats *stats);
+int adaptyst_send_data_async_nl(amod_t id, const char *buf, unsigned int n,
+                                int *queued);
+int adaptyst_send_string_async_nl(amod_t id, const char *str, int *queued);
+int adaptyst_send_message_async_nl(amod_t id, const char *buf, unsigned int n,
+                                   int *queued);
+int adaptyst_send_flush_nl(amod_t id);
+int adaptyst_set_send_policy_nl(amod_t id, unsigned long long high_water_mark,
+                                adaptyst_send_policy policy);
+int adaptyst_get_send_stats_nl(amod_t id, adaptyst_send_stats *stats);
+int adaptyst_get_channel(amod_t id, const char *name,
+                         adaptyst_channel_t *channel);
+int adaptyst_get_channel_nl(amod_t id, const char *name,
+                            adaptyst_channel_t *channel);
 void adaptyst_set_error(const char *msg);
 void adaptyst_set_error_nl(const char *msg);
 unsigned long long adaptyst_get_timestamp(int *err);
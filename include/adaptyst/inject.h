@@ -6,10 +6,13 @@
 
 #include <adaptyst/amod_t.h>
 #include <adaptyst/inject_errors.h>
+#include <adaptyst/region.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
+typedef struct adaptyst_region *adaptyst_region_t;
+
 void adaptyst_set_print_errors(unsigned int print);
 int adaptyst_init();
 int adaptyst_init_custom_buf_size(unsigned int size);
@@ -17,6 +20,11 @@ const char **adaptyst_get_runtime_info();
 char *adaptyst_get_error_msg();
 int adaptyst_region_start(const char *name);
 int adaptyst_region_end(const char *name);
+int adaptyst_region_register(const char *name, adaptyst_region_t *region);
+int adaptyst_region_start_h(adaptyst_region_t region);
+int adaptyst_region_end_h(adaptyst_region_t region);
+int adaptyst_region_set_policy(adaptyst_region_t region,
+                               const adaptyst_region_policy *policy);
 void adaptyst_close();
 #ifdef __cplusplus
 }
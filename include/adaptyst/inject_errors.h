@@ -16,5 +16,7 @@
 #define ADAPTYST_INJECT_ERR_REGION_ALREADY_STARTED 9
 #define ADAPTYST_INJECT_ERR_INVALID_REGION_STATE 10
 #define ADAPTYST_INJECT_ERR_REGION_IN_DIFFERENT_UNIT 11
+#define ADAPTYST_INJECT_ERR_INVALID_REGION 12
+#define ADAPTYST_INJECT_ERR_CHANNEL_NOT_FOUND 13
 
 #endif
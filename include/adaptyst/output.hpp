@@ -4,27 +4,269 @@
 #ifndef ADAPTYST_OUTPUT_HPP_
 #define ADAPTYST_OUTPUT_HPP_
 
+#include "os_detect.h"
 #include <filesystem>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <mutex>
 #include <fstream>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <typeinfo>
+#include <type_traits>
+
+#ifdef ADAPTYST_TABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#define TABLE_FORMAT_VERSION 1
+#define TABLE_DEFAULT_CHUNK_ROWS 65536
+#define TABLE_MAX_PENDING_CHUNKS 16
+#define TABLE_ZSTD_LEVEL 3
+
+#ifdef ADAPTYST_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BINARY_ARRAY_MAGIC 0x52414441
+#define BINARY_ARRAY_VERSION 1
+#define BINARY_ARRAY_INITIAL_CAPACITY 4096
+#endif
 
 namespace adaptyst {
   namespace fs = std::filesystem;
 
+  /**
+     This class keeps parsed metadata files (e.g. dirmeta.json) in memory
+     so that every file is read at most once per process and repeated
+     updates are coalesced into a single write at a sync point (see sync()).
+     Files are written atomically by replacing them with a complete
+     temporary copy. Metadata which have been written and aren't used
+     by any object are dropped from memory at sync points.
+
+     All remaining changes are written when the process exits normally.
+  */
+  class MetadataCache {
+  public:
+    /**
+       Metadata of a single file.
+    */
+    struct Entry {
+      std::mutex mutex;
+      fs::path path;
+      nlohmann::json data;
+      bool dirty;
+    };
+
+    static MetadataCache &instance();
+
+    /**
+       Gets the cached metadata of a file, reading and parsing it
+       first if this is the first time it's requested.
+
+       @param path Path to the metadata file. It doesn't need to exist.
+
+       @throw std::runtime_error If the file exists but cannot be read.
+    */
+    std::shared_ptr<Entry> get(fs::path path) {
+      std::unique_lock lock(this->mutex);
+      auto entry = this->entries.find(path.string());
+
+      if (entry != this->entries.end()) {
+        return entry->second;
+      }
+
+      std::shared_ptr<Entry> new_entry = std::make_shared<Entry>();
+      new_entry->path = path;
+      new_entry->data = nlohmann::json::object();
+      new_entry->dirty = false;
+
+      if (fs::exists(path)) {
+        std::ifstream metadata_stream(path);
+
+        if (!metadata_stream) {
+          throw std::runtime_error("Could not open " + path.string() +
+                                   " for reading!");
+        }
+
+        std::string json_str((std::istreambuf_iterator<char>(metadata_stream)),
+                             std::istreambuf_iterator<char>());
+        new_entry->data = nlohmann::json::parse(json_str);
+      }
+
+      this->entries[path.string()] = new_entry;
+      return new_entry;
+    }
+
+    /**
+       Creates a directory along with its parents unless it's already
+       known to exist.
+
+       @param path Path to the directory.
+
+       @throw std::runtime_error If the directory cannot be created.
+    */
+    void create_directories(fs::path &path) {
+      std::unique_lock lock(this->mutex);
+
+      if (this->directories.contains(path.string())) {
+        return;
+      }
+
+      try {
+        fs::create_directories(path);
+      } catch (std::exception &e) {
+        throw std::runtime_error("Could not create directory " +
+                                 path.string() + ": " +
+                                 std::string(e.what()));
+      }
+
+      this->directories.insert(path.string());
+    }
+
+    /**
+       Writes metadata of a single file to disk if it has changed
+       since the last write.
+
+       @param entry Metadata to write.
+
+       @throw std::runtime_error If the file cannot be written.
+    */
+    static void write(Entry &entry) {
+      std::unique_lock lock(entry.mutex);
+
+      if (!entry.dirty || entry.path.empty()) {
+        return;
+      }
+
+      fs::path tmp_path = entry.path;
+      tmp_path += ".tmp";
+
+      {
+        std::ofstream metadata_stream(tmp_path);
+
+        if (!metadata_stream) {
+          throw std::runtime_error("Could not open " + tmp_path.string() +
+                                   " for writing!");
+        }
+
+        metadata_stream << entry.data.dump() << std::endl;
+
+        if (!metadata_stream) {
+          throw std::runtime_error("Could not write to " + tmp_path.string() + "!");
+        }
+      }
+
+      try {
+        fs::rename(tmp_path, entry.path);
+      } catch (std::exception &e) {
+        throw std::runtime_error("Could not replace " + entry.path.string() +
+                                 ": " + std::string(e.what()));
+      }
+
+      entry.dirty = false;
+    }
+
+    /**
+       Writes all metadata changed since the last write to disk and
+       drops the written metadata which aren't used anymore.
+
+       @throw std::runtime_error If any file cannot be written. All other
+                                 files are still written.
+    */
+    void sync() {
+      std::vector<std::shared_ptr<Entry> > to_write;
+
+      {
+        std::unique_lock lock(this->mutex);
+
+        for (auto &entry : this->entries) {
+          to_write.push_back(entry.second);
+        }
+      }
+
+      std::string errors = "";
+
+      for (auto &entry : to_write) {
+        try {
+          MetadataCache::write(*entry);
+        } catch (std::exception &e) {
+          errors += std::string(errors.empty() ? "" : "\n") + e.what();
+        }
+      }
+
+      to_write.clear();
+
+      {
+        // No new reference can be obtained without the mutex, so
+        // an entry referred to only by the cache is safe to drop
+        // (it's read from disk again if requested later)
+        std::unique_lock lock(this->mutex);
+        std::erase_if(this->entries, [](auto &entry) {
+          if (entry.second.use_count() > 1) {
+            return false;
+          }
+
+          std::unique_lock entry_lock(entry.second->mutex);
+          return !entry.second->dirty;
+        });
+      }
+
+      if (!errors.empty()) {
+        throw std::runtime_error(errors);
+      }
+    }
+
+    ~MetadataCache() {
+      try {
+        this->sync();
+      } catch (...) { }
+    }
+
+  private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry> > entries;
+    std::unordered_set<std::string> directories;
+
+    MetadataCache() { }
+  };
+
   /**
      This abstract class describes an arbitrary object with attached metadata in
      form of key-value pairs, where the value type is templatised.
    */
   class ObjectWithMetadata {
   protected:
-    nlohmann::json metadata;
+    std::shared_ptr<MetadataCache::Entry> metadata_entry;
+
+    /**
+       Gets the metadata of the object. Subclasses can override this
+       to set up metadata lazily.
+    */
+    virtual MetadataCache::Entry &get_metadata_entry() {
+      return *this->metadata_entry;
+    }
 
   public:
     ObjectWithMetadata() {
-      this->metadata = nlohmann::json::object();
+      this->metadata_entry = std::make_shared<MetadataCache::Entry>();
+      this->metadata_entry->data = nlohmann::json::object();
+      this->metadata_entry->dirty = false;
     }
 
+    virtual ~ObjectWithMetadata() { }
+
     /**
        Sets a key-value pair in the metadata.
 
@@ -36,13 +278,21 @@ namespace adaptyst {
     template<class T>
     void set_metadata(std::string key, T value,
                       bool save = true) {
-      if (this->metadata[key] != value) {
-        this->metadata[key] = value;
+      MetadataCache::Entry &entry = this->get_metadata_entry();
+      bool changed = false;
+
+      {
+        std::unique_lock lock(entry.mutex);
 
-        if (save) {
-          this->save_metadata();
+        if (entry.data[key] != value) {
+          entry.data[key] = value;
+          changed = true;
         }
       }
+
+      if (changed && save) {
+        this->save_metadata();
+      }
     }
 
     /**
@@ -57,7 +307,9 @@ namespace adaptyst {
     */
     template<class T>
     T get_metadata(std::string key, T default_value) {
-      return this->metadata.value(key, default_value);
+      MetadataCache::Entry &entry = this->get_metadata_entry();
+      std::unique_lock lock(entry.mutex);
+      return entry.data.value(key, default_value);
     }
 
     /**
@@ -70,51 +322,71 @@ namespace adaptyst {
     */
     template<class T>
     T get_metadata(std::string key) {
-      return this->metadata[key].get<T>();
+      MetadataCache::Entry &entry = this->get_metadata_entry();
+      std::unique_lock lock(entry.mutex);
+      return entry.data[key].get<T>();
     }
 
     /**
-       Saves metadata in a way dependent on the implementation,
-       e.g. to disk.
+       Marks metadata as to be saved. They are written to disk or elsewhere
+       at the next sync point (see MetadataCache::sync()), together
+       with any other changes made in the meantime.
     */
-    virtual void save_metadata() = 0;
+    virtual void save_metadata() {
+      MetadataCache::Entry &entry = this->get_metadata_entry();
+      std::unique_lock lock(entry.mutex);
+      entry.dirty = true;
+    }
+
+    /**
+       Saves metadata immediately, without waiting for the next
+       sync point.
+    */
+    void sync_metadata() {
+      this->save_metadata();
+      MetadataCache::write(this->get_metadata_entry());
+    }
   };
 
   /**
      This class represents a directory path with metadata attached
      to it thanks to inheriting from ObjectWithMetadata.
+
+     Paths obtained through concatenation (operator/) do not touch
+     the filesystem until they are used, i.e. until their name or
+     metadata are requested or a file is created inside.
   */
   class Path : public ObjectWithMetadata {
     friend class File;
 
   private:
     fs::path path;
+    bool set_up;
 
-    void setup(fs::path path) {
-      this->path = fs::absolute(path);
-      try {
-        fs::create_directories(this->path);
-      } catch (std::exception &e) {
-        throw std::runtime_error("Could not create directory " +
-                                 this->path.string() + ": " +
-                                 std::string(e.what()));
-      }
+    Path(fs::path path, bool lazy) {
+      this->path = path;
+      this->set_up = false;
 
-      fs::path metadata_path = this->path / "dirmeta.json";
+      if (!lazy) {
+        this->setup();
+      }
+    }
 
-      if (fs::exists(metadata_path)) {
-        std::ifstream metadata_stream(metadata_path);
+    void setup() {
+      if (this->set_up) {
+        return;
+      }
 
-        if (!metadata_stream) {
-          throw std::runtime_error("Could not open " +
-                                 (this->path / "dirmeta.json").string() +
-                                 " for reading!");
-        }
+      MetadataCache &cache = MetadataCache::instance();
+      cache.create_directories(this->path);
+      this->metadata_entry = cache.get(this->path / "dirmeta.json");
+      this->set_up = true;
+    }
 
-        std::string json_str((std::istreambuf_iterator<char>(metadata_stream)),
-                             std::istreambuf_iterator<char>());
-        this->metadata = nlohmann::json::parse(json_str);
-      }
+  protected:
+    MetadataCache::Entry &get_metadata_entry() {
+      this->setup();
+      return *this->metadata_entry;
     }
 
   public:
@@ -123,9 +395,7 @@ namespace adaptyst {
 
        @param path Path the object should be about.
     */
-    Path(fs::path path) {
-      this->setup(path);
-    }
+    Path(fs::path path) : Path(fs::absolute(path), false) { }
 
     /**
        Gets the full path name.
@@ -133,6 +403,7 @@ namespace adaptyst {
        @return Full path name.
     */
     const char *get_path_name() {
+      this->setup();
       return this->path.c_str();
     }
 
@@ -142,7 +413,7 @@ namespace adaptyst {
        @param second String the path should be concatenated with.
     */
     Path operator/(std::string second) {
-      return Path(this->path / second);
+      return Path(this->path / second, true);
     }
 
     /**
@@ -152,22 +423,7 @@ namespace adaptyst {
                      concatenated with.
     */
     Path operator/(const char *second) {
-      return Path(this->path / second);
-    }
-
-    /**
-       Saves metadata to disk.
-    */
-    void save_metadata() {
-      std::ofstream metadata_stream(this->path / "dirmeta.json");
-
-      if (!metadata_stream) {
-        throw std::runtime_error("Could not open " +
-                                 (this->path / "dirmeta.json").string() +
-                                 " for writing!");
-      }
-
-      metadata_stream << this->metadata.dump() << std::endl;
+      return Path(this->path / second, true);
     }
   };
 
@@ -183,6 +439,21 @@ namespace adaptyst {
     std::ifstream istream;
     std::ofstream ostream;
 
+    struct Unopened { };
+
+    /**
+       Constructs a File object without opening any streams, for
+       derived classes accessing the file in other ways (e.g. by mapping
+       it into memory).
+    */
+    File(Path &path, std::string name, Unopened) : path(path) {
+      this->name = name;
+      path.setup();
+
+      this->metadata_entry =
+        MetadataCache::instance().get(path.path / ("meta_" + this->name + ".json"));
+    }
+
   public:
     /**
        Constructs a File object.
@@ -197,6 +468,7 @@ namespace adaptyst {
          std::string extension = "",
          bool truncate = true) : path(path) {
       this->name = name;
+      path.setup();
 
       fs::path new_path = path.path / (name + extension);
 
@@ -219,21 +491,8 @@ namespace adaptyst {
                                  " for writing!");
       }
 
-      fs::path metadata_path = path.path / ("meta_" + this->name + ".json");
-
-      if (fs::exists(metadata_path)) {
-        std::ifstream metadata_stream(metadata_path);
-
-        if (!metadata_stream) {
-          throw std::runtime_error("Could not open " +
-                                 (path.path / ("meta_" + this->name + ".json")).string() +
-                                 " for reading!");
-        }
-
-        std::string json_str((std::istreambuf_iterator<char>(metadata_stream)),
-                             std::istreambuf_iterator<char>());
-        this->metadata = nlohmann::json::parse(json_str);
-      }
+      this->metadata_entry =
+        MetadataCache::instance().get(path.path / ("meta_" + this->name + ".json"));
     }
 
     File &operator=(File &&source) {
@@ -241,7 +500,7 @@ namespace adaptyst {
       this->name = source.name;
       this->istream = std::move(source.istream);
       this->ostream = std::move(source.ostream);
-      this->metadata.swap(source.metadata);
+      this->metadata_entry.swap(source.metadata_entry);
       return *this;
     }
 
@@ -262,22 +521,6 @@ namespace adaptyst {
     std::ofstream &get_ostream() {
       return this->ostream;
     }
-
-    /**
-       Saves metadata to disk, separately from the file itself.
-    */
-    void save_metadata() {
-      fs::path metadata_path = path.path / ("meta_" + this->name + ".json");
-
-      std::ofstream metadata_stream(metadata_path);
-
-      if (!metadata_stream) {
-        throw std::runtime_error("Could not open " + metadata_path.string() +
-                                 " for writing!");
-      }
-
-      metadata_stream << this->metadata.dump() << std::endl;
-    }
   };
 
   template<typename T>
@@ -351,12 +594,759 @@ namespace adaptyst {
       this->vec.push_back(val);
 
       if constexpr (is_pair<T>) {
-        this->ostream << val.first << " " << val.second << std::endl;
+        this->ostream << val.first << " " << val.second << '\n';
+      } else {
+        this->ostream << val << '\n';
+      }
+    }
+
+    /**
+       Makes sure that all pushed elements have been written to disk.
+    */
+    void flush() {
+      this->ostream.flush();
+    }
+  };
+
+  /**
+     This class represents a table with a fixed schema of typed columns
+     saved to a binary file and with metadata attached to it (thanks to
+     inheriting from File which inherits from ObjectWithMetadata) and
+     saved separately.
+
+     Rows are appended to a buffer of the calling thread. When the buffer
+     has chunk_rows rows, it is handed over to a background thread which
+     encodes every column of the chunk separately, compresses it with zstd
+     if Adaptyst has been built with zstd support and appends it to the file.
+     The order of rows appended by the same thread is kept, but rows of
+     different threads end up in different chunks.
+
+     Integer columns are stored as zigzag varints of differences between
+     consecutive values, "double" columns as native doubles and "string"
+     columns as varint lengths followed by the bytes.
+
+     The layout of the file is described by the metadata only, so that
+     readers can read just the columns they need and skip chunks based on
+     the minimum and maximum values of a column (e.g. a time range):
+     * "format_version": TABLE_FORMAT_VERSION,
+     * "columns": the schema, i.e. [{"name": ..., "type": "int64", "uint64",
+       "double" or "string"}, ...],
+     * "compression": "zstd" or "none",
+     * "rows": the number of rows in the file,
+     * "chunks": [{"rows": ..., "columns": [{"offset": ..., "size": ...,
+       "raw_size": ..., "min": ..., "max": ...}, ...]}, ...], where offset
+       and size describe where the column is in the file (in bytes),
+       raw_size is its size before compression and min and max are not
+       set for "string" columns.
+
+     Use Array or BinaryArray instead if there is only one column.
+  */
+  class Table : public File {
+  public:
+    /**
+       A type of a column.
+    */
+    enum ColumnType {
+      INT64,
+      UINT64,
+      DOUBLE,
+      STRING
+    };
+
+    /**
+       A column of a table schema.
+    */
+    struct Column {
+      std::string name;
+      ColumnType type;
+    };
+
+    /**
+       Constructs a Table object. If the table already exists, new rows
+       are added after the existing ones.
+
+       @param path       Path to a directory where the table is.
+       @param name       Name of the table.
+       @param schema     Columns of the table.
+       @param chunk_rows The number of rows of a chunk.
+
+       @throw std::runtime_error If the file cannot be opened or if it is
+                                 a table with a different schema.
+    */
+    Table(Path &path, std::string name, std::vector<Column> schema,
+          unsigned int chunk_rows = TABLE_DEFAULT_CHUNK_ROWS) : File(path, name, ".tbl", false) {
+      this->file_path = fs::path(path.get_path_name()) / (name + ".tbl");
+      this->schema = schema;
+      this->chunk_rows = std::max(chunk_rows, 1U);
+      this->id = Table::next_id++;
+      this->stop = false;
+      this->writing = false;
+
+#ifdef ADAPTYST_TABLE_ZSTD
+      std::string compression = "zstd";
+#else
+      std::string compression = "none";
+#endif
+
+      nlohmann::json columns = nlohmann::json::array();
+
+      for (auto &column : schema) {
+        columns.push_back({{"name", column.name},
+                           {"type", Table::get_type_name(column.type)}});
+      }
+
+      nlohmann::json existing = this->get_metadata<nlohmann::json>("columns",
+                                                                   nullptr);
+
+      if (!existing.is_null()) {
+        if (existing != columns ||
+            this->get_metadata<int>("format_version", 0) != TABLE_FORMAT_VERSION) {
+          throw std::runtime_error(this->file_path.string() + " is a table with "
+                                   "a different schema");
+        }
+
+        if (this->get_metadata<std::string>("compression", "") != compression) {
+          throw std::runtime_error(this->file_path.string() + " uses "
+                                   "a different compression");
+        }
+
+        this->chunks = this->get_metadata<nlohmann::json>("chunks");
+        this->rows = this->get_metadata<unsigned long long>("rows");
+      } else {
+        this->chunks = nlohmann::json::array();
+        this->rows = 0;
+        this->set_metadata<int>("format_version", TABLE_FORMAT_VERSION, false);
+        this->set_metadata<nlohmann::json>("columns", columns, false);
+        this->set_metadata<std::string>("compression", compression, false);
+        this->set_metadata<nlohmann::json>("chunks", this->chunks, false);
+        this->set_metadata<unsigned long long>("rows", 0);
+      }
+
+      this->offset = fs::file_size(this->file_path);
+      this->writer = std::thread([this]() { this->write_loop(); });
+    }
+
+    Table(const Table &) = delete;
+    Table &operator=(const Table &) = delete;
+
+    /**
+       Writes all buffered rows and waits for the background thread
+       to finish.
+    */
+    ~Table() {
+      try {
+        this->flush();
+      } catch (...) { }
+
+      {
+        std::unique_lock lock(this->queue_mutex);
+        this->stop = true;
+      }
+
+      this->queue_cv.notify_all();
+      this->writer.join();
+    }
+
+    /**
+       Appends a row to the buffer of the calling thread. Values must be
+       given in the order of the schema: numbers for numeric columns
+       (converted to the column type) and strings for "string" columns.
+
+       This blocks only when the background thread is more than
+       TABLE_MAX_PENDING_CHUNKS chunks behind.
+
+       @throw std::runtime_error If the values do not match the schema or
+                                 if writing an earlier chunk has failed.
+    */
+    template<class... Args>
+    void append(Args&&... values) {
+      size_t index = 0;
+
+      if (sizeof...(Args) != this->schema.size() ||
+          !(Table::is_compatible<Args>(this->schema[index++].type) && ...)) {
+        throw std::runtime_error("The values do not match the schema of table " +
+                                 this->name);
+      }
+
+      Buffer &buffer = this->get_buffer();
+      std::unique_lock lock(buffer.mutex);
+
+      index = 0;
+      ((Table::add_value(buffer.chunk.columns[index], this->schema[index].type,
+                         std::forward<Args>(values)), index++), ...);
+
+      if (++buffer.chunk.rows >= this->chunk_rows) {
+        Chunk chunk = std::move(buffer.chunk);
+        this->init_chunk(buffer.chunk);
+        lock.unlock();
+        this->submit(std::move(chunk));
+      }
+    }
+
+    /**
+       Makes sure that all rows appended so far, including the ones
+       in buffers of other threads, have been written to disk and
+       described in the metadata.
+
+       @throw std::runtime_error If any chunk could not be written.
+    */
+    void flush() {
+      std::vector<Chunk> to_submit;
+
+      {
+        std::unique_lock lock(this->buffers_mutex);
+
+        for (auto &entry : this->buffers) {
+          std::unique_lock buffer_lock(entry.second->mutex);
+
+          if (entry.second->chunk.rows > 0) {
+            to_submit.push_back(std::move(entry.second->chunk));
+            this->init_chunk(entry.second->chunk);
+          }
+        }
+      }
+
+      for (auto &chunk : to_submit) {
+        this->submit(std::move(chunk));
+      }
+
+      std::unique_lock lock(this->queue_mutex);
+      this->queue_cv.wait(lock, [this]() {
+        return (this->queue.empty() && !this->writing) || this->error;
+      });
+
+      if (this->error) {
+        std::rethrow_exception(this->error);
+      }
+
+      this->ostream.flush();
+    }
+
+    /**
+       Gets the columns of the table.
+    */
+    std::vector<Column> &get_schema() {
+      return this->schema;
+    }
+
+    /**
+       Gets the name of a column type as used in the metadata.
+    */
+    static const char *get_type_name(ColumnType type) {
+      switch (type) {
+      case INT64:
+        return "int64";
+      case UINT64:
+        return "uint64";
+      case DOUBLE:
+        return "double";
+      default:
+        return "string";
+      }
+    }
+
+  private:
+    struct ColumnData {
+      std::vector<long long> ints;
+      std::vector<unsigned long long> uints;
+      std::vector<double> doubles;
+      std::vector<std::string> strings;
+    };
+
+    struct Chunk {
+      std::vector<ColumnData> columns;
+      unsigned int rows;
+    };
+
+    struct Buffer {
+      std::mutex mutex;
+      Chunk chunk;
+    };
+
+    static inline std::atomic<unsigned long long> next_id = 1;
+
+    fs::path file_path;
+    std::vector<Column> schema;
+    unsigned int chunk_rows;
+    unsigned long long id;
+
+    std::unordered_map<std::thread::id, std::unique_ptr<Buffer> > buffers;
+    std::mutex buffers_mutex;
+
+    std::deque<Chunk> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stop;
+    bool writing;
+    std::exception_ptr error;
+
+    // Used only by the background thread after construction
+    unsigned long long offset;
+    unsigned long long rows;
+    nlohmann::json chunks;
+
+    std::thread writer;
+
+    template<class T>
+    static bool is_compatible(ColumnType type) {
+      if constexpr (std::is_arithmetic_v<std::remove_cvref_t<T> >) {
+        return type != STRING;
       } else {
-        this->ostream << val << std::endl;
+        return type == STRING;
+      }
+    }
+
+    template<class T>
+    static void add_value(ColumnData &data, ColumnType type, T &&value) {
+      static_assert(std::is_arithmetic_v<std::remove_cvref_t<T> > ||
+                    std::is_convertible_v<T, std::string_view>,
+                    "Table values must be numbers or strings");
+
+      if constexpr (std::is_arithmetic_v<std::remove_cvref_t<T> >) {
+        if (type == INT64) {
+          data.ints.push_back((long long)value);
+        } else if (type == UINT64) {
+          data.uints.push_back((unsigned long long)value);
+        } else {
+          data.doubles.push_back((double)value);
+        }
+      } else {
+        data.strings.emplace_back(std::string_view(value));
+      }
+    }
+
+    Buffer &get_buffer() {
+      // IDs are never reused, so a cached buffer cannot belong to
+      // a destroyed table with the same address
+      thread_local unsigned long long last_id = 0;
+      thread_local Buffer *last_buffer = nullptr;
+
+      if (last_id != this->id) {
+        std::unique_lock lock(this->buffers_mutex);
+        std::unique_ptr<Buffer> &buffer = this->buffers[std::this_thread::get_id()];
+
+        if (!buffer) {
+          buffer = std::make_unique<Buffer>();
+          this->init_chunk(buffer->chunk);
+        }
+
+        last_buffer = buffer.get();
+        last_id = this->id;
+      }
+
+      return *last_buffer;
+    }
+
+    void init_chunk(Chunk &chunk) {
+      chunk.columns.clear();
+      chunk.columns.resize(this->schema.size());
+      chunk.rows = 0;
+
+      for (size_t i = 0; i < this->schema.size(); i++) {
+        switch (this->schema[i].type) {
+        case INT64:
+          chunk.columns[i].ints.reserve(this->chunk_rows);
+          break;
+        case UINT64:
+          chunk.columns[i].uints.reserve(this->chunk_rows);
+          break;
+        case DOUBLE:
+          chunk.columns[i].doubles.reserve(this->chunk_rows);
+          break;
+        default:
+          chunk.columns[i].strings.reserve(this->chunk_rows);
+          break;
+        }
+      }
+    }
+
+    void submit(Chunk &&chunk) {
+      std::unique_lock lock(this->queue_mutex);
+      this->queue_cv.wait(lock, [this]() {
+        return this->queue.size() < TABLE_MAX_PENDING_CHUNKS || this->error;
+      });
+
+      if (this->error) {
+        std::rethrow_exception(this->error);
+      }
+
+      this->queue.push_back(std::move(chunk));
+      this->queue_cv.notify_all();
+    }
+
+    void write_loop() {
+      std::unique_lock lock(this->queue_mutex);
+
+      while (true) {
+        this->queue_cv.wait(lock, [this]() {
+          return !this->queue.empty() || this->stop;
+        });
+
+        if (this->queue.empty()) {
+          break;
+        }
+
+        Chunk chunk = std::move(this->queue.front());
+        this->queue.pop_front();
+        this->writing = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+
+        try {
+          this->write_chunk(chunk);
+        } catch (...) {
+          error = std::current_exception();
+        }
+
+        lock.lock();
+        this->writing = false;
+
+        if (error && !this->error) {
+          this->error = error;
+        }
+
+        this->queue_cv.notify_all();
+      }
+    }
+
+    static void put_varint(std::string &out, unsigned long long value) {
+      while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+      }
+
+      out.push_back((char)value);
+    }
+
+    template<class T>
+    static void put_deltas(std::string &out, std::vector<T> &values,
+                           nlohmann::json &column) {
+      unsigned long long prev = 0;
+
+      for (T value : values) {
+        // The difference wraps around, so it is always representable
+        long long delta = (long long)((unsigned long long)value - prev);
+        Table::put_varint(out, ((unsigned long long)delta << 1) ^
+                          (unsigned long long)(delta >> 63));
+        prev = (unsigned long long)value;
+      }
+
+      auto minmax = std::minmax_element(values.begin(), values.end());
+      column["min"] = *minmax.first;
+      column["max"] = *minmax.second;
+    }
+
+    void write_chunk(Chunk &chunk) {
+      nlohmann::json columns = nlohmann::json::array();
+
+      for (size_t i = 0; i < this->schema.size(); i++) {
+        ColumnData &data = chunk.columns[i];
+        nlohmann::json column = nlohmann::json::object();
+        std::string block;
+
+        switch (this->schema[i].type) {
+        case INT64:
+          Table::put_deltas(block, data.ints, column);
+          break;
+
+        case UINT64:
+          Table::put_deltas(block, data.uints, column);
+          break;
+
+        case DOUBLE: {
+          block.resize(data.doubles.size() * sizeof(double));
+          std::memcpy(block.data(), data.doubles.data(), block.size());
+
+          auto minmax = std::minmax_element(data.doubles.begin(),
+                                            data.doubles.end());
+          column["min"] = *minmax.first;
+          column["max"] = *minmax.second;
+          break;
+        }
+
+        default:
+          for (auto &value : data.strings) {
+            Table::put_varint(block, value.size());
+            block += value;
+          }
+
+          break;
+        }
+
+        column["raw_size"] = block.size();
+
+#ifdef ADAPTYST_TABLE_ZSTD
+        std::string compressed(ZSTD_compressBound(block.size()), '\0');
+        size_t size = ZSTD_compress(compressed.data(), compressed.size(),
+                                    block.data(), block.size(), TABLE_ZSTD_LEVEL);
+
+        if (ZSTD_isError(size)) {
+          throw std::runtime_error("Could not compress a chunk of table " +
+                                   this->name + ": " + ZSTD_getErrorName(size));
+        }
+
+        compressed.resize(size);
+        block.swap(compressed);
+#endif
+
+        this->ostream.write(block.data(), block.size());
+
+        if (!this->ostream) {
+          throw std::runtime_error("Could not write to " + this->file_path.string());
+        }
+
+        column["offset"] = this->offset;
+        column["size"] = block.size();
+        this->offset += block.size();
+
+        columns.push_back(column);
+      }
+
+      this->chunks.push_back({{"rows", chunk.rows}, {"columns", columns}});
+      this->rows += chunk.rows;
+
+      this->set_metadata<nlohmann::json>("chunks", this->chunks, false);
+      this->set_metadata<unsigned long long>("rows", this->rows);
+    }
+  };
+
+#ifdef ADAPTYST_UNIX
+  /**
+     Gets the tag identifying the type of elements stored in
+     a BinaryArray file. The tag of arithmetic types depends only on
+     their kind and size, while the tag of other types is derived from
+     their type name and may therefore differ between compilers.
+  */
+  template<class T>
+  unsigned long long get_binary_array_type_tag() {
+    if constexpr (std::is_arithmetic_v<T>) {
+      unsigned long long kind = std::is_floating_point_v<T> ? 3 :
+        (std::is_signed_v<T> ? 2 : 1);
+      return (kind << 32) | sizeof(T);
+    } else {
+      unsigned long long hash = 14695981039346656037ULL;
+
+      for (const char *c = typeid(T).name(); *c; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+      }
+
+      return hash;
+    }
+  }
+
+  /**
+     This class represents an array of trivially-copyable values saved
+     to a memory-mapped binary file and with metadata attached to it
+     (thanks to inheriting from File which inherits from ObjectWithMetadata)
+     and saved separately.
+
+     The file consists of a 64-byte header (magic number, format version,
+     element size, type tag and element count) followed by the elements
+     in the native byte order. Pushing an element is a plain memory store,
+     elements are accessed without copying and opening an existing
+     array takes the same time regardless of its size.
+
+     Use Array instead if the file should be human-readable.
+  */
+  template<class T> requires std::is_trivially_copyable_v<T>
+  class BinaryArray : public File {
+  private:
+    struct Header {
+      unsigned int magic;
+      unsigned int version;
+      unsigned int element_size;
+      unsigned int reserved;
+      unsigned long long type_tag;
+      unsigned long long count;
+      unsigned long long padding[4];
+    };
+
+    static_assert(sizeof(Header) == 64);
+
+    fs::path file_path;
+    int fd;
+    void *mem;
+    size_t mapped_size;
+    size_t capacity;
+    Header *header;
+    T *elements;
+
+    // The current mapping is replaced only once the new one is ready,
+    // so that the array stays intact if growing it fails
+    void map(size_t capacity) {
+      size_t new_size = sizeof(Header) + capacity * sizeof(T);
+
+      if (ftruncate(this->fd, new_size) == -1) {
+        throw std::runtime_error("Could not resize " + this->file_path.string() +
+                                 ", error " + std::to_string(errno));
+      }
+
+      void *mem = mmap(nullptr, new_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, this->fd, 0);
+
+      if (mem == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + this->file_path.string() +
+                                 " into memory, error " + std::to_string(errno));
+      }
+
+      if (this->mem) {
+        munmap(this->mem, this->mapped_size);
+      }
+
+      this->mem = mem;
+      this->mapped_size = new_size;
+      this->capacity = capacity;
+      this->header = (Header *)mem;
+      this->elements = (T *)((char *)mem + sizeof(Header));
+    }
+
+  public:
+    /**
+       Constructs a BinaryArray object.
+
+       @param path Path to a directory where the array is.
+       @param name Name of the array.
+
+       @throw std::runtime_error If the file cannot be opened or mapped into
+                                 memory or if it is not a binary array
+                                 of elements of type T.
+    */
+    BinaryArray(Path &path, std::string name) : File(path, name, Unopened()) {
+      this->file_path = fs::path(path.get_path_name()) / (name + ".bin");
+      this->mem = nullptr;
+      this->mapped_size = 0;
+      this->fd = open(this->file_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+      if (this->fd == -1) {
+        throw std::runtime_error("Could not open " + this->file_path.string() +
+                                 ", error " + std::to_string(errno));
+      }
+
+      struct stat stat_buf;
+
+      if (fstat(this->fd, &stat_buf) == -1) {
+        ::close(this->fd);
+        throw std::runtime_error("Could not stat " + this->file_path.string() +
+                                 ", error " + std::to_string(errno));
+      }
+
+      try {
+        if (stat_buf.st_size == 0) {
+          this->map(BINARY_ARRAY_INITIAL_CAPACITY);
+          this->header->magic = BINARY_ARRAY_MAGIC;
+          this->header->version = BINARY_ARRAY_VERSION;
+          this->header->element_size = sizeof(T);
+          this->header->reserved = 0;
+          this->header->type_tag = get_binary_array_type_tag<T>();
+          this->header->count = 0;
+        } else {
+          if ((size_t)stat_buf.st_size < sizeof(Header)) {
+            throw std::runtime_error(this->file_path.string() + " is not "
+                                     "a binary array");
+          }
+
+          this->map((stat_buf.st_size - sizeof(Header)) / sizeof(T));
+
+          if (this->header->magic != BINARY_ARRAY_MAGIC ||
+              this->header->version != BINARY_ARRAY_VERSION ||
+              this->header->count > this->capacity) {
+            throw std::runtime_error(this->file_path.string() + " is not "
+                                     "a binary array");
+          }
+
+          if (this->header->element_size != sizeof(T) ||
+              this->header->type_tag != get_binary_array_type_tag<T>()) {
+            throw std::runtime_error(this->file_path.string() + " stores "
+                                     "elements of a different type");
+          }
+        }
+      } catch (...) {
+        if (this->mem) {
+          munmap(this->mem, this->mapped_size);
+        }
+
+        ::close(this->fd);
+        throw;
+      }
+    }
+
+    BinaryArray(const BinaryArray &) = delete;
+    BinaryArray &operator=(const BinaryArray &) = delete;
+
+    ~BinaryArray() {
+      size_t count = this->header->count;
+      munmap(this->mem, this->mapped_size);
+
+      // Unused capacity is not kept on disk (the array remains valid
+      // if this fails)
+      int code = ftruncate(this->fd, sizeof(Header) + count * sizeof(T));
+      (void)code;
+
+      ::close(this->fd);
+    }
+
+    /**
+       Accesses the index-th element of the array. The reference
+       is valid until the next call of push_back().
+
+       @param index Array index to access.
+
+       @return index-th element of the array.
+    */
+    T &operator[](size_t index) {
+      return this->elements[index];
+    }
+
+    /**
+       Gets the pointer to the first element of the array. The pointer
+       is valid until the next call of push_back().
+    */
+    T *data() {
+      return this->elements;
+    }
+
+    /**
+       Gets the current array size.
+
+       @return Array size.
+    */
+    size_t size() {
+      return this->header->count;
+    }
+
+    /**
+       Pushes a new element to the end of the array. The file is grown
+       geometrically when needed.
+
+       @param val Value to push.
+
+       @throw std::runtime_error If the file cannot be grown.
+    */
+    void push_back(const T &val) {
+      size_t count = this->header->count;
+
+      if (count == this->capacity) {
+        this->map(std::max<size_t>(2 * this->capacity,
+                                   BINARY_ARRAY_INITIAL_CAPACITY));
+      }
+
+      this->elements[count] = val;
+      this->header->count = count + 1;
+    }
+
+    /**
+       Makes sure that all pushed elements have been written to disk.
+    */
+    void flush() {
+      if (msync(this->mem, this->mapped_size, MS_SYNC) == -1) {
+        throw std::runtime_error("Could not flush " + this->file_path.string() +
+                                 ", error " + std::to_string(errno));
       }
     }
   };
+#endif
 }
 
 #endif
@@ -17,6 +17,16 @@
 #include <sys/wait.h>
 #endif
 
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <thread>
+#endif
+
 namespace adaptyst {
   namespace fs = std::filesystem;
 
@@ -36,6 +46,29 @@ namespace adaptyst {
     cpu_set_t cpu_analysis_set;
     cpu_set_t cpu_workflow_set;
 #endif
+    unsigned long analysis_memory_nodes;
+    unsigned long workflow_memory_nodes;
+
+#ifdef ADAPTYST_UNIX
+    static unsigned long get_numa_nodes(const cpu_set_t &set) {
+      unsigned long nodes = 0;
+
+      for (int i = 0; i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET(i, &set)) {
+          int node = CPUConfig::get_numa_node(i);
+
+          if (node < 0 || (size_t)node >= sizeof(nodes) * 8) {
+            // Binding to a subset of nodes would be wrong here
+            return 0;
+          }
+
+          nodes |= 1UL << node;
+        }
+      }
+
+      return nodes;
+    }
+#endif
 
   public:
     /**
@@ -44,6 +77,8 @@ namespace adaptyst {
     */
     CPUConfig() {
       this->valid = false;
+      this->analysis_memory_nodes = 0;
+      this->workflow_memory_nodes = 0;
     }
 
     /**
@@ -59,6 +94,8 @@ namespace adaptyst {
     CPUConfig(std::string mask) {
       this->valid = false;
       this->profiler_thread_count = 0;
+      this->analysis_memory_nodes = 0;
+      this->workflow_memory_nodes = 0;
 
 #ifdef ADAPTYST_UNIX
       CPU_ZERO(&this->cpu_analysis_set);
@@ -131,7 +168,66 @@ namespace adaptyst {
     cpu_set_t get_cpu_workflow_set() const {
       return this->cpu_workflow_set;
     }
+
+    /**
+       Makes processes started with this configuration allocate memory
+       only from the NUMA nodes of their cores, i.e. the ones for doing
+       the performance analysis or the ones for running the workflow.
+       Nothing changes for a set of cores whose NUMA nodes cannot
+       be determined.
+    */
+    void bind_memory() {
+      if (!this->valid) {
+        return;
+      }
+
+      this->analysis_memory_nodes = CPUConfig::get_numa_nodes(this->cpu_analysis_set);
+      this->workflow_memory_nodes = CPUConfig::get_numa_nodes(this->cpu_workflow_set);
+    }
 #endif
+
+    /**
+       Returns the bitmask of NUMA nodes that processes doing
+       the performance analysis should allocate memory from, or 0
+       if memory allocations should not be restricted.
+    */
+    unsigned long get_analysis_memory_nodes() const {
+      return this->analysis_memory_nodes;
+    }
+
+    /**
+       Returns the bitmask of NUMA nodes that the workflow should
+       allocate memory from, or 0 if memory allocations should not
+       be restricted.
+    */
+    unsigned long get_workflow_memory_nodes() const {
+      return this->workflow_memory_nodes;
+    }
+
+    /**
+       Returns the NUMA node of a logical core.
+
+       @param cpu The logical core number.
+
+       @return The NUMA node ID or -1 if it cannot be determined,
+               e.g. on a system without NUMA support.
+    */
+    static int get_numa_node(int cpu) {
+      std::error_code err;
+      fs::directory_iterator it(fs::path("/sys/devices/system/cpu") /
+                                ("cpu" + std::to_string(cpu)), err);
+
+      for (; !err && it != fs::directory_iterator(); it.increment(err)) {
+        std::string name = it->path().filename().string();
+
+        if (name.length() > 4 && name.starts_with("node") &&
+            name.find_first_not_of("0123456789", 4) == std::string::npos) {
+          return std::stoi(name.substr(4));
+        }
+      }
+
+      return -1;
+    }
   };
 
   /**
@@ -153,6 +249,7 @@ namespace adaptyst {
     unsigned int buf_size;
     int exit_code;
     std::function<void()> notify_callback;
+    fs::path executable;
 #ifdef ADAPTYST_UNIX
     int notify_pipe[2];
     int stdin_pipe[2];
@@ -165,12 +262,343 @@ namespace adaptyst {
     bool completed;
     int id;
 
+#ifdef __linux__
+    static const size_t SPAWN_STACK_SIZE = 65536;
+
+    // Everything the child of spawn() needs, prepared beforehand so that
+    // the child makes only system calls before execve()
+    struct SpawnChild {
+      int close_fds[3];
+      int notify_fd;
+      int pid_fd;
+      int stdin_fd;
+      int stdout_fd;
+      const char *stdout_path;
+      const char *stderr_path;
+      const char *working_dir;
+      bool set_affinity;
+      cpu_set_t affinity;
+      unsigned long memory_nodes;
+      char **paths;
+      char **argv;
+      char **envp;
+      sigset_t sigmask;
+    };
+
+    struct SpawnState {
+      SpawnChild child;
+      std::vector<std::string> paths;
+      std::vector<std::string> env_entries;
+      std::vector<char *> path_ptrs;
+      std::vector<char *> argv_ptrs;
+      std::vector<char *> env_ptrs;
+      std::string stdout_path;
+      std::string stderr_path;
+      std::string working_dir;
+    };
+
+    std::thread spawner;
+#endif
+
     inline void close_fd(int fd) {
       if (fd != -1) {
         close(fd);
       }
     }
 
+#ifdef __linux__
+    static int spawn_child(void *arg) {
+      SpawnChild *child = (SpawnChild *)arg;
+
+      // The address space is shared with Adaptyst until execve(), so its
+      // signal handlers must not run here
+      struct sigaction default_action = {};
+      default_action.sa_handler = SIG_DFL;
+
+      for (int sig = 1; sig < _NSIG; sig++) {
+        struct sigaction action;
+
+        if (sigaction(sig, nullptr, &action) == 0 &&
+            action.sa_handler != SIG_DFL && action.sa_handler != SIG_IGN) {
+          sigaction(sig, &default_action, nullptr);
+        }
+      }
+
+      sigprocmask(SIG_SETMASK, &child->sigmask, nullptr);
+
+      for (int i = 0; i < 3; i++) {
+        if (child->close_fds[i] != -1) {
+          close(child->close_fds[i]);
+        }
+      }
+
+      if (child->pid_fd != -1) {
+        pid_t pid = getpid();
+
+        if (write(child->pid_fd, &pid, sizeof(pid)) != sizeof(pid)) {
+          _exit(Process::ERROR_START);
+        }
+
+        close(child->pid_fd);
+      }
+
+      if (child->notify_fd != -1) {
+        char buf;
+        int received = read(child->notify_fd, &buf, 1);
+        close(child->notify_fd);
+
+        if (received <= 0 || buf != 0x03) {
+          _exit(Process::ERROR_START);
+        }
+      }
+
+      if (chdir(child->working_dir) == -1) {
+        _exit(Process::ERROR_WORKING_DIR);
+      }
+
+      if (child->stderr_path) {
+        int stderr_fd = creat(child->stderr_path,
+                              S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+        if (stderr_fd == -1) {
+          _exit(Process::ERROR_STDERR);
+        }
+
+        if (dup2(stderr_fd, STDERR_FILENO) == -1) {
+          _exit(Process::ERROR_STDERR_DUP2);
+        }
+
+        close(stderr_fd);
+      }
+
+      int stdout_fd = child->stdout_fd;
+
+      if (child->stdout_path) {
+        stdout_fd = creat(child->stdout_path,
+                          S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+        if (stdout_fd == -1) {
+          _exit(Process::ERROR_STDOUT);
+        }
+      }
+
+      if (stdout_fd != -1) {
+        if (dup2(stdout_fd, STDOUT_FILENO) == -1) {
+          _exit(Process::ERROR_STDOUT_DUP2);
+        }
+
+        close(stdout_fd);
+      }
+
+      if (dup2(child->stdin_fd, STDIN_FILENO) == -1) {
+        _exit(Process::ERROR_STDIN_DUP2);
+      }
+
+      close(child->stdin_fd);
+
+      if (child->set_affinity) {
+        if (sched_setaffinity(0, sizeof(child->affinity), &child->affinity) == -1) {
+          _exit(Process::ERROR_AFFINITY);
+        }
+
+        if (child->memory_nodes != 0 &&
+            syscall(SYS_set_mempolicy, MPOL_BIND, &child->memory_nodes,
+                    sizeof(child->memory_nodes) * 8 + 1) == -1) {
+          _exit(Process::ERROR_MEMORY_POLICY);
+        }
+      }
+
+      // The same search as in execvpe(), with the candidate paths
+      // built by Adaptyst
+      bool no_access = false;
+
+      for (int i = 0; child->paths[i]; i++) {
+        execve(child->paths[i], child->argv, child->envp);
+
+        if (errno == EACCES) {
+          no_access = true;
+        } else if (errno != ENOENT && errno != ENOTDIR) {
+          _exit(errno);
+        }
+      }
+
+      _exit(no_access ? Process::ERROR_NO_ACCESS : Process::ERROR_NOT_FOUND);
+    }
+
+    // Starts a child sharing the address space of Adaptyst like with
+    // vfork(), so that nothing is copied regardless of how much memory
+    // Adaptyst and its modules use. The calling thread is suspended until
+    // the child calls execve() or exits, so the child can use its stack,
+    // TLS (including errno) and the prepared arguments safely.
+    static pid_t clone_child(SpawnChild &child) {
+      void *stack = mmap(nullptr, Process::SPAWN_STACK_SIZE,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+      if (stack == MAP_FAILED) {
+        return -1;
+      }
+
+      sigset_t all_signals;
+      sigfillset(&all_signals);
+      pthread_sigmask(SIG_SETMASK, &all_signals, &child.sigmask);
+
+      pid_t pid = clone(Process::spawn_child,
+                        (char *)stack + Process::SPAWN_STACK_SIZE,
+                        CLONE_VM | CLONE_VFORK | SIGCHLD, &child);
+
+      pthread_sigmask(SIG_SETMASK, &child.sigmask, nullptr);
+      munmap(stack, Process::SPAWN_STACK_SIZE);
+      return pid;
+    }
+
+    // Starts a command with clone_child(). A command waiting for notify()
+    // cannot be started by the calling thread, as it would be suspended
+    // until the notification it is supposed to send. Such a command is
+    // started by a separate thread instead (which is what is suspended),
+    // with the child reporting its PID through a pipe before waiting.
+    pid_t spawn(std::vector<std::string> &env_entries,
+                const CPUConfig &cpu_config, bool is_analysis,
+                fs::path &working_path) {
+      auto state = std::make_unique<SpawnState>();
+      std::vector<std::string> &elems = std::get<0>(this->command);
+
+      if (!this->executable.empty()) {
+        state->paths.push_back(this->executable.string());
+      } else if (elems[0].find('/') != std::string::npos) {
+        state->paths.push_back(elems[0]);
+      } else {
+        const char *path_env = getenv("PATH");
+        std::string search = path_env ? path_env : "/bin:/usr/bin";
+        size_t begin = 0;
+
+        while (true) {
+          size_t end = search.find(':', begin);
+          std::string dir = search.substr(begin, end == std::string::npos ?
+                                          std::string::npos : end - begin);
+          state->paths.push_back((dir.empty() ? "." : dir) + "/" + elems[0]);
+
+          if (end == std::string::npos) {
+            break;
+          }
+
+          begin = end + 1;
+        }
+      }
+
+      state->env_entries = std::move(env_entries);
+
+      for (auto &path : state->paths) {
+        state->path_ptrs.push_back((char *)path.c_str());
+      }
+
+      for (auto &elem : elems) {
+        state->argv_ptrs.push_back((char *)elem.c_str());
+      }
+
+      for (auto &entry : state->env_entries) {
+        state->env_ptrs.push_back((char *)entry.c_str());
+      }
+
+      state->path_ptrs.push_back(nullptr);
+      state->argv_ptrs.push_back(nullptr);
+      state->env_ptrs.push_back(nullptr);
+      state->working_dir = working_path.string();
+
+      SpawnChild &child = state->child;
+      child.close_fds[0] = this->stdin_pipe[1];
+      child.close_fds[1] = this->stdout_pipe[0];
+      child.close_fds[2] = -1;
+      child.notify_fd = -1;
+      child.pid_fd = -1;
+      child.stdin_fd = this->stdin_pipe[0];
+      child.stdout_fd = -1;
+      child.stdout_path = nullptr;
+      child.stderr_path = nullptr;
+      child.working_dir = state->working_dir.c_str();
+      child.paths = state->path_ptrs.data();
+      child.argv = state->argv_ptrs.data();
+      child.envp = state->env_ptrs.data();
+
+      if (!this->stdout_redirect) {
+        child.stdout_fd = this->stdout_pipe[1];
+      } else if (this->stdout_fd != nullptr) {
+        child.stdout_fd = *(this->stdout_fd);
+      } else if (!this->stdout_terminal) {
+        state->stdout_path = this->stdout_path.string();
+        child.stdout_path = state->stdout_path.c_str();
+      }
+
+      if (this->stderr_redirect) {
+        state->stderr_path = this->stderr_path.string();
+        child.stderr_path = state->stderr_path.c_str();
+      }
+
+      child.set_affinity = cpu_config.is_valid();
+      child.memory_nodes = 0;
+
+      if (child.set_affinity) {
+        child.affinity = is_analysis ? cpu_config.get_cpu_analysis_set() :
+          cpu_config.get_cpu_workflow_set();
+        child.memory_nodes = is_analysis ?
+          cpu_config.get_analysis_memory_nodes() :
+          cpu_config.get_workflow_memory_nodes();
+      }
+
+      if (!this->notifiable) {
+        return Process::clone_child(child);
+      }
+
+      int pid_pipe[2];
+
+      if (pipe2(pid_pipe, O_CLOEXEC) == -1) {
+        return -1;
+      }
+
+      child.close_fds[2] = this->notify_pipe[1];
+      child.notify_fd = this->notify_pipe[0];
+      child.pid_fd = pid_pipe[1];
+
+      try {
+        this->spawner = std::thread([state = std::move(state)]() {
+          Process::clone_child(state->child);
+
+          // This also tells the reader below that clone() has failed
+          // if the child hasn't reported anything
+          close(state->child.pid_fd);
+        });
+      } catch (std::system_error &) {
+        close(pid_pipe[0]);
+        close(pid_pipe[1]);
+        return -1;
+      }
+
+      // The file descriptors of the child are copied when it is created,
+      // so start() can close them only after that
+      pid_t pid;
+      int received;
+
+      do {
+        received = read(pid_pipe[0], &pid, sizeof(pid));
+      } while (received == -1 && errno == EINTR);
+
+      close(pid_pipe[0]);
+
+      if (received != sizeof(pid)) {
+        this->spawner.join();
+        return -1;
+      }
+
+      return pid;
+    }
+
+    void join_spawner() {
+      if (this->spawner.joinable()) {
+        this->spawner.join();
+      }
+    }
+#endif
+
     void init(unsigned int buf_size) {
       this->stdout_redirect = false;
       this->stdout_terminal = false;
@@ -280,6 +708,16 @@ namespace adaptyst {
     */
     static const int ERROR_ABNORMAL_EXIT = 210;
 
+    /**
+       Error exit code when setting the NUMA memory policy for the process.
+    */
+    static const int ERROR_MEMORY_POLICY = 211;
+
+    /**
+       Error exit code when changing the working directory of the process.
+    */
+    static const int ERROR_WORKING_DIR = 212;
+
     /**
        Constructs a Process object.
 
@@ -332,6 +770,10 @@ namespace adaptyst {
         waitpid(this->id, nullptr, 0);
 #endif
       }
+
+#ifdef __linux__
+      this->join_spawner();
+#endif
     }
 
     /**
@@ -379,6 +821,15 @@ namespace adaptyst {
 #endif
     }
 
+    /**
+       Sets the file to be executed for a shell command rather than
+       looking for the first element of the command in PATH. The first
+       element is then used only as argv[0].
+    */
+    void set_executable(fs::path path) {
+      this->executable = path;
+    }
+
     /**
        Redirects stderr to a specified file.
 
@@ -393,6 +844,14 @@ namespace adaptyst {
        Spawns a new process executing a code or command specified in the
        constructor and returns the ID of the process immediately.
 
+       On Linux, a shell command is started by a child sharing the memory
+       of the current process until it executes the command (like with
+       vfork()), so that the cost of starting it doesn't depend on how
+       much memory the current process uses. This applies to commands
+       waiting for a notification too, with the child waiting before
+       executing the command. A code is run in a forked copy of
+       the current process.
+
        @param wait_for_notify Indicates whether the process should wait
                               for a notification before executing. If true,
                               the notification should be sent via notify().
@@ -464,7 +923,17 @@ namespace adaptyst {
                                                               this->buf_size);
       }
 
-      pid_t forked = fork();
+      pid_t forked;
+
+#ifdef __linux__
+      if (this->command.index() == 0) {
+        forked = this->spawn(env_entries, cpu_config, is_analysis, working_path);
+      } else {
+        forked = fork();
+      }
+#else
+      forked = fork();
+#endif
 
       if (forked == 0) {
         // This executed in a separate process with everything effectively
@@ -562,9 +1031,25 @@ namespace adaptyst {
             if (sched_setaffinity(0, sizeof(affinity), &affinity) == -1) {
               std::exit(Process::ERROR_AFFINITY);
             }
+
+#ifdef __linux__
+            unsigned long memory_nodes = is_analysis ?
+              cpu_config.get_analysis_memory_nodes() :
+              cpu_config.get_workflow_memory_nodes();
+
+            if (memory_nodes != 0 &&
+                syscall(SYS_set_mempolicy, MPOL_BIND, &memory_nodes,
+                        sizeof(memory_nodes) * 8 + 1) == -1) {
+              std::exit(Process::ERROR_MEMORY_POLICY);
+            }
+#endif
           }
 
-          execvpe(elems[0].c_str(), argv, env);
+          if (this->executable.empty()) {
+            execvpe(elems[0].c_str(), argv, env);
+          } else {
+            execve(this->executable.c_str(), argv, env);
+          }
 
           // This is reached only if execvpe fails
           switch (errno) {
@@ -713,6 +1198,10 @@ namespace adaptyst {
           throw Process::WaitException();
         }
 
+#ifdef __linux__
+        this->join_spawner();
+#endif
+
         this->started = false;
         this->notifiable = false;
         this->completed = true;
@@ -0,0 +1,114 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef ADAPTYST_REGION_H_
+#define ADAPTYST_REGION_H_
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+/**
+   \def ADAPTYST_REGION_HISTOGRAM_BUCKETS
+   The number of buckets in the duration histogram of
+   adaptyst_region_summary.
+*/
+#define ADAPTYST_REGION_HISTOGRAM_BUCKETS 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+     A policy deciding which instances of a region are reported
+     as region start and end events.
+  */
+  typedef struct {
+    /**
+       Only every sample_every-th instance of the region in a workflow
+       part (i.e. a thread) is reported. 0 and 1 mean every instance.
+    */
+    unsigned int sample_every;
+
+    /**
+       Only instances lasting at least that many nanoseconds are reported,
+       0 for no threshold. The start event of such an instance is reported
+       only after the instance ends, with its original timestamp.
+    */
+    unsigned long long min_duration_ns;
+
+    /**
+       Whether instances should be aggregated into summaries (see
+       adaptyst_region_summary) rather than reported one by one.
+       sample_every and min_duration_ns are ignored in this case.
+    */
+    bool aggregate;
+
+    /**
+       How often summaries of an aggregated region are reported
+       by a workflow part, in milliseconds, checked whenever an instance
+       ends. Summaries are also reported when the injection resources
+       are closed, so 0 means that this is the only time they are reported.
+    */
+    unsigned int flush_interval_ms;
+  } adaptyst_region_policy;
+
+  /**
+     A summary of instances of an aggregated region in a workflow part
+     since the previous summary.
+  */
+  typedef struct {
+    /** The number of instances. */
+    unsigned long long count;
+
+    /** The total duration of the instances in nanoseconds. */
+    unsigned long long total_ns;
+
+    /** The duration of the shortest instance in nanoseconds. */
+    unsigned long long min_ns;
+
+    /** The duration of the longest instance in nanoseconds. */
+    unsigned long long max_ns;
+
+    /**
+       The histogram of durations: histogram[0] is the number of instances
+       shorter than 2 ns and histogram[i] for i > 0 is the number of instances
+       lasting between 2^i ns (inclusive) and 2^(i + 1) ns (exclusive).
+    */
+    unsigned long long histogram[ADAPTYST_REGION_HISTOGRAM_BUCKETS];
+  } adaptyst_region_summary;
+
+  /**
+     Statistics of durations of all ended instances of a region,
+     maintained by Adaptyst while the workflow runs. Percentiles have
+     a relative error of at most 12.5%.
+  */
+  typedef struct {
+    /** The number of instances. */
+    unsigned long long count;
+
+    /** The total duration of the instances in nanoseconds. */
+    unsigned long long total_ns;
+
+    /** The duration of the shortest instance in nanoseconds. */
+    unsigned long long min_ns;
+
+    /** The duration of the longest instance in nanoseconds. */
+    unsigned long long max_ns;
+
+    /** The median duration in nanoseconds. */
+    unsigned long long p50_ns;
+
+    /** The 90th percentile of durations in nanoseconds. */
+    unsigned long long p90_ns;
+
+    /** The 99th percentile of durations in nanoseconds. */
+    unsigned long long p99_ns;
+
+    /** The 99.9th percentile of durations in nanoseconds. */
+    unsigned long long p999_ns;
+  } adaptyst_region_stats;
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef ADAPTYST_SEND_QUEUE_H_
+#define ADAPTYST_SEND_QUEUE_H_
+
+/**
+   \def ADAPTYST_SEND_DEFAULT_HIGH_WATER_MARK
+   The default maximum number of bytes waiting in the send queue
+   of a module before its policy applies (see adaptyst_send_policy).
+*/
+#define ADAPTYST_SEND_DEFAULT_HIGH_WATER_MARK (1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+     What adaptyst_send_data_async() and its relatives do when
+     a message would make the send queue of a module exceed its
+     high-water mark.
+
+     adaptyst_send_data_async(), adaptyst_send_string_async() and
+     adaptyst_send_message_async() copy a message to the send queue
+     of a module and return without waiting for Adaptyst to read it,
+     setting *queued (if not NULL) to whether the message has been
+     queued rather than dropped. Queued messages are written in order
+     by a thread of the injection library, small ones being batched
+     together, and the synchronous send functions wait for them first.
+     adaptyst_send_flush() waits until the queue is empty and
+     adaptyst_set_send_policy() sets the high-water mark and policy
+     of a module (ADAPTYST_SEND_DEFAULT_HIGH_WATER_MARK and
+     ADAPTYST_SEND_BLOCK by default).
+
+     A message is always accepted by an empty queue, even if it's
+     larger than the high-water mark.
+  */
+  typedef enum {
+    /** The caller waits until enough queued bytes are sent. */
+    ADAPTYST_SEND_BLOCK = 0,
+
+    /** The new message is dropped. */
+    ADAPTYST_SEND_DROP = 1,
+
+    /**
+       The newest queued message is replaced by the new one and counted
+       as dropped, so that only the latest state of what is sent reaches
+       Adaptyst. If the newest message has started being sent already,
+       the new one is dropped.
+    */
+    ADAPTYST_SEND_COALESCE = 2
+  } adaptyst_send_policy;
+
+  /**
+     Counters of the send queue of a module, as returned by
+     adaptyst_get_send_stats().
+  */
+  typedef struct {
+    /** The number of bytes waiting to be sent. */
+    unsigned long long queued_bytes;
+
+    /** The number of messages waiting to be sent. */
+    unsigned long long queued_messages;
+
+    /** The number of bytes sent so far. */
+    unsigned long long sent_bytes;
+
+    /** The number of messages sent so far. */
+    unsigned long long sent_messages;
+
+    /** The number of bytes dropped or coalesced so far. */
+    unsigned long long dropped_bytes;
+
+    /** The number of messages dropped or coalesced so far. */
+    unsigned long long dropped_messages;
+
+    /**
+       The number of write calls made so far. Small messages queued
+       together are sent with a single call.
+    */
+    unsigned long long write_calls;
+  } adaptyst_send_stats;
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,15 +6,23 @@
 
 #include "os_detect.h"
 #include <string>
-#include <queue>
+#include <string_view>
+#include <vector>
 #include <memory>
 #include <iostream>
 #include <filesystem>
 #include <Poco/Net/ServerSocket.h>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <fstream>
 #include <poll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <functional>
+#include <chrono>
 #include <Poco/Buffer.h>
 #include <Poco/Net/NetException.h>
 #include <Poco/StreamCopier.h>
@@ -23,6 +31,12 @@
 
 #define UNLIMITED_ACCEPTED -1
 #define NO_TIMEOUT -1
+#define FRAME_HEADER_SIZE 4
+#define FRAMING_REQUEST "<ADAPTYST_FRAMED>"
+
+#ifndef MAX_MESSAGE_SIZE
+#define MAX_MESSAGE_SIZE 268435456
+#endif
 
 #ifndef FILE_BUFFER_SIZE
 #define FILE_BUFFER_SIZE 1048576
@@ -32,13 +46,6 @@ namespace adaptyst {
   namespace net = Poco::Net;
   namespace fs = std::filesystem;
 
-  class charstreambuf : public std::streambuf {
-  public:
-    charstreambuf(std::unique_ptr<char[]> &begin, unsigned int length) {
-      this->setg(begin.get(), begin.get(), begin.get() + length - 1);
-    }
-  };
-
   /**
      An exception which is thrown when a connection error occurs.
 
@@ -66,6 +73,675 @@ namespace adaptyst {
 
   };
 
+  /**
+     An exception which is thrown when the other end sends a message
+     longer than the maximum message size of the receiving end.
+  */
+  class MessageTooLongException : public ConnectionException {
+
+  };
+
+  /**
+     A class tracking the time left until a deadline, so that a timeout
+     can apply to a sequence of reads as a whole rather than to each of
+     them separately.
+  */
+  class Deadline {
+  private:
+    long timeout_seconds;
+    std::chrono::steady_clock::time_point end;
+    bool started;
+
+  public:
+    /**
+       Constructs a Deadline object expiring after a given time
+       from now.
+
+       @param timeout_seconds The number of seconds until the deadline,
+                              NO_TIMEOUT for no deadline.
+    */
+    Deadline(long timeout_seconds) {
+      this->timeout_seconds = timeout_seconds;
+      this->end = std::chrono::steady_clock::now() +
+        std::chrono::seconds(timeout_seconds == NO_TIMEOUT ? 0 : timeout_seconds);
+      this->started = false;
+    }
+
+    /**
+       Gets the timeout for the next read, i.e. the whole timeout for
+       the first read and the number of seconds left (rounded up)
+       for every next one.
+
+       @return The number of seconds, NO_TIMEOUT if there is no deadline.
+
+       @throw TimeoutException If the deadline has already passed.
+    */
+    long get_timeout() {
+      if (this->timeout_seconds == NO_TIMEOUT || !this->started) {
+        this->started = true;
+        return this->timeout_seconds;
+      }
+
+      auto left = std::chrono::ceil<std::chrono::seconds>(this->end -
+                                                           std::chrono::steady_clock::now());
+
+      if (left.count() <= 0) {
+        throw TimeoutException();
+      }
+
+      return left.count();
+    }
+  };
+
+  /**
+     A class extracting messages from data received through a connection.
+
+     By default, messages are newline-delimited. When the line equal to
+     FRAMING_REQUEST is received, all subsequent messages are expected to be
+     framed, i.e. prefixed by their length as a 4-byte big-endian unsigned
+     integer, so that they can contain any bytes, including newlines.
+
+     Empty messages are skipped in both modes. Messages longer than
+     the maximum message size are rejected in both modes, so that
+     the other end cannot make the buffer grow without bounds.
+  */
+  class MessageBuffer {
+  private:
+    std::vector<char> buf;
+    size_t start;
+    size_t end;
+    size_t scanned;
+    size_t max_message_size;
+    bool framed;
+
+  public:
+    /**
+       Constructs a MessageBuffer object.
+
+       @param buf_size         The initial buffer size in bytes. The buffer
+                               is grown when a message does not fit into it.
+       @param max_message_size The maximum message length in bytes.
+    */
+    MessageBuffer(unsigned int buf_size,
+                  size_t max_message_size = MAX_MESSAGE_SIZE) : buf(buf_size) {
+      this->start = 0;
+      this->end = 0;
+      this->scanned = 0;
+      this->max_message_size = max_message_size;
+      this->framed = false;
+    }
+
+    /**
+       Sets the maximum message length in bytes. This applies to
+       messages which haven't been extracted yet.
+    */
+    void set_max_message_size(size_t max_message_size) {
+      this->max_message_size = max_message_size;
+    }
+
+    /**
+       Gets the place where at least len bytes of newly-received data can
+       be written to. Any views returned by next() and take_remaining()
+       are invalidated.
+
+       @param len The number of bytes to be written.
+    */
+    char *reserve(unsigned int len) {
+      if (this->start == this->end) {
+        this->start = 0;
+        this->end = 0;
+        this->scanned = 0;
+      } else if (this->buf.size() - this->end < len && this->start > 0) {
+        std::memmove(this->buf.data(), this->buf.data() + this->start,
+                     this->end - this->start);
+        this->end -= this->start;
+        this->scanned -= this->start;
+        this->start = 0;
+      }
+
+      if (this->buf.size() - this->end < len) {
+        this->buf.resize(this->end + len);
+      }
+
+      return this->buf.data() + this->end;
+    }
+
+    /**
+       Marks len bytes written to the place returned by reserve() as
+       received.
+
+       @param len The number of bytes received.
+    */
+    void commit(unsigned int len) {
+      this->end += len;
+    }
+
+    /**
+       Extracts the next complete message.
+
+       @param msg Where the view of the message should be stored. The view
+                  is valid until reserve() is called.
+
+       @return Whether a complete message is available.
+
+       @throw MessageTooLongException When the next message is longer
+                                      than the maximum message size.
+    */
+    bool next(std::string_view &msg) {
+      while (true) {
+        if (this->framed) {
+          if (this->end - this->start < FRAME_HEADER_SIZE) {
+            return false;
+          }
+
+          const unsigned char *header =
+            (const unsigned char *)this->buf.data() + this->start;
+          size_t len = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+            ((size_t)header[2] << 8) | (size_t)header[3];
+
+          if (len > this->max_message_size) {
+            throw MessageTooLongException();
+          }
+
+          if (this->end - this->start - FRAME_HEADER_SIZE < len) {
+            return false;
+          }
+
+          msg = std::string_view(this->buf.data() + this->start + FRAME_HEADER_SIZE, len);
+          this->start += FRAME_HEADER_SIZE + len;
+          this->scanned = this->start;
+        } else {
+          const char *newline =
+            (const char *)std::memchr(this->buf.data() + this->scanned, '\n',
+                                      this->end - this->scanned);
+
+          if (!newline) {
+            if (this->end - this->start > this->max_message_size) {
+              throw MessageTooLongException();
+            }
+
+            this->scanned = this->end;
+            return false;
+          }
+
+          size_t pos = newline - this->buf.data();
+
+          if (pos - this->start > this->max_message_size) {
+            throw MessageTooLongException();
+          }
+
+          msg = std::string_view(this->buf.data() + this->start, pos - this->start);
+          this->start = pos + 1;
+          this->scanned = this->start;
+
+          if (msg == FRAMING_REQUEST) {
+            this->framed = true;
+            continue;
+          }
+        }
+
+        if (!msg.empty()) {
+          return true;
+        }
+      }
+    }
+
+    /**
+       Extracts all remaining data, regardless of whether they form
+       a complete message. This should be called when the other end
+       has closed the connection.
+
+       In the framed mode, the header of the incomplete frame is not
+       included.
+
+       @return The view of remaining data, valid until reserve() is called.
+    */
+    std::string_view take_remaining() {
+      size_t skipped = 0;
+
+      if (this->framed) {
+        skipped = std::min((size_t)FRAME_HEADER_SIZE, this->end - this->start);
+      }
+
+      std::string_view remaining(this->buf.data() + this->start + skipped,
+                                 this->end - this->start - skipped);
+      this->start = this->end;
+      this->scanned = this->end;
+      return remaining;
+    }
+
+    /**
+       Removes up to max_len bytes of received data from the buffer
+       regardless of message boundaries. This is used when raw data
+       (e.g. a file) follow a message.
+
+       @param max_len The maximum number of bytes to be removed.
+
+       @return The view of the removed data, valid until reserve()
+               is called.
+    */
+    std::string_view take(size_t max_len) {
+      size_t len = std::min(max_len, this->end - this->start);
+      std::string_view data(this->buf.data() + this->start, len);
+      this->start += len;
+      this->scanned = std::max(this->scanned, this->start);
+      return data;
+    }
+
+    /**
+       Writes the frame header for a message of a given length.
+
+       @param dst Where FRAME_HEADER_SIZE bytes of the header should
+                  be written to.
+       @param len The length of the message in bytes.
+    */
+    static void make_header(char *dst, unsigned int len) {
+      dst[0] = (len >> 24) & 0xff;
+      dst[1] = (len >> 16) & 0xff;
+      dst[2] = (len >> 8) & 0xff;
+      dst[3] = len & 0xff;
+    }
+  };
+
+  /**
+     A class moving file data between file descriptors inside the kernel
+     (with copy_file_range(), sendfile() or splice(), depending on
+     the types of file descriptors), without copying them through
+     user space.
+  */
+  class FileTransfer {
+  private:
+    static bool is_unsupported(int error) {
+      return error == EINVAL || error == ENOSYS || error == EOPNOTSUPP ||
+        error == EXDEV || error == EBADF;
+    }
+
+    static void wait_readable(int fd, long timeout_seconds) {
+      if (timeout_seconds == NO_TIMEOUT) {
+        return;
+      }
+
+      struct pollfd poll_struct;
+      poll_struct.fd = fd;
+      poll_struct.events = POLLIN;
+
+      int code = ::poll(&poll_struct, 1, 1000 * timeout_seconds);
+
+      if (code == -1) {
+        throw ConnectionException();
+      } else if (code == 0) {
+        throw TimeoutException();
+      }
+    }
+
+    static void throw_error(std::string func, int fd) {
+      std::runtime_error err(func + "() failed for fd " + std::to_string(fd) +
+                             ", error " + std::to_string(errno));
+      throw ConnectionException(err);
+    }
+
+  public:
+    /**
+       Sends the contents of a file to a file descriptor.
+
+       @param out_fd  The file descriptor the file should be sent to.
+       @param file_fd The file descriptor of the file, open for reading.
+       @param size    The size of the file in bytes.
+       @param sent    Where the number of bytes sent should be stored.
+
+       @return Whether the whole file has been sent. If false, no
+               in-kernel mechanism is available for out_fd and the rest
+               of the file starting at the offset of sent must be sent in
+               the usual way.
+
+       @throw ConnectionException In case of any errors.
+    */
+    static bool send(int out_fd, int file_fd, unsigned long long size,
+                     unsigned long long &sent) {
+      struct stat out_stat;
+      sent = 0;
+
+      if (fstat(out_fd, &out_stat) == -1) {
+        FileTransfer::throw_error("fstat", out_fd);
+      }
+
+      if (S_ISREG(out_stat.st_mode)) {
+        while (sent < size) {
+          off_t offset = sent;
+          ssize_t copied = copy_file_range(file_fd, &offset, out_fd, nullptr,
+                                           size - sent, 0);
+
+          if (copied == -1) {
+            if (errno == EINTR) {
+              continue;
+            } else if (FileTransfer::is_unsupported(errno)) {
+              break;
+            }
+
+            FileTransfer::throw_error("copy_file_range", out_fd);
+          } else if (copied == 0) {
+            // The file has been truncated in the meantime
+            return true;
+          }
+
+          sent += copied;
+        }
+      }
+
+      while (sent < size) {
+        off_t offset = sent;
+        ssize_t copied = sendfile(out_fd, file_fd, &offset, size - sent);
+
+        if (copied == -1) {
+          if (errno == EINTR) {
+            continue;
+          } else if (FileTransfer::is_unsupported(errno)) {
+            break;
+          }
+
+          FileTransfer::throw_error("sendfile", out_fd);
+        } else if (copied == 0) {
+          return true;
+        }
+
+        sent += copied;
+      }
+
+      if (S_ISFIFO(out_stat.st_mode)) {
+        while (sent < size) {
+          loff_t offset = sent;
+          ssize_t copied = splice(file_fd, &offset, out_fd, nullptr,
+                                  size - sent, SPLICE_F_MOVE);
+
+          if (copied == -1) {
+            if (errno == EINTR) {
+              continue;
+            } else if (FileTransfer::is_unsupported(errno)) {
+              break;
+            }
+
+            FileTransfer::throw_error("splice", out_fd);
+          } else if (copied == 0) {
+            return true;
+          }
+
+          sent += copied;
+        }
+      }
+
+      return sent == size;
+    }
+
+    /**
+       Receives a given number of bytes from a file descriptor and writes
+       them to a file.
+
+       @param in_fd           The file descriptor data should be received from.
+       @param file_fd         The file descriptor of the file, open for writing.
+       @param len             The number of bytes to be received.
+       @param timeout_seconds A maximum number of seconds that can pass while
+                              waiting for any data. Use NO_TIMEOUT for no timeout.
+       @param received        Where the number of bytes received should
+                              be stored.
+
+       @return Whether the transfer has finished, i.e. either len bytes have
+               been received or the other end has closed the connection.
+               If false, no in-kernel mechanism is available for in_fd and
+               the remaining data must be received in the usual way.
+
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException In case of any other errors.
+    */
+    static bool receive(int in_fd, int file_fd, unsigned long long len,
+                        long timeout_seconds, unsigned long long &received) {
+      struct stat in_stat;
+      received = 0;
+
+      if (fstat(in_fd, &in_stat) == -1) {
+        FileTransfer::throw_error("fstat", in_fd);
+      }
+
+      if (S_ISFIFO(in_stat.st_mode)) {
+        while (received < len) {
+          FileTransfer::wait_readable(in_fd, timeout_seconds);
+          ssize_t moved = splice(in_fd, nullptr, file_fd, nullptr,
+                                 len - received, SPLICE_F_MOVE);
+
+          if (moved == -1) {
+            if (errno == EINTR) {
+              continue;
+            } else if (received == 0 && FileTransfer::is_unsupported(errno)) {
+              return false;
+            }
+
+            FileTransfer::throw_error("splice", in_fd);
+          } else if (moved == 0) {
+            return true;
+          }
+
+          received += moved;
+        }
+
+        return true;
+      }
+
+      // splice() needs a pipe on one of its ends, so data coming from
+      // e.g. a socket go through an intermediate pipe (still without
+      // being copied to user space)
+      int pipe_fd[2];
+
+      if (pipe(pipe_fd) == -1) {
+        return false;
+      }
+
+      try {
+        while (received < len) {
+          FileTransfer::wait_readable(in_fd, timeout_seconds);
+          ssize_t moved = splice(in_fd, nullptr, pipe_fd[1], nullptr,
+                                 len - received, SPLICE_F_MOVE);
+
+          if (moved == -1) {
+            if (errno == EINTR) {
+              continue;
+            } else if (received == 0 && FileTransfer::is_unsupported(errno)) {
+              ::close(pipe_fd[0]);
+              ::close(pipe_fd[1]);
+              return false;
+            }
+
+            FileTransfer::throw_error("splice", in_fd);
+          } else if (moved == 0) {
+            break;
+          }
+
+          while (moved > 0) {
+            ssize_t written = splice(pipe_fd[0], nullptr, file_fd, nullptr,
+                                     moved, SPLICE_F_MOVE);
+
+            if (written == -1) {
+              if (errno == EINTR) {
+                continue;
+              }
+
+              FileTransfer::throw_error("splice", file_fd);
+            }
+
+            moved -= written;
+            received += written;
+          }
+        }
+      } catch (...) {
+        ::close(pipe_fd[0]);
+        ::close(pipe_fd[1]);
+        throw;
+      }
+
+      ::close(pipe_fd[0]);
+      ::close(pipe_fd[1]);
+      return true;
+    }
+
+    /**
+       Sends a file to a file descriptor, falling back to reading the file
+       into a buffer if no in-kernel mechanism is available.
+
+       @param file   The path to a file to be sent.
+       @param out_fd The file descriptor the file should be sent to.
+       @param write  The function writing a buffer through the connection
+                     out_fd belongs to, used for the fallback.
+
+       @throw ConnectionException In case of any errors.
+    */
+    static void send_file(fs::path file, int out_fd,
+                          std::function<void(unsigned int, char *)> write) {
+      int file_fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+      if (file_fd == -1) {
+        std::runtime_error err("Could not open the file " +
+                               file.string() + "!");
+        throw ConnectionException(err);
+      }
+
+      try {
+        struct stat file_stat;
+
+        if (fstat(file_fd, &file_stat) == -1) {
+          FileTransfer::throw_error("fstat", file_fd);
+        }
+
+        unsigned long long sent;
+
+        if (!FileTransfer::send(out_fd, file_fd, file_stat.st_size, sent)) {
+          std::unique_ptr<char[]> buf(new char[FILE_BUFFER_SIZE]);
+
+          while (true) {
+            ssize_t bytes_read = ::pread(file_fd, buf.get(), FILE_BUFFER_SIZE,
+                                         sent);
+
+            if (bytes_read == -1) {
+              if (errno == EINTR) {
+                continue;
+              }
+
+              FileTransfer::throw_error("pread", file_fd);
+            } else if (bytes_read == 0) {
+              break;
+            }
+
+            write(bytes_read, buf.get());
+            sent += bytes_read;
+          }
+        }
+      } catch (...) {
+        ::close(file_fd);
+        throw;
+      }
+
+      ::close(file_fd);
+    }
+
+    /**
+       Receives a given number of bytes from a file descriptor and writes
+       them to a file, falling back to reading data into a buffer if
+       no in-kernel mechanism is available.
+
+       @param file            The path to a file to be written. If it exists,
+                              it is truncated.
+       @param len             The number of bytes to be received.
+       @param buffered        Data which have already been received from
+                              in_fd and must go to the file first.
+       @param in_fd           The file descriptor data should be received from.
+       @param buf_size        The buffer size for the fallback, in bytes.
+       @param timeout_seconds A maximum number of seconds that can pass while
+                              waiting for any data. Use NO_TIMEOUT for no timeout.
+       @param read            The function reading data through the connection
+                              in_fd belongs to, used for the fallback.
+
+       @return The number of bytes received, including buffered.
+
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException In case of any other errors.
+    */
+    static unsigned long long receive_file(fs::path file, unsigned long long len,
+                                           std::string_view buffered, int in_fd,
+                                           unsigned int buf_size, long timeout_seconds,
+                                           std::function<int(char *, unsigned int,
+                                                             long)> read) {
+      int file_fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                           S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+      if (file_fd == -1) {
+        std::runtime_error err("Could not open the file " +
+                               file.string() + "!");
+        throw ConnectionException(err);
+      }
+
+      unsigned long long received = 0;
+
+      try {
+        FileTransfer::write_all(file_fd, buffered.data(), buffered.size());
+        received = buffered.size();
+
+        unsigned long long moved;
+        bool finished = received == len ||
+          FileTransfer::receive(in_fd, file_fd, len - received,
+                                timeout_seconds, moved);
+
+        if (received < len) {
+          received += moved;
+        }
+
+        if (!finished) {
+          std::unique_ptr<char[]> buf(new char[buf_size]);
+
+          while (received < len) {
+            int bytes_received = read(buf.get(),
+                                      std::min<unsigned long long>(buf_size,
+                                                                   len - received),
+                                      timeout_seconds);
+
+            if (bytes_received == -1) {
+              throw ConnectionException();
+            } else if (bytes_received == 0) {
+              break;
+            }
+
+            FileTransfer::write_all(file_fd, buf.get(), bytes_received);
+            received += bytes_received;
+          }
+        }
+      } catch (...) {
+        ::close(file_fd);
+        throw;
+      }
+
+      ::close(file_fd);
+      return received;
+    }
+
+    /**
+       Writes a whole buffer to a file descriptor.
+
+       @throw ConnectionException In case of any errors.
+    */
+    static void write_all(int fd, const char *buf, size_t len) {
+      while (len > 0) {
+        ssize_t written = ::write(fd, buf, len);
+
+        if (written == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          FileTransfer::throw_error("write", fd);
+        }
+
+        buf += written;
+        len -= written;
+      }
+    }
+  };
+
   /**
      An interface describing a two-end connection.
   */
@@ -106,19 +782,78 @@ namespace adaptyst {
     */
     virtual std::string read(long timeout_seconds = NO_TIMEOUT) = 0;
 
+    /**
+       Reads a message from the connection without copying it.
+
+       A message is either a line or a frame, depending on whether
+       the other end has enabled framing (see enable_framing()).
+
+       @param timeout_seconds A maximum number of seconds that can pass
+                              while waiting for the whole message (not
+                              just for any data of it). Use NO_TIMEOUT
+                              for no timeout.
+
+       @return The view of the message, valid until the next read from
+               the connection. An empty view means that the other end has
+               closed the connection.
+
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException In case of any other errors.
+    */
+    virtual std::string_view read_view(long timeout_seconds = NO_TIMEOUT) = 0;
+
+    /**
+       Sets the maximum length of a message which can be received through
+       the connection, MAX_MESSAGE_SIZE by default. Reading a longer
+       message results in MessageTooLongException.
+
+       @param max_message_size The maximum message length in bytes.
+    */
+    virtual void set_max_message_size(size_t max_message_size) = 0;
+
     /**
        Writes a string to the connection.
 
+       If framing is enabled (see enable_framing()), the string is sent as
+       a frame and new_line is ignored: the frame boundary delimits
+       the message instead and no newline character is sent, also when
+       new_line is true.
+
        @param msg      A string to be sent.
        @param new_line Indicates whether a newline character should be
-                       appended to the string.
+                       appended to the string. Ignored if framing is
+                       enabled.
 
        @throw ConnectionException In case of any errors.
     */
     virtual void write(std::string msg, bool new_line = true) = 0;
 
     /**
-       Writes a file to the connection.
+       Writes a message of arbitrary bytes (including newlines) to
+       the connection as a frame, enabling framing first if it hasn't
+       been enabled yet.
+
+       @param buf A buffer storing the message.
+       @param len The number of bytes of the message.
+
+       @throw ConnectionException In case of any errors.
+    */
+    virtual void write_message(const char *buf, unsigned int len) = 0;
+
+    /**
+       Switches the connection to sending length-prefixed frames instead of
+       newline-delimited strings. The other end is informed about this
+       automatically and no further action is needed there.
+
+       This affects only the direction from this end to the other one.
+
+       @throw ConnectionException In case of any errors.
+    */
+    virtual void enable_framing() = 0;
+
+    /**
+       Writes a file to the connection. Data are moved inside the kernel
+       where possible, without copying them through user space.
 
        @param file The path to a file to be sent.
 
@@ -126,6 +861,28 @@ namespace adaptyst {
     */
     virtual void write(fs::path file) = 0;
 
+    /**
+       Receives a given number of bytes from the connection and writes
+       them to a file, e.g. a file sent by the other end with
+       write(fs::path). Data are moved inside the kernel where
+       possible, without copying them through user space.
+
+       @param file            The path to a file to be written. If it exists,
+                              it is truncated.
+       @param len             The number of bytes to be received.
+       @param timeout_seconds A maximum number of seconds that can pass
+                              while waiting for any data. Use NO_TIMEOUT for
+                              no timeout.
+
+       @return The number of bytes received. It's smaller than len only if
+               the other end has closed the connection.
+
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException In case of any other errors.
+    */
+    virtual unsigned long long read(fs::path file, unsigned long long len,
+                                    long timeout_seconds = NO_TIMEOUT) = 0;
+
     /**
        Writes data to the connection.
 
@@ -165,8 +922,14 @@ namespace adaptyst {
     virtual unsigned int get_buf_size() = 0;
     virtual int read(char *buf, unsigned int len, long timeout_seconds) = 0;
     virtual std::string read(long timeout_seconds = NO_TIMEOUT) = 0;
+    virtual std::string_view read_view(long timeout_seconds = NO_TIMEOUT) = 0;
+    virtual void set_max_message_size(size_t max_message_size) = 0;
     virtual void write(std::string msg, bool new_line = true) = 0;
+    virtual void write_message(const char *buf, unsigned int len) = 0;
+    virtual void enable_framing() = 0;
     virtual void write(fs::path file) = 0;
+    virtual unsigned long long read(fs::path file, unsigned long long len,
+                                    long timeout_seconds = NO_TIMEOUT) = 0;
     virtual void write(unsigned int len, char *buf) = 0;
   };
 
@@ -288,13 +1051,15 @@ namespace adaptyst {
   class TCPSocket : public Socket {
   private:
     net::StreamSocket socket;
-    std::unique_ptr<char[]> buf;
     unsigned int buf_size;
-    int start_pos;
-    std::queue<std::string> buffered_msgs;
+    MessageBuffer messages;
+    std::vector<char> frame_buf;
+    bool framed;
 
   protected:
-    void close();
+    void close() {
+      this->socket.close();
+    }
 
   public:
     /**
@@ -304,11 +1069,10 @@ namespace adaptyst {
                        the already-established TCP socket.
        @param buf_size The buffer size for communication, in bytes.
     */
-    TCPSocket(net::StreamSocket &sock, unsigned int buf_size) {
+    TCPSocket(net::StreamSocket &sock, unsigned int buf_size) : messages(buf_size) {
       this->socket = sock;
-      this->buf.reset(new char[buf_size]);
       this->buf_size = buf_size;
-      this->start_pos = 0;
+      this->framed = false;
     }
 
     ~TCPSocket() {
@@ -354,118 +1118,148 @@ namespace adaptyst {
       }
     }
 
-    std::string read(long timeout_seconds = NO_TIMEOUT) {
-      try {
-        if (!this->buffered_msgs.empty()) {
-          std::string msg = this->buffered_msgs.front();
-          this->buffered_msgs.pop();
-          return msg;
+    std::string_view read_view(long timeout_seconds = NO_TIMEOUT) {
+      std::string_view msg;
+      Deadline deadline(timeout_seconds);
+
+      while (!this->messages.next(msg)) {
+        int bytes_received =
+          this->read(this->messages.reserve(this->buf_size),
+                     this->buf_size, deadline.get_timeout());
+
+        if (bytes_received == 0) {
+          return this->messages.take_remaining();
         }
 
-        std::string cur_msg = "";
+        this->messages.commit(bytes_received);
+      }
 
-        while (true) {
-          int bytes_received =
-            this->read(this->buf.get() + this->start_pos,
-                       this->buf_size - this->start_pos, timeout_seconds);
+      return msg;
+    }
 
-          if (bytes_received == 0) {
-            return std::string(this->buf.get(), this->start_pos);
-          }
+    std::string read(long timeout_seconds = NO_TIMEOUT) {
+      return std::string(this->read_view(timeout_seconds));
+    }
 
-          bool first_msg_to_receive = true;
-          std::string first_msg;
+    void set_max_message_size(size_t max_message_size) {
+      this->messages.set_max_message_size(max_message_size);
+    }
 
-          charstreambuf buf(this->buf, bytes_received + this->start_pos);
-          std::istream in(&buf);
+    /**
+       Receives whatever data is available with a single read() call
+       and keeps it for next_view(). This is meant to be called when
+       the file descriptor for reading is known to be readable, e.g.
+       as reported by epoll.
 
-          int cur_pos = 0;
-          bool last_is_newline = this->buf.get()[bytes_received + this->start_pos - 1] == '\n';
+       @param timeout_seconds The maximum time in seconds to wait for
+                              any data, NO_TIMEOUT for no limit.
 
-          while (!in.eof()) {
-            std::string msg;
-            std::getline(in, msg);
+       @return The number of bytes received, 0 if the other end
+               has been closed.
 
-            if (in.eof() && !last_is_newline) {
-              int size = bytes_received + this->start_pos - cur_pos;
+       @throw TimeoutException    When there is no data within the time.
+       @throw ConnectionException In case of any other errors.
+    */
+    int fill(long timeout_seconds = NO_TIMEOUT) {
+      int bytes_received =
+        this->read(this->messages.reserve(this->buf_size),
+                   this->buf_size, timeout_seconds);
 
-              if (size == this->buf_size) {
-                cur_msg += std::string(this->buf.get(), this->buf_size);
-                this->start_pos = 0;
-              } else {
-                std::memmove(this->buf.get(), this->buf.get() + cur_pos, size);
-                this->start_pos = size;
-              }
-            } else {
-              if (!cur_msg.empty() || !msg.empty()) {
-                if (first_msg_to_receive) {
-                  first_msg = cur_msg + msg;
-                  first_msg_to_receive = false;
-                } else {
-                  this->buffered_msgs.push(cur_msg + msg);
-                }
-
-                cur_msg = "";
-              }
+      if (bytes_received == -1) {
+        throw ConnectionException();
+      }
 
-              cur_pos += msg.length() + 1;
-            }
-          }
+      this->messages.commit(bytes_received);
+      return bytes_received;
+    }
 
-          if (last_is_newline) {
-            this->start_pos = 0;
-          }
+    /**
+       Extracts the next complete message from the data received so far
+       without reading anything.
 
-          if (!first_msg_to_receive) {
-            return first_msg;
-          }
-        }
+       @param msg Where the view of the message should be stored. The view
+                  is valid until the next read or fill() call.
 
-        // Should not get here.
-        return "";
-      } catch (net::NetException &e) {
-        throw ConnectionException(e);
-      }
+       @return Whether a complete message is available.
+    */
+    bool next_view(std::string_view &msg) {
+      return this->messages.next(msg);
     }
 
     void write(std::string msg, bool new_line) {
-      try {
-        if (new_line) {
-          msg += "\n";
-        }
+      if (this->framed) {
+        this->write_message(msg.data(), msg.size());
+        return;
+      }
 
-        const char *buf = msg.c_str();
+      if (new_line) {
+        msg += "\n";
+      }
 
-        int bytes_written = this->socket.sendBytes(buf, msg.size());
+      this->write(msg.size(), msg.data());
+    }
 
-        if (bytes_written != msg.size()) {
-          std::runtime_error err("Wrote " +
-                                 std::to_string(bytes_written) +
-                                 " bytes instead of " +
-                                 std::to_string(msg.size()) +
-                                 " to " +
-                                 this->socket.address().toString());
-          throw ConnectionException(err);
-        }
-      } catch (net::NetException &e) {
-        throw ConnectionException(e);
+    void write_message(const char *buf, unsigned int len) {
+      if (!this->framed) {
+        this->enable_framing();
       }
+
+      // The header and the payload are sent together so that a frame
+      // does not need two round trips with Nagle's algorithm enabled.
+      this->frame_buf.resize(FRAME_HEADER_SIZE + len);
+      MessageBuffer::make_header(this->frame_buf.data(), len);
+      std::memcpy(this->frame_buf.data() + FRAME_HEADER_SIZE, buf, len);
+      this->write(this->frame_buf.size(), this->frame_buf.data());
     }
 
-    void write(fs::path file) {
-      try {
-        net::SocketStream socket_stream(this->socket);
-        Poco::FileInputStream stream(file, std::ios::in | std::ios::binary);
-        Poco::StreamCopier::copyStream(stream, socket_stream);
-      } catch (net::NetException &e) {
-        throw ConnectionException(e);
+    void enable_framing() {
+      if (this->framed) {
+        return;
       }
+
+      std::string request = FRAMING_REQUEST "\n";
+      this->write(request.size(), request.data());
+      this->framed = true;
+    }
+
+    void write(fs::path file) {
+      FileTransfer::send_file(file, this->socket.impl()->sockfd(),
+                              [this](unsigned int len, char *buf) {
+                                this->write(len, buf);
+                              });
+    }
+
+    unsigned long long read(fs::path file, unsigned long long len,
+                            long timeout_seconds = NO_TIMEOUT) {
+      return FileTransfer::receive_file(file, len, this->messages.take(len),
+                                        this->socket.impl()->sockfd(),
+                                        this->buf_size, timeout_seconds,
+                                        [this](char *buf, unsigned int len,
+                                               long timeout_seconds) {
+                                          return this->read(buf, len, timeout_seconds);
+                                        });
+    }
+
+    /**
+       Sets the maximum time in seconds a write can block for before
+       TimeoutException is thrown, NO_TIMEOUT for no limit (the default).
+    */
+    void set_send_timeout(long timeout_seconds) {
+      this->socket.setSendTimeout(timeout_seconds == NO_TIMEOUT ?
+                                  Poco::Timespan() :
+                                  Poco::Timespan(timeout_seconds, 0));
     }
 
     void write(unsigned int len, char *buf) {
       try {
+        // A peer which has gone away should result in ConnectionException
+        // rather than SIGPIPE
+#ifdef MSG_NOSIGNAL
+        int bytes_written = this->socket.sendBytes(buf, len, MSG_NOSIGNAL);
+#else
         int bytes_written = this->socket.sendBytes(buf, len);
-        if (bytes_written != len) {
+#endif
+        if (bytes_written != (int)len) {
           std::runtime_error err("Wrote " +
                                  std::to_string(bytes_written) +
                                  " bytes instead of " +
@@ -476,6 +1270,8 @@ namespace adaptyst {
         }
       } catch (net::NetException &e) {
         throw ConnectionException(e);
+      } catch (Poco::TimeoutException &e) {
+        throw TimeoutException();
       }
     }
   };
@@ -527,6 +1323,12 @@ namespace adaptyst {
     std::unique_ptr<Connection> accept_connection(unsigned int buf_size,
                                                   long timeout) {
       try {
+        if (timeout != NO_TIMEOUT &&
+            !this->acceptor.poll(Poco::Timespan(timeout, 0),
+                                 net::Socket::SELECT_READ)) {
+          throw TimeoutException();
+        }
+
         net::StreamSocket socket = this->acceptor.acceptConnection();
         return std::make_unique<TCPSocket>(socket, buf_size);
       } catch (net::NetException &e) {
@@ -601,9 +1403,8 @@ namespace adaptyst {
     int read_fd[2];
     int write_fd[2];
     unsigned int buf_size;
-    std::queue<std::string> buffered_msgs;
-    std::unique_ptr<char[]> buf;
-    int start_pos;
+    MessageBuffer messages;
+    bool framed;
     bool close_on_destruct;
 
   public:
@@ -623,10 +1424,9 @@ namespace adaptyst {
     FileDescriptor(int read_fd[2],
                    int write_fd[2],
                    unsigned int buf_size,
-                   bool close_on_destruct = true) {
-      this->buf.reset(new char[buf_size]);
+                   bool close_on_destruct = true) : messages(buf_size) {
       this->buf_size = buf_size;
-      this->start_pos = 0;
+      this->framed = false;
       this->close_on_destruct = close_on_destruct;
 
       if (read_fd != nullptr) {
@@ -670,138 +1470,240 @@ namespace adaptyst {
       return ::read(this->read_fd[0], buf, len);
     }
 
-    std::string read(long timeout_seconds = NO_TIMEOUT) {
-      if (!this->buffered_msgs.empty()) {
-        std::string msg = this->buffered_msgs.front();
-        this->buffered_msgs.pop();
-        return msg;
-      }
-
-      std::string cur_msg = "";
+    std::string_view read_view(long timeout_seconds = NO_TIMEOUT) {
+      std::string_view msg;
+      Deadline deadline(timeout_seconds);
 
-      while (true) {
+      while (!this->messages.next(msg)) {
         int bytes_received =
-          this->read(this->buf.get() + this->start_pos,
-                     this->buf_size - this->start_pos,
-                     timeout_seconds);
+          this->read(this->messages.reserve(this->buf_size),
+                     this->buf_size, deadline.get_timeout());
 
         if (bytes_received == -1) {
           throw ConnectionException();
         } else if (bytes_received == 0) {
-          return std::string(this->buf.get(), this->start_pos);
+          return this->messages.take_remaining();
         }
 
-        bool first_msg_to_receive = true;
-        std::string first_msg;
-
-        charstreambuf buf(this->buf, bytes_received + this->start_pos);
-        std::istream in(&buf);
+        this->messages.commit(bytes_received);
+      }
 
-        int cur_pos = 0;
-        bool last_is_newline = this->buf.get()[bytes_received + this->start_pos - 1] == '\n';
+      return msg;
+    }
 
-        while (!in.eof()) {
-          std::string msg;
-          std::getline(in, msg);
+    std::string read(long timeout_seconds = NO_TIMEOUT) {
+      return std::string(this->read_view(timeout_seconds));
+    }
 
-          if (in.eof() && !last_is_newline) {
-            int size = bytes_received + this->start_pos - cur_pos;
+    void set_max_message_size(size_t max_message_size) {
+      this->messages.set_max_message_size(max_message_size);
+    }
 
-            if (size == this->buf_size) {
-              cur_msg += std::string(this->buf.get(), this->buf_size);
-              this->start_pos = 0;
-            } else {
-              std::memmove(this->buf.get(), this->buf.get() + cur_pos, size);
-              this->start_pos = size;
-            }
-          } else {
-            if (!cur_msg.empty() || !msg.empty()) {
-              if (first_msg_to_receive) {
-                first_msg = cur_msg + msg;
-                first_msg_to_receive = false;
-              } else {
-                this->buffered_msgs.push(cur_msg + msg);
-              }
+    /**
+       Receives whatever data is available with a single read() call
+       and keeps it for next_view(). This is meant to be called when
+       the file descriptor for reading is known to be readable, e.g.
+       as reported by epoll.
 
-              cur_msg = "";
-            }
+       @param timeout_seconds The maximum time in seconds to wait for
+                              any data, NO_TIMEOUT for no limit.
 
-            cur_pos += msg.length() + 1;
-          }
-        }
+       @return The number of bytes received, 0 if the other end
+               has been closed.
 
-        if (last_is_newline) {
-          this->start_pos = 0;
-        }
+       @throw TimeoutException    When there is no data within the time.
+       @throw ConnectionException In case of any other errors.
+    */
+    int fill(long timeout_seconds = NO_TIMEOUT) {
+      int bytes_received =
+        this->read(this->messages.reserve(this->buf_size),
+                   this->buf_size, timeout_seconds);
 
-        if (!first_msg_to_receive) {
-          return first_msg;
-        }
+      if (bytes_received == -1) {
+        throw ConnectionException();
       }
 
-      // Should not get here.
-      return "";
+      this->messages.commit(bytes_received);
+      return bytes_received;
+    }
+
+    /**
+       Extracts the next complete message from the data received so far
+       without reading anything.
+
+       @param msg Where the view of the message should be stored. The view
+                  is valid until the next read or fill() call.
+
+       @return Whether a complete message is available.
+    */
+    bool next_view(std::string_view &msg) {
+      return this->messages.next(msg);
     }
 
     void write(std::string msg, bool new_line) {
+      if (this->framed) {
+        this->write_message(msg.data(), msg.size());
+        return;
+      }
+
       if (new_line) {
         msg += "\n";
       }
 
-      const char *buf = msg.c_str();
-      int written = ::write(this->write_fd[1], buf, msg.size());
+      this->write(msg.size(), msg.data());
+    }
+
+    void write_message(const char *buf, unsigned int len) {
+      if (!this->framed) {
+        this->enable_framing();
+      }
+
+      char header[FRAME_HEADER_SIZE];
+      MessageBuffer::make_header(header, len);
 
-      if (written != msg.size()) {
-        std::runtime_error err("Wrote " +
-                               std::to_string(written) +
-                               " bytes instead of " +
-                               std::to_string(msg.size()) +
-                               " to fd " +
+      struct iovec iov[2];
+      iov[0].iov_base = header;
+      iov[0].iov_len = FRAME_HEADER_SIZE;
+      iov[1].iov_base = (void *)buf;
+      iov[1].iov_len = len;
+
+      size_t to_write = FRAME_HEADER_SIZE + (size_t)len;
+      int written = ::writev(this->write_fd[1], iov, 2);
+
+      if (written == -1 && (errno == EINTR || errno == EAGAIN ||
+                            errno == EWOULDBLOCK)) {
+        written = 0;
+      }
+
+      if (written == -1) {
+        std::runtime_error err("Could not write to fd " +
                                std::to_string(this->write_fd[1]));
         throw ConnectionException(err);
+      } else if ((size_t)written != to_write) {
+        // A partial write can happen for frames larger than the pipe
+        // capacity, send the rest in the usual way.
+        if (written < FRAME_HEADER_SIZE) {
+          this->write(FRAME_HEADER_SIZE - written, header + written);
+          written = FRAME_HEADER_SIZE;
+        }
+
+        this->write(to_write - written,
+                    (char *)buf + (written - FRAME_HEADER_SIZE));
       }
     }
 
-    void write(fs::path file) {
-      std::unique_ptr<char> buf(new char[FILE_BUFFER_SIZE]);
-      std::ifstream file_stream(file, std::ios_base::in |
-                                std::ios_base::binary);
+    void enable_framing() {
+      if (this->framed) {
+        return;
+      }
 
-      if (!file_stream) {
-        std::runtime_error err("Could not open the file " +
-                               file.string() + "!");
-        throw ConnectionException(err);
+      std::string request = FRAMING_REQUEST "\n";
+      this->write(request.size(), request.data());
+      this->framed = true;
+    }
+
+    /**
+       Returns the bytes write(msg, new_line) would send, so that
+       they can be sent later by the caller (e.g. through OutputQueue).
+       As with write(msg, new_line), new_line is ignored if framing
+       is enabled.
+    */
+    std::string encode(std::string msg, bool new_line) {
+      if (this->framed) {
+        return this->encode_message(msg.data(), msg.size());
+      }
+
+      if (new_line) {
+        msg += "\n";
+      }
+
+      return msg;
+    }
+
+    /**
+       Returns the bytes write_message() would send once framing is
+       enabled (see start_framing()), so that they can be sent later
+       by the caller (e.g. through OutputQueue).
+    */
+    std::string encode_message(const char *buf, unsigned int len) {
+      std::string encoded(FRAME_HEADER_SIZE + (size_t)len, 0);
+      MessageBuffer::make_header(encoded.data(), len);
+      std::memcpy(encoded.data() + FRAME_HEADER_SIZE, buf, len);
+      return encoded;
+    }
+
+    /**
+       Considers framing enabled without sending anything.
+
+       @return The framing request which must be sent by the caller
+               before any messages returned by encode() and
+               encode_message() from now on, empty if framing has been
+               enabled already.
+    */
+    std::string start_framing() {
+      if (this->framed) {
+        return "";
       }
 
-      while (file_stream) {
-        file_stream.read(buf.get(), FILE_BUFFER_SIZE);
-        int bytes_read = file_stream.gcount();
-        int bytes_written = ::write(this->write_fd[1], buf.get(),
-                                    bytes_read);
+      this->framed = true;
+      return FRAMING_REQUEST "\n";
+    }
+
+    void write(fs::path file) {
+      FileTransfer::send_file(file, this->write_fd[1],
+                              [this](unsigned int len, char *buf) {
+                                this->write(len, buf);
+                              });
+    }
+
+    unsigned long long read(fs::path file, unsigned long long len,
+                            long timeout_seconds = NO_TIMEOUT) {
+      return FileTransfer::receive_file(file, len, this->messages.take(len),
+                                        this->read_fd[0], this->buf_size,
+                                        timeout_seconds,
+                                        [this](char *buf, unsigned int len,
+                                               long timeout_seconds) {
+                                          return this->read(buf, len, timeout_seconds);
+                                        });
+    }
+
+    void write(unsigned int len, char *buf) {
+      unsigned int written = 0;
+
+      // Large messages don't fit into a pipe in one go and the file
+      // descriptor may be non-blocking, so keep writing the rest
+      while (written < len) {
+        int bytes_written = ::write(this->write_fd[1], buf + written,
+                                    len - written);
+
+        if (bytes_written == -1) {
+          int error = errno;
+
+          if (error == EINTR) {
+            continue;
+          } else if (error == EAGAIN || error == EWOULDBLOCK) {
+            struct pollfd poll_struct;
+            poll_struct.fd = this->write_fd[1];
+            poll_struct.events = POLLOUT;
+
+            if (::poll(&poll_struct, 1, -1) == -1 && errno != EINTR) {
+              throw ConnectionException();
+            }
+
+            continue;
+          }
 
-        if (bytes_written != bytes_read) {
           std::runtime_error err("Wrote " +
-                                 std::to_string(bytes_written) +
+                                 std::to_string(written) +
                                  " bytes instead of " +
-                                 std::to_string(bytes_read) +
+                                 std::to_string(len) +
                                  " to fd " +
-                                 std::to_string(this->write_fd[1]));
+                                 std::to_string(this->write_fd[1]) +
+                                 ": " + std::string(std::strerror(error)));
           throw ConnectionException(err);
         }
-      }
-    }
 
-    void write(unsigned int len, char *buf) {
-      int bytes_written = ::write(this->write_fd[1], buf, len);
-
-      if (bytes_written != len) {
-        std::runtime_error err("Wrote " +
-                               std::to_string(bytes_written) +
-                               " bytes instead of " +
-                               std::to_string(len) +
-                               " to fd " +
-                               std::to_string(this->write_fd[1]));
-        throw ConnectionException(err);
+        written += bytes_written;
       }
     }
 
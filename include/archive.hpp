@@ -11,10 +11,65 @@
 #include <archive_entry.h>
 #include <nlohmann/json.hpp>
 #include <unordered_set>
+#include <vector>
+
+#define ARCHIVE_BUFFER_SIZE 1048576
 
 namespace adaptyst {
   namespace fs = std::filesystem;
 
+  /**
+     A class describing how an archive file should be compressed.
+  */
+  class ArchiveCompression {
+  public:
+    enum Type {
+      STORE,
+      DEFLATE,
+      ZSTD
+    };
+
+    /**
+       Constructs an ArchiveCompression object.
+
+       @param type  The compression type. STORE and DEFLATE produce
+                    ZIP archives, ZSTD produces zstd-compressed tar archives.
+       @param level The compression level (ignored for STORE). It must be
+                    between 0 and 9 for DEFLATE and between 1 and 22 for ZSTD.
+
+       @throw std::runtime_error If the level is out of range.
+    */
+    ArchiveCompression(Type type = DEFLATE, int level = 9);
+
+    /**
+       Constructs an ArchiveCompression object from its textual
+       specification, i.e. "store", "deflate[:<level>]" or "zstd[:<level>]".
+
+       @throw std::runtime_error If the specification is invalid.
+    */
+    static ArchiveCompression parse(std::string spec);
+
+    /**
+       Gets the compression type.
+    */
+    Type get_type();
+
+    /**
+       Gets the compression level.
+    */
+    int get_level();
+
+    /**
+       Gets the file extension of archives produced with this compression,
+       including the leading dot (e.g. ".zip").
+    */
+    std::string get_extension();
+
+  private:
+    Type type;
+    int level;
+  };
+
   /**
      A class describing an archive file to be written to.
   */
@@ -23,8 +78,12 @@ namespace adaptyst {
     struct archive *arch;
     struct archive_entry *arch_entry;
     unsigned int buf_size;
+    std::vector<char> buf;
     std::unique_ptr<Connection> conn;
 
+    void set_format(ArchiveCompression &compression);
+    void write_entry_header(std::string &filename, size_t size);
+
   public:
     /**
        Constructs an Archive object and opens a file for writing.
@@ -34,11 +93,13 @@ namespace adaptyst {
        have been written. Therefore, you should explicitly call close()
        (which may throw an exception) before the object goes out of scope.
 
-       @param path     The path to an archive file to be created. The file
-                       must not exist yet.
-       @param buf_size A number of bytes of the internal buffers.
+       @param path        The path to an archive file to be created. The file
+                          must not exist yet.
+       @param buf_size    A number of bytes of the internal buffers.
+       @param compression The format and compression of the archive file.
     */
-    Archive(fs::path path, unsigned int buf_size = 1024);
+    Archive(fs::path path, unsigned int buf_size = ARCHIVE_BUFFER_SIZE,
+            ArchiveCompression compression = ArchiveCompression());
 
     /**
        Constructs an Archive object with all archive file data to be sent
@@ -51,13 +112,15 @@ namespace adaptyst {
 
        @param conn     A Connection object which all archive file data
                        will be sent through.
-       @param padding  Whether padding is allowed to be added to the last block
-                       of the archive file data if necessary. If you are not
-                       sure, this should be set to true (default).
-       @param buf_size A number of bytes of the internal buffers.
+       @param padding     Whether padding is allowed to be added to the last block
+                          of the archive file data if necessary. If you are not
+                          sure, this should be set to true (default).
+       @param buf_size    A number of bytes of the internal buffers.
+       @param compression The format and compression of the archive file data.
     */
     Archive(std::unique_ptr<Connection> &conn, bool padding = true,
-            unsigned int buf_size = 1024);
+            unsigned int buf_size = ARCHIVE_BUFFER_SIZE,
+            ArchiveCompression compression = ArchiveCompression());
 
     /**
        Adds a file to the root of the archive file.
@@ -68,6 +131,16 @@ namespace adaptyst {
     */
     void add_file(std::string filename, fs::path path);
 
+    /**
+       Saves data from memory to the root of the archive file as
+       a regular file.
+
+       @param filename The name of a file that will appear inside the archive.
+       @param data     The data to be saved.
+       @param size     A number of bytes of the data.
+    */
+    void add_file_data(std::string filename, const char *data, size_t size);
+
     /**
        Saves data extracted from a stream to the root of the archive file
        as a regular file.
@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef CGROUP_HPP_
+#define CGROUP_HPP_
+
+#include "adaptyst/process.hpp"
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+#define CGROUP_TEARDOWN_TIMEOUT_MS 1000
+
+namespace adaptyst {
+  namespace fs = std::filesystem;
+
+  /**
+     A structure describing how an entity should isolate its workflow
+     from performance analysis with cgroups v2.
+  */
+  struct CgroupPolicy {
+    /**
+       The cgroup under which Adaptyst creates its cgroups, empty if
+       cgroups should not be used. A relative path is relative to
+       the cgroup2 mount point. The cgroup must be writable by Adaptyst
+       (e.g. delegated to the user) and must not contain any processes.
+    */
+    fs::path parent;
+
+    /**
+       The value of memory.max of the workflow cgroup, empty for
+       no limit.
+    */
+    std::string memory_max;
+
+    /**
+       The value of io.max of the workflow cgroup (e.g. "8:0 wbps=1048576"),
+       empty for no limit.
+    */
+    std::string io_max;
+  };
+
+  /**
+     A class describing a cgroup v2 created by Adaptyst. The cgroup
+     is removed when the object is destroyed: processes left in it are
+     either moved back to where they came from (if join() has been
+     called) or killed.
+  */
+  class Cgroup {
+  public:
+    /**
+       Creates a cgroup.
+
+       @param path Absolute path to the cgroup directory.
+
+       @throw std::runtime_error If the cgroup cannot be created.
+    */
+    Cgroup(fs::path path);
+    ~Cgroup();
+
+    /**
+       Enables a controller for the children of the cgroup.
+
+       @return Whether the controller is available in the cgroup.
+
+       @throw std::runtime_error If the controller is available but
+                                 cannot be enabled.
+    */
+    bool enable_controller(std::string name);
+
+    /**
+       Writes a value to an interface file of the cgroup, e.g. cpuset.cpus.
+
+       @throw std::runtime_error If the value cannot be written.
+    */
+    void write(std::string file, std::string value);
+
+    /**
+       Moves a process with all its threads to the cgroup.
+
+       @throw std::runtime_error If the process cannot be moved.
+    */
+    void add_process(int pid);
+
+    /**
+       Moves the current process to the cgroup, remembering its current
+       cgroup so that all processes in the cgroup are moved there when
+       the object is destroyed.
+
+       @throw std::runtime_error If the process cannot be moved.
+    */
+    void join();
+
+    /**
+       Returns CPU, memory and I/O statistics of the cgroup read from
+       cpu.stat, memory.stat, memory.peak and io.stat (the ones
+       available).
+    */
+    nlohmann::json get_stats();
+
+    /**
+       Returns the path to the cgroup directory.
+    */
+    fs::path &get_path();
+
+    /**
+       Returns the path where the cgroup2 filesystem is mounted.
+    */
+    static fs::path get_mount_path();
+
+    /**
+       Returns the absolute path to the cgroup of the current process.
+
+       @throw std::runtime_error If the cgroup cannot be determined.
+    */
+    static fs::path get_current_path();
+
+    /**
+       Converts a CPU set to a cpuset.cpus-compatible list, e.g. "0-3,8".
+    */
+    static std::string to_list(const cpu_set_t &set);
+
+    /**
+       Converts a bitmask of NUMA nodes to a cpuset.mems-compatible list.
+    */
+    static std::string to_list(unsigned long nodes);
+
+  private:
+    fs::path path;
+    fs::path origin;
+
+    std::string read(std::string file);
+  };
+
+  /**
+     A class describing the cgroups isolating the workflow of an entity
+     from performance analysis, so that threads started by the workflow
+     or by libraries used by modules cannot run on each other's cores.
+
+     All cgroups are created in "adaptyst_<PID>" under the parent cgroup
+     from CgroupPolicy, which contains:
+     * "analysis" with Adaptyst itself and everything it starts other
+       than workflows, shared by all entities with the same parent cgroup
+       and allowed to run on the performance analysis cores of all of
+       them,
+     * "workflow_<entity name>" with the workflow of an entity, allowed
+       to run only on its workflow cores and limited as set in CgroupPolicy.
+
+     Adaptyst is moved back to its original cgroup and all cgroups are
+     removed when objects of the last entity using them are destroyed.
+  */
+  class CgroupIsolation {
+  public:
+    /**
+       Creates the cgroups of an entity and moves Adaptyst to the
+       "analysis" cgroup.
+
+       @param policy     Cgroup policy of the entity.
+       @param name       Name of the entity.
+       @param cpu_config CPU core configuration of the entity. The cores
+                         are not restricted if it is invalid.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    CgroupIsolation(CgroupPolicy &policy, std::string name,
+                    const CPUConfig &cpu_config);
+    ~CgroupIsolation();
+
+    /**
+       Moves the workflow to its cgroup. This should be called before
+       the workflow is notified to start.
+
+       @throw std::runtime_error If the workflow cannot be moved.
+    */
+    void add_workflow(int pid);
+
+    /**
+       Returns the statistics of the workflow cgroup (see
+       Cgroup::get_stats()).
+    */
+    nlohmann::json get_stats();
+
+  private:
+    struct Tree {
+      std::unique_ptr<Cgroup> root;
+      std::unique_ptr<Cgroup> analysis;
+      cpu_set_t analysis_cpus;
+    };
+
+    static inline std::mutex trees_mutex;
+    static inline std::unordered_map<std::string, std::weak_ptr<Tree> > trees;
+
+    std::shared_ptr<Tree> tree;
+    std::unique_ptr<Cgroup> workflow;
+  };
+};
+
+#endif
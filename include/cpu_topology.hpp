@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef CPU_TOPOLOGY_HPP_
+#define CPU_TOPOLOGY_HPP_
+
+#include <string>
+#include <vector>
+
+#define CPU_TOPOLOGY_RESERVED_CPUS 2
+
+namespace adaptyst {
+  /**
+     A structure describing how an entity should assign CPU cores
+     to performance analysis and the workflow.
+  */
+  struct CPUPolicy {
+    /**
+       The CPU mask to be used as it is (see CPUConfig), overriding
+       everything else if not empty.
+    */
+    std::string mask;
+
+    /**
+       The NUMA node of the cores for performance analysis,
+       -1 if any node can be used.
+
+       This is ignored when performance analysis and the workflow share
+       all cores (i.e. there are no processing threads) and when there
+       are only 2 or 3 allowed logical cores, as their roles are fixed
+       then.
+    */
+    int analysis_numa_node = -1;
+
+    /**
+       The NUMA node of the cores for the workflow, -1 if any
+       node can be used.
+
+       This is ignored when there are only 2 or 3 allowed logical
+       cores, as their roles are fixed then.
+    */
+    int workflow_numa_node = -1;
+
+    /**
+       Whether memory allocations should be restricted to the NUMA
+       nodes of the cores used (see CPUConfig::bind_memory()).
+    */
+    bool bind_memory = false;
+  };
+
+  /**
+     A class describing the topology of the logical cores the current
+     process is allowed to run on (i.e. ones in its inherited affinity
+     mask, which reflects e.g. cgroup cpusets), based on sysfs.
+  */
+  class CPUTopology {
+  public:
+    /**
+       A structure describing a logical core.
+    */
+    struct LogicalCore {
+      int cpu;
+      int core;
+      int package;
+      int numa_node;
+    };
+
+    /**
+       Constructs a CPUTopology object describing the machine
+       Adaptyst runs on.
+
+       @throw std::runtime_error If the affinity mask cannot be obtained.
+    */
+    CPUTopology();
+
+    /**
+       Constructs a CPUTopology object from a given list
+       of allowed logical cores.
+    */
+    CPUTopology(std::vector<LogicalCore> cores);
+
+    /**
+       Returns the number of allowed logical cores.
+    */
+    unsigned int get_logical_core_count();
+
+    /**
+       Returns the number of physical cores with at least one
+       allowed logical core.
+    */
+    unsigned int get_physical_core_count();
+
+    /**
+       Builds a CPU mask from roles of allowed logical cores, where
+       the i-th character of roles is the role of the i-th allowed
+       logical core in ascending order. Logical cores not allowed
+       or without a role are not used.
+    */
+    std::string make_mask(std::string roles);
+
+    /**
+       Builds a CPU mask such that:
+       * the first physical cores covering CPU_TOPOLOGY_RESERVED_CPUS
+         logical cores are left to the OS and Adaptyst itself,
+       * performance analysis gets processing_threads logical cores
+         from whole physical cores, so that none of them shares
+         a physical core with the workflow,
+       * the workflow gets all remaining physical cores.
+
+       If processing_threads is 0, all allowed logical cores are used
+       for both performance analysis and the workflow.
+
+       @param processing_threads The number of logical cores for
+                                 performance analysis.
+       @param analysis_node      The NUMA node of the cores for performance
+                                 analysis, -1 for any node.
+       @param workflow_node      The NUMA node of the cores for the workflow,
+                                 -1 for any node.
+
+       @throw std::runtime_error If there are not enough cores matching
+                                 the criteria.
+    */
+    std::string make_mask(unsigned int processing_threads,
+                          int analysis_node, int workflow_node);
+
+  private:
+    std::vector<LogicalCore> cores;
+    std::vector<std::vector<int> > physical_cores;
+    std::vector<int> physical_core_nodes;
+    int max_cpu;
+
+    void group_cores();
+  };
+};
+
+#endif
@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef DAEMON_HPP_
+#define DAEMON_HPP_
+
+#include "adaptyst/socket.hpp"
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define DAEMON_PROTOCOL_VERSION 2
+#define DAEMON_DEFAULT_ADDRESS "127.0.0.1"
+#define DAEMON_DEFAULT_PORT 42311
+#define DAEMON_TOKEN_ENV "ADAPTYST_DAEMON_TOKEN"
+#define DAEMON_AUTH_TIMEOUT 10
+#define DAEMON_AUTH_MAX_SIZE 4096
+#define DAEMON_RECEIVE_TIMEOUT 60
+
+namespace adaptyst {
+  namespace fs = std::filesystem;
+
+  /**
+     A class describing an Adaptyst daemon, i.e. a long-lived process
+     keeping a computer system (with its modules loaded and initialised)
+     and running performance analysis of commands submitted by
+     DaemonClient. Runs are done one at a time, in the order of
+     connections.
+
+     A submitted command runs as the user running the daemon, so
+     the first message of every connection must carry the shared
+     secret of the daemon and connections failing to do so within
+     DAEMON_AUTH_TIMEOUT seconds are closed without any reply. As
+     clients are served one at a time, a client which sends nothing
+     for DAEMON_RECEIVE_TIMEOUT seconds is disconnected as well.
+     The secret is sent in plain text, like for RemoteAgent.
+  */
+  class Daemon {
+  public:
+    /**
+       A callback running performance analysis of a command. It should
+       set result_dir to the directory with the results (also when
+       the analysis fails) and return whether the analysis has
+       been successful, with error describing the reason otherwise.
+    */
+    typedef std::function<bool(std::string label,
+                               std::vector<std::string> &command,
+                               fs::path &result_dir,
+                               std::string &error)> RunCallback;
+
+    /**
+       Constructs a Daemon object and starts listening for connections.
+
+       @param address  The address to listen at.
+       @param port     The port to listen at.
+       @param buf_size The buffer size for communication, in bytes.
+       @param token    The shared secret every connection must
+                       authenticate with.
+       @param run      The callback running performance analysis.
+
+       @throw ConnectionException In case of any errors.
+    */
+    Daemon(std::string address, unsigned short port,
+           unsigned int buf_size, std::string token, RunCallback run);
+
+    /**
+       Serves clients one after another until a client asks
+       the daemon to stop.
+    */
+    void serve();
+
+  private:
+    std::unique_ptr<Acceptor> acceptor;
+    unsigned int buf_size;
+    std::string token;
+    RunCallback run;
+
+    bool serve_client(Connection &conn);
+  };
+
+  /**
+     A class describing the connection to an Adaptyst daemon.
+  */
+  class DaemonClient {
+  public:
+    /**
+       Connects to a daemon.
+
+       @param address  The address of the daemon.
+       @param port     The port of the daemon.
+       @param buf_size The buffer size for communication, in bytes.
+       @param token    The shared secret of the daemon.
+
+       @throw ConnectionException In case of any errors (including
+                                  the daemon closing the connection
+                                  because of a wrong secret).
+       @throw std::runtime_error  If the daemon is incompatible.
+    */
+    DaemonClient(std::string address, unsigned short port,
+                 unsigned int buf_size, std::string token);
+
+    ~DaemonClient();
+
+    /**
+       Makes the daemon run performance analysis of a command and
+       waits until it is finished.
+
+       @param command    The command to be analysed.
+       @param label      The label of the performance analysis (can be empty).
+       @param result_dir Where the path to the directory with the results
+                         should be stored.
+       @param error      Where the reason of the failure should be stored.
+
+       @return Whether the analysis has been successful.
+
+       @throw ConnectionException In case of any connection errors.
+    */
+    bool run(std::vector<std::string> &command, std::string label,
+             fs::path &result_dir, std::string &error);
+
+    /**
+       Makes the daemon exit after closing the connection.
+
+       @throw ConnectionException In case of any errors.
+    */
+    void stop();
+
+  private:
+    std::unique_ptr<Connection> conn;
+  };
+};
+
+#endif
@@ -0,0 +1,103 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef DATAFLOW_HPP_
+#define DATAFLOW_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#define DATAFLOW_DEFAULT_QUEUE_CAPACITY 1024
+
+namespace adaptyst {
+  /**
+     A record published by a module for modules of the nodes its node
+     has edges to. Once published, a record is immutable and shared
+     by all of its consumers.
+  */
+  struct Record {
+    std::string tag;
+    std::unique_ptr<char[]> data;
+    unsigned int size;
+  };
+
+  /**
+     A class describing a bounded queue of records consumed by
+     a single module and fed by the modules of the departure nodes
+     of all edges arriving at the module node.
+
+     Records are passed by reference, so publishing a record to many
+     queues never copies its data. When the queue is full, producers
+     wait for the consumer. The queue ends when all producers finish
+     and everything has been consumed.
+  */
+  class RecordQueue {
+  public:
+    enum Status {
+      RECORD,
+      TIMEOUT,
+      END
+    };
+
+    RecordQueue();
+
+    /**
+       Prepares the queue for a new run of the workflow, dropping
+       any records left from the previous one.
+
+       @param capacity  Maximum number of records waiting for
+                        the consumer.
+       @param producers Number of producers which will call
+                        producer_done().
+    */
+    void open(unsigned int capacity, unsigned int producers);
+
+    /**
+       Adds a record to the queue, waiting until there is space
+       for it.
+
+       @return Whether the record has been added. It isn't if
+               the consumer has already finished.
+    */
+    bool push(std::shared_ptr<const Record> &record);
+
+    /**
+       Takes the next record from the queue.
+
+       @param record          Where the record should be stored.
+       @param timeout_seconds Timeout in seconds or NO_TIMEOUT.
+    */
+    Status pop(std::shared_ptr<const Record> &record, long timeout_seconds);
+
+    /**
+       Indicates that one of the producers won't push any more records.
+    */
+    void producer_done();
+
+    /**
+       Indicates that the consumer won't pop any more records, so that
+       producers never wait for it again.
+    */
+    void consumer_done();
+
+  private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<std::shared_ptr<const Record> > records;
+    unsigned int capacity;
+    unsigned int producers;
+    bool consumer_active;
+  };
+};
+
+// A record handle of the C module API. Every consumer holds its own
+// handle to the shared record.
+struct adaptyst_record {
+  std::shared_ptr<adaptyst::Record> record;
+};
+
+#endif
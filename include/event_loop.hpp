@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef EVENT_LOOP_HPP_
+#define EVENT_LOOP_HPP_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/types.h>
+
+#define EVENT_LOOP_MAX_EVENTS 16
+
+namespace adaptyst {
+  /**
+     A class describing an epoll-based event loop multiplexing
+     file descriptors and process exits in a single thread.
+
+     Callbacks are always run by the thread calling run(). add(),
+     add_process(), remove() and stop() can be called from any thread.
+  */
+  class EventLoop {
+  public:
+    /**
+       A callback run when a file descriptor is readable or its other
+       end has been closed. The callback should return false if
+       the file descriptor should not be watched anymore.
+    */
+    typedef std::function<bool()> Callback;
+
+    /**
+       Constructs an EventLoop object.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    EventLoop();
+
+    ~EventLoop();
+
+    /**
+       Starts watching a file descriptor.
+
+       @param fd       The file descriptor to be watched for reading.
+       @param callback The callback to be run when fd is readable.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    void add(int fd, Callback callback);
+
+    /**
+       Starts watching a process for its exit by means of a pidfd.
+       The process is not reaped.
+
+       @param pid      The PID of the process.
+       @param callback The callback to be run once the process exits.
+
+       @return Whether the process can be watched. If false, pidfds
+               are not supported by the system and the caller must
+               detect the process exit by other means.
+    */
+    bool add_process(pid_t pid, std::function<void()> callback);
+
+    /**
+       Stops watching a file descriptor.
+
+       @param fd The file descriptor.
+    */
+    void remove(int fd);
+
+    /**
+       Runs the loop until stop() is called.
+
+       @param timeout_ms The maximum time in milliseconds the loop can
+                         wait for events before running on_timeout.
+                         -1 means no limit.
+       @param on_timeout The callback to be run when timeout_ms passes
+                         without any events. Can be empty.
+    */
+    void run(int timeout_ms = -1,
+             std::function<void()> on_timeout = std::function<void()>());
+
+    /**
+       Makes run() return as soon as the callbacks currently being run
+       (if any) finish.
+    */
+    void stop();
+
+  private:
+    int epoll_fd;
+    int wake_fd;
+    std::atomic_bool stopped;
+    std::mutex callbacks_mutex;
+    std::unordered_map<int, Callback> callbacks;
+    std::unordered_set<int> owned_fds;
+  };
+};
+
+#endif
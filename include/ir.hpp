@@ -4,24 +4,80 @@
 #ifndef IR_HPP_
 #define IR_HPP_
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "adaptyst/hw.h"
 #include "adaptyst/output.hpp"
 #include "adaptyst/process.hpp"
 
+#define IR_ARENA_BLOCK_SIZE 4096
+
 namespace adaptyst {
+  /**
+     A class allocating memory for the C representation of an IR.
+     Memory is taken from blocks reserved upfront and all of it is
+     freed at once when the arena is destroyed.
+  */
+  class IRArena {
+  public:
+    IRArena();
+
+    /**
+       Makes sure that the next allocations of up to size bytes in total
+       (including alignment) are taken from a single block.
+    */
+    void reserve(size_t size);
+
+    void *allocate(size_t size, size_t alignment);
+
+    template<class T>
+    T *allocate_array(size_t count) {
+      return (T *)this->allocate(count * sizeof(T), alignof(T));
+    }
+
+    /**
+       Copies a string to the arena, including the terminating
+       null character.
+    */
+    char *copy(const std::string &str);
+
+  private:
+    std::vector<std::unique_ptr<char[]> > blocks;
+    char *current;
+    size_t left;
+  };
+
   class IR {
   private:
     unsigned int type;
     bool compiled;
+    std::mutex compile_mutex;
+    IRArena arena;
+    void *c_data;
 
   protected:
-    virtual void *get_c_data() = 0;
+    virtual void *build_c_data(IRArena &arena) = 0;
     virtual void _compile() = 0;
-    virtual int _execute() = 0;
+    virtual std::vector<std::string> get_command() = 0;
+
+    /**
+       Returns the file to be executed for get_command(), empty if
+       the first element of the command should be looked for in PATH.
+    */
+    virtual fs::path get_executable() { return fs::path(); }
 
   public:
     IR(unsigned int type);
+    virtual ~IR() { }
+
+    /**
+       Returns the C representation of the IR, compiling the IR first
+       if needed. The representation is built only once and the same
+       data are returned to all callers.
+    */
     ir to_c_type();
     void compile();
     std::unique_ptr<Process> execute();
@@ -32,9 +88,10 @@ namespace adaptyst {
     std::unique_ptr<Path> output_dir;
 
   protected:
-    void *get_c_data();
+    void *build_c_data(IRArena &arena);
     void _compile();
-    int _execute();
+    std::vector<std::string> get_command();
+    fs::path get_executable();
 
   public:
     MLIR(fs::path output_dir);
@@ -42,17 +99,40 @@ namespace adaptyst {
 
   class SingleCmd : public IR {
   private:
-    std::vector<char **> cmd_copies;
-    std::vector<int> element_sizes;
+    std::vector<std::string> elements;
 
   protected:
-    void *get_c_data();
+    void *build_c_data(IRArena &arena);
     void _compile();
-    int _execute();
+    std::vector<std::string> get_command();
 
   public:
     SingleCmd(std::vector<std::string> elements);
-    ~SingleCmd();
+  };
+
+  /**
+     A class describing commands run as a pipeline, i.e. at the same
+     time with the standard output of every command connected to the
+     standard input of the next one. The pipeline is run by /bin/sh,
+     so its exit code is the one of the last command.
+  */
+  class Pipeline : public IR {
+  private:
+    std::vector<std::vector<std::string> > commands;
+
+  protected:
+    void *build_c_data(IRArena &arena);
+    void _compile();
+    std::vector<std::string> get_command();
+
+  public:
+    /**
+       Constructs a Pipeline object.
+
+       @throw std::runtime_error If there are no commands or any
+                                 of them is empty.
+    */
+    Pipeline(std::vector<std::vector<std::string> > commands);
   };
 };
 
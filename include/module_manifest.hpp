@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef MODULE_MANIFEST_HPP_
+#define MODULE_MANIFEST_HPP_
+
+#include "adaptyst/hw.h"
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#define MODULE_MANIFEST_VERSION 1
+
+namespace adaptyst {
+  namespace fs = std::filesystem;
+
+  /**
+     A class describing the metadata of a module (name, version, options,
+     tags etc.), which can be obtained without loading the module library
+     if it has been cached before.
+
+     Manifests are cached as JSON files in get_cache_dir(), one per module
+     library, and they are rebuilt (loading the library once) whenever
+     the size or modification time of the library or its injection library
+     changes.
+  */
+  class ModuleManifest {
+  public:
+    /**
+       A structure describing a module option.
+    */
+    struct OptionInfo {
+      std::string help;
+      option_type type;
+      option_type array_type;
+
+      /**
+         The default value (an array for array options), null if
+         the option must be set.
+      */
+      nlohmann::json default_value;
+    };
+
+    /**
+       Gets the manifest of a module, loading the module library only
+       if there is no valid cached manifest.
+
+       @param backend_name  Name of the module directory.
+       @param library_paths Paths where modules are installed.
+
+       @throw std::runtime_error If the module cannot be found or its
+                                 metadata is invalid.
+    */
+    static ModuleManifest get(std::string backend_name,
+                              std::vector<fs::path> &library_paths);
+
+    /**
+       Gets the manifests of all installed modules, sorted by name.
+       If a module is installed in more than one path, the first one
+       in library_paths is used.
+
+       @throw std::runtime_error If the metadata of any module is invalid.
+    */
+    static std::vector<ModuleManifest> get_all(std::vector<fs::path> &library_paths);
+
+    /**
+       Returns the directory where manifests are cached:
+       ADAPTYST_MODULE_CACHE_DIR if set, otherwise "adaptyst/modules" in
+       XDG_CACHE_HOME (or ~/.cache).
+    */
+    static fs::path get_cache_dir();
+
+    /**
+       Checks module options from the system YAML file in the same way as
+       they are checked when the module is loaded, i.e. whether all options
+       without default values are set and whether values can be parsed.
+
+       @throw std::runtime_error If the options are invalid.
+    */
+    void validate(std::unordered_map<std::string, std::string> &options,
+                  std::unordered_map<std::string, std::vector<std::string> > &array_options);
+
+    std::string &get_name();
+    std::string &get_version();
+    std::vector<int> &get_version_nums();
+    fs::path &get_lib_path();
+
+    /**
+       Returns the path to the injection library of the module,
+       empty if there isn't one.
+    */
+    fs::path &get_inject_lib_path();
+
+    /**
+       Returns the maximum number of instances of the module in an entity,
+       0 for no limit.
+    */
+    unsigned int get_max_count_per_entity();
+    std::unordered_set<std::string> &get_tags();
+    std::map<std::string, OptionInfo> &get_options();
+
+  private:
+    std::string name;
+    std::string version;
+    std::vector<int> version_nums;
+    fs::path lib_path;
+    fs::path inject_lib_path;
+    unsigned int max_count_per_entity;
+    std::unordered_set<std::string> tags;
+    std::map<std::string, OptionInfo> options;
+
+    static nlohmann::json get_file_key(fs::path path);
+    static ModuleManifest build(std::string backend_name, fs::path lib_path,
+                                fs::path inject_lib_path);
+    nlohmann::json to_json();
+    static ModuleManifest from_json(nlohmann::json &json);
+  };
+};
+
+#endif
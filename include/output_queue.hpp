@@ -0,0 +1,304 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OUTPUT_QUEUE_HPP_
+#define OUTPUT_QUEUE_HPP_
+
+#include "adaptyst/send_queue.h"
+#include "adaptyst/socket.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <sys/uio.h>
+
+#define OUTPUT_QUEUE_MAX_BATCH 64
+
+namespace adaptyst {
+  /**
+     A class describing a queue of bytes to be written to a file
+     descriptor by a dedicated thread, so that threads sending
+     messages don't wait for the reader at the other end (unless
+     they choose so, see adaptyst_send_policy).
+
+     The queue is bounded by a high-water mark in bytes. Up to
+     OUTPUT_QUEUE_MAX_BATCH queued messages are written with a single
+     writev() call and partial writes continue where they have stopped,
+     so messages are never cut or interleaved.
+
+     The object must not be destroyed in a child process created by
+     fork() (there is no thread there), but leaked instead.
+  */
+  class OutputQueue {
+  private:
+    struct Entry {
+      std::string data;
+      bool control;
+    };
+
+    int fd;
+    unsigned long long high_water_mark;
+    adaptyst_send_policy policy;
+
+    std::deque<Entry> entries;
+
+    // The number of entries at the front being written without
+    // the mutex and the number of bytes of the first entry written
+    // before
+    size_t in_flight;
+    size_t offset;
+
+    adaptyst_send_stats stats;
+    bool failed;
+    std::string error;
+    bool stop;
+
+    std::mutex mutex;
+    std::condition_variable entries_cv;
+    std::condition_variable space_cv;
+    std::thread thread;
+
+    void throw_error() {
+      std::runtime_error err(this->error);
+      throw ConnectionException(err);
+    }
+
+    void drain() {
+      std::unique_lock lock(this->mutex);
+
+      while (true) {
+        this->entries_cv.wait(lock, [this]() {
+          return !this->entries.empty() || this->stop;
+        });
+
+        if (this->entries.empty()) {
+          break;
+        }
+
+        size_t count = std::min(this->entries.size(), (size_t)OUTPUT_QUEUE_MAX_BATCH);
+        struct iovec iov[OUTPUT_QUEUE_MAX_BATCH];
+
+        for (size_t i = 0; i < count; i++) {
+          size_t start = i == 0 ? this->offset : 0;
+          iov[i].iov_base = this->entries[i].data.data() + start;
+          iov[i].iov_len = this->entries[i].data.size() - start;
+        }
+
+        // Entries are only appended while the lock is released, which
+        // doesn't move the ones being written
+        this->in_flight = count;
+        lock.unlock();
+
+        ssize_t written = ::writev(this->fd, iov, count);
+        int error = errno;
+
+        if (written == -1 && (error == EAGAIN || error == EWOULDBLOCK)) {
+          struct pollfd poll_struct;
+          poll_struct.fd = this->fd;
+          poll_struct.events = POLLOUT;
+          ::poll(&poll_struct, 1, -1);
+        }
+
+        lock.lock();
+        this->in_flight = 0;
+        this->stats.write_calls++;
+
+        if (written == -1) {
+          if (error == EINTR || error == EAGAIN || error == EWOULDBLOCK) {
+            continue;
+          }
+
+          this->failed = true;
+          this->error = "Could not write to fd " + std::to_string(this->fd) +
+            ": " + std::string(std::strerror(error));
+
+          for (auto &entry : this->entries) {
+            if (!entry.control) {
+              this->stats.dropped_messages++;
+            }
+          }
+
+          this->stats.dropped_bytes += this->stats.queued_bytes;
+          this->stats.queued_bytes = 0;
+          this->stats.queued_messages = 0;
+          this->entries.clear();
+          this->offset = 0;
+          this->space_cv.notify_all();
+          continue;
+        }
+
+        this->stats.queued_bytes -= written;
+        this->stats.sent_bytes += written;
+
+        while (written > 0) {
+          size_t remaining = this->entries.front().data.size() - this->offset;
+
+          if ((size_t)written < remaining) {
+            this->offset += written;
+            break;
+          }
+
+          written -= remaining;
+
+          if (!this->entries.front().control) {
+            this->stats.queued_messages--;
+            this->stats.sent_messages++;
+          }
+
+          this->entries.pop_front();
+          this->offset = 0;
+        }
+
+        this->space_cv.notify_all();
+      }
+    }
+
+  public:
+    /**
+       Constructs an OutputQueue object and starts its thread.
+
+       @param fd              The file descriptor to write to. It is not
+                              closed by the object.
+       @param high_water_mark The maximum number of bytes waiting to be
+                              written before the policy applies.
+       @param policy          What push() should do when the high-water
+                              mark would be exceeded.
+    */
+    OutputQueue(int fd,
+                unsigned long long high_water_mark = ADAPTYST_SEND_DEFAULT_HIGH_WATER_MARK,
+                adaptyst_send_policy policy = ADAPTYST_SEND_BLOCK) {
+      this->fd = fd;
+      this->high_water_mark = high_water_mark;
+      this->policy = policy;
+      this->in_flight = 0;
+      this->offset = 0;
+      this->stats = {};
+      this->failed = false;
+      this->error = "";
+      this->stop = false;
+      this->thread = std::thread([this]() { this->drain(); });
+    }
+
+    /**
+       Writes everything queued so far and stops the thread.
+    */
+    ~OutputQueue() {
+      {
+        std::unique_lock lock(this->mutex);
+        this->stop = true;
+      }
+
+      this->entries_cv.notify_all();
+      this->thread.join();
+    }
+
+    void set_policy(unsigned long long high_water_mark,
+                    adaptyst_send_policy policy) {
+      std::unique_lock lock(this->mutex);
+      this->high_water_mark = high_water_mark;
+      this->policy = policy;
+      this->space_cv.notify_all();
+    }
+
+    /**
+       Queues bytes to be written.
+
+       @param data    The bytes to write.
+       @param control Whether the bytes must be written regardless of
+                      the high-water mark and never coalesced, e.g.
+                      because they change how the reader treats
+                      the bytes after them. They aren't counted as
+                      a message.
+
+       @return Whether the bytes have been queued, false if they have
+               been dropped.
+
+       @throw ConnectionException If any previous write has failed.
+    */
+    bool push(std::string data, bool control = false) {
+      std::unique_lock lock(this->mutex);
+
+      if (this->failed) {
+        this->throw_error();
+      }
+
+      size_t size = data.size();
+
+      auto fits = [this, size]() {
+        return this->stats.queued_bytes == 0 ||
+          this->stats.queued_bytes + size <= this->high_water_mark;
+      };
+
+      if (!control && !fits()) {
+        if (this->policy == ADAPTYST_SEND_BLOCK) {
+          this->space_cv.wait(lock, [this, &fits]() {
+            return this->failed || this->policy != ADAPTYST_SEND_BLOCK || fits();
+          });
+
+          if (this->failed) {
+            this->throw_error();
+          }
+        }
+
+        if (!fits()) {
+          size_t last = this->entries.size() - 1;
+
+          if (this->policy == ADAPTYST_SEND_COALESCE &&
+              !this->entries.empty() && !this->entries.back().control &&
+              last >= this->in_flight && (last > 0 || this->offset == 0)) {
+            Entry &entry = this->entries.back();
+            this->stats.dropped_bytes += entry.data.size();
+            this->stats.dropped_messages++;
+            this->stats.queued_bytes -= entry.data.size();
+            this->stats.queued_bytes += size;
+            entry.data = std::move(data);
+            return true;
+          }
+
+          this->stats.dropped_bytes += size;
+          this->stats.dropped_messages++;
+          return false;
+        }
+      }
+
+      this->entries.push_back({std::move(data), control});
+      this->stats.queued_bytes += size;
+
+      if (!control) {
+        this->stats.queued_messages++;
+      }
+
+      this->entries_cv.notify_one();
+      return true;
+    }
+
+    /**
+       Waits until everything queued so far is written.
+
+       @throw ConnectionException If any write has failed.
+    */
+    void flush() {
+      std::unique_lock lock(this->mutex);
+      this->space_cv.wait(lock, [this]() {
+        return this->entries.empty() || this->failed;
+      });
+
+      if (this->failed) {
+        this->throw_error();
+      }
+    }
+
+    adaptyst_send_stats get_stats() {
+      std::unique_lock lock(this->mutex);
+      return this->stats;
+    }
+  };
+};
+
+#endif
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OVERHEAD_HPP_
+#define OVERHEAD_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace adaptyst {
+  namespace ch = std::chrono;
+
+  /**
+     A class describing counters of the work done by Adaptyst itself on
+     behalf of an entity, a node or a module (e.g. time spent on handling
+     messages from the workflow or bytes sent to the workflow), so that
+     the perturbation caused by Adaptyst can be bounded when comparing
+     results.
+
+     Every thread updates its own copy of the counters without any
+     synchronisation and the copies are summed up only when the counters
+     are read with get() or to_json().
+  */
+  class OverheadCounters {
+  public:
+    enum Counter {
+      WORKFLOW_MESSAGES,
+      WORKFLOW_MESSAGE_NS,
+      REGION_REGEX_NS,
+      REGION_RING_RECORDS,
+      REGION_RING_DRAIN_NS,
+      INJECT_REGION_SWITCHES,
+      INJECT_WAIT_NS,
+      SRC_ARCHIVE_PATHS,
+      SRC_ARCHIVE_NS,
+      INIT_NS,
+      PROCESS_NS,
+      CLOSE_NS,
+      MESSAGES_SENT,
+      BYTES_SENT,
+      MESSAGES_RECEIVED,
+      BYTES_RECEIVED,
+      RECORDS_PUBLISHED,
+      RECORDS_CONSUMED,
+      PUBLISH_WAIT_NS,
+      COUNTER_COUNT
+    };
+
+    /**
+       A class measuring the time between its construction and
+       destruction and adding it in nanoseconds to a counter.
+    */
+    class Timer {
+    public:
+      Timer(OverheadCounters &counters, Counter counter) : counters(counters) {
+        this->counter = counter;
+        this->start = ch::steady_clock::now();
+      }
+
+      ~Timer() {
+        this->counters.add(this->counter,
+                           ch::duration_cast<ch::nanoseconds>(ch::steady_clock::now() -
+                                                              this->start).count());
+      }
+
+    private:
+      OverheadCounters &counters;
+      Counter counter;
+      ch::steady_clock::time_point start;
+    };
+
+    OverheadCounters();
+
+    /**
+       Adds a value to a counter. This is meant to be called frequently
+       and costs a few memory accesses when the calling thread has already
+       used the counters before.
+    */
+    inline void add(Counter counter, unsigned long long value = 1) {
+      std::atomic<unsigned long long> &elem = this->get_shard().values[counter];
+      elem.store(elem.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+    }
+
+    /**
+       Gets the value of a counter summed up across all threads.
+    */
+    unsigned long long get(Counter counter);
+
+    /**
+       Zeroes all counters. No other thread should update the counters
+       at the same time.
+    */
+    void reset();
+
+    /**
+       Returns the counters as a JSON object mapping names of counters
+       (e.g. "workflow_message_ns") to their values. Counters which
+       are zero are omitted.
+    */
+    nlohmann::json to_json();
+
+    /**
+       Returns the name of a counter as used in to_json().
+    */
+    static const char *get_name(Counter counter);
+
+  private:
+    struct Shard {
+      std::array<std::atomic<unsigned long long>, COUNTER_COUNT> values{};
+    };
+
+    unsigned long long id;
+    std::vector<std::unique_ptr<Shard> > shards;
+    std::mutex shards_mutex;
+
+    inline Shard &get_shard() {
+      // IDs are never reused, so a cached shard cannot belong to
+      // a destroyed object with the same address
+      thread_local unsigned long long last_id = 0;
+      thread_local Shard *last_shard = nullptr;
+
+      if (last_id != this->id) {
+        last_shard = this->find_shard();
+        last_id = this->id;
+      }
+
+      return *last_shard;
+    }
+
+    Shard *find_shard();
+  };
+};
+
+#endif
@@ -5,11 +5,29 @@
 #define PRINT_HPP_
 
 #include "system.hpp"
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 
+#define LOG_QUEUE_SIZE 8192
+
 namespace adaptyst {
+  class LogStream {
+    friend class Terminal;
+
+  private:
+    std::mutex mutex;
+    fs::path path;
+    std::ofstream stream;
+    std::string description;
+    bool opened;
+    bool unflushed;
+  };
+
+  class LogQueue;
+
   class Terminal {
   private:
     std::mutex mutex;
@@ -19,20 +37,39 @@ namespace adaptyst {
     int last_line_len;
     std::string version;
     std::unordered_map<Identifiable *,
-                       std::unordered_map<std::string, std::pair<std::shared_ptr<std::mutex>,
-                                                                 std::ofstream> > > log_streams;
+                       std::unordered_map<std::string, std::unique_ptr<LogStream> > > log_streams;
     fs::path log_dir;
+    std::atomic<bool> async_logging;
+    unsigned int log_queue_size;
+    std::atomic<unsigned long long> log_session;
+    std::vector<std::shared_ptr<LogQueue> > log_queues;
+    std::thread log_writer;
+    std::atomic<bool> log_writer_stop;
+    std::atomic<unsigned int> log_producers;
+    std::atomic<unsigned long long> dropped_logs;
+    std::atomic<unsigned long long> failed_logs;
+    std::string log_error;
     Terminal(bool batch, bool formatted, std::string version,
              fs::path log_dir);
+    LogQueue *get_log_queue();
+    void write_log(LogStream &stream, std::string &message, bool flush);
+    void write_logs();
 
   public:
     static std::unique_ptr<Terminal> instance;
     static void init(bool batch, bool formatted, std::string version,
                      fs::path log_dir);
 
+    ~Terminal();
     void print_notice();
+    LogStream *get_log_stream(Identifiable *source, std::string log_type);
+    void log(std::string message, LogStream *stream);
     void log(std::string message, Identifiable *source,
              std::string log_type);
+    void start_async_logging(unsigned int queue_size = LOG_QUEUE_SIZE);
+    void stop_async_logging();
+    unsigned long long get_dropped_log_count();
+    unsigned long long get_failed_log_count();
     void print(std::string message, bool sub, bool error,
                bool same_line = false);
     void print(std::string message, bool sub, bool error,
@@ -0,0 +1,253 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef REGION_RING_HPP_
+#define REGION_RING_HPP_
+
+#include <atomic>
+#include <new>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REGION_RING_MAGIC 0x41445252
+#define REGION_RING_NAME_SIZE 116
+
+namespace adaptyst {
+  /**
+     A fixed-size binary record describing a single region event
+     stored in a RegionRing.
+  */
+  struct RegionRecord {
+    /** Timestamp of the event in nanoseconds. */
+    unsigned long long timestamp;
+
+    /** Whether the timestamp could be obtained. */
+    bool timestamp_valid;
+
+    /** Whether the event ends the region (if false, it starts it). */
+    bool end;
+
+    /** Number of characters in the name (without the null terminator). */
+    unsigned short name_len;
+
+    /** Name of the region. */
+    char name[REGION_RING_NAME_SIZE];
+  };
+
+  static_assert(sizeof(RegionRecord) == 128);
+
+  /**
+     A class describing a single-producer-single-consumer ring buffer
+     of region events living in POSIX shared memory.
+
+     The producer is a single thread of the profiled workflow and the
+     consumer is Adaptyst. Neither side waits for the other unless
+     the buffer is full.
+  */
+  class RegionRing {
+  private:
+    struct Header {
+      unsigned int magic;
+      unsigned int capacity;
+      alignas(64) std::atomic<unsigned long long> head;
+      alignas(64) std::atomic<unsigned long long> tail;
+    };
+
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free);
+
+    std::string name;
+    void *mem;
+    size_t size;
+    Header *header;
+    RegionRecord *records;
+
+    RegionRing(std::string name, void *mem, size_t size) {
+      this->name = name;
+      this->mem = mem;
+      this->size = size;
+      this->header = (Header *)mem;
+      this->records = (RegionRecord *)((char *)mem + sizeof(Header));
+    }
+
+    static size_t get_size(unsigned int capacity) {
+      return sizeof(Header) + capacity * sizeof(RegionRecord);
+    }
+
+  public:
+    /**
+       Creates a new shared-memory ring buffer. This should be called
+       by the producer.
+
+       @param name     Name of the shared-memory object, starting with '/'.
+       @param capacity Number of records the buffer can hold. Must be
+                       a power of 2.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    static std::unique_ptr<RegionRing> create(std::string name,
+                                              unsigned int capacity) {
+      if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        throw std::runtime_error("Region ring capacity must be a power of 2");
+      }
+
+      int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+
+      if (fd == -1 && errno == EEXIST) {
+        // This is a leftover of a process with the same PID and TID
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+      }
+
+      if (fd == -1) {
+        throw std::runtime_error("shm_open() failed for " + name + ", error " +
+                                 std::to_string(errno));
+      }
+
+      size_t size = RegionRing::get_size(capacity);
+
+      if (ftruncate(fd, size) == -1) {
+        int error = errno;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ftruncate() failed for " + name + ", error " +
+                                 std::to_string(error));
+      }
+
+      void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+
+      if (mem == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("mmap() failed for " + name + ", error " +
+                                 std::to_string(errno));
+      }
+
+      Header *header = new (mem) Header;
+      header->capacity = capacity;
+      header->head.store(0, std::memory_order_relaxed);
+      header->tail.store(0, std::memory_order_relaxed);
+      header->magic = REGION_RING_MAGIC;
+
+      return std::unique_ptr<RegionRing>(new RegionRing(name, mem, size));
+    }
+
+    /**
+       Opens an existing shared-memory ring buffer and removes its name
+       from the system so that the memory is freed once both ends unmap it.
+       This should be called by the consumer.
+
+       @param name Name of the shared-memory object, starting with '/'.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    static std::unique_ptr<RegionRing> open(std::string name) {
+      int fd = shm_open(name.c_str(), O_RDWR, 0);
+
+      if (fd == -1) {
+        throw std::runtime_error("shm_open() failed for " + name + ", error " +
+                                 std::to_string(errno));
+      }
+
+      shm_unlink(name.c_str());
+
+      struct stat stat_buf;
+
+      if (fstat(fd, &stat_buf) == -1 ||
+          (size_t)stat_buf.st_size < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error(name + " is not a valid region ring");
+      }
+
+      size_t size = stat_buf.st_size;
+      void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+
+      if (mem == MAP_FAILED) {
+        throw std::runtime_error("mmap() failed for " + name + ", error " +
+                                 std::to_string(errno));
+      }
+
+      Header *header = (Header *)mem;
+
+      if (header->magic != REGION_RING_MAGIC ||
+          RegionRing::get_size(header->capacity) != size) {
+        munmap(mem, size);
+        throw std::runtime_error(name + " is not a valid region ring");
+      }
+
+      return std::unique_ptr<RegionRing>(new RegionRing(name, mem, size));
+    }
+
+    ~RegionRing() {
+      munmap(this->mem, this->size);
+    }
+
+    /**
+       Gets the name of the shared-memory object.
+    */
+    std::string &get_name() {
+      return this->name;
+    }
+
+    /**
+       Appends a record to the buffer. Producer only.
+
+       @param record Record to append.
+
+       @return Whether the record has been appended (false means
+               that the buffer is full).
+    */
+    bool push(const RegionRecord &record) {
+      unsigned long long head = this->header->head.load(std::memory_order_relaxed);
+      unsigned long long tail = this->header->tail.load(std::memory_order_acquire);
+
+      if (head - tail >= this->header->capacity) {
+        return false;
+      }
+
+      std::memcpy(&this->records[head & (this->header->capacity - 1)],
+                  &record, sizeof(RegionRecord));
+      this->header->head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+       Removes the oldest record from the buffer. Consumer only.
+
+       @param record Where the removed record should be stored.
+
+       @return Whether a record has been removed (false means
+               that the buffer is empty).
+    */
+    bool pop(RegionRecord &record) {
+      unsigned long long tail = this->header->tail.load(std::memory_order_relaxed);
+      unsigned long long head = this->header->head.load(std::memory_order_acquire);
+
+      if (tail == head) {
+        return false;
+      }
+
+      std::memcpy(&record, &this->records[tail & (this->header->capacity - 1)],
+                  sizeof(RegionRecord));
+      this->header->tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+       Returns whether the buffer is empty.
+    */
+    bool empty() {
+      return this->header->head.load(std::memory_order_acquire) ==
+        this->header->tail.load(std::memory_order_acquire);
+    }
+  };
+};
+
+#endif
@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef REGION_STATS_HPP_
+#define REGION_STATS_HPP_
+
+#include "adaptyst/region.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#define REGION_STATS_SUB_BUCKET_BITS 3
+
+namespace adaptyst {
+  /**
+     A class describing streaming statistics of region durations in
+     an entity, per region and per workflow part (i.e. thread).
+
+     Region start and end events are matched by Adaptyst as they arrive,
+     so that modules can query the statistics while the workflow runs
+     rather than storing the events themselves. Durations are counted
+     in a log-linear histogram with 2^REGION_STATS_SUB_BUCKET_BITS
+     sub-buckets per power of 2, so percentiles have a relative error
+     of at most 1 / 2^REGION_STATS_SUB_BUCKET_BITS and the memory used
+     doesn't grow with the number of instances.
+  */
+  class RegionStats {
+  public:
+    /**
+       Records a region start or end event.
+
+       @param name      Name of the region.
+       @param part_id   Workflow part ID.
+       @param start     Whether the event starts the region.
+       @param timestamp Timestamp of the event in nanoseconds.
+    */
+    void add_switch(std::string &name, std::string &part_id,
+                    bool start, unsigned long long timestamp);
+
+    /**
+       Records the summary of instances of an aggregated region.
+
+       @param name    Name of the region.
+       @param part_id Workflow part ID.
+       @param summary Summary reported by the workflow.
+    */
+    void add_summary(std::string &name, std::string &part_id,
+                     const adaptyst_region_summary &summary);
+
+    /**
+       Gets the statistics of a region.
+
+       @param name    Name of the region.
+       @param part_id Workflow part ID or an empty string for
+                      the statistics across all parts.
+       @param stats   Where the statistics should be stored.
+
+       @return Whether any instances of the region have ended in
+               the part (or any part).
+    */
+    bool get(std::string &name, std::string &part_id,
+             adaptyst_region_stats &stats);
+
+    /**
+       Gets a percentile of durations of a region.
+
+       @param name       Name of the region.
+       @param part_id    Workflow part ID or an empty string for
+                         the statistics across all parts.
+       @param percentile Percentile between 0 and 100.
+       @param ns         Where the duration in nanoseconds should be stored.
+
+       @return Whether any instances of the region have ended in
+               the part (or any part).
+    */
+    bool get_percentile(std::string &name, std::string &part_id,
+                        double percentile, unsigned long long &ns);
+
+    /**
+       Removes all statistics.
+    */
+    void reset();
+
+    /**
+       Returns whether no region events have been recorded.
+    */
+    bool empty();
+
+    /**
+       Returns the statistics as a JSON object mapping region names
+       to their statistics, with the statistics per part under "parts".
+    */
+    nlohmann::json to_json();
+
+  private:
+    struct Stats {
+      unsigned long long count = 0;
+      unsigned long long total_ns = 0;
+      unsigned long long min_ns = 0;
+      unsigned long long max_ns = 0;
+      std::vector<unsigned long long> histogram;
+
+      void add(unsigned long long duration, unsigned long long count = 1);
+      void merge(const adaptyst_region_summary &summary);
+      unsigned long long percentile(double percentile);
+      void fill(adaptyst_region_stats &stats);
+      nlohmann::json to_json();
+    };
+
+    struct Region {
+      Stats total;
+      std::unordered_map<std::string, Stats> parts;
+      std::unordered_map<std::string, unsigned long long> open;
+      unsigned long long unmatched = 0;
+    };
+
+    std::unordered_map<std::string, Region> regions;
+    std::mutex mutex;
+
+    Stats *find(std::string &name, std::string &part_id);
+  };
+};
+
+#endif
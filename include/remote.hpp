@@ -0,0 +1,365 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef REMOTE_HPP_
+#define REMOTE_HPP_
+
+#include "adaptyst/hw.h"
+#include "adaptyst/socket.hpp"
+#include "archive.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#define REMOTE_PROTOCOL_VERSION 2
+#define REMOTE_DEFAULT_ADDRESS "127.0.0.1"
+#define REMOTE_DEFAULT_PORT 42310
+#define REMOTE_TOKEN_ENV "ADAPTYST_REMOTE_TOKEN"
+#define REMOTE_AUTH_TIMEOUT 10
+#define REMOTE_AUTH_MAX_SIZE 4096
+#define REMOTE_CHANNEL_CONTROL 0
+#define REMOTE_CHANNEL_FIRST_FILE 16
+#define REMOTE_CHUNK_SIZE 262144
+#define REMOTE_SCAN_INTERVAL_MS 500
+#define REMOTE_CLOCK_ROUNDS 8
+#define REMOTE_REAP_INTERVAL 1
+
+namespace adaptyst {
+  namespace fs = std::filesystem;
+
+  /**
+     Gets the shared secret authenticating Adaptyst instances to
+     remote agents (or to daemons).
+
+     @param token_file The file with the secret (with any trailing
+                       whitespace ignored). If it is empty, the secret
+                       is taken from the env_var environment variable
+                       instead.
+     @param env_var    The environment variable with the secret.
+
+     @throw std::runtime_error If the file cannot be read or there
+                               is no secret.
+  */
+  std::string get_remote_token(fs::path token_file,
+                               std::string env_var = REMOTE_TOKEN_ENV);
+
+  /**
+     Checks whether a received secret is equal to the expected one.
+     The comparison takes the same time wherever the first difference
+     is, so that the secret cannot be guessed by measuring it.
+  */
+  bool is_token_equal(std::string_view received, std::string &expected);
+
+  /**
+     A class carrying many independent streams (channels) over
+     a single connection. Every frame sent through the connection
+     starts with the 4-byte big-endian ID of its channel.
+
+     Channel REMOTE_CHANNEL_CONTROL carries text commands, channels
+     from REMOTE_CHANNEL_FIRST_FILE onwards carry contents of
+     result files.
+  */
+  class Multiplexer {
+  public:
+    /**
+       Constructs a Multiplexer object and enables framing in
+       the connection.
+
+       @param conn The connection to be used.
+
+       @throw ConnectionException In case of any errors.
+    */
+    Multiplexer(std::unique_ptr<Connection> conn);
+
+    /**
+       Sends data through a channel. This can be called from
+       multiple threads at the same time.
+
+       @param channel The channel ID.
+       @param buf     The data to be sent.
+       @param len     The number of bytes of the data.
+
+       @throw ConnectionException In case of any errors.
+    */
+    void send(unsigned int channel, const char *buf, unsigned int len);
+
+    /**
+       Sends a text command through REMOTE_CHANNEL_CONTROL.
+
+       @throw ConnectionException In case of any errors.
+    */
+    void send_control(std::string msg);
+
+    /**
+       Receives the next frame from any channel. This must be called
+       from one thread at a time.
+
+       @param channel         Where the channel ID should be stored.
+       @param payload         Where the view of the data should be stored.
+                              The view is valid until the next call.
+       @param timeout_seconds A maximum number of seconds that can pass
+                              while waiting for the frame. Use NO_TIMEOUT
+                              for no timeout.
+
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException When the connection has been closed or
+                                  in case of any other errors.
+    */
+    void receive(unsigned int &channel, std::string_view &payload,
+                 long timeout_seconds = NO_TIMEOUT);
+
+    /**
+       Receives the next text command from REMOTE_CHANNEL_CONTROL,
+       expecting no frames from other channels in the meantime.
+
+       @throw std::runtime_error  If a frame from another channel
+                                  is received.
+       @throw TimeoutException    In case of timeout (see timeout_seconds).
+       @throw ConnectionException In case of any other errors.
+    */
+    std::string receive_control(long timeout_seconds = NO_TIMEOUT);
+
+    /**
+       Sets the maximum number of bytes of data (i.e. excluding the channel
+       ID) a received frame can carry. Receiving a longer frame results
+       in MessageTooLongException.
+    */
+    void set_max_receive_size(size_t max_size);
+
+  private:
+    std::unique_ptr<Connection> conn;
+    std::mutex send_mutex;
+    std::vector<char> send_buf;
+  };
+
+  /**
+     A class sending result files from local directories to the other
+     end of a Multiplexer as they are being written, rather than after
+     performance analysis is finished.
+
+     Directories are scanned periodically. Data appended to files
+     are sent as they are, while files which are replaced or modified
+     in place are sent again from the beginning.
+  */
+  class ResultStreamer {
+  public:
+    ResultStreamer(Multiplexer &mux);
+
+    ~ResultStreamer();
+
+    /**
+       Adds a directory to be sent.
+
+       @param tag  The name identifying the directory at the other end.
+       @param path The path to the directory.
+    */
+    void add_root(std::string tag, fs::path path);
+
+    /**
+       Starts scanning the directories in a background thread.
+
+       @param interval_ms The time between scans in milliseconds.
+    */
+    void start(unsigned int interval_ms = REMOTE_SCAN_INTERVAL_MS);
+
+    /**
+       Stops the background thread and sends all changes which
+       have not been sent yet.
+
+       @throw ConnectionException In case of any errors.
+    */
+    void finish();
+
+  private:
+    struct FileState {
+      unsigned int channel;
+      ino_t inode;
+      off_t offset;
+      struct timespec mtime;
+    };
+
+    Multiplexer &mux;
+    std::vector<std::pair<std::string, fs::path> > roots;
+    std::unordered_map<std::string, FileState> files;
+    unsigned int next_channel;
+    std::vector<char> buf;
+    std::mutex scan_mutex;
+    std::mutex stop_mutex;
+    std::condition_variable stop_cond;
+    bool stopping;
+    std::thread scanner;
+    std::exception_ptr error;
+
+    void scan();
+    void send_file(fs::path &path, FileState &state, struct stat &stat_buf);
+  };
+
+  /**
+     A class writing result files received from a ResultStreamer
+     at the other end of a Multiplexer.
+  */
+  class ResultReceiver {
+  public:
+    ~ResultReceiver();
+
+    /**
+       Adds a directory where files from the directory identified
+       by a tag at the other end should be written to.
+    */
+    void add_root(std::string tag, fs::path path);
+
+    /**
+       Handles a frame received through a Multiplexer.
+
+       @param channel The channel ID of the frame.
+       @param payload The data of the frame.
+
+       @return Whether the frame has been related to result files.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    bool handle(unsigned int channel, std::string_view payload);
+
+  private:
+    std::unordered_map<std::string, fs::path> roots;
+    std::unordered_map<unsigned int, int> fds;
+  };
+
+  /**
+     A class describing the connection from Adaptyst to a remote agent
+     hosting an entity.
+  */
+  class RemoteController {
+  public:
+    /**
+       Connects to a remote agent and authenticates with a shared secret
+       (see get_remote_token()).
+
+       @throw ConnectionException In case of any errors, including
+                                  the agent rejecting the secret.
+       @throw std::runtime_error  If the agent is incompatible.
+    */
+    RemoteController(std::string address, unsigned short port,
+                     unsigned int buf_size, std::string token);
+
+    /**
+       Sends the system definition file and the name of the entity
+       the agent should host.
+    */
+    void send_definition(fs::path def_file, std::string entity_name);
+
+    /**
+       Sends the IR of the workflow to be run by the agent.
+
+       @throw std::runtime_error If the IR type is not supported remotely.
+    */
+    void send_ir(ir workflow);
+
+    /**
+       Sends the compression of source code archives.
+    */
+    void send_src_compression(ArchiveCompression compression);
+
+    /**
+       Estimates the difference between the clock of the agent and
+       the local clock, both of them being the ones used by
+       adaptyst_get_timestamp(). The estimate with the shortest
+       round trip out of REMOTE_CLOCK_ROUNDS is taken.
+
+       @param rtt Where the round-trip time of the chosen estimate,
+                  in nanoseconds, should be stored.
+
+       @return The agent timestamp minus the local timestamp taken
+               at the same moment, in nanoseconds.
+    */
+    long long sync_clock(unsigned long long &rtt);
+
+    /**
+       Makes the agent run performance analysis and writes the
+       result files streamed back to receiver until the agent
+       finishes.
+
+       @throw std::runtime_error If performance analysis has failed
+                                 at the agent.
+    */
+    void run(ResultReceiver &receiver);
+
+    /**
+       Ends the session with the agent.
+    */
+    void close();
+
+  private:
+    std::unique_ptr<Multiplexer> mux;
+  };
+
+  /**
+     A class describing a remote agent, i.e. a process hosting entities
+     for Adaptyst instances running on other machines. Every session
+     (i.e. connection) hosts one entity and is served in its own child
+     process.
+
+     A session runs any command it is given as the user running
+     the agent, so the first message of every connection must carry
+     the shared secret of the agent and connections failing to do so
+     within REMOTE_AUTH_TIMEOUT seconds in total (or sending a longer
+     message than REMOTE_AUTH_MAX_SIZE bytes) are closed before anything
+     else is read. Authentication happens before the session process
+     is started, so unauthenticated peers cannot make the agent start
+     any processes. The secret is sent in plain text, so an agent listening
+     at anything other than a loopback address should only be reachable
+     through a trusted network or a tunnel (e.g. SSH).
+  */
+  class RemoteAgent {
+  public:
+    /**
+       Constructs a RemoteAgent object and starts listening for connections.
+
+       @param address           The address to listen at.
+       @param port              The port to listen at.
+       @param library_paths     The paths where modules are looked for.
+       @param local_config_path The path to the local configuration file.
+       @param work_dir          The directory where sessions should store
+                                their files temporarily.
+       @param buf_size          The buffer size for communication, in bytes.
+       @param formatted         Whether sessions should use non-standard
+                                terminal formatting.
+       @param token             The shared secret every connection must
+                                authenticate with.
+
+       @throw ConnectionException In case of any errors.
+    */
+    RemoteAgent(std::string address, unsigned short port,
+                std::vector<fs::path> &library_paths,
+                fs::path local_config_path, fs::path work_dir,
+                unsigned int buf_size, bool formatted, std::string token);
+
+    /**
+       Serves sessions one after another, forever.
+    */
+    void serve();
+
+  private:
+    std::unique_ptr<Acceptor> acceptor;
+    std::vector<fs::path> library_paths;
+    fs::path local_config_path;
+    fs::path work_dir;
+    unsigned int buf_size;
+    bool formatted;
+    std::string token;
+    unsigned int sessions;
+
+    bool authenticate(Multiplexer &mux);
+    void serve_session(Multiplexer &mux);
+  };
+};
+
+#endif
@@ -0,0 +1,396 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef SHM_CHANNEL_HPP_
+#define SHM_CHANNEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <new>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define SHM_CHANNEL_MAGIC 0x41444348
+
+namespace adaptyst {
+  /**
+     A class describing a bounded multi-producer-multi-consumer queue
+     of messages living in shared memory created with memfd_create().
+
+     The memory is shared by the Adaptyst and injection parts of
+     a module (and all processes of the workflow), which communicate
+     through it without any system calls as long as the queue is
+     neither full nor empty. Pushing never blocks: a message which
+     doesn't fit is dropped and counted. A consumer can wait for
+     messages on a futex-based doorbell, which producers ring only
+     when somebody is waiting.
+  */
+  class ShmChannel {
+  private:
+    struct Header {
+      unsigned int magic;
+      unsigned int slot_size;
+      unsigned int slot_count;
+      unsigned int slot_stride;
+      alignas(64) std::atomic<unsigned long long> head;
+      alignas(64) std::atomic<unsigned long long> tail;
+      alignas(64) std::atomic<unsigned int> doorbell;
+      std::atomic<unsigned int> waiters;
+      std::atomic<unsigned long long> dropped;
+    };
+
+    struct Slot {
+      std::atomic<unsigned long long> sequence;
+      unsigned int size;
+      char data[];
+    };
+
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free);
+    static_assert(sizeof(std::atomic<unsigned int>) == sizeof(int));
+
+    int fd;
+    bool owner;
+    void *mem;
+    size_t size;
+    Header *header;
+    char *slots;
+
+    // The geometry of the channel is copied from the header once it has
+    // been validated, as the workflow can overwrite the header at any time
+    unsigned int slot_size;
+    unsigned int slot_count;
+    unsigned int slot_stride;
+
+    ShmChannel(int fd, bool owner, void *mem, size_t size) {
+      this->fd = fd;
+      this->owner = owner;
+      this->mem = mem;
+      this->size = size;
+      this->header = (Header *)mem;
+      this->slots = (char *)mem + sizeof(Header);
+      this->slot_size = this->header->slot_size;
+      this->slot_count = this->header->slot_count;
+      this->slot_stride = this->header->slot_stride;
+    }
+
+    static unsigned int get_stride(unsigned int slot_size) {
+      return (sizeof(Slot) + slot_size + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+    }
+
+    static size_t get_size(unsigned int slot_count, unsigned int stride) {
+      return sizeof(Header) + (size_t)slot_count * stride;
+    }
+
+    inline Slot *get_slot(unsigned long long pos) {
+      return (Slot *)(this->slots + (pos & (this->slot_count - 1)) *
+                      this->slot_stride);
+    }
+
+    inline void futex(int op, unsigned int value, const struct timespec *timeout) {
+      // Not FUTEX_PRIVATE_FLAG, the memory is shared between processes
+      syscall(SYS_futex, &this->header->doorbell, op, value, timeout, nullptr, 0);
+    }
+
+  public:
+    /**
+       Creates a new channel. This should be called by the Adaptyst
+       part of a module before the workflow starts, so that the workflow
+       inherits the file descriptor returned by get_fd().
+
+       @param name       Name of the channel (for debugging purposes only).
+       @param slot_size  Maximum size of a message in bytes.
+       @param slot_count Maximum number of messages in the queue. Must be
+                         a power of 2.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    static std::unique_ptr<ShmChannel> create(std::string name,
+                                              unsigned int slot_size,
+                                              unsigned int slot_count) {
+      if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        throw std::runtime_error("Channel slot count must be a power of 2");
+      }
+
+      if (slot_size == 0) {
+        throw std::runtime_error("Channel slot size must be positive");
+      }
+
+      // No MFD_CLOEXEC, the descriptor must survive exec() of the workflow
+      int fd = memfd_create(("adaptyst_channel_" + name).c_str(), 0);
+
+      if (fd == -1) {
+        throw std::runtime_error("memfd_create() failed for channel " + name +
+                                 ", error " + std::to_string(errno));
+      }
+
+      unsigned int stride = ShmChannel::get_stride(slot_size);
+      size_t size = ShmChannel::get_size(slot_count, stride);
+
+      if (ftruncate(fd, size) == -1) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("ftruncate() failed for channel " + name +
+                                 ", error " + std::to_string(error));
+      }
+
+      void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+      if (mem == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("mmap() failed for channel " + name +
+                                 ", error " + std::to_string(error));
+      }
+
+      Header *header = new (mem) Header;
+      header->slot_size = slot_size;
+      header->slot_count = slot_count;
+      header->slot_stride = stride;
+      header->magic = SHM_CHANNEL_MAGIC;
+
+      std::unique_ptr<ShmChannel> channel(new ShmChannel(fd, true, mem, size));
+      channel->reset();
+      return channel;
+    }
+
+    /**
+       Maps an existing channel inherited from Adaptyst. This should
+       be called by the injection part of a module. The file descriptor
+       is left open, so that processes spawned by the workflow can map
+       the channel as well.
+
+       @param fd File descriptor of the channel.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    static std::unique_ptr<ShmChannel> open(int fd) {
+      struct stat stat_buf;
+
+      if (fstat(fd, &stat_buf) == -1 ||
+          (size_t)stat_buf.st_size < sizeof(Header)) {
+        throw std::runtime_error("File descriptor " + std::to_string(fd) +
+                                 " is not a valid channel");
+      }
+
+      size_t size = stat_buf.st_size;
+      void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+      if (mem == MAP_FAILED) {
+        throw std::runtime_error("mmap() failed for file descriptor " +
+                                 std::to_string(fd) + ", error " +
+                                 std::to_string(errno));
+      }
+
+      Header *header = (Header *)mem;
+      std::unique_ptr<ShmChannel> channel(new ShmChannel(fd, false, mem, size));
+
+      // The copied geometry is validated rather than the header itself,
+      // which can change in the meantime
+      if (header->magic != SHM_CHANNEL_MAGIC ||
+          channel->slot_size == 0 || channel->slot_count == 0 ||
+          (channel->slot_count & (channel->slot_count - 1)) != 0 ||
+          channel->slot_stride < ShmChannel::get_stride(channel->slot_size) ||
+          ShmChannel::get_size(channel->slot_count, channel->slot_stride) != size) {
+        throw std::runtime_error("File descriptor " + std::to_string(fd) +
+                                 " is not a valid channel");
+      }
+
+      return channel;
+    }
+
+    ~ShmChannel() {
+      munmap(this->mem, this->size);
+
+      if (this->owner) {
+        ::close(this->fd);
+      }
+    }
+
+    /**
+       Gets the file descriptor of the channel.
+    */
+    int get_fd() {
+      return this->fd;
+    }
+
+    /**
+       Gets the maximum size of a message in bytes.
+    */
+    unsigned int get_slot_size() {
+      return this->slot_size;
+    }
+
+    /**
+       Gets the number of messages dropped because the queue was full.
+    */
+    unsigned long long get_dropped() {
+      return this->header->dropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+       Empties the queue and zeroes the number of dropped messages.
+       Nobody else should use the channel at the same time.
+    */
+    void reset() {
+      for (unsigned int i = 0; i < this->slot_count; i++) {
+        new (&this->get_slot(i)->sequence) std::atomic<unsigned long long>(i);
+      }
+
+      this->header->head.store(0, std::memory_order_relaxed);
+      this->header->tail.store(0, std::memory_order_relaxed);
+      this->header->doorbell.store(0, std::memory_order_relaxed);
+      this->header->waiters.store(0, std::memory_order_relaxed);
+      this->header->dropped.store(0, std::memory_order_release);
+    }
+
+    /**
+       Appends a message to the queue without waiting.
+
+       @param buf Message to append.
+       @param n   Size of the message in bytes.
+
+       @return Whether the message has been appended (false means that
+               the queue is full or the message is too large).
+    */
+    bool push(const void *buf, unsigned int n) {
+      if (n > this->slot_size) {
+        this->header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      unsigned long long pos = this->header->head.load(std::memory_order_relaxed);
+      Slot *slot;
+
+      while (true) {
+        slot = this->get_slot(pos);
+        long long diff = (long long)slot->sequence.load(std::memory_order_acquire) -
+          (long long)pos;
+
+        if (diff == 0) {
+          if (this->header->head.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          this->header->dropped.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        } else {
+          pos = this->header->head.load(std::memory_order_relaxed);
+        }
+      }
+
+      std::memcpy(slot->data, buf, n);
+      slot->size = n;
+      slot->sequence.store(pos + 1, std::memory_order_release);
+
+      // Pairs with the fence in wait(), so that either the waiter sees
+      // the message or the producer sees the waiter
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (this->header->waiters.load(std::memory_order_relaxed) > 0) {
+        this->header->doorbell.fetch_add(1, std::memory_order_relaxed);
+        this->futex(FUTEX_WAKE, INT_MAX, nullptr);
+      }
+
+      return true;
+    }
+
+    /**
+       Removes the oldest message from the queue without waiting.
+
+       @param buf      Where the message should be stored.
+       @param buf_size Size of the buffer. The message is truncated if
+                       the buffer is smaller than the message.
+       @param n        Where the size of the message (before truncation)
+                       should be stored. A size larger than a slot (which
+                       can be written only by a misbehaving workflow) is
+                       clamped to the slot.
+
+       @return Whether a message has been removed (false means that
+               the queue is empty).
+    */
+    bool pop(void *buf, unsigned int buf_size, unsigned int *n) {
+      unsigned long long pos = this->header->tail.load(std::memory_order_relaxed);
+      Slot *slot;
+
+      while (true) {
+        slot = this->get_slot(pos);
+        long long diff = (long long)slot->sequence.load(std::memory_order_acquire) -
+          (long long)(pos + 1);
+
+        if (diff == 0) {
+          if (this->header->tail.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = this->header->tail.load(std::memory_order_relaxed);
+        }
+      }
+
+      unsigned int size = std::min<unsigned int>(slot->size,
+                                                 this->slot_stride - sizeof(Slot));
+      *n = size;
+      std::memcpy(buf, slot->data, std::min(size, buf_size));
+      slot->sequence.store(pos + this->slot_count, std::memory_order_release);
+      return true;
+    }
+
+    /**
+       Returns whether the queue is empty.
+    */
+    bool empty() {
+      unsigned long long pos = this->header->tail.load(std::memory_order_acquire);
+      return this->get_slot(pos)->sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    /**
+       Waits until the queue is not empty.
+
+       @param timeout_ms Timeout in milliseconds, negative for no timeout.
+
+       @return Whether the queue is not empty.
+    */
+    bool wait(long timeout_ms) {
+      if (!this->empty()) {
+        return true;
+      }
+
+      this->header->waiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      unsigned int doorbell = this->header->doorbell.load(std::memory_order_relaxed);
+
+      if (this->empty()) {
+        struct timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+        this->futex(FUTEX_WAIT, doorbell, timeout_ms < 0 ? nullptr : &timeout);
+      }
+
+      this->header->waiters.fetch_sub(1, std::memory_order_relaxed);
+      return !this->empty();
+    }
+  };
+};
+
+// A channel handle of the C module APIs
+struct adaptyst_channel {
+  std::string name;
+  std::unique_ptr<adaptyst::ShmChannel> channel;
+};
+
+#endif
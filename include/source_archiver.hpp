@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef SOURCE_ARCHIVER_HPP_
+#define SOURCE_ARCHIVER_HPP_
+
+#include "archive.hpp"
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#define SOURCE_ARCHIVER_THREADS 4
+
+namespace adaptyst {
+  namespace fs = std::filesystem;
+
+  /**
+     A class packing source code files into an archive file, along with
+     "index.json" mapping the original paths to the names inside
+     the archive.
+
+     Paths can be added at any point before close() is called, e.g. while
+     a workflow is still running. Files are read and hashed by a pool of
+     worker threads, while a single thread at a time writes to the archive.
+     Files with identical contents are stored only once.
+  */
+  class SourceArchiver {
+  public:
+    /**
+       Constructs a SourceArchiver object and starts its worker threads.
+
+       @param path        The path to an archive file to be created, without
+                          the extension (which is determined by compression).
+       @param compression The format and compression of the archive file.
+       @param threads     The number of worker threads.
+    */
+    SourceArchiver(fs::path path, ArchiveCompression compression,
+                   unsigned int threads = SOURCE_ARCHIVER_THREADS);
+
+    /**
+       Schedules a source code file to be added to the archive. Paths
+       that have already been scheduled, that do not exist or that are not
+       regular files are ignored. This does not block.
+
+       @param path The path to a source code file.
+    */
+    void add_path(fs::path path);
+
+    /**
+       Waits for all scheduled files to be added, writes "index.json"
+       and closes the archive file.
+
+       @throw std::exception If any file could not be added or the archive
+                             file could not be closed.
+    */
+    void close();
+
+    ~SourceArchiver();
+
+  private:
+    Archive archive;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    std::queue<fs::path> queue;
+    std::unordered_set<std::string> scheduled;
+    unsigned int in_progress;
+    bool closing;
+    std::vector<std::thread> workers;
+    std::mutex archive_mutex;
+    nlohmann::json src_mapping;
+    std::unordered_map<std::string,
+                       std::vector<std::pair<std::string, fs::path> > > contents;
+    unsigned int files_written;
+    std::exception_ptr error;
+
+    void work();
+    void stop_workers();
+  };
+};
+
+#endif
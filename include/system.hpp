@@ -11,7 +11,21 @@
 #include <vector>
 #include <filesystem>
 #include <future>
+#include <atomic>
+#include <functional>
 #include "ir.hpp"
+#include "region_ring.hpp"
+#include "shm_channel.hpp"
+#include "tsc_clock.hpp"
+#include "region_stats.hpp"
+#include "source_archiver.hpp"
+#include "remote.hpp"
+#include "cpu_topology.hpp"
+#include "cgroup.hpp"
+#include "telemetry.hpp"
+#include "module_manifest.hpp"
+#include "overhead.hpp"
+#include "dataflow.hpp"
 #include "adaptyst/output.hpp"
 #include "adaptyst/process.hpp"
 
@@ -81,8 +95,10 @@ namespace adaptyst {
   };
 
   class Node;
+  class NodeConnection;
   class Entity;
   class System;
+  class LogStream;
 
   typedef struct InjectPath {
     std::string name;
@@ -90,6 +106,7 @@ namespace adaptyst {
     int read_fd[2];
     int write_fd[2];
     std::string path;
+    std::vector<std::pair<std::string, int> > channels;
   } InjectPath;
 
   class Module : public Identifiable {
@@ -106,8 +123,6 @@ namespace adaptyst {
       unsigned int default_array_value_size;
     };
 
-    static std::vector<std::unique_ptr<Module> > get_all_modules(std::vector<fs::path> &library_paths);
-
     Module(std::string backend_name,
            std::vector<fs::path> &library_paths);
     Module(std::string backend_name,
@@ -121,6 +136,8 @@ namespace adaptyst {
     void process(std::shared_ptr<IR> ir_obj);
     bool wait();
     void close();
+    void reset();
+    void start_iteration(unsigned int iteration, bool warmup);
     void set_will_profile(bool will_profile);
     bool get_will_profile();
     void set_error(std::string error);
@@ -148,6 +165,7 @@ namespace adaptyst {
     void set_profile_info(profile_info info);
     bool is_initialising();
     const char *get_cpu_mask();
+    bool is_memory_bound();
     std::unordered_set<fs::path> &get_src_code_paths();
     std::string get_name();
     std::string get_version();
@@ -158,13 +176,31 @@ namespace adaptyst {
     fs::path get_inject_lib_path();
     amod_t get_id();
     std::shared_ptr<FileDescriptor> get_fd();
+    OverheadCounters &get_overhead();
     std::string &receive_string_inject(long timeout_seconds = NO_TIMEOUT);
+    int get_log_handle(std::string type);
+    LogStream *get_log_stream(int handle);
     bool is_workflow_running();
     bool is_workflow_ever_run();
     unsigned long long get_workflow_start_time(bool &err);
     unsigned long long get_workflow_end_time(bool &err);
     void region_switch(std::string name, std::string part_id,
                        std::string state, std::string timestamp_str);
+    void region_summary(std::string name, std::string part_id,
+                        const adaptyst_region_summary &summary);
+    void open_records(unsigned int capacity, unsigned int producers);
+    void publish_record(std::shared_ptr<Record> record);
+    bool push_record(std::shared_ptr<const Record> &record);
+    RecordQueue::Status consume_record(std::shared_ptr<const Record> &record,
+                                       long timeout_seconds);
+    void producer_done();
+    void records_done();
+    void create_channel(std::string name, unsigned int slot_size,
+                        unsigned int slot_count);
+    adaptyst_channel *get_channel(std::string name);
+    std::vector<std::pair<std::string, int> > get_channel_fds();
+    unsigned long long get_timestamp(bool &err);
+    RegionStats &get_region_stats();
 
   private:
     amod_t id;
@@ -175,11 +211,18 @@ namespace adaptyst {
     std::string error;
     void *context;
     void *handle;
+    adaptyst_module_vtable vtable;
+    const char **name_sym;
+    const char **version_sym;
+    int *version_nums_sym;
     fs::path inject_lib_path;
     bool injecting_process;
     bool injection_available;
     std::future<bool> process_future;
     std::vector<std::string> log_types;
+    std::vector<LogStream *> log_handles;
+    std::unordered_map<std::string, int> log_handle_ids;
+    std::mutex log_handles_mutex;
     std::vector<void *> malloced;
     std::unordered_set<std::string> tags;
     Node *node;
@@ -195,11 +238,15 @@ namespace adaptyst {
     int write_fd[2];
     std::shared_ptr<FileDescriptor> fd;
     std::string last_received_message_inject;
+    RecordQueue records;
+    std::unordered_map<std::string, std::unique_ptr<adaptyst_channel> > channels;
+    OverheadCounters overhead;
 
     void construct(std::string backend_name,
                    std::unordered_map<std::string, std::string> &options,
                    std::unordered_map<std::string, std::vector<std::string>> &array_options,
                    std::vector<fs::path> &library_paths, bool never_directing, bool no_inject);
+    void resolve_vtable();
   };
 
   class Node : public Identifiable {
@@ -208,14 +255,19 @@ namespace adaptyst {
          std::shared_ptr<Entity> &entity);
     bool init(unsigned int buf_size);
     void process(std::shared_ptr<IR> ir_obj);
+    void skip_process();
     bool wait();
     void close();
+    void reset();
+    void start_iteration(unsigned int iteration, bool warmup);
     std::unordered_set<std::string> &get_tags();
     void add_in_tags(std::unordered_set<std::string> &tags);
     void add_out_tags(std::unordered_set<std::string> &tags);
     bool has_in_tag(std::string tag);
     bool has_out_tag(std::string tag);
     void add_module(std::unique_ptr<Module> &mod);
+    void add_dependency(std::string node);
+    std::vector<std::string> &get_dependencies();
     void profile_notify();
     int profile_wait();
     int get_modules_profiling();
@@ -227,9 +279,11 @@ namespace adaptyst {
     profile_info &get_profile_info();
     void set_profile_info(profile_info info);
     const char *get_cpu_mask();
+    bool is_memory_bound();
     fs::path &get_tmp_dir();
     fs::path &get_local_config_dir();
     std::unordered_set<fs::path> get_src_code_paths();
+    void archive_src_code_path(fs::path path);
     std::vector<InjectPath> get_module_inject_paths();
     bool is_workflow_running();
     bool is_workflow_ever_run();
@@ -237,6 +291,16 @@ namespace adaptyst {
     unsigned long long get_workflow_end_time(bool &err);
     void region_switch(std::string name, std::string part_id,
                        std::string state, std::string timestamp_str);
+    void region_summary(std::string name, std::string part_id,
+                        const adaptyst_region_summary &summary);
+    void add_outgoing(NodeConnection *connection);
+    void add_incoming(NodeConnection *connection);
+    void open_records();
+    void publish_record(std::shared_ptr<const Record> &record);
+    void records_done();
+    unsigned long long get_timestamp(bool &err);
+    RegionStats &get_region_stats();
+    nlohmann::json get_module_overhead();
 
   private:
     std::unique_ptr<Path> dir;
@@ -247,23 +311,50 @@ namespace adaptyst {
     std::unordered_set<std::string> out_tags;
     int modules_profiling;
     std::mutex modules_profiling_mutex;
+    std::vector<std::string> dependencies;
+    std::vector<NodeConnection *> outgoing;
+    std::vector<NodeConnection *> incoming;
+    std::vector<Node *> arrival_nodes;
+    std::vector<Node *> departure_nodes;
+    OverheadCounters overhead;
   };
 
   class NodeConnection : public Identifiable {
   private:
     std::shared_ptr<Node> departure_node;
     std::shared_ptr<Node> arrival_node;
+    unsigned int queue_capacity;
 
   public:
     NodeConnection(std::string id,
                    std::shared_ptr<Node> &departure_node,
-                   std::shared_ptr<Node> &arrival_node);
+                   std::shared_ptr<Node> &arrival_node,
+                   unsigned int queue_capacity = DATAFLOW_DEFAULT_QUEUE_CAPACITY);
     std::shared_ptr<Node> &get_departure_node();
     std::shared_ptr<Node> &get_arrival_node();
+    unsigned int get_queue_capacity();
     std::vector<std::string> get_log_types();
     std::string get_type();
   };
 
+  class StartBarrier {
+  public:
+    StartBarrier();
+    void add_participant();
+    void arrive(Entity *entity, std::function<void()> release,
+                std::function<void()> announce);
+    void withdraw(Entity *entity);
+
+  private:
+    std::mutex mutex;
+    unsigned int participants;
+    std::unordered_set<Entity *> finished;
+    std::vector<std::pair<std::function<void()>,
+                          std::function<void()> > > waiting;
+
+    void release_if_complete();
+  };
+
   class Entity : public Identifiable {
   public:
     enum AccessMode {
@@ -278,10 +369,12 @@ namespace adaptyst {
            fs::path local_config_path,
            fs::path tmp_dir, bool no_inject,
            unsigned int buf_size);
+    ~Entity();
     void add_node(std::shared_ptr<Node> &node);
     void add_connection(std::string id,
                         std::string departure_node,
-                        std::string arrival_node);
+                        std::string arrival_node,
+                        unsigned int queue_capacity = DATAFLOW_DEFAULT_QUEUE_CAPACITY);
     std::shared_ptr<Node> &get_node(std::string id);
     void set_directing_node(std::string node);
     std::string get_directing_node();
@@ -290,10 +383,12 @@ namespace adaptyst {
     void init();
     void process(bool save_src_code_paths);
     void close();
+    void reset(fs::path entity_dir);
     void set_entity_dir(fs::path &entity_dir);
     void profile_notify();
     int profile_wait();
     const char *get_cpu_mask();
+    bool is_memory_bound();
     fs::path &get_tmp_dir();
     fs::path &get_local_config_dir();
     std::vector<std::shared_ptr<Node> > get_all_nodes();
@@ -305,6 +400,28 @@ namespace adaptyst {
     bool is_workflow_ever_run();
     unsigned long long get_workflow_start_time(bool &err);
     unsigned long long get_workflow_end_time(bool &err);
+    void set_region_ring_size(unsigned int size);
+    void set_tsc_clock(bool enabled);
+    unsigned long long get_timestamp(bool &err);
+    RegionStats &get_region_stats();
+    void region_switch(std::string name, std::string part_id,
+                       std::string state, std::string timestamp_str);
+    void region_summary(std::string name, std::string part_id,
+                        const adaptyst_region_summary &summary);
+    void start_iteration(fs::path iteration_dir, unsigned int iteration,
+                         bool warmup);
+    nlohmann::json get_run_info();
+    void set_region_policies(std::unordered_map<std::string,
+                             adaptyst_region_policy> policies);
+    bool will_run_workflow();
+    void set_start_barrier(std::shared_ptr<StartBarrier> barrier);
+    void set_src_compression(ArchiveCompression compression);
+    void archive_src_code_path(fs::path path);
+    void set_remote(std::string address, unsigned short port,
+                    fs::path def_file, fs::path token_file);
+    void set_cpu_policy(CPUPolicy policy);
+    void set_cgroup_policy(CgroupPolicy policy);
+    bool is_remote();
 
   private:
     AccessMode access_mode;
@@ -317,6 +434,11 @@ namespace adaptyst {
     fs::path local_config_path;
     fs::path tmp_dir;
     std::string cpu_mask;
+    CPUPolicy cpu_policy;
+    CgroupPolicy cgroup_policy;
+    std::unique_ptr<CgroupIsolation> cgroup_isolation;
+    unsigned long long telemetry_source;
+    bool telemetry_source_set;
     std::shared_ptr<IR> ir_obj;
     std::unique_ptr<Process> profiled_process;
     std::unordered_set<fs::path> src_code_paths;
@@ -326,6 +448,7 @@ namespace adaptyst {
     bool workflow_start_time_set;
     std::mutex workflow_finish_print_mutex;
     std::mutex profile_notify_mutex;
+    std::mutex cpu_mask_mutex;
     int modules_notified;
     int modules_profiling;
     bool no_inject;
@@ -341,6 +464,36 @@ namespace adaptyst {
     std::mutex profile_wait_mutex;
     bool process_finished;
     int process_exit_code;
+    unsigned int region_ring_size;
+    std::vector<std::pair<std::string, std::unique_ptr<RegionRing> > > region_rings;
+    std::mutex region_rings_mutex;
+    std::mutex region_switch_mutex;
+    std::unordered_map<std::string, adaptyst_region_policy> region_policies;
+    RegionStats region_stats;
+    std::future<void> region_drain;
+    std::atomic<bool> region_drain_stop;
+    bool tsc_clock_enabled;
+    std::unique_ptr<TscClock> tsc_clock;
+    std::vector<TscCalibration> tsc_calibrations;
+    std::mutex tsc_calibrations_mutex;
+    std::future<void> tsc_recalibration;
+    std::atomic<bool> tsc_recalibration_stop;
+    std::shared_ptr<StartBarrier> start_barrier;
+    LogStream *general_log;
+    ArchiveCompression src_compression;
+    std::unique_ptr<SourceArchiver> src_archiver;
+    std::mutex src_archiver_mutex;
+    std::string remote_address;
+    unsigned short remote_port;
+    fs::path remote_def_file;
+    fs::path remote_token_file;
+    std::unique_ptr<RemoteController> remote;
+    OverheadCounters overhead;
+
+    bool drain_region_rings();
+    void process_remote();
+    void start_workflow();
+    void announce_workflow_start();
   };
 
   class System {
@@ -351,7 +504,14 @@ namespace adaptyst {
     std::unique_ptr<Path> root_dir;
     std::variant<fs::path, int> codes_dst;
     bool custom_src_code_paths_save;
-
+    bool start_barrier;
+    std::string hosted_entity;
+    fs::path def_file;
+    unsigned int runs;
+    unsigned int warmup_runs;
+
+    void copy_definition();
+    void process_once();
     void init(fs::path def_file, fs::path root_dir,
               std::vector<fs::path> &library_paths, fs::path local_config_path,
               fs::path tmp_dir, bool no_inject, unsigned int buf_size);
@@ -363,8 +523,14 @@ namespace adaptyst {
            std::vector<fs::path> &library_paths, fs::path local_config_path,
            fs::path tmp_dir, bool no_inject, unsigned int buf_size,
            std::variant<fs::path, int> codes_dst);
+    System(fs::path def_file, std::string hosted_entity, fs::path root_dir,
+           std::vector<fs::path> &library_paths, fs::path local_config_path,
+           fs::path tmp_dir, bool no_inject, unsigned int buf_size);
     ~System();
+    void reset(fs::path root_dir);
     void set_ir(std::shared_ptr<IR> ir_obj);
+    void set_src_compression(ArchiveCompression compression);
+    void set_runs(unsigned int runs, unsigned int warmup_runs);
     void process();
     bool with_custom_src_code_paths();
   };
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef TELEMETRY_HPP_
+#define TELEMETRY_HPP_
+
+#include "adaptyst/socket.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+#define TELEMETRY_DEFAULT_PORT 42312
+#define TELEMETRY_QUEUE_SIZE 4096
+#define TELEMETRY_INTERVAL_MS 1000
+#define TELEMETRY_SEND_TIMEOUT 5
+
+namespace adaptyst {
+  /**
+     A class describing a TCP endpoint publishing live telemetry of
+     performance analysis to any number of subscribers, so that a run
+     can be watched without tailing log files on the machine where
+     it happens.
+
+     Every subscriber receives newline-delimited JSON objects, each
+     with "type" and "time" (milliseconds since the Unix epoch):
+     * "workflow": a state transition of the workflow of an entity
+       ("entity", "state" being "ready", "started" or "finished",
+       "exit_code" for "finished"),
+     * "module": a module indicating that it is ready to start
+       performance analysis ("entity", "node", "module", "state"),
+     * "regions": region events of an entity aggregated over
+       "interval_ms" ("entity", "regions" mapping region names to
+       "starts", "ends" and "aggregated", the last one being the number
+       of instances reported by the injection library as summaries),
+     * "counters": the overhead counters of an entity and its modules
+       (see OverheadCounters), sent every interval,
+     * "dropped": the number of messages ("count") the subscriber has
+       missed because it has not been reading fast enough.
+
+     Publishing never blocks on subscribers: every subscriber has
+     a bounded queue from which the oldest messages are dropped when
+     it is full, and a subscriber whose writes block for longer than
+     TELEMETRY_SEND_TIMEOUT seconds is disconnected.
+  */
+  class Telemetry {
+  public:
+    /**
+       The telemetry endpoint of Adaptyst, nullptr if telemetry
+       is disabled.
+    */
+    static std::unique_ptr<Telemetry> instance;
+
+    /**
+       Constructs a Telemetry object and starts accepting subscribers.
+
+       @param address     The address to listen at.
+       @param port        The port to listen at.
+       @param buf_size    The buffer size for communication, in bytes.
+       @param interval_ms How often aggregated region events and
+                          counters should be published, in milliseconds.
+       @param queue_size  The maximum number of messages waiting to be
+                          sent to a subscriber.
+
+       @throw ConnectionException In case of any errors.
+    */
+    Telemetry(std::string address, unsigned short port,
+              unsigned int buf_size,
+              unsigned int interval_ms = TELEMETRY_INTERVAL_MS,
+              unsigned int queue_size = TELEMETRY_QUEUE_SIZE);
+
+    /**
+       Publishes the remaining aggregated data, tries to send all queued
+       messages and disconnects all subscribers.
+    */
+    ~Telemetry();
+
+    /**
+       Returns "<TCP server address>_<TCP server port>".
+    */
+    std::string get_connection_instructions();
+
+    /**
+       Queues a message for all current subscribers. "time" is added
+       to the message if it is not there.
+    */
+    void publish(nlohmann::json message);
+
+    /**
+       Counts a region start or end for the next "regions" message.
+    */
+    void add_region_event(std::string entity, std::string region, bool start);
+
+    /**
+       Counts region instances aggregated by the injection library for
+       the next "regions" message.
+    */
+    void add_region_summary(std::string entity, std::string region,
+                            unsigned long long count);
+
+    /**
+       Registers a function returning a message to be published every
+       interval (e.g. counters), null if there is nothing to publish.
+       The function is called from a telemetry thread.
+
+       @return The ID of the source to be passed to remove_source().
+    */
+    unsigned long long add_source(std::function<nlohmann::json()> source);
+
+    /**
+       Unregisters a function added by add_source(). The function is
+       guaranteed not to be called after this returns.
+    */
+    void remove_source(unsigned long long id);
+
+  private:
+    struct Subscriber {
+      std::unique_ptr<Connection> connection;
+      std::deque<std::string> queue;
+      unsigned long long dropped;
+      bool finished;
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::thread thread;
+    };
+
+    struct RegionCounts {
+      unsigned long long starts;
+      unsigned long long ends;
+      unsigned long long aggregated;
+    };
+
+    std::unique_ptr<Acceptor> acceptor;
+    unsigned int buf_size;
+    unsigned int interval_ms;
+    unsigned int queue_size;
+    std::atomic_bool stop;
+
+    std::vector<std::unique_ptr<Subscriber> > subscribers;
+    std::mutex subscribers_mutex;
+
+    std::map<std::string, std::map<std::string, RegionCounts> > regions;
+    std::mutex regions_mutex;
+
+    std::map<unsigned long long, std::function<nlohmann::json()> > sources;
+    unsigned long long next_source_id;
+    std::mutex sources_mutex;
+
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+
+    std::thread accept_thread;
+    std::thread flush_thread;
+
+    void accept_loop();
+    void flush_loop();
+    void flush();
+    void send_loop(Subscriber &subscriber);
+    void prune_subscribers();
+  };
+};
+
+#endif
@@ -0,0 +1,363 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef TSC_CLOCK_HPP_
+#define TSC_CLOCK_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <stdexcept>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#define TSC_CLOCK_MAGIC 0x41445443
+#define TSC_CLOCK_SHIFT 32
+#define TSC_CLOCK_CALIBRATION_US 10000
+
+namespace adaptyst {
+  /**
+     Parameters converting raw counter ticks to nanoseconds of
+     CLOCK_MONOTONIC: ns = base_ns + ((ticks - base_ticks) * mult) >> shift.
+  */
+  struct TscCalibration {
+    unsigned long long base_ticks;
+    unsigned long long base_ns;
+    unsigned long long mult;
+    unsigned int shift;
+
+    inline unsigned long long to_ns(unsigned long long ticks) const {
+      // Ticks read before base_ticks (e.g. on another CPU just before
+      // a recalibration) give base_ns rather than wrapping around
+      long long delta = (long long)(ticks - this->base_ticks);
+
+      if (delta <= 0) {
+        return this->base_ns;
+      }
+
+      // 128-bit arithmetic, so that a late recalibration never overflows
+      return this->base_ns +
+        (unsigned long long)(((unsigned __int128)delta * this->mult) >> this->shift);
+    }
+  };
+
+  /**
+     A class describing the invariant TSC on x86 or the virtual counter
+     (cntvct_el0) on ARM, read directly by workflow threads instead of
+     calling clock_gettime().
+
+     Calibration is published by Adaptyst in a shared-memory page created
+     with memfd_create(), which the workflow maps and reads without any
+     locks through a sequence counter. Adaptyst recalibrates the clock
+     periodically while the workflow runs, never moving it backwards.
+  */
+  class TscClock {
+  private:
+    struct Page {
+      unsigned int magic;
+      std::atomic<unsigned int> sequence;
+      std::atomic<unsigned long long> base_ticks;
+      std::atomic<unsigned long long> base_ns;
+      std::atomic<unsigned long long> mult;
+      std::atomic<unsigned int> shift;
+    };
+
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free);
+
+    int fd;
+    bool owner;
+    Page *page;
+    TscCalibration first;
+
+    TscClock(int fd, bool owner, Page *page) {
+      this->fd = fd;
+      this->owner = owner;
+      this->page = page;
+    }
+
+    static bool read_monotonic(unsigned long long &ns) {
+      struct timespec ts;
+
+      if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
+        return false;
+      }
+
+      ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      return true;
+    }
+
+    // Reads the counter and CLOCK_MONOTONIC at (nearly) the same time,
+    // keeping the closest of a few attempts
+    static void sample(unsigned long long &ticks, unsigned long long &ns) {
+      unsigned long long best = ~0ULL;
+
+      for (int i = 0; i < 5; i++) {
+        unsigned long long before = TscClock::read_ticks();
+        unsigned long long sample_ns;
+
+        if (!TscClock::read_monotonic(sample_ns)) {
+          throw std::runtime_error("clock_gettime() failed, error " +
+                                   std::to_string(errno));
+        }
+
+        unsigned long long after = TscClock::read_ticks();
+
+        if (after - before < best) {
+          best = after - before;
+          ticks = before + (after - before) / 2;
+          ns = sample_ns;
+        }
+      }
+    }
+
+    void publish(const TscCalibration &calibration) {
+      unsigned int sequence = this->page->sequence.load(std::memory_order_relaxed);
+      this->page->sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      this->page->base_ticks.store(calibration.base_ticks, std::memory_order_relaxed);
+      this->page->base_ns.store(calibration.base_ns, std::memory_order_relaxed);
+      this->page->mult.store(calibration.mult, std::memory_order_relaxed);
+      this->page->shift.store(calibration.shift, std::memory_order_relaxed);
+
+      this->page->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+  public:
+    /**
+       Returns whether the counter can be used as a timestamp source,
+       i.e. whether it ticks at a constant rate in all CPU states and
+       is readable from user space.
+    */
+    static bool is_available() {
+#if defined(__x86_64__) || defined(__i386__)
+      unsigned int eax, ebx, ecx, edx;
+
+      if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return false;
+      }
+
+      return (edx & (1 << 8)) != 0;
+#elif defined(__aarch64__)
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    /**
+       Reads the counter. This must be called only if is_available()
+       returns true.
+    */
+    static inline unsigned long long read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#elif defined(__aarch64__)
+      unsigned long long ticks;
+      asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks) :: "memory");
+      return ticks;
+#else
+      return 0;
+#endif
+    }
+
+    /**
+       Creates and calibrates a new clock. This should be called by
+       Adaptyst before the workflow starts, so that the workflow inherits
+       the file descriptor returned by get_fd(). It takes about
+       TSC_CLOCK_CALIBRATION_US microseconds.
+
+       @throw std::runtime_error In case of any errors (including
+                                 the counter not being available).
+    */
+    static std::unique_ptr<TscClock> create() {
+      if (!TscClock::is_available()) {
+        throw std::runtime_error("No invariant timestamp counter is available");
+      }
+
+      // No MFD_CLOEXEC, the descriptor must survive exec() of the workflow
+      int fd = memfd_create("adaptyst_tsc_clock", 0);
+
+      if (fd == -1) {
+        throw std::runtime_error("memfd_create() failed for the TSC clock, error " +
+                                 std::to_string(errno));
+      }
+
+      if (ftruncate(fd, sizeof(Page)) == -1) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("ftruncate() failed for the TSC clock, error " +
+                                 std::to_string(error));
+      }
+
+      void *mem = mmap(nullptr, sizeof(Page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+      if (mem == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("mmap() failed for the TSC clock, error " +
+                                 std::to_string(error));
+      }
+
+      Page *page = new (mem) Page;
+      page->sequence.store(0, std::memory_order_relaxed);
+      page->magic = TSC_CLOCK_MAGIC;
+
+      std::unique_ptr<TscClock> clock(new TscClock(fd, true, page));
+
+      TscCalibration &first = clock->first;
+      first.shift = TSC_CLOCK_SHIFT;
+      TscClock::sample(first.base_ticks, first.base_ns);
+
+      std::this_thread::sleep_for(std::chrono::microseconds(TSC_CLOCK_CALIBRATION_US));
+
+      TscCalibration calibration = first;
+      TscClock::sample(calibration.base_ticks, calibration.base_ns);
+
+      if (calibration.base_ticks <= first.base_ticks) {
+        throw std::runtime_error("The timestamp counter doesn't advance");
+      }
+
+      first.mult = ((unsigned __int128)(calibration.base_ns - first.base_ns) <<
+                    TSC_CLOCK_SHIFT) / (calibration.base_ticks - first.base_ticks);
+      calibration.mult = first.mult;
+      clock->publish(calibration);
+      return clock;
+    }
+
+    /**
+       Maps an existing clock inherited from Adaptyst. This should be
+       called by the workflow. The mapping and the file descriptor are
+       kept until the clock is destroyed.
+
+       @param fd File descriptor of the clock.
+
+       @throw std::runtime_error In case of any errors.
+    */
+    static std::unique_ptr<TscClock> open(int fd) {
+      struct stat stat_buf;
+
+      if (fstat(fd, &stat_buf) == -1 || stat_buf.st_size != sizeof(Page)) {
+        throw std::runtime_error("File descriptor " + std::to_string(fd) +
+                                 " is not a valid TSC clock");
+      }
+
+      void *mem = mmap(nullptr, sizeof(Page), PROT_READ, MAP_SHARED, fd, 0);
+
+      if (mem == MAP_FAILED) {
+        throw std::runtime_error("mmap() failed for file descriptor " +
+                                 std::to_string(fd) + ", error " +
+                                 std::to_string(errno));
+      }
+
+      Page *page = (Page *)mem;
+
+      if (page->magic != TSC_CLOCK_MAGIC || !TscClock::is_available()) {
+        munmap(mem, sizeof(Page));
+        throw std::runtime_error("File descriptor " + std::to_string(fd) +
+                                 " is not a valid TSC clock");
+      }
+
+      return std::unique_ptr<TscClock>(new TscClock(fd, false, page));
+    }
+
+    ~TscClock() {
+      munmap(this->page, sizeof(Page));
+
+      if (this->owner) {
+        ::close(this->fd);
+      }
+    }
+
+    /**
+       Gets the file descriptor of the clock.
+    */
+    int get_fd() {
+      return this->fd;
+    }
+
+    /**
+       Gets the current calibration.
+    */
+    TscCalibration get_calibration() {
+      TscCalibration calibration;
+      unsigned int before, after;
+
+      do {
+        before = this->page->sequence.load(std::memory_order_acquire);
+
+        calibration.base_ticks = this->page->base_ticks.load(std::memory_order_relaxed);
+        calibration.base_ns = this->page->base_ns.load(std::memory_order_relaxed);
+        calibration.mult = this->page->mult.load(std::memory_order_relaxed);
+        calibration.shift = this->page->shift.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = this->page->sequence.load(std::memory_order_relaxed);
+      } while (before != after || (before & 1) != 0);
+
+      return calibration;
+    }
+
+    /**
+       Gets the current time in nanoseconds of CLOCK_MONOTONIC.
+    */
+    inline unsigned long long now() {
+      // The calibration is loaded first, so that its base_ticks is
+      // normally never newer than the ticks
+      TscCalibration calibration = this->get_calibration();
+      return calibration.to_ns(TscClock::read_ticks());
+    }
+
+    /**
+       Recalibrates the clock against CLOCK_MONOTONIC, using the whole
+       time since the clock has been created to measure the counter
+       frequency. Adaptyst only.
+
+       @return The new calibration.
+    */
+    TscCalibration recalibrate() {
+      TscCalibration current = this->get_calibration();
+      TscCalibration calibration = current;
+      TscClock::sample(calibration.base_ticks, calibration.base_ns);
+
+      if (calibration.base_ticks > this->first.base_ticks) {
+        calibration.mult = ((unsigned __int128)(calibration.base_ns - this->first.base_ns) <<
+                            calibration.shift) /
+          (calibration.base_ticks - this->first.base_ticks);
+      }
+
+      // Timestamps obtained before never appear later than new ones
+      unsigned long long previous_ns = current.to_ns(calibration.base_ticks);
+
+      if (previous_ns > calibration.base_ns) {
+        calibration.base_ns = previous_ns;
+      }
+
+      this->publish(calibration);
+      return calibration;
+    }
+
+    /**
+       Gets the counter frequency in Hz according to the current
+       calibration.
+    */
+    double get_frequency() {
+      TscCalibration calibration = this->get_calibration();
+      return calibration.mult == 0 ? 0 :
+        1e9 * (double)(1ULL << calibration.shift) / calibration.mult;
+    }
+  };
+};
+
+#endif
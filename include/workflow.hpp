@@ -38,6 +38,15 @@ namespace adaptyst {
   public:
     std::unique_ptr<IR> compile(Workflow &workflow);
   };
+
+  /**
+     A workflow compiler treating command elements equal to "|" as
+     separators between commands of a pipeline.
+  */
+  class WorkflowCompilerPipeline : public WorkflowCompiler {
+  public:
+    std::unique_ptr<IR> compile(Workflow &workflow);
+  };
 };
 
 #endif
@@ -5,7 +5,103 @@
 #include <fstream>
 
 namespace adaptyst {
-  Archive::Archive(fs::path path, unsigned int buf_size) {
+  ArchiveCompression::ArchiveCompression(Type type, int level) {
+    if (type == DEFLATE && (level < 0 || level > 9)) {
+      throw std::runtime_error("The deflate compression level must be "
+                               "between 0 and 9!");
+    } else if (type == ZSTD && (level < 1 || level > 22)) {
+      throw std::runtime_error("The zstd compression level must be "
+                               "between 1 and 22!");
+    }
+
+    this->type = type;
+    this->level = level;
+  }
+
+  ArchiveCompression ArchiveCompression::parse(std::string spec) {
+    std::string name = spec;
+    std::string level_str = "";
+    std::string::size_type sep = spec.find(':');
+
+    if (sep != std::string::npos) {
+      name = spec.substr(0, sep);
+      level_str = spec.substr(sep + 1);
+    }
+
+    auto get_level = [&spec, &level_str](int default_level) {
+      if (level_str.empty()) {
+        return default_level;
+      }
+
+      try {
+        size_t pos;
+        int level = std::stoi(level_str, &pos);
+
+        if (pos == level_str.length()) {
+          return level;
+        }
+      } catch (...) { }
+
+      throw std::runtime_error("Invalid compression level in \"" +
+                               spec + "\"!");
+    };
+
+    if (name == "store" && level_str.empty()) {
+      return ArchiveCompression(STORE, 0);
+    } else if (name == "deflate") {
+      return ArchiveCompression(DEFLATE, get_level(9));
+    } else if (name == "zstd") {
+      return ArchiveCompression(ZSTD, get_level(3));
+    }
+
+    throw std::runtime_error("Invalid compression \"" + spec + "\", it must be "
+                             "\"store\", \"deflate[:<level>]\" or "
+                             "\"zstd[:<level>]\"!");
+  }
+
+  ArchiveCompression::Type ArchiveCompression::get_type() {
+    return this->type;
+  }
+
+  int ArchiveCompression::get_level() {
+    return this->level;
+  }
+
+  std::string ArchiveCompression::get_extension() {
+    return this->type == ZSTD ? ".tar.zst" : ".zip";
+  }
+
+  void Archive::set_format(ArchiveCompression &compression) {
+    if (compression.get_type() == ArchiveCompression::ZSTD) {
+      if (archive_write_set_format_pax_restricted(this->arch) != ARCHIVE_OK ||
+          archive_write_add_filter_zstd(this->arch) != ARCHIVE_OK) {
+        throw Archive::InitException();
+      }
+
+      std::string options = "zstd:compression-level=" +
+        std::to_string(compression.get_level());
+
+      if (archive_write_set_options(this->arch, options.c_str()) != ARCHIVE_OK) {
+        throw Archive::InitException();
+      }
+    } else {
+      if (archive_write_set_format_zip(this->arch) != ARCHIVE_OK) {
+        throw Archive::InitException();
+      }
+
+      std::string options = compression.get_type() == ArchiveCompression::STORE ?
+        "zip:compression=store" :
+        "zip:compression=deflate,zip:compression-level=" +
+        std::to_string(compression.get_level());
+
+      if (archive_write_set_options(this->arch, options.c_str()) != ARCHIVE_OK) {
+        throw Archive::InitException();
+      }
+    }
+  }
+
+  Archive::Archive(fs::path path, unsigned int buf_size,
+                   ArchiveCompression compression) : buf(buf_size) {
     this->arch = nullptr;
     this->arch_entry = nullptr;
     this->buf_size = buf_size;
@@ -26,12 +122,12 @@ namespace adaptyst {
       throw Archive::InitException();
     }
 
-    if (archive_write_set_format_zip(this->arch) != ARCHIVE_OK) {
-      throw Archive::InitException();
-    }
+    this->set_format(compression);
 
-    if (archive_write_set_options(this->arch, "compression-level=9") !=
-        ARCHIVE_OK) {
+    // Output blocks are sized like the internal buffers so that large
+    // archives are not written in tiny chunks (a regular file is never
+    // padded to the block size)
+    if (archive_write_set_bytes_per_block(this->arch, this->buf_size) != ARCHIVE_OK) {
       throw Archive::InitException();
     }
 
@@ -41,7 +137,8 @@ namespace adaptyst {
   }
 
   Archive::Archive(std::unique_ptr<Connection> &conn, bool padding,
-                   unsigned int buf_size) {
+                   unsigned int buf_size,
+                   ArchiveCompression compression) : buf(buf_size) {
     this->arch = nullptr;
     this->arch_entry = nullptr;
     this->buf_size = buf_size;
@@ -59,14 +156,7 @@ namespace adaptyst {
       throw Archive::InitException();
     }
 
-    if (archive_write_set_format_zip(this->arch) != ARCHIVE_OK) {
-      throw Archive::InitException();
-    }
-
-    if (archive_write_set_options(this->arch, "compression-level=9") !=
-        ARCHIVE_OK) {
-      throw Archive::InitException();
-    }
+    this->set_format(compression);
 
     auto archive_open_padding =
       [](struct archive *arch, void *data) -> int {
@@ -105,6 +195,27 @@ namespace adaptyst {
     }
   }
 
+  void Archive::write_entry_header(std::string &filename, size_t size) {
+    archive_entry_clear(this->arch_entry);
+
+    archive_entry_set_pathname(this->arch_entry, filename.c_str());
+    archive_entry_set_size(this->arch_entry, size);
+    archive_entry_set_filetype(this->arch_entry, AE_IFREG);
+    archive_entry_set_perm(this->arch_entry, 0644);
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    time_t secs = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+
+    archive_entry_set_atime(this->arch_entry, secs, 0);
+    archive_entry_set_birthtime(this->arch_entry, secs, 0);
+    archive_entry_set_ctime(this->arch_entry, secs, 0);
+    archive_entry_set_mtime(this->arch_entry, secs, 0);
+
+    if (archive_write_header(this->arch, this->arch_entry) != ARCHIVE_OK) {
+      throw Archive::FileIOException(this->arch);
+    }
+  }
+
   void Archive::add_file(std::string filename, fs::path path) {
     if (!this->arch) {
       throw Archive::AlreadyClosedException();
@@ -118,36 +229,24 @@ namespace adaptyst {
       throw Archive::NotRegularFileException();
     }
 
-    archive_entry_clear(this->arch_entry);
-
-    std::ifstream stream(path);
+    std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
 
     if (!stream) {
       throw Archive::FileOpenException();
     }
 
-    archive_entry_set_pathname(this->arch_entry, filename.c_str());
-    archive_entry_set_size(this->arch_entry, fs::file_size(path));
-    archive_entry_set_filetype(this->arch_entry, AE_IFREG);
-    archive_entry_set_perm(this->arch_entry, 0644);
-
-    auto now = std::chrono::system_clock::now().time_since_epoch();
-    time_t secs = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+    this->write_entry_header(filename, fs::file_size(path));
 
-    archive_entry_set_atime(this->arch_entry, secs, 0);
-    archive_entry_set_birthtime(this->arch_entry, secs, 0);
-    archive_entry_set_ctime(this->arch_entry, secs, 0);
-    archive_entry_set_mtime(this->arch_entry, secs, 0);
+    char *buf = this->buf.data();
 
-    if (archive_write_header(this->arch, this->arch_entry) != ARCHIVE_OK) {
-      throw Archive::FileIOException(this->arch);
-    }
+    while (stream) {
+      stream.read(buf, this->buf_size);
+      int bytes_read = stream.gcount();
 
-    char buf[this->buf_size];
-    int bytes_read;
+      if (bytes_read == 0) {
+        break;
+      }
 
-    while (!stream.fail() &&
-           (bytes_read = stream.readsome(buf, this->buf_size)) > 0) {
       int bytes_written = archive_write_data(this->arch, buf, bytes_read);
       if (bytes_written == -1) {
         throw Archive::FileIOException(this->arch);
@@ -156,37 +255,44 @@ namespace adaptyst {
       }
     }
 
-    if (stream.fail()) {
+    if (stream.bad()) {
       throw Archive::FileIOException();
     }
   }
 
-  void Archive::add_file_stream(std::string filename, std::istream &stream,
-                                unsigned int size) {
+  void Archive::add_file_data(std::string filename, const char *data,
+                              size_t size) {
     if (!this->arch) {
       throw Archive::AlreadyClosedException();
     }
 
-    archive_entry_clear(this->arch_entry);
+    this->write_entry_header(filename, size);
 
-    archive_entry_set_pathname(this->arch_entry, filename.c_str());
-    archive_entry_set_size(this->arch_entry, size);
-    archive_entry_set_filetype(this->arch_entry, AE_IFREG);
-    archive_entry_set_perm(this->arch_entry, 0644);
+    size_t total_bytes = 0;
 
-    auto now = std::chrono::system_clock::now().time_since_epoch();
-    time_t secs = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+    while (total_bytes < size) {
+      size_t to_write = std::min<size_t>(size - total_bytes, this->buf_size);
+      la_ssize_t bytes_written = archive_write_data(this->arch, data + total_bytes,
+                                                    to_write);
+      if (bytes_written == -1) {
+        throw Archive::FileIOException(this->arch);
+      } else if ((size_t)bytes_written != to_write) {
+        throw Archive::FileIOException();
+      }
 
-    archive_entry_set_atime(this->arch_entry, secs, 0);
-    archive_entry_set_birthtime(this->arch_entry, secs, 0);
-    archive_entry_set_ctime(this->arch_entry, secs, 0);
-    archive_entry_set_mtime(this->arch_entry, secs, 0);
+      total_bytes += to_write;
+    }
+  }
 
-    if (archive_write_header(this->arch, this->arch_entry) != ARCHIVE_OK) {
-      throw Archive::FileIOException(this->arch);
+  void Archive::add_file_stream(std::string filename, std::istream &stream,
+                                unsigned int size) {
+    if (!this->arch) {
+      throw Archive::AlreadyClosedException();
     }
 
-    char buf[this->buf_size];
+    this->write_entry_header(filename, size);
+
+    char *buf = this->buf.data();
     int bytes_read;
     int total_bytes = 0;
 
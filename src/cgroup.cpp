@@ -0,0 +1,373 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "cgroup.hpp"
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace adaptyst {
+  namespace ch = std::chrono;
+
+  static int write_file(fs::path path, std::string value) {
+    int fd = open(path.c_str(), O_WRONLY);
+
+    if (fd == -1) {
+      return errno;
+    }
+
+    int error = 0;
+
+    if (::write(fd, value.c_str(), value.length()) == -1) {
+      error = errno;
+    }
+
+    close(fd);
+    return error;
+  }
+
+  static bool has_controller(fs::path path, std::string name) {
+    std::ifstream stream(path / "cgroup.controllers");
+    std::string controller;
+
+    while (stream >> controller) {
+      if (controller == name) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static bool enable_controller_at(fs::path path, std::string name) {
+    if (!has_controller(path, name)) {
+      return false;
+    }
+
+    int error = write_file(path / "cgroup.subtree_control", "+" + name);
+
+    if (error != 0) {
+      throw std::runtime_error("Could not enable the " + name + " controller in " +
+                               path.string() + ", error " + std::to_string(error));
+    }
+
+    return true;
+  }
+
+  Cgroup::Cgroup(fs::path path) {
+    std::error_code err;
+
+    if (!fs::create_directory(path, err)) {
+      throw std::runtime_error("Could not create cgroup " + path.string() +
+                               (err ? ": " + err.message() : ", it already exists"));
+    }
+
+    this->path = path;
+  }
+
+  Cgroup::~Cgroup() {
+    std::istringstream procs(this->read("cgroup.procs"));
+    std::string pid;
+
+    if (!this->origin.empty()) {
+      while (procs >> pid) {
+        write_file(this->origin / "cgroup.procs", pid);
+      }
+    } else if (procs >> pid) {
+      // Processes left behind by the workflow
+      write_file(this->path / "cgroup.kill", "1");
+    }
+
+    // A cgroup can be removed only after the kernel notices that it is
+    // empty, which may not be immediate
+    auto start = ch::steady_clock::now();
+
+    while (this->read("cgroup.events").find("populated 1") != std::string::npos &&
+           ch::steady_clock::now() - start < ch::milliseconds(CGROUP_TEARDOWN_TIMEOUT_MS)) {
+      std::this_thread::sleep_for(ch::milliseconds(10));
+    }
+
+    rmdir(this->path.c_str());
+  }
+
+  bool Cgroup::enable_controller(std::string name) {
+    return enable_controller_at(this->path, name);
+  }
+
+  void Cgroup::write(std::string file, std::string value) {
+    int error = write_file(this->path / file, value);
+
+    if (error != 0) {
+      throw std::runtime_error("Could not write \"" + value + "\" to " +
+                               (this->path / file).string() + ", error " +
+                               std::to_string(error));
+    }
+  }
+
+  void Cgroup::add_process(int pid) {
+    this->write("cgroup.procs", std::to_string(pid));
+  }
+
+  void Cgroup::join() {
+    fs::path origin = Cgroup::get_current_path();
+    this->add_process(getpid());
+    this->origin = origin;
+  }
+
+  nlohmann::json Cgroup::get_stats() {
+    nlohmann::json stats = nlohmann::json::object();
+
+    for (auto &file : {std::make_pair("cpu", "cpu.stat"),
+                       std::make_pair("memory", "memory.stat")}) {
+      std::istringstream stream(this->read(file.second));
+      std::string key;
+      unsigned long long value;
+      nlohmann::json values = nlohmann::json::object();
+
+      while (stream >> key >> value) {
+        values[key] = value;
+      }
+
+      if (!values.empty()) {
+        stats[file.first] = values;
+      }
+    }
+
+    std::istringstream peak(this->read("memory.peak"));
+    unsigned long long peak_value;
+
+    if (peak >> peak_value) {
+      stats["memory_peak"] = peak_value;
+    }
+
+    // io.stat has a line per device, e.g. "8:0 rbytes=1024 wbytes=0 ..."
+    std::istringstream io(this->read("io.stat"));
+    std::string line;
+    nlohmann::json devices = nlohmann::json::object();
+
+    while (std::getline(io, line)) {
+      std::istringstream fields(line);
+      std::string device, field;
+      nlohmann::json values = nlohmann::json::object();
+
+      if (!(fields >> device)) {
+        continue;
+      }
+
+      while (fields >> field) {
+        size_t sep = field.find('=');
+
+        if (sep == std::string::npos) {
+          continue;
+        }
+
+        try {
+          values[field.substr(0, sep)] = std::stoull(field.substr(sep + 1));
+        } catch (...) { }
+      }
+
+      devices[device] = values;
+    }
+
+    if (!devices.empty()) {
+      stats["io"] = devices;
+    }
+
+    return stats;
+  }
+
+  fs::path &Cgroup::get_path() {
+    return this->path;
+  }
+
+  fs::path Cgroup::get_mount_path() {
+    std::ifstream mounts("/proc/self/mounts");
+    std::string line;
+
+    while (std::getline(mounts, line)) {
+      std::istringstream fields(line);
+      std::string device, mount_point, type;
+
+      if (fields >> device >> mount_point >> type && type == "cgroup2") {
+        return mount_point;
+      }
+    }
+
+    return "/sys/fs/cgroup";
+  }
+
+  fs::path Cgroup::get_current_path() {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+
+    while (std::getline(cgroups, line)) {
+      // The cgroup v2 hierarchy is the one with ID 0 and no controllers
+      if (line.starts_with("0::")) {
+        return Cgroup::get_mount_path() / fs::path(line.substr(3)).relative_path();
+      }
+    }
+
+    throw std::runtime_error("Could not determine the cgroup v2 of Adaptyst, "
+                             "is the cgroup v2 hierarchy mounted?");
+  }
+
+  std::string Cgroup::to_list(const cpu_set_t &set) {
+    std::string list;
+
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (!CPU_ISSET(i, &set)) {
+        continue;
+      }
+
+      int end = i;
+
+      while (end + 1 < CPU_SETSIZE && CPU_ISSET(end + 1, &set)) {
+        end++;
+      }
+
+      if (!list.empty()) {
+        list += ",";
+      }
+
+      list += std::to_string(i);
+
+      if (end > i) {
+        list += "-" + std::to_string(end);
+      }
+
+      i = end;
+    }
+
+    return list;
+  }
+
+  std::string Cgroup::to_list(unsigned long nodes) {
+    std::string list;
+
+    for (size_t i = 0; i < sizeof(nodes) * 8; i++) {
+      if ((nodes & (1UL << i)) != 0) {
+        list += (list.empty() ? "" : ",") + std::to_string(i);
+      }
+    }
+
+    return list;
+  }
+
+  std::string Cgroup::read(std::string file) {
+    std::ifstream stream(this->path / file);
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+  }
+
+  CgroupIsolation::CgroupIsolation(CgroupPolicy &policy, std::string name,
+                                   const CPUConfig &cpu_config) {
+    fs::path parent = policy.parent.is_absolute() ?
+      policy.parent : Cgroup::get_mount_path() / policy.parent;
+
+    std::unique_lock lock(CgroupIsolation::trees_mutex);
+
+    try {
+      this->tree = CgroupIsolation::trees[parent.string()].lock();
+
+      if (!this->tree) {
+        // Memory and I/O controllers are needed only for limits, but
+        // they also provide statistics
+        auto enable_controllers = [&policy](std::function<bool(std::string)> enable,
+                                            fs::path path) {
+          if (!enable("cpuset")) {
+            throw std::runtime_error("The cpuset controller is not available in " +
+                                     path.string());
+          }
+
+          if (!enable("memory") && !policy.memory_max.empty()) {
+            throw std::runtime_error("The memory controller is not available in " +
+                                     path.string());
+          }
+
+          if (!enable("io") && !policy.io_max.empty()) {
+            throw std::runtime_error("The io controller is not available in " +
+                                     path.string());
+          }
+        };
+
+        auto tree = std::make_shared<Tree>();
+        CPU_ZERO(&tree->analysis_cpus);
+
+        enable_controllers([&parent](std::string controller) {
+          return enable_controller_at(parent, controller);
+        }, parent);
+
+        tree->root = std::make_unique<Cgroup>(parent / ("adaptyst_" +
+                                                        std::to_string(getpid())));
+
+        enable_controllers([&tree](std::string controller) {
+          return tree->root->enable_controller(controller);
+        }, tree->root->get_path());
+
+        tree->analysis = std::make_unique<Cgroup>(tree->root->get_path() / "analysis");
+        tree->analysis->join();
+
+        CgroupIsolation::trees[parent.string()] = tree;
+        this->tree = tree;
+      }
+
+      this->workflow = std::make_unique<Cgroup>(this->tree->root->get_path() /
+                                                ("workflow_" + name));
+
+      if (cpu_config.is_valid()) {
+        cpu_set_t analysis_cpus = cpu_config.get_cpu_analysis_set();
+        CPU_OR(&this->tree->analysis_cpus, &this->tree->analysis_cpus, &analysis_cpus);
+
+        if (CPU_COUNT(&this->tree->analysis_cpus) > 0) {
+          this->tree->analysis->write("cpuset.cpus",
+                                      Cgroup::to_list(this->tree->analysis_cpus));
+        }
+
+        cpu_set_t workflow_cpus = cpu_config.get_cpu_workflow_set();
+
+        if (CPU_COUNT(&workflow_cpus) > 0) {
+          this->workflow->write("cpuset.cpus", Cgroup::to_list(workflow_cpus));
+        }
+
+        if (cpu_config.get_workflow_memory_nodes() != 0) {
+          this->workflow->write("cpuset.mems",
+                                Cgroup::to_list(cpu_config.get_workflow_memory_nodes()));
+        }
+      }
+
+      if (!policy.memory_max.empty()) {
+        this->workflow->write("memory.max", policy.memory_max);
+      }
+
+      if (!policy.io_max.empty()) {
+        this->workflow->write("io.max", policy.io_max);
+      }
+    } catch (...) {
+      this->workflow.reset();
+      this->tree.reset();
+      throw;
+    }
+  }
+
+  CgroupIsolation::~CgroupIsolation() {
+    // The cgroups must be gone before another entity creates them again
+    std::unique_lock lock(CgroupIsolation::trees_mutex);
+    this->workflow.reset();
+    this->tree.reset();
+  }
+
+  void CgroupIsolation::add_workflow(int pid) {
+    this->workflow->add_process(pid);
+  }
+
+  nlohmann::json CgroupIsolation::get_stats() {
+    return this->workflow->get_stats();
+  }
+};
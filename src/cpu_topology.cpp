@@ -0,0 +1,186 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "cpu_topology.hpp"
+#include "adaptyst/process.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <sched.h>
+
+namespace adaptyst {
+  static int read_topology_value(int cpu, std::string name, int default_value) {
+    std::ifstream stream(fs::path("/sys/devices/system/cpu") /
+                         ("cpu" + std::to_string(cpu)) / "topology" / name);
+    int value;
+
+    if (!stream || !(stream >> value)) {
+      return default_value;
+    }
+
+    return value;
+  }
+
+  CPUTopology::CPUTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+      throw std::runtime_error("sched_getaffinity() failed, error " +
+                               std::to_string(errno));
+    }
+
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (!CPU_ISSET(i, &allowed)) {
+        continue;
+      }
+
+      LogicalCore core;
+      core.cpu = i;
+
+      // Without topology information, every logical core is treated
+      // as a separate physical one
+      core.core = read_topology_value(i, "core_id", i);
+      core.package = read_topology_value(i, "physical_package_id", 0);
+      core.numa_node = CPUConfig::get_numa_node(i);
+
+      this->cores.push_back(core);
+    }
+
+    this->group_cores();
+  }
+
+  CPUTopology::CPUTopology(std::vector<LogicalCore> cores) {
+    this->cores = cores;
+    this->group_cores();
+  }
+
+  void CPUTopology::group_cores() {
+    std::sort(this->cores.begin(), this->cores.end(),
+              [](const LogicalCore &a, const LogicalCore &b) {
+                return a.cpu < b.cpu;
+              });
+
+    std::map<std::pair<int, int>, int> indices;
+    this->max_cpu = -1;
+
+    for (auto &core : this->cores) {
+      auto key = std::make_pair(core.package, core.core);
+      auto elem = indices.find(key);
+
+      if (elem == indices.end()) {
+        indices[key] = this->physical_cores.size();
+        this->physical_cores.push_back({core.cpu});
+        this->physical_core_nodes.push_back(core.numa_node);
+      } else {
+        this->physical_cores[elem->second].push_back(core.cpu);
+      }
+
+      this->max_cpu = std::max(this->max_cpu, core.cpu);
+    }
+  }
+
+  unsigned int CPUTopology::get_logical_core_count() {
+    return this->cores.size();
+  }
+
+  unsigned int CPUTopology::get_physical_core_count() {
+    return this->physical_cores.size();
+  }
+
+  std::string CPUTopology::make_mask(std::string roles) {
+    std::string mask(this->max_cpu + 1, ' ');
+
+    for (size_t i = 0; i < roles.length() && i < this->cores.size(); i++) {
+      mask[this->cores[i].cpu] = roles[i];
+    }
+
+    return mask;
+  }
+
+  std::string CPUTopology::make_mask(unsigned int processing_threads,
+                                     int analysis_node, int workflow_node) {
+    std::string mask(this->max_cpu + 1, ' ');
+
+    if (processing_threads == 0) {
+      for (size_t i = 0; i < this->physical_cores.size(); i++) {
+        if (workflow_node == -1 || this->physical_core_nodes[i] == workflow_node) {
+          for (int cpu : this->physical_cores[i]) {
+            mask[cpu] = 'b';
+          }
+        }
+      }
+
+      if (mask.find('b') == std::string::npos) {
+        throw std::runtime_error("There are no allowed logical cores in NUMA node " +
+                                 std::to_string(workflow_node) + "!");
+      }
+
+      return mask;
+    }
+
+    std::vector<bool> used(this->physical_cores.size(), false);
+    unsigned int reserved = 0;
+
+    for (size_t i = 0; i < this->physical_cores.size() &&
+           reserved < CPU_TOPOLOGY_RESERVED_CPUS; i++) {
+      used[i] = true;
+      reserved += this->physical_cores[i].size();
+    }
+
+    unsigned int assigned = 0;
+
+    for (size_t i = 0; i < this->physical_cores.size() &&
+           assigned < processing_threads; i++) {
+      if (used[i] || (analysis_node != -1 &&
+                      this->physical_core_nodes[i] != analysis_node)) {
+        continue;
+      }
+
+      used[i] = true;
+
+      // Remaining SMT siblings are left unused rather than given
+      // to the workflow
+      for (size_t j = 0; j < this->physical_cores[i].size() &&
+             assigned < processing_threads; j++) {
+        mask[this->physical_cores[i][j]] = 'p';
+        assigned++;
+      }
+    }
+
+    if (assigned < processing_threads) {
+      throw std::runtime_error("Only " + std::to_string(assigned) + " logical cores "
+                               "can be used for processing threads" +
+                               (analysis_node == -1 ? std::string("") :
+                                " in NUMA node " + std::to_string(analysis_node)) +
+                               ", but " + std::to_string(processing_threads) +
+                               " are requested!");
+    }
+
+    bool workflow_cores = false;
+
+    for (size_t i = 0; i < this->physical_cores.size(); i++) {
+      if (used[i] || (workflow_node != -1 &&
+                      this->physical_core_nodes[i] != workflow_node)) {
+        continue;
+      }
+
+      for (int cpu : this->physical_cores[i]) {
+        mask[cpu] = 'c';
+      }
+
+      workflow_cores = true;
+    }
+
+    if (!workflow_cores) {
+      throw std::runtime_error("No physical cores are left for the workflow" +
+                               (workflow_node == -1 ? std::string("") :
+                                " in NUMA node " + std::to_string(workflow_node)) +
+                               " after assigning processing threads!");
+    }
+
+    return mask;
+  }
+};
@@ -0,0 +1,214 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "daemon.hpp"
+#include "entrypoint.hpp"
+#include "remote.hpp"
+#include <iostream>
+
+namespace adaptyst {
+  static std::string get_hello() {
+    return "hello " + std::to_string(DAEMON_PROTOCOL_VERSION) + " " +
+      std::string(version);
+  }
+
+  static bool is_hello_compatible(std::string_view msg) {
+    return msg.starts_with("hello " + std::to_string(DAEMON_PROTOCOL_VERSION) + " ");
+  }
+
+  static void send(Connection &conn, std::string msg) {
+    conn.write_message(msg.data(), msg.size());
+  }
+
+  static std::string receive(Connection &conn,
+                             long timeout_seconds = NO_TIMEOUT) {
+    std::string_view msg = conn.read_view(timeout_seconds);
+
+    if (msg.empty()) {
+      std::runtime_error err("The connection has been closed");
+      throw ConnectionException(err);
+    }
+
+    return std::string(msg);
+  }
+
+  Daemon::Daemon(std::string address, unsigned short port,
+                 unsigned int buf_size, std::string token, RunCallback run) {
+    this->buf_size = buf_size;
+    this->token = token;
+    this->run = run;
+
+    TCPAcceptor::Factory factory(address, port);
+    this->acceptor = factory.make_acceptor(UNLIMITED_ACCEPTED);
+  }
+
+  void Daemon::serve() {
+    std::cout << "Waiting for performance analysis requests at " <<
+      this->acceptor->get_connection_instructions() << std::endl;
+
+    while (true) {
+      std::unique_ptr<Connection> conn = this->acceptor->accept(this->buf_size);
+
+      try {
+        conn->enable_framing();
+
+        if (!this->serve_client(*conn)) {
+          return;
+        }
+      } catch (TimeoutException &) {
+        std::cerr << "A client has been disconnected for not sending "
+          "anything in time" << std::endl;
+      } catch (std::exception &e) {
+        std::cerr << "A client has disconnected unexpectedly: " <<
+          e.what() << std::endl;
+      }
+    }
+  }
+
+  bool Daemon::serve_client(Connection &conn) {
+    // Nothing is answered to unauthenticated clients
+    conn.set_max_message_size(DAEMON_AUTH_MAX_SIZE);
+    std::string auth = receive(conn, DAEMON_AUTH_TIMEOUT);
+
+    if (!auth.starts_with("auth ") ||
+        !is_token_equal(std::string_view(auth).substr(5), this->token)) {
+      std::cerr << "A client has failed to authenticate" << std::endl;
+      return true;
+    }
+
+    conn.set_max_message_size(MAX_MESSAGE_SIZE);
+
+    std::string hello = receive(conn, DAEMON_RECEIVE_TIMEOUT);
+    send(conn, get_hello());
+
+    if (!is_hello_compatible(hello)) {
+      return true;
+    }
+
+    while (true) {
+      std::string msg = receive(conn, DAEMON_RECEIVE_TIMEOUT);
+
+      if (msg.starts_with("run\n")) {
+        // "run\n<label>\n<element>\0<element>\0..."
+        std::string::size_type sep = msg.find('\n', 4);
+
+        if (sep == std::string::npos) {
+          send(conn, "done error\nMalformed request");
+          continue;
+        }
+
+        std::string label = msg.substr(4, sep - 4);
+        std::vector<std::string> command;
+        std::string::size_type start = sep + 1;
+
+        while (start < msg.size()) {
+          std::string::size_type end = msg.find('\0', start);
+
+          if (end == std::string::npos) {
+            end = msg.size();
+          }
+
+          command.push_back(msg.substr(start, end - start));
+          start = end + 1;
+        }
+
+        if (command.empty()) {
+          send(conn, "done error\nNo command has been provided");
+          continue;
+        }
+
+        fs::path result_dir;
+        std::string error;
+
+        bool ok;
+
+        try {
+          ok = this->run(label, command, result_dir, error);
+        } catch (std::exception &e) {
+          ok = false;
+          error = e.what();
+        }
+
+        if (ok) {
+          send(conn, "done ok " + result_dir.string());
+        } else {
+          send(conn, "done error " + result_dir.string() + "\n" + error);
+        }
+      } else if (msg == "close") {
+        return true;
+      } else if (msg == "stop") {
+        return false;
+      } else {
+        send(conn, "done error\nUnknown request");
+      }
+    }
+  }
+
+  DaemonClient::DaemonClient(std::string address, unsigned short port,
+                             unsigned int buf_size, std::string token) {
+    net::StreamSocket socket;
+
+    try {
+      socket.connect(net::SocketAddress(address, port));
+      socket.setNoDelay(true);
+    } catch (net::NetException &e) {
+      throw ConnectionException(e);
+    }
+
+    this->conn = std::make_unique<TCPSocket>(socket, buf_size);
+    this->conn->enable_framing();
+
+    send(*this->conn, "auth " + token);
+    send(*this->conn, get_hello());
+
+    if (!is_hello_compatible(receive(*this->conn))) {
+      throw std::runtime_error("The daemon at " + address + ":" +
+                               std::to_string(port) + " is incompatible "
+                               "with this version of Adaptyst");
+    }
+  }
+
+  DaemonClient::~DaemonClient() {
+    try {
+      send(*this->conn, "close");
+    } catch (std::exception &) {
+      // The daemon handles disconnections anyway
+    }
+  }
+
+  bool DaemonClient::run(std::vector<std::string> &command, std::string label,
+                         fs::path &result_dir, std::string &error) {
+    std::string msg = "run\n" + label + "\n";
+
+    for (auto &elem : command) {
+      msg += elem;
+      msg += '\0';
+    }
+
+    send(*this->conn, msg);
+
+    std::string reply = receive(*this->conn);
+
+    if (reply.starts_with("done ok ")) {
+      result_dir = reply.substr(8);
+      return true;
+    } else if (reply.starts_with("done error")) {
+      std::string::size_type sep = reply.find('\n');
+
+      if (sep == std::string::npos) {
+        sep = reply.size();
+      }
+
+      result_dir = sep > 11 ? reply.substr(11, sep - 11) : "";
+      error = sep < reply.size() ? reply.substr(sep + 1) : "";
+      return false;
+    }
+
+    error = "Unexpected reply from the daemon: " + reply;
+    return false;
+  }
+
+  void DaemonClient::stop() {
+    send(*this->conn, "stop");
+  }
+};
@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "dataflow.hpp"
+#include "adaptyst/socket.hpp"
+#include <chrono>
+
+namespace adaptyst {
+  RecordQueue::RecordQueue() {
+    this->capacity = DATAFLOW_DEFAULT_QUEUE_CAPACITY;
+    this->producers = 0;
+    this->consumer_active = false;
+  }
+
+  void RecordQueue::open(unsigned int capacity, unsigned int producers) {
+    std::unique_lock lock(this->mutex);
+    this->records.clear();
+    this->capacity = capacity > 0 ? capacity : 1;
+    this->producers = producers;
+    this->consumer_active = true;
+  }
+
+  bool RecordQueue::push(std::shared_ptr<const Record> &record) {
+    std::unique_lock lock(this->mutex);
+
+    this->not_full.wait(lock, [this]() {
+      return !this->consumer_active || this->records.size() < this->capacity;
+    });
+
+    if (!this->consumer_active) {
+      return false;
+    }
+
+    this->records.push_back(record);
+    this->not_empty.notify_one();
+    return true;
+  }
+
+  RecordQueue::Status RecordQueue::pop(std::shared_ptr<const Record> &record,
+                                       long timeout_seconds) {
+    std::unique_lock lock(this->mutex);
+
+    auto ready = [this]() {
+      return !this->records.empty() || this->producers == 0;
+    };
+
+    if (timeout_seconds == NO_TIMEOUT) {
+      this->not_empty.wait(lock, ready);
+    } else if (!this->not_empty.wait_for(lock, std::chrono::seconds(timeout_seconds),
+                                         ready)) {
+      return TIMEOUT;
+    }
+
+    if (this->records.empty()) {
+      return END;
+    }
+
+    record = std::move(this->records.front());
+    this->records.pop_front();
+    this->not_full.notify_one();
+    return RECORD;
+  }
+
+  void RecordQueue::producer_done() {
+    std::unique_lock lock(this->mutex);
+
+    if (this->producers > 0 && --this->producers == 0) {
+      this->not_empty.notify_all();
+    }
+  }
+
+  void RecordQueue::consumer_done() {
+    std::unique_lock lock(this->mutex);
+    this->consumer_active = false;
+    this->records.clear();
+    this->not_full.notify_all();
+  }
+};
@@ -5,6 +5,8 @@
 #include "print.hpp"
 #include "cmd.hpp"
 #include "system.hpp"
+#include "remote.hpp"
+#include "daemon.hpp"
 #include "workflow.hpp"
 #include "adaptyst/output.hpp"
 #include <CLI/CLI.hpp>
@@ -47,6 +49,40 @@ namespace adaptyst {
     }
   };
 
+  /**
+     Splits a string of the form ADDRESS[:PORT] into the address
+     and the port.
+
+     @return Whether the string is valid.
+  */
+  static bool parse_address(std::string spec, unsigned short default_port,
+                            std::string &address, unsigned short &port) {
+    address = spec;
+    port = default_port;
+
+    std::string::size_type sep = spec.rfind(':');
+
+    if (sep == std::string::npos) {
+      return !address.empty();
+    }
+
+    address = spec.substr(0, sep);
+
+    try {
+      unsigned long port_val = std::stoul(spec.substr(sep + 1));
+
+      if (port_val == 0 || port_val > 65535) {
+        return false;
+      }
+
+      port = port_val;
+    } catch (std::exception &) {
+      return false;
+    }
+
+    return !address.empty();
+  }
+
   int main_entrypoint(int argc, char **argv) {
     CLI::App app("Adaptyst: a performance analysis tool");
     app.formatter(std::make_shared<PrettyFormatter>());
@@ -82,6 +118,12 @@ namespace adaptyst {
                  "the path to a file defining a workflow to be "
                  "analysed");
 
+    bool is_pipeline = false;
+    app.add_flag("--pipeline", is_pipeline, "With -d, treat arguments equal "
+                 "to \"|\" as separators between commands run at the same "
+                 "time, with the standard output of every command connected "
+                 "to the standard input of the next one");
+
     std::string system_def_dir = "";
     app.add_option("-s,--system", system_def_dir, "Path to the definition "
                    "file of a computer system (required). See the "
@@ -109,6 +151,21 @@ namespace adaptyst {
       ->option_text("UINT")
       ->check(OnlyMinRange(0));
 
+    std::string src_compression = "deflate:9";
+    app.add_option("--src-compression", src_compression, "Compression of "
+                   "archives with detected source code files: \"store\" or "
+                   "\"deflate[:<0-9>]\" for ZIP archives, or \"zstd[:<1-22>]\" "
+                   "for zstd-compressed tar archives (default: deflate:9)")
+      ->check([](const std::string &arg) -> std::string {
+        try {
+          ArchiveCompression::parse(arg);
+          return "";
+        } catch (std::exception &e) {
+          return e.what();
+        }
+      })
+      ->option_text("TYPE[:LEVEL]");
+
     // no_inject will be fully implemented when process injection mechanism
     // is implemented
     bool no_inject = false;
@@ -135,10 +192,96 @@ namespace adaptyst {
     //   })
     //   ->option_text("TYPE[:ARG]");
 
+    unsigned int runs = 1;
+    app.add_option("--runs", runs, "Number of times the workflow should "
+                   "be run, with the modules kept initialised between "
+                   "the runs and the results of every run saved "
+                   "separately (default: 1)")
+      ->option_text("UINT")
+      ->check(OnlyMinRange(1));
+
+    unsigned int warmup_runs = 0;
+    app.add_option("--warmup-runs", warmup_runs, "Number of additional runs "
+                   "of the workflow before the ones from --runs, whose "
+                   "results are discarded (default: 0)")
+      ->option_text("UINT")
+      ->check(OnlyMinRange(0));
+
     bool no_format = false;
     app.add_flag("--no-format", no_format, "Do not use any non-standard "
                  "terminal formatting");
 
+    bool async_log = false;
+    app.add_flag("--async-log", async_log, "Write logs in a background "
+                 "thread so that logging never blocks modules (messages "
+                 "may be dropped if they are produced faster than they "
+                 "can be saved)");
+
+    std::string agent_address;
+    CLI::Option *agent_opt =
+      app.add_option("--agent", agent_address, "Run as a remote agent "
+                     "listening at ADDRESS[:PORT] (the default address is "
+                     REMOTE_DEFAULT_ADDRESS " and the default port is " +
+                     std::to_string(REMOTE_DEFAULT_PORT) + ") and hosting "
+                     "entities of type \"remote\" for Adaptyst instances "
+                     "running on other machines. Sessions run any commands "
+                     "they are given, so connections must authenticate "
+                     "with the secret from --agent-token-file or "
+                     REMOTE_TOKEN_ENV ", which is sent in plain text: listen "
+                     "at other addresses than loopback ones only in trusted "
+                     "networks")
+      ->option_text("[ADDRESS][:PORT]")
+      ->expected(0, 1);
+
+    std::string agent_token_file;
+    app.add_option("--agent-token-file", agent_token_file, "Path to the file "
+                   "with the shared secret for --agent (if not set, "
+                   REMOTE_TOKEN_ENV " is used)")
+      ->option_text("FILE");
+
+    std::string daemon_spec;
+    app.add_option("--daemon", daemon_spec, "Run as a daemon listening at "
+                   "ADDRESS[:PORT] (the default port is " +
+                   std::to_string(DAEMON_DEFAULT_PORT) + "), keeping the "
+                   "computer system from -s with its modules initialised "
+                   "and analysing commands submitted with --submit one "
+                   "after another. Submitted commands run as the user "
+                   "running the daemon, so connections must authenticate "
+                   "with the secret from --daemon-token-file or "
+                   DAEMON_TOKEN_ENV ", which is sent in plain text: listen "
+                   "at other addresses than loopback ones only in trusted "
+                   "networks")
+      ->option_text("ADDRESS[:PORT]");
+
+    std::string submit_spec;
+    app.add_option("--submit", submit_spec, "Submit the command to "
+                   "the daemon listening at ADDRESS[:PORT] instead of "
+                   "analysing it here, and print the path to the results "
+                   "once the analysis is finished")
+      ->option_text("ADDRESS[:PORT]");
+
+    std::string stop_daemon_spec;
+    app.add_option("--stop-daemon", stop_daemon_spec, "Make the daemon "
+                   "listening at ADDRESS[:PORT] exit")
+      ->option_text("ADDRESS[:PORT]");
+
+    std::string daemon_token_file;
+    app.add_option("--daemon-token-file", daemon_token_file, "Path to the file "
+                   "with the shared secret for --daemon, --submit and "
+                   "--stop-daemon (if not set, " DAEMON_TOKEN_ENV " is used)")
+      ->option_text("FILE");
+
+    std::string telemetry_spec;
+    app.add_option("--telemetry", telemetry_spec, "Publish live progress "
+                   "of performance analysis (workflow states, region "
+                   "events and overhead counters) as newline-delimited "
+                   "JSON to TCP clients connecting to ADDRESS[:PORT] "
+                   "(the default port is " +
+                   std::to_string(TELEMETRY_DEFAULT_PORT) + "). Slow "
+                   "clients miss messages rather than slow down "
+                   "the analysis")
+      ->option_text("ADDRESS[:PORT]");
+
     std::string footer =
       "If you want to change the paths of the system-wide and local Adaptyst\n"
       "configuration files, set the environment variables ADAPTYST_CONFIG and\n"
@@ -245,16 +388,16 @@ namespace adaptyst {
 
       if (list_modules) {
         try {
-          auto modules = Module::get_all_modules(module_paths);
+          auto modules = ModuleManifest::get_all(module_paths);
 
           if (modules.empty()) {
             std::cout << "No modules are installed." << std::endl;
           } else {
             std::cout << "Installed modules:" << std::endl;
             for (auto &sys_module : modules) {
-              std::string name = sys_module->get_name();
-              std::string version = sys_module->get_version();
-              fs::path path = sys_module->get_lib_path();
+              std::string name = sys_module.get_name();
+              std::string version = sys_module.get_version();
+              fs::path path = sys_module.get_lib_path();
 
               std::cout << "* " << name << " v" << version << " (";
               std::cout << path.string() << ")" << std::endl;
@@ -300,7 +443,11 @@ namespace adaptyst {
 
       std::cout << "Path of the local Adaptyst configuration file ";
       std::cout << "(changable via ADAPTYST_LOCAL_CONFIG env variable):" << std::endl;
-      std::cout << local_config_path.string() << std::endl;
+      std::cout << local_config_path.string() << std::endl << std::endl;
+
+      std::cout << "Path where metadata of Adaptyst modules is cached ";
+      std::cout << "(changable via ADAPTYST_MODULE_CACHE_DIR env variable):" << std::endl;
+      std::cout << ModuleManifest::get_cache_dir().string() << std::endl;
 
       return 0;
     } else if (module_help != "" && plugin_help != "") {
@@ -308,7 +455,7 @@ namespace adaptyst {
       return 1;
     } else if (module_help != "") {
       try {
-        Module sys_module(module_help, module_paths);
+        ModuleManifest sys_module = ModuleManifest::get(module_help, module_paths);
 
         std::string name = sys_module.get_name();
         std::string version = sys_module.get_version();
@@ -317,7 +464,7 @@ namespace adaptyst {
         std::cout << "Available options:" << std::endl;
         std::cout << "------------------";
 
-        for (auto &option_metadata : sys_module.get_all_options()) {
+        for (auto &option_metadata : sys_module.get_options()) {
           std::cout << std::endl;
 
           if (option_metadata.second.array_type == NONE &&
@@ -417,18 +564,122 @@ namespace adaptyst {
       std::cout << "You can currently only analyse commands via the -d option.";
       std::cout << std::endl;
       return 0;
+    } else if (agent_opt->count() > 0) {
+      std::string address;
+      unsigned short port;
+
+      if (agent_address.empty() || agent_address.starts_with(":")) {
+        agent_address = REMOTE_DEFAULT_ADDRESS + agent_address;
+      }
+
+      if (!parse_address(agent_address, REMOTE_DEFAULT_PORT, address, port)) {
+        std::cerr << "The address provided to --agent is invalid!" << std::endl;
+        return 1;
+      }
+
+      std::string token;
+
+      try {
+        token = get_remote_token(agent_token_file);
+      } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+
+      fs::path work_dir = fs::temp_directory_path() /
+        ("adaptyst.agent.pid." + std::to_string(getpid()));
+
+      try {
+        fs::create_directories(work_dir);
+        RemoteAgent agent(address, port, module_paths, local_config_path,
+                          work_dir, buf_size, !no_format, token);
+        agent.serve();
+      } catch (std::exception &e) {
+        std::cerr << "The remote agent has failed! Details: " << std::endl;
+        std::cerr << e.what() << std::endl;
+        return 2;
+      }
+
+      return 0;
+    } else if (!submit_spec.empty() || !stop_daemon_spec.empty()) {
+      std::string address;
+      unsigned short port;
+      bool stop = submit_spec.empty();
+
+      if (!parse_address(stop ? stop_daemon_spec : submit_spec,
+                         DAEMON_DEFAULT_PORT, address, port)) {
+        std::cerr << "The address of the daemon is invalid!" << std::endl;
+        return 1;
+      }
+
+      if (!stop && command_elements.empty()) {
+        std::cerr << "A workflow to be analysed is required!";
+        std::cerr << std::endl;
+        return 1;
+      } else if (!stop && !is_command) {
+        std::cerr << "Only analysing commands is supported at the moment, please use -d.";
+        std::cerr << std::endl;
+        return 1;
+      } else if (!stop && is_pipeline) {
+        std::cerr << "Pipelines cannot be submitted to the daemon at the moment.";
+        std::cerr << std::endl;
+        return 1;
+      }
+
+      std::string token;
+
+      try {
+        token = get_remote_token(daemon_token_file, DAEMON_TOKEN_ENV);
+      } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+
+      try {
+        DaemonClient client(address, port, buf_size, token);
+
+        if (stop) {
+          client.stop();
+          return 0;
+        }
+
+        fs::path result_dir;
+        std::string error;
+
+        if (client.run(command_elements, label, result_dir, error)) {
+          std::cout << result_dir.string() << std::endl;
+          return 0;
+        }
+
+        std::cerr << "Performance analysis has failed! Details: " << std::endl;
+        std::cerr << error << std::endl;
+
+        if (!result_dir.empty()) {
+          std::cerr << "The incomplete results are available in ";
+          std::cerr << result_dir.string() << std::endl;
+        }
+      } catch (std::exception &e) {
+        std::cerr << "Could not communicate with the daemon! Details: " << std::endl;
+        std::cerr << e.what() << std::endl;
+      }
+
+      return 2;
     } else if (system_def_dir == "") {
       std::cerr << "The definition file of a computer system is required! (use -s)";
       std::cerr << std::endl;
       return 1;
-    } else if (command_elements.empty()) {
+    } else if (command_elements.empty() && daemon_spec.empty()) {
       std::cerr << "A workflow to be analysed is required!";
       std::cerr << std::endl;
       return 1;
-    } else if (!is_command) {
+    } else if (!is_command && daemon_spec.empty()) {
       std::cerr << "Only analysing commands is supported at the moment, please use -d.";
       std::cerr << std::endl;
       return 1;
+    } else if (is_pipeline && !is_command) {
+      std::cerr << "--pipeline can be used only with -d.";
+      std::cerr << std::endl;
+      return 1;
     }
 
     pid_t current_pid = getpid();
@@ -450,44 +701,91 @@ namespace adaptyst {
       return 1;
     }
 
-    const time_t t = std::time(nullptr);
-    struct tm *tm = std::gmtime(&t);
+    auto make_out_dir = [](std::string label) {
+      const time_t t = std::time(nullptr);
+      struct tm *tm = std::gmtime(&t);
 
-    std::ostringstream timestamp_stream;
-    timestamp_stream << std::put_time(tm, "%Y_%m_%d_%H_%M_%S");
-    std::string timestamp = timestamp_stream.str();
+      std::ostringstream timestamp_stream;
+      timestamp_stream << std::put_time(tm, "%Y_%m_%d_%H_%M_%S");
+      std::string timestamp = timestamp_stream.str();
 
-    int index = 1;
+      std::string out_dir;
+      int index = 1;
 
-    do {
-      out_dir = "adaptyst_" + timestamp + "__" + std::to_string(index++);
-    } while (fs::exists(out_dir));
+      do {
+        out_dir = "adaptyst_" + timestamp + "__" + std::to_string(index++);
+      } while (fs::exists(out_dir));
 
-    Path out_dir_obj(out_dir);
+      Path out_dir_obj(out_dir);
 
-    out_dir_obj.set_metadata<int>("year",
-                                  TM_YEAR_ALIGN + tm->tm_year, false);
-    out_dir_obj.set_metadata<int>("month", tm->tm_mon + 1, false);
-    out_dir_obj.set_metadata<int>("day", tm->tm_mday, false);
-    out_dir_obj.set_metadata<int>("hour", tm->tm_hour, false);
-    out_dir_obj.set_metadata<int>("minute", tm->tm_min, false);
-    out_dir_obj.set_metadata<int>("second", tm->tm_sec, false);
+      out_dir_obj.set_metadata<int>("year",
+                                    TM_YEAR_ALIGN + tm->tm_year, false);
+      out_dir_obj.set_metadata<int>("month", tm->tm_mon + 1, false);
+      out_dir_obj.set_metadata<int>("day", tm->tm_mday, false);
+      out_dir_obj.set_metadata<int>("hour", tm->tm_hour, false);
+      out_dir_obj.set_metadata<int>("minute", tm->tm_min, false);
+      out_dir_obj.set_metadata<int>("second", tm->tm_sec, false);
 
-    char hostname[HOST_NAME_MAX + 1];
+      char hostname[HOST_NAME_MAX + 1];
 
-    if (gethostname(hostname, HOST_NAME_MAX + 1) == -1) {
-      out_dir_obj.set_metadata<std::string>("executor", "(unknown)", false);
-    } else {
-      out_dir_obj.set_metadata<std::string>("executor", std::string(hostname), false);
+      if (gethostname(hostname, HOST_NAME_MAX + 1) == -1) {
+        out_dir_obj.set_metadata<std::string>("executor", "(unknown)", false);
+      } else {
+        out_dir_obj.set_metadata<std::string>("executor", std::string(hostname), false);
+      }
+
+      out_dir_obj.set_metadata<std::string>("label", label.empty() ? out_dir : label, false);
+      out_dir_obj.save_metadata();
+
+      return out_dir;
+    };
+
+    bool daemon_mode = !daemon_spec.empty();
+    std::string daemon_address;
+    unsigned short daemon_port;
+
+    if (daemon_mode && !parse_address(daemon_spec, DAEMON_DEFAULT_PORT,
+                                      daemon_address, daemon_port)) {
+      std::cerr << "The address provided to --daemon is invalid!" << std::endl;
+      fs::remove_all(tmp_dir);
+      return 1;
+    }
+
+    std::string daemon_token;
+
+    if (daemon_mode) {
+      try {
+        daemon_token = get_remote_token(daemon_token_file, DAEMON_TOKEN_ENV);
+      } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        fs::remove_all(tmp_dir);
+        return 1;
+      }
     }
 
-    out_dir_obj.set_metadata<std::string>("label", label.empty() ? out_dir : label, false);
-    out_dir_obj.save_metadata();
+    std::string telemetry_address;
+    unsigned short telemetry_port;
 
+    if (!telemetry_spec.empty() && !parse_address(telemetry_spec, TELEMETRY_DEFAULT_PORT,
+                                                  telemetry_address, telemetry_port)) {
+      std::cerr << "The address provided to --telemetry is invalid!" << std::endl;
+      fs::remove_all(tmp_dir);
+      return 1;
+    }
+
+    if (!daemon_mode) {
+      out_dir = make_out_dir(label);
+    }
+
+    // The daemon moves logs to the output directory of each run
     Terminal::init(false, !no_format, adaptyst::version,
-                   fs::path(out_dir) / "log");
+                   daemon_mode ? tmp_dir / "log" : fs::path(out_dir) / "log");
     Terminal &terminal = *Terminal::instance;
 
+    if (async_log) {
+      terminal.start_async_logging();
+    }
+
     terminal.print_notice();
 
     auto start_time =
@@ -540,6 +838,74 @@ namespace adaptyst {
       return 2;
     }
 
+    if (!telemetry_spec.empty()) {
+      try {
+        Telemetry::instance = std::make_unique<Telemetry>(telemetry_address,
+                                                          telemetry_port, buf_size);
+        terminal.print("Live telemetry is published at " +
+                       Telemetry::instance->get_connection_instructions() + ".",
+                       false, false);
+      } catch (std::exception &e) {
+        terminal.print("Could not start publishing telemetry: " +
+                       std::string(e.what()), false, true);
+        fs::remove_all(tmp_dir);
+        return 2;
+      }
+    }
+
+    if (daemon_mode) {
+      int to_return = 0;
+
+      try {
+        terminal.print("Reading the computer system definition file...", false, false);
+        System system(system_def_dir, tmp_dir / "daemon", module_paths,
+                      local_config_path, tmp_dir / "system", no_inject, buf_size);
+        system.set_src_compression(ArchiveCompression::parse(src_compression));
+        system.set_runs(runs, warmup_runs);
+
+        auto run = [&terminal, &system, &make_out_dir](std::string run_label,
+                                                      std::vector<std::string> &command,
+                                                      fs::path &result_dir,
+                                                      std::string &error) {
+          result_dir = fs::absolute(make_out_dir(run_label));
+
+          try {
+            terminal.set_log_dir(result_dir / "log");
+            system.reset(result_dir / "system");
+
+            WorkflowCompilerSingleCmd compiler;
+            Workflow workflow(command);
+            system.set_ir(compiler.compile(workflow));
+
+            terminal.print("Running performance analysis of a submitted command...",
+                           false, false);
+            system.process();
+            MetadataCache::instance().sync();
+
+            terminal.print("The results are available in " + result_dir.string(),
+                           true, false);
+            return true;
+          } catch (std::exception &e) {
+            error = e.what();
+            terminal.print(error, true, true);
+            terminal.print("The incomplete results are available in " +
+                           result_dir.string(), true, false);
+            return false;
+          }
+        };
+
+        Daemon daemon(daemon_address, daemon_port, buf_size, daemon_token, run);
+        daemon.serve();
+      } catch (std::exception &e) {
+        terminal.print(e.what(), true, true);
+        to_return = 2;
+      }
+
+      Telemetry::instance.reset();
+      fs::remove_all(tmp_dir);
+      return to_return;
+    }
+
     std::vector<pid_t> spawned_children;
     int to_return = 0;
 
@@ -547,10 +913,16 @@ namespace adaptyst {
       terminal.print("Reading the computer system definition file...", false, false);
       System system(system_def_dir, fs::path(out_dir) / "system", module_paths,
                     local_config_path, tmp_dir / "system", no_inject, buf_size);
+      system.set_src_compression(ArchiveCompression::parse(src_compression));
+      system.set_runs(runs, warmup_runs);
 
       terminal.print("Making an IR of the command/workflow...", false, false);
 
-      if (is_command) {
+      if (is_command && is_pipeline) {
+        WorkflowCompilerPipeline compiler;
+        Workflow workflow(command_elements);
+        system.set_ir(compiler.compile(workflow));
+      } else if (is_command) {
         WorkflowCompilerSingleCmd compiler;
         Workflow workflow(command_elements);
         system.set_ir(compiler.compile(workflow));
@@ -604,6 +976,8 @@ namespace adaptyst {
       to_return = 2;
     }
 
+    Telemetry::instance.reset();
+
     if (to_return == 0) {
       terminal.print("The results are available in " + fs::absolute(out_dir).string(),
                      true, false);
@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "event_loop.hpp"
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+namespace adaptyst {
+  EventLoop::EventLoop() {
+    this->stopped = false;
+    this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (this->epoll_fd == -1) {
+      throw std::runtime_error("epoll_create1() failed, error " +
+                               std::to_string(errno));
+    }
+
+    this->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (this->wake_fd == -1) {
+      int error = errno;
+      ::close(this->epoll_fd);
+      throw std::runtime_error("eventfd() failed, error " +
+                               std::to_string(error));
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = this->wake_fd;
+
+    if (epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->wake_fd, &event) == -1) {
+      int error = errno;
+      ::close(this->wake_fd);
+      ::close(this->epoll_fd);
+      throw std::runtime_error("epoll_ctl() failed for the wakeup fd, error " +
+                               std::to_string(error));
+    }
+  }
+
+  EventLoop::~EventLoop() {
+    for (int fd : this->owned_fds) {
+      ::close(fd);
+    }
+
+    ::close(this->wake_fd);
+    ::close(this->epoll_fd);
+  }
+
+  void EventLoop::add(int fd, Callback callback) {
+    std::unique_lock lock(this->callbacks_mutex);
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+
+    if (epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      throw std::runtime_error("epoll_ctl() failed for fd " + std::to_string(fd) +
+                               ", error " + std::to_string(errno));
+    }
+
+    this->callbacks[fd] = callback;
+  }
+
+  bool EventLoop::add_process(pid_t pid, std::function<void()> callback) {
+#ifdef SYS_pidfd_open
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+
+    if (pidfd == -1) {
+      return false;
+    }
+
+    {
+      // This must be done before add() in case the process exits
+      // before add() returns
+      std::unique_lock lock(this->callbacks_mutex);
+      this->owned_fds.insert(pidfd);
+    }
+
+    try {
+      this->add(pidfd, [callback]() {
+        callback();
+        return false;
+      });
+    } catch (std::exception &) {
+      std::unique_lock lock(this->callbacks_mutex);
+      this->owned_fds.erase(pidfd);
+      ::close(pidfd);
+      return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void EventLoop::remove(int fd) {
+    std::unique_lock lock(this->callbacks_mutex);
+
+    if (!this->callbacks.contains(fd)) {
+      return;
+    }
+
+    epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    this->callbacks.erase(fd);
+
+    if (this->owned_fds.contains(fd)) {
+      ::close(fd);
+      this->owned_fds.erase(fd);
+    }
+  }
+
+  void EventLoop::run(int timeout_ms, std::function<void()> on_timeout) {
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+    while (!this->stopped) {
+      int count = epoll_wait(this->epoll_fd, events, EVENT_LOOP_MAX_EVENTS,
+                             timeout_ms);
+
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        throw std::runtime_error("epoll_wait() failed, error " +
+                                 std::to_string(errno));
+      }
+
+      if (count == 0) {
+        if (on_timeout) {
+          on_timeout();
+        }
+
+        continue;
+      }
+
+      for (int i = 0; i < count && !this->stopped; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == this->wake_fd) {
+          continue;
+        }
+
+        Callback callback;
+
+        {
+          std::unique_lock lock(this->callbacks_mutex);
+          auto elem = this->callbacks.find(fd);
+
+          if (elem == this->callbacks.end()) {
+            // The fd has been removed by one of the previous callbacks
+            continue;
+          }
+
+          callback = elem->second;
+        }
+
+        if (!callback()) {
+          this->remove(fd);
+        }
+      }
+    }
+  }
+
+  void EventLoop::stop() {
+    this->stopped = true;
+
+    unsigned long long value = 1;
+    int code = ::write(this->wake_fd, &value, sizeof(value));
+    (void)code;
+  }
+};
@@ -12,15 +12,191 @@
 #include <adaptyst/inject.h>
 #include <adaptyst/hw_inject.h>
 #include <adaptyst/socket.hpp>
+#include "output_queue.hpp"
+#include "region_ring.hpp"
+#include "shm_channel.hpp"
+#include "tsc_clock.hpp"
+#include <sched.h>
 #include <time.h>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <vector>
+#include <sstream>
+#include <pthread.h>
 
 extern "C" {
-  static char *error_msg = NULL;
+  static thread_local char *error_msg = NULL;
 }
 
+// An interned region, never freed once registered. The policy from
+// the system YAML file takes precedence over the one from the call site.
+struct adaptyst_region {
+  std::string name;
+  unsigned int index;
+  std::atomic<unsigned int> open_parts;
+  std::atomic<const adaptyst_region_policy *> call_policy;
+  std::atomic<const adaptyst_region_policy *> config_policy;
+};
+
 namespace adaptyst {
+  static unsigned long long get_monotonic_ns() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long long)time.tv_sec * 1000000000ULL + time.tv_nsec;
+  }
+
+  static std::mutex region_registry_mutex;
+  static std::unordered_map<std::string, std::unique_ptr<adaptyst_region> > region_registry;
+  static std::vector<adaptyst_region *> region_list;
+
+  // Policies are never freed either, as threads switching regions
+  // read them without locking
+  static std::vector<std::unique_ptr<adaptyst_region_policy> > region_policies;
+
+  static adaptyst_region *register_region(std::string name) {
+    std::unique_lock lock(region_registry_mutex);
+    auto elem = region_registry.find(name);
+
+    if (elem != region_registry.end()) {
+      return elem->second.get();
+    }
+
+    std::unique_ptr<adaptyst_region> region = std::make_unique<adaptyst_region>();
+    region->name = name;
+    region->index = region_list.size();
+    region->open_parts = 0;
+    region->call_policy = nullptr;
+    region->config_policy = nullptr;
+
+    adaptyst_region *result = region.get();
+    region_list.push_back(result);
+    region_registry[name] = std::move(region);
+    return result;
+  }
+
+  static const adaptyst_region_policy *store_policy(const adaptyst_region_policy &policy) {
+    std::unique_lock lock(region_registry_mutex);
+    region_policies.push_back(std::make_unique<adaptyst_region_policy>(policy));
+    return region_policies.back().get();
+  }
+
+  static const adaptyst_region_policy *get_policy(adaptyst_region *region) {
+    const adaptyst_region_policy *policy =
+      region->config_policy.load(std::memory_order_acquire);
+    return policy ? policy : region->call_policy.load(std::memory_order_acquire);
+  }
+
+  /**
+     Instances of an aggregated region in a thread which haven't been
+     reported yet.
+  */
+  struct RegionAggregate {
+    unsigned long long generation;
+    adaptyst_region *region;
+    std::string part_id;
+    adaptyst_region_summary summary;
+    unsigned long long last_flush;
+
+    void add(unsigned long long duration) {
+      if (this->summary.count == 0 || duration < this->summary.min_ns) {
+        this->summary.min_ns = duration;
+      }
+
+      if (duration > this->summary.max_ns) {
+        this->summary.max_ns = duration;
+      }
+
+      this->summary.count++;
+      this->summary.total_ns += duration;
+      this->summary.histogram[duration < 2 ? 0 : 63 - __builtin_clzll(duration)]++;
+    }
+  };
+
+  /**
+     State of a region in a thread.
+  */
+  struct ThreadRegion {
+    enum Mode {
+      // Start and end events are reported as they happen
+      EVENTS,
+      // Nothing is reported
+      SKIPPED,
+      // Both events are reported at the end if the instance is long enough
+      DEFERRED,
+      // The instance is added to the aggregate
+      AGGREGATED
+    };
+
+    bool open = false;
+    Mode mode = EVENTS;
+    unsigned long long instances = 0;
+    unsigned long long start_timestamp = 0;
+    int start_error = 0;
+    unsigned long long min_duration_ns = 0;
+    unsigned long long flush_interval_ns = 0;
+    std::shared_ptr<RegionAggregate> aggregate;
+  };
+
+  /**
+     Region switch statistics of a thread, written only by that thread.
+  */
+  struct ThreadCounters {
+    std::atomic<unsigned long long> switches{0};
+    std::atomic<unsigned long long> wait_ns{0};
+
+    void add_switch() {
+      this->switches.store(this->switches.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+
+    void add_wait(unsigned long long ns) {
+      this->wait_ns.store(this->wait_ns.load(std::memory_order_relaxed) + ns,
+                          std::memory_order_relaxed);
+    }
+  };
+
+  /**
+     Region state of a thread. It is valid only if its generation
+     matches state_generation, which changes whenever the injection
+     resources are initialised and in a child process after fork().
+  */
+  struct ThreadState {
+    unsigned long long generation = 0;
+    std::string part_id;
+    RegionRing *ring = nullptr;
+    bool ring_checked = false;
+    std::shared_ptr<ThreadCounters> counters;
+    std::vector<ThreadRegion> regions;
+    std::unordered_map<std::string, adaptyst_region *> names;
+  };
+
+  // TSC clocks shared by Adaptyst are never unmapped either, as
+  // adaptyst_get_timestamp() reads the current one without locking
+  static std::mutex tsc_clocks_mutex;
+  static std::unordered_map<int, std::unique_ptr<TscClock> > tsc_clocks;
+  static std::atomic<TscClock *> tsc_clock = nullptr;
+
+  static TscClock *open_tsc_clock(int fd) {
+    std::unique_lock lock(tsc_clocks_mutex);
+    auto elem = tsc_clocks.find(fd);
+
+    if (elem != tsc_clocks.end()) {
+      return elem->second.get();
+    }
+
+    std::unique_ptr<TscClock> clock = TscClock::open(fd);
+    TscClock *to_return = clock.get();
+    tsc_clocks[fd] = std::move(clock);
+    return to_return;
+  }
+
+  static std::atomic<unsigned long long> state_generation = 1;
+  static thread_local ThreadState thread_state;
+  static thread_local std::string region_error;
+  static std::once_flag atfork_flag;
+
   class Injection {
   private:
     struct ModuleHandle {
@@ -28,6 +204,16 @@ namespace adaptyst {
       amod_t id;
       std::unique_ptr<FileDescriptor> fd;
       void *handle;
+      int (*init)(amod_t);
+      void (*close)(amod_t);
+      int (*region_start)(amod_t, const char *, const char *, const char *);
+      int (*region_end)(amod_t, const char *, const char *, const char *);
+      int (*region_summary)(amod_t, const char *, const char *,
+                            const adaptyst_region_summary *);
+      std::unique_ptr<OutputQueue> queue;
+      unsigned long long queue_generation = 0;
+      unsigned long long high_water_mark = ADAPTYST_SEND_DEFAULT_HIGH_WATER_MARK;
+      adaptyst_send_policy send_policy = ADAPTYST_SEND_BLOCK;
     };
 
     int *read_fd;
@@ -37,9 +223,269 @@ namespace adaptyst {
     std::string error_message;
     int status;
     std::unique_ptr<FileDescriptor> fd;
-    std::unordered_map<std::string, std::unordered_set<std::string> > regions;
+    std::mutex fd_mutex;
+    std::mutex module_mutex;
     std::string module_error;
     std::string last_received_message;
+    unsigned int ring_capacity;
+    std::unordered_map<std::string, std::unique_ptr<RegionRing> > rings;
+    std::vector<std::shared_ptr<ThreadCounters> > counters;
+    std::mutex counters_mutex;
+    std::vector<std::shared_ptr<RegionAggregate> > aggregates;
+    std::mutex aggregates_mutex;
+    std::unordered_map<amod_t, std::unordered_map<std::string,
+                                                  std::unique_ptr<adaptyst_channel> > > channels;
+    std::mutex queues_mutex;
+
+    ThreadState &get_thread_state() {
+      ThreadState &state = thread_state;
+      unsigned long long generation = state_generation.load(std::memory_order_acquire);
+
+      if (state.generation != generation) {
+        state.generation = generation;
+        state.part_id = std::to_string(getpid()) + "_" + std::to_string(gettid());
+        state.ring = nullptr;
+        state.ring_checked = false;
+        state.regions.clear();
+        state.counters = std::make_shared<ThreadCounters>();
+
+        std::unique_lock lock(this->counters_mutex);
+        this->counters.push_back(state.counters);
+      }
+
+      return state;
+    }
+
+    ModuleHandle &get_handle(amod_t id) {
+      auto handle = this->handles.find(id);
+
+      if (handle == this->handles.end()) {
+        throw std::runtime_error("Module with ID " + std::to_string(id) +
+                                 " not found");
+      }
+
+      return handle->second;
+    }
+
+    // Send queues are created on first use. A queue inherited through
+    // fork() has no thread writing it, so it is leaked (the parent
+    // writes what it contains) and replaced. queues_mutex must be held
+    // unless inject_mutex is held in exclusive mode.
+    OutputQueue *get_queue(ModuleHandle &handle, bool create) {
+      unsigned long long generation = state_generation.load();
+
+      if (handle.queue && handle.queue_generation != generation) {
+        handle.queue.release();
+      }
+
+      if (!handle.queue && create) {
+        handle.queue = std::make_unique<OutputQueue>(handle.fd->get_write_fd().second,
+                                                     handle.high_water_mark,
+                                                     handle.send_policy);
+        handle.queue_generation = generation;
+      }
+
+      return handle.queue.get();
+    }
+
+    // Synchronous sends go after everything queued before
+    void flush_queue(ModuleHandle &handle) {
+      OutputQueue *queue = this->get_queue(handle, false);
+
+      if (queue) {
+        queue->flush();
+      }
+    }
+
+    RegionRing *get_ring(std::string &part_id) {
+      auto ring = this->rings.find(part_id);
+
+      if (ring != this->rings.end()) {
+        return ring->second.get();
+      }
+
+      // A null pointer is stored on failure so that the pipe is used
+      // for the part from now on without retrying every time.
+      std::unique_ptr<RegionRing> new_ring;
+
+      try {
+        new_ring = RegionRing::create("/adaptyst_ring_" + part_id,
+                                      this->ring_capacity);
+      } catch (std::exception &e) {
+        this->rings[part_id] = nullptr;
+        return nullptr;
+      }
+
+      this->fd->write("ring " + part_id + " " + new_ring->get_name(), true);
+
+      if (this->fd->read() != "ack") {
+        shm_unlink(new_ring->get_name().c_str());
+        this->rings[part_id] = nullptr;
+        return nullptr;
+      }
+
+      this->rings[part_id] = std::move(new_ring);
+      return this->rings[part_id].get();
+    }
+
+    // Reports a region event to Adaptyst and the module injection
+    // libraries. Module errors are appended to region_error.
+    int report_switch(ThreadState &state, adaptyst_region *region, bool start,
+                      unsigned long long timestamp, int error) {
+      if (this->ring_capacity > 0 && !state.ring_checked) {
+        std::unique_lock lock(this->fd_mutex);
+        state.ring = this->get_ring(state.part_id);
+        state.ring_checked = true;
+      }
+
+      RegionRing *ring = state.ring;
+
+      if (ring && region->name.length() < REGION_RING_NAME_SIZE) {
+        RegionRecord record;
+        record.timestamp = timestamp;
+        record.timestamp_valid = !error;
+        record.end = !start;
+        record.name_len = region->name.length();
+        std::memcpy(record.name, region->name.c_str(), region->name.length() + 1);
+
+        if (!ring->push(record)) {
+          unsigned long long wait_start = get_monotonic_ns();
+
+          while (!ring->push(record)) {
+            sched_yield();
+          }
+
+          state.counters->add_wait(get_monotonic_ns() - wait_start);
+        }
+      } else {
+        unsigned long long wait_start = get_monotonic_ns();
+
+        if (ring) {
+          // Events of a part must reach Adaptyst in order, so
+          // everything in the ring must be consumed first.
+          while (!ring->empty()) {
+            sched_yield();
+          }
+        }
+
+        std::string answer;
+
+        {
+          std::unique_lock lock(this->fd_mutex);
+          this->fd->write(std::string(start ? "start " : "end ") + state.part_id + " " +
+                          (error ? std::string("-1") : std::to_string(timestamp)) + " " +
+                          region->name, true);
+          answer = this->fd->read();
+        }
+
+        state.counters->add_wait(get_monotonic_ns() - wait_start);
+
+        if (answer != "ack") {
+          return ADAPTYST_INJECT_ERR_INVALID_REPLY;
+        }
+      }
+
+      state.counters->add_switch();
+
+      int to_return = ADAPTYST_INJECT_OK;
+
+      if (!this->handles.empty()) {
+        std::string timestamp_str = error ? "-1" : std::to_string(timestamp);
+        std::string state_str = start ? "start" : "end";
+
+        // Module injection libraries are not required to be thread-safe
+        std::unique_lock lock(this->module_mutex);
+
+        for (auto &entry : this->handles) {
+          int (*module_switch)(amod_t, const char *, const char *, const char *) =
+            start ? entry.second.region_start : entry.second.region_end;
+
+          if (!module_switch) {
+            to_return = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+            region_error += "\n" + entry.second.name + ": adaptyst_region_" + state_str + "() not found";
+            continue;
+          }
+
+          this->module_error = "";
+          int result = module_switch(entry.second.id, state.part_id.c_str(),
+                                     region->name.c_str(), timestamp_str.c_str());
+
+          if (result != ADAPTYST_MODULE_OK) {
+            to_return = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+            region_error += "\n" + entry.second.name + ": adaptyst_region_ " + state_str + "() "
+              "returned " + std::to_string(result);
+
+            if (!this->module_error.empty()) {
+              region_error += ", message: " + this->module_error;
+            }
+          }
+        }
+      }
+
+      return to_return;
+    }
+
+    // Reports the summary of an aggregate to Adaptyst and the module
+    // injection libraries defining adaptyst_region_summary() and
+    // starts a new summary. Module errors are appended to region_error.
+    int report_summary(RegionAggregate &aggregate, unsigned long long timestamp) {
+      if (aggregate.summary.count == 0) {
+        aggregate.last_flush = timestamp;
+        return ADAPTYST_INJECT_OK;
+      }
+
+      adaptyst_region_summary &summary = aggregate.summary;
+      std::string msg = "summary " + aggregate.part_id + " " +
+        std::to_string(summary.count) + " " + std::to_string(summary.total_ns) + " " +
+        std::to_string(summary.min_ns) + " " + std::to_string(summary.max_ns) + " ";
+
+      for (int i = 0; i < ADAPTYST_REGION_HISTOGRAM_BUCKETS; i++) {
+        msg += (i > 0 ? "," : "") + std::to_string(summary.histogram[i]);
+      }
+
+      msg += " " + aggregate.region->name;
+
+      std::string answer;
+
+      {
+        std::unique_lock lock(this->fd_mutex);
+        this->fd->write(msg, true);
+        answer = this->fd->read();
+      }
+
+      int to_return = answer == "ack" ? ADAPTYST_INJECT_OK :
+        ADAPTYST_INJECT_ERR_INVALID_REPLY;
+
+      if (to_return == ADAPTYST_INJECT_OK && !this->handles.empty()) {
+        std::unique_lock lock(this->module_mutex);
+
+        for (auto &entry : this->handles) {
+          if (!entry.second.region_summary) {
+            continue;
+          }
+
+          this->module_error = "";
+          int result = entry.second.region_summary(entry.second.id,
+                                                   aggregate.part_id.c_str(),
+                                                   aggregate.region->name.c_str(),
+                                                   &summary);
+
+          if (result != ADAPTYST_MODULE_OK) {
+            to_return = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+            region_error += "\n" + entry.second.name + ": adaptyst_region_summary() "
+              "returned " + std::to_string(result);
+
+            if (!this->module_error.empty()) {
+              region_error += ", message: " + this->module_error;
+            }
+          }
+        }
+      }
+
+      summary = adaptyst_region_summary{};
+      aggregate.last_flush = timestamp;
+      return to_return;
+    }
 
   public:
     Injection(int *read_fd,
@@ -51,21 +497,107 @@ namespace adaptyst {
       this->status = ADAPTYST_INJECT_OK;
       this->error_message = "";
       this->module_error = "";
+      this->ring_capacity = 0;
+      tsc_clock.store(nullptr, std::memory_order_release);
+
+      std::call_once(atfork_flag, []() {
+        pthread_atfork(nullptr, nullptr, []() { state_generation++; });
+      });
+
+      state_generation++;
+
+      {
+        std::unique_lock lock(region_registry_mutex);
+
+        for (auto region : region_list) {
+          region->open_parts = 0;
+          region->config_policy = nullptr;
+        }
+      }
 
       this->fd = std::make_unique<FileDescriptor>(this->write_fd,
                                                   this->read_fd,
                                                   this->buf_size,
                                                   false);
 
-      this->fd->write("init", true);
+      this->fd->write("init ring", true);
       std::string answer = this->fd->read();
 
-      if (answer != "ack") {
+      if (answer.starts_with("ack ring ")) {
+        try {
+          this->ring_capacity = std::stoul(answer.substr(9));
+        } catch (std::exception &) {
+          this->status = ADAPTYST_INJECT_ERR_INVALID_REPLY;
+          return;
+        }
+      } else if (answer != "ack") {
         this->status = ADAPTYST_INJECT_ERR_INVALID_REPLY;
         return;
       }
 
       while ((answer = this->fd->read()) != "<STOP>") {
+        if (answer.starts_with("clock ")) {
+          // "clock <file descriptor>"
+          try {
+            tsc_clock.store(open_tsc_clock(std::stoi(answer.substr(6))),
+                            std::memory_order_release);
+          } catch (std::exception &e) {
+            this->error_message += "\nTSC clock: " + std::string(e.what()) +
+              ", CLOCK_MONOTONIC will be used instead";
+            this->status = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+          }
+
+          continue;
+        }
+
+        if (answer.starts_with("policy ")) {
+          // "policy <sample every> <min. duration in ns> <aggregate>
+          // <flush interval in ms> <region name>"
+          std::stringstream stream(answer.substr(7));
+          adaptyst_region_policy policy;
+          std::string name;
+
+          if (!(stream >> policy.sample_every >> policy.min_duration_ns >>
+                policy.aggregate >> policy.flush_interval_ms) ||
+              stream.get() != ' ' || !std::getline(stream, name) || name.empty()) {
+            this->error_message += "\nInvalid reply from Adaptyst when "
+              "processing region policies";
+            this->status = ADAPTYST_INJECT_ERR_INVALID_REPLY;
+            continue;
+          }
+
+          adaptyst::register_region(name)->config_policy = store_policy(policy);
+          continue;
+        }
+
+        if (answer.starts_with("channel ")) {
+          // "channel <module ID> <file descriptor> <channel name>"
+          std::stringstream stream(answer.substr(8));
+          amod_t id;
+          int channel_fd;
+          std::string name;
+
+          if (!(stream >> id >> channel_fd) || stream.get() != ' ' ||
+              !std::getline(stream, name) || name.empty()) {
+            this->error_message += "\nInvalid reply from Adaptyst when "
+              "processing channels";
+            this->status = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+            continue;
+          }
+
+          try {
+            auto channel = std::make_unique<adaptyst_channel>();
+            channel->name = name;
+            channel->channel = ShmChannel::open(channel_fd);
+            this->channels[id][name] = std::move(channel);
+          } catch (std::exception &e) {
+            this->error_message += "\nChannel " + name + ": " + std::string(e.what());
+            this->status = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
+          }
+
+          continue;
+        }
+
         std::unique_ptr<char> stream_buffer(new char[answer.length() + 1]);
         bool name_extracted = false;
         bool id_extracted = false;
@@ -79,7 +611,7 @@ namespace adaptyst {
         int write_fd[2];
         int index = 0;
 
-        for (int i = 0; i < answer.length(); i++) {
+        for (size_t i = 0; i < answer.length(); i++) {
           if (answer[i] == ' ') {
             if (!name_extracted) {
               stream_buffer.get()[index++] = 0;
@@ -149,6 +681,17 @@ namespace adaptyst {
         mod_handle.fd = std::make_unique<FileDescriptor>(write_fd, read_fd, this->buf_size,
                                                          false);
         mod_handle.handle = handle;
+        mod_handle.init = (int (*)(amod_t))dlsym(handle, "adaptyst_init");
+        mod_handle.close = (void (*)(amod_t))dlsym(handle, "adaptyst_close");
+        mod_handle.region_start =
+          (int (*)(amod_t, const char *, const char *, const char *))
+          dlsym(handle, "adaptyst_region_start");
+        mod_handle.region_end =
+          (int (*)(amod_t, const char *, const char *, const char *))
+          dlsym(handle, "adaptyst_region_end");
+        mod_handle.region_summary =
+          (int (*)(amod_t, const char *, const char *, const adaptyst_region_summary *))
+          dlsym(handle, "adaptyst_region_summary");
 
         this->handles[id] = std::move(mod_handle);
       }
@@ -160,22 +703,64 @@ namespace adaptyst {
     }
 
     ~Injection() {
+      if (this->status != ADAPTYST_INJECT_ERR_INVALID_REPLY) {
+        int error;
+        unsigned long long timestamp = adaptyst_get_timestamp(&error);
+
+        unsigned long long generation = state_generation.load();
+
+        for (auto &aggregate : this->aggregates) {
+          // Aggregates inherited through fork() are reported by the parent
+          if (aggregate->generation != generation) {
+            continue;
+          }
+
+          try {
+            this->report_summary(*aggregate, timestamp);
+          } catch (std::exception &) { }
+        }
+      }
+
+      unsigned long long region_switches = 0;
+      unsigned long long wait_ns = 0;
+
+      for (auto &thread_counters : this->counters) {
+        region_switches += thread_counters->switches.load(std::memory_order_relaxed);
+        wait_ns += thread_counters->wait_ns.load(std::memory_order_relaxed);
+      }
+
+      if (region_switches > 0 && this->status != ADAPTYST_INJECT_ERR_INVALID_REPLY) {
+        // Adaptyst doesn't answer this, so that closing never blocks
+        try {
+          this->fd->write("overhead " + std::to_string(region_switches) + " " +
+                          std::to_string(wait_ns), true);
+        } catch (std::exception &) { }
+      }
+
       for (auto &entry : this->handles) {
-        void (*close)(amod_t) = (void (*)(amod_t))dlsym(entry.second.handle,
-                                                        "adaptyst_close");
+        void (*close)(amod_t) = entry.second.close;
 
         if (close) {
           close(entry.second.id);
         }
 
+        if (this->get_queue(entry.second, false)) {
+          // This writes everything queued by the module
+          try {
+            entry.second.queue.reset();
+          } catch (std::exception &) { }
+        }
+
         dlclose(entry.second.handle);
       }
+
+      tsc_clock.store(nullptr, std::memory_order_release);
     }
 
     void init() {
       std::vector<amod_t> to_remove;
       for (auto &entry : this->handles) {
-        int (*init)(amod_t) = (int (*)(amod_t))dlsym(entry.second.handle, "adaptyst_init");
+        int (*init)(amod_t) = entry.second.init;
 
         if (!init) {
           this->error_message += "\n" + entry.second.name + ": Could not find adaptyst_init()";
@@ -216,107 +801,248 @@ namespace adaptyst {
       this->module_error = error;
     }
 
+    adaptyst_channel *get_channel(amod_t id, std::string name) {
+      auto module_channels = this->channels.find(id);
+
+      if (module_channels == this->channels.end()) {
+        return nullptr;
+      }
+
+      auto channel = module_channels->second.find(name);
+      return channel == module_channels->second.end() ? nullptr : channel->second.get();
+    }
+
     int get_status() {
       return this->status;
     }
 
-    int region_switch(std::string name,
-                      std::string state) {
-      if (state != "start" && state != "end") {
-        return ADAPTYST_INJECT_ERR_INVALID_REGION_STATE;
+    // Adds an ended instance to the aggregate of its thread and
+    // reports the aggregate if the flush interval has passed
+    int aggregate_instance(ThreadState &state, ThreadRegion &thread_region,
+                           adaptyst_region *region, unsigned long long timestamp) {
+      if (!thread_region.aggregate) {
+        thread_region.aggregate = std::make_shared<RegionAggregate>();
+        thread_region.aggregate->generation = state.generation;
+        thread_region.aggregate->region = region;
+        thread_region.aggregate->part_id = state.part_id;
+        thread_region.aggregate->summary = adaptyst_region_summary{};
+        thread_region.aggregate->last_flush = thread_region.start_timestamp;
+
+        std::unique_lock lock(this->aggregates_mutex);
+        this->aggregates.push_back(thread_region.aggregate);
       }
 
-      if (state == "start" && this->regions.contains(name)) {
-        return ADAPTYST_INJECT_ERR_REGION_ALREADY_STARTED;
+      RegionAggregate &aggregate = *thread_region.aggregate;
+      aggregate.add(timestamp - thread_region.start_timestamp);
+
+      if (thread_region.flush_interval_ns == 0 ||
+          timestamp - aggregate.last_flush < thread_region.flush_interval_ns) {
+        return ADAPTYST_INJECT_OK;
       }
 
-      std::string part_id = std::to_string(getpid()) + "_" + std::to_string(gettid());
+      unsigned long long wait_start = get_monotonic_ns();
+      int result = this->report_summary(aggregate, timestamp);
+      state.counters->add_wait(get_monotonic_ns() - wait_start);
+      return result;
+    }
 
-      if (state == "end") {
-        if (!this->regions.contains(name)) {
-          return ADAPTYST_INJECT_ERR_REGION_NOT_FOUND;
-        }
+    int region_switch(adaptyst_region *region, bool start) {
+      ThreadState &state = this->get_thread_state();
 
-        if (!this->regions[name].contains(part_id)) {
-          return ADAPTYST_INJECT_ERR_REGION_IN_DIFFERENT_UNIT;
-        }
+      if (region->index >= state.regions.size()) {
+        state.regions.resize(region->index + 1);
       }
 
-      int error;
-      unsigned long long timestamp = adaptyst_get_timestamp(&error);
-      std::string timestamp_str;
+      ThreadRegion &thread_region = state.regions[region->index];
 
-      if (error) {
-        timestamp_str = "-1";
-      } else {
-        timestamp_str = std::to_string(timestamp);
+      if (start && thread_region.open) {
+        return ADAPTYST_INJECT_ERR_REGION_ALREADY_STARTED;
       }
 
-      this->fd->write(state + " " + part_id + " " + timestamp_str + " " + name, true);
-      std::string answer = this->fd->read();
-
-      if (answer != "ack") {
-        return ADAPTYST_INJECT_ERR_INVALID_REPLY;
+      if (!start && !thread_region.open) {
+        return region->open_parts > 0 ? ADAPTYST_INJECT_ERR_REGION_IN_DIFFERENT_UNIT :
+          ADAPTYST_INJECT_ERR_REGION_NOT_FOUND;
       }
 
+      int error = 0;
+      unsigned long long timestamp = 0;
       int to_return = ADAPTYST_INJECT_OK;
-      this->error_message = "";
+      region_error.clear();
       error_msg = NULL;
 
-      for (auto &entry : this->handles) {
-        int (*module_switch)(amod_t, const char *, const char *, const char *) =
-          (int (*)(amod_t, const char *, const char *, const char *))
-          dlsym(entry.second.handle, ("adaptyst_region_" + state).c_str());
-
-        if (!module_switch) {
-          to_return = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
-          this->error_message += "\n" + entry.second.name + ": adaptyst_region_" + state + "() not found";
-          continue;
+      if (start) {
+        // The policy is fixed for the whole instance
+        const adaptyst_region_policy *policy = get_policy(region);
+        thread_region.mode = ThreadRegion::EVENTS;
+
+        if (policy && policy->aggregate) {
+          thread_region.mode = ThreadRegion::AGGREGATED;
+          thread_region.flush_interval_ns = policy->flush_interval_ms * 1000000ULL;
+        } else if (policy && policy->sample_every > 1 &&
+                   thread_region.instances % policy->sample_every != 0) {
+          thread_region.mode = ThreadRegion::SKIPPED;
+        } else if (policy && policy->min_duration_ns > 0) {
+          thread_region.mode = ThreadRegion::DEFERRED;
+          thread_region.min_duration_ns = policy->min_duration_ns;
         }
 
-        this->module_error = "";
-        int result = module_switch(entry.second.id, part_id.c_str(),
-                                   name.c_str(), timestamp_str.c_str());
+        thread_region.instances++;
 
-        if (result != ADAPTYST_MODULE_OK) {
-          to_return = ADAPTYST_INJECT_WARN_NOT_ALL_MODULES_SUCCEEDED;
-          this->error_message += "\n" + entry.second.name + ": adaptyst_region_ " + state + "() "
-            "returned " + std::to_string(result);
+        // Skipped instances don't need the clock at all
+        if (thread_region.mode != ThreadRegion::SKIPPED) {
+          timestamp = adaptyst_get_timestamp(&error);
+        }
 
-          if (!this->module_error.empty()) {
-            this->error_message += ", message: " + this->module_error;
+        thread_region.start_timestamp = timestamp;
+        thread_region.start_error = error;
+
+        if (thread_region.mode == ThreadRegion::EVENTS) {
+          to_return = this->report_switch(state, region, true, timestamp, error);
+        }
+      } else if (thread_region.mode == ThreadRegion::EVENTS) {
+        timestamp = adaptyst_get_timestamp(&error);
+        to_return = this->report_switch(state, region, false, timestamp, error);
+      } else if (thread_region.mode == ThreadRegion::DEFERRED) {
+        timestamp = adaptyst_get_timestamp(&error);
+
+        // An instance whose duration is unknown is always reported
+        if (error || thread_region.start_error ||
+            timestamp - thread_region.start_timestamp >= thread_region.min_duration_ns) {
+          to_return = this->report_switch(state, region, true,
+                                          thread_region.start_timestamp,
+                                          thread_region.start_error);
+
+          if (to_return != ADAPTYST_INJECT_ERR_INVALID_REPLY) {
+            int result = this->report_switch(state, region, false, timestamp, error);
+
+            if (result != ADAPTYST_INJECT_OK) {
+              to_return = result;
+            }
           }
         }
+      } else if (thread_region.mode == ThreadRegion::AGGREGATED) {
+        timestamp = adaptyst_get_timestamp(&error);
+
+        if (!error && !thread_region.start_error) {
+          to_return = this->aggregate_instance(state, thread_region, region, timestamp);
+        }
       }
 
-      if (!this->error_message.empty()) {
-        this->error_message = this->error_message.substr(1);
-        error_msg = (char *)this->error_message.c_str();
+      if (to_return == ADAPTYST_INJECT_ERR_INVALID_REPLY) {
+        return to_return;
       }
 
-      if (this->regions.find(name) == this->regions.end()) {
-        this->regions[name] = std::unordered_set<std::string>();
+      if (!region_error.empty()) {
+        region_error = region_error.substr(1);
+        error_msg = (char *)region_error.c_str();
       }
 
-      if (state == "start") {
-        this->regions[name].insert(part_id);
-      } else {
-        this->regions[name].erase(part_id);
+      thread_region.open = start;
 
-        if (this->regions[name].empty()) {
-          this->regions.erase(name);
-        }
+      if (start) {
+        region->open_parts++;
+      } else {
+        region->open_parts--;
       }
 
       return to_return;
     }
 
     void send_msg(amod_t id, char *buf, unsigned int n) {
-      this->handles[id].fd->write(n, buf);
+      ModuleHandle &handle = this->handles[id];
+      this->flush_queue(handle);
+      handle.fd->write(n, buf);
     }
 
     void send_msg(amod_t id, const char *msg) {
-      this->handles[id].fd->write(std::string(msg), true);
+      ModuleHandle &handle = this->handles[id];
+      this->flush_queue(handle);
+      handle.fd->write(std::string(msg), true);
+    }
+
+    bool send_msg_async(amod_t id, const char *buf, unsigned int n) {
+      OutputQueue *queue;
+
+      {
+        std::unique_lock lock(this->queues_mutex);
+        queue = this->get_queue(this->get_handle(id), true);
+      }
+
+      return queue->push(std::string(buf, n));
+    }
+
+    bool send_msg_async(amod_t id, const char *msg) {
+      OutputQueue *queue;
+      std::string encoded;
+
+      {
+        std::unique_lock lock(this->queues_mutex);
+        ModuleHandle &handle = this->get_handle(id);
+        queue = this->get_queue(handle, true);
+        encoded = handle.fd->encode(std::string(msg), true);
+      }
+
+      return queue->push(std::move(encoded));
+    }
+
+    bool send_framed_msg_async(amod_t id, const char *buf, unsigned int n) {
+      OutputQueue *queue;
+      std::string encoded;
+
+      {
+        // The framing request must be queued before any framed
+        // message of other threads
+        std::unique_lock lock(this->queues_mutex);
+        ModuleHandle &handle = this->get_handle(id);
+        queue = this->get_queue(handle, true);
+        std::string request = handle.fd->start_framing();
+
+        if (!request.empty()) {
+          queue->push(request, true);
+        }
+
+        encoded = handle.fd->encode_message(buf, n);
+      }
+
+      return queue->push(std::move(encoded));
+    }
+
+    void flush_send(amod_t id) {
+      OutputQueue *queue;
+
+      {
+        std::unique_lock lock(this->queues_mutex);
+        queue = this->get_queue(this->get_handle(id), false);
+      }
+
+      if (queue) {
+        queue->flush();
+      }
+    }
+
+    void set_send_policy(amod_t id, unsigned long long high_water_mark,
+                         adaptyst_send_policy policy) {
+      std::unique_lock lock(this->queues_mutex);
+      ModuleHandle &handle = this->get_handle(id);
+      handle.high_water_mark = high_water_mark;
+      handle.send_policy = policy;
+
+      OutputQueue *queue = this->get_queue(handle, false);
+
+      if (queue) {
+        queue->set_policy(high_water_mark, policy);
+      }
+    }
+
+    adaptyst_send_stats get_send_stats(amod_t id) {
+      OutputQueue *queue;
+
+      {
+        std::unique_lock lock(this->queues_mutex);
+        queue = this->get_queue(this->get_handle(id), false);
+      }
+
+      return queue ? queue->get_stats() : adaptyst_send_stats{};
     }
 
     void receive_msg(amod_t id, char *buf, unsigned int buf_status,
@@ -328,12 +1054,35 @@ namespace adaptyst {
       this->last_received_message = this->handles[id].fd->read(timeout_seconds);
       return this->last_received_message;
     }
+
+    void send_framed_msg(amod_t id, const char *buf, unsigned int n) {
+      ModuleHandle &handle = this->handles[id];
+      this->flush_queue(handle);
+      handle.fd->write_message(buf, n);
+    }
+
+    std::string_view receive_msg_view(amod_t id,
+                                      long timeout_seconds = NO_TIMEOUT) {
+      return this->handles[id].fd->read_view(timeout_seconds);
+    }
+
+    void send_file(amod_t id, const char *path) {
+      ModuleHandle &handle = this->handles[id];
+      this->flush_queue(handle);
+      handle.fd->write(fs::path(path));
+    }
+
+    unsigned long long receive_file(amod_t id, const char *path,
+                                    unsigned long long n,
+                                    long timeout_seconds = NO_TIMEOUT) {
+      return this->handles[id].fd->read(fs::path(path), n, timeout_seconds);
+    }
   };
 };
 
 static std::unique_ptr<adaptyst::Injection> instance;
 static unsigned int print_errors = 1;
-static std::mutex inject_mutex;
+static std::shared_mutex inject_mutex;
 
 extern "C" {
   static const char *result[] = {
@@ -398,6 +1147,14 @@ extern "C" {
         std::cerr << "where it is active";
         break;
 
+      case ADAPTYST_INJECT_ERR_INVALID_REGION:
+        std::cerr << "Invalid region handle (has it been registered?)";
+        break;
+
+      case ADAPTYST_INJECT_ERR_CHANNEL_NOT_FOUND:
+        std::cerr << "Channel not found (has it been created by the module?)";
+        break;
+
       default:
         std::cerr << "Code " << code;
         break;
@@ -422,7 +1179,7 @@ extern "C" {
     try {
       read_fd[0] = std::stoi(std::string(runtime_info[1]));
       read_fd[1] = std::stoi(std::string(runtime_info[3]));
-    } catch (std::exception) {
+    } catch (std::exception &) {
       return ADAPTYST_INJECT_ERR_INVALID_RUNTIME_INFO;
     }
 
@@ -431,7 +1188,7 @@ extern "C" {
     try {
       write_fd[0] = std::stoi(std::string(runtime_info[5]));
       write_fd[1] = std::stoi(std::string(runtime_info[7]));
-    } catch (std::exception) {
+    } catch (std::exception &) {
       return ADAPTYST_INJECT_ERR_INVALID_RUNTIME_INFO;
     }
 
@@ -461,38 +1218,113 @@ extern "C" {
     return error_msg;
   }
 
-  int _adaptyst_region_start(const char *name) {
-    if (!instance) {
-      int result = _adaptyst_init();
+  int _adaptyst_region_register(const char *name, adaptyst_region_t *region) {
+    try {
+      *region = adaptyst::register_region(std::string(name));
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
 
-      if (result != ADAPTYST_INJECT_OK) {
-        return result;
-      }
+  int _adaptyst_region_start_h(adaptyst_region_t region) {
+    if (!region) {
+      return ADAPTYST_INJECT_ERR_INVALID_REGION;
+    }
+
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
     }
 
     try {
-      return instance->region_switch(std::string(name),
-                                     "start");
+      return instance->region_switch(region, true);
     } catch (std::exception &e) {
       error_msg = (char *)e.what();
       return ADAPTYST_INJECT_EXCEPTION;
     }
   }
 
-  int _adaptyst_region_end(const char *name) {
+  int _adaptyst_region_end_h(adaptyst_region_t region) {
+    if (!region) {
+      return ADAPTYST_INJECT_ERR_INVALID_REGION;
+    }
+
     if (!instance) {
       return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
     }
 
     try {
-      return instance->region_switch(std::string(name),
-                                     "end");
+      return instance->region_switch(region, false);
     } catch (std::exception &e) {
       error_msg = (char *)e.what();
       return ADAPTYST_INJECT_EXCEPTION;
     }
   }
 
+  int _adaptyst_region_set_policy(adaptyst_region_t region,
+                                  const adaptyst_region_policy *policy) {
+    if (!region) {
+      return ADAPTYST_INJECT_ERR_INVALID_REGION;
+    }
+
+    try {
+      region->call_policy = policy ? adaptyst::store_policy(*policy) : nullptr;
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  // Region names are resolved through a per-thread cache, so that
+  // the name-based API doesn't contend on the region registry
+  static adaptyst_region_t find_region(const char *name) {
+    std::string name_str(name);
+    auto &names = adaptyst::thread_state.names;
+    auto elem = names.find(name_str);
+
+    if (elem != names.end()) {
+      return elem->second;
+    }
+
+    adaptyst_region_t region = adaptyst::register_region(name_str);
+    names[name_str] = region;
+    return region;
+  }
+
+  int _adaptyst_region_start(const char *name) {
+    try {
+      return _adaptyst_region_start_h(find_region(name));
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_region_end(const char *name) {
+    try {
+      return _adaptyst_region_end_h(find_region(name));
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  // The first region start is allowed to happen without adaptyst_init()
+  static int init_if_needed() {
+    {
+      std::shared_lock lock(inject_mutex);
+
+      if (instance) {
+        return ADAPTYST_INJECT_OK;
+      }
+    }
+
+    std::unique_lock lock(inject_mutex);
+    return instance ? ADAPTYST_INJECT_OK : _adaptyst_init();
+  }
+
   void adaptyst_close() {
     std::unique_lock lock(inject_mutex);
     if (instance) {
@@ -538,7 +1370,7 @@ extern "C" {
     try {
       instance->receive_msg(id, buf, buf_size, n, timeout_seconds);
       return ADAPTYST_INJECT_OK;
-    } catch (adaptyst::TimeoutException) {
+    } catch (adaptyst::TimeoutException &) {
       return ADAPTYST_INJECT_ERR_TIMEOUT;
     } catch (std::exception &e) {
       error_msg = (char *)e.what();
@@ -597,7 +1429,56 @@ extern "C" {
       }
 
       return ADAPTYST_INJECT_OK;
-    } catch (adaptyst::TimeoutException) {
+    } catch (adaptyst::TimeoutException &) {
+      return ADAPTYST_INJECT_ERR_TIMEOUT;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_send_message(amod_t id, const char *buf, unsigned int n) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      instance->send_framed_msg(id, buf, n);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_receive_message(amod_t id, const char **buf, unsigned int *n) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      std::string_view received = instance->receive_msg_view(id);
+      *buf = received.data();
+      *n = received.size();
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_receive_message_timeout(amod_t id, const char **buf,
+                                        unsigned int *n, long timeout_seconds) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      std::string_view received = instance->receive_msg_view(id, timeout_seconds);
+      *buf = received.data();
+      *n = received.size();
+      return ADAPTYST_INJECT_OK;
+    } catch (adaptyst::TimeoutException &) {
       return ADAPTYST_INJECT_ERR_TIMEOUT;
     } catch (std::exception &e) {
       error_msg = (char *)e.what();
@@ -605,6 +1486,171 @@ extern "C" {
     }
   }
 
+  int _adaptyst_send_file(amod_t id, const char *path) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      instance->send_file(id, path);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_receive_file(amod_t id, const char *path, unsigned long long n,
+                             unsigned long long *received) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      *received = instance->receive_file(id, path, n);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_receive_file_timeout(amod_t id, const char *path, unsigned long long n,
+                                     unsigned long long *received, long timeout_seconds) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      *received = instance->receive_file(id, path, n, timeout_seconds);
+      return ADAPTYST_INJECT_OK;
+    } catch (adaptyst::TimeoutException &) {
+      return ADAPTYST_INJECT_ERR_TIMEOUT;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  // Drops are expected under ADAPTYST_SEND_DROP and ADAPTYST_SEND_COALESCE
+  // and counted in adaptyst_send_stats, so they aren't reported as errors
+  int _adaptyst_send_data_async(amod_t id, const char *buf, unsigned int n,
+                                int *queued) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      bool result = instance->send_msg_async(id, buf, n);
+
+      if (queued) {
+        *queued = result;
+      }
+
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_send_string_async(amod_t id, const char *str, int *queued) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      bool result = instance->send_msg_async(id, str);
+
+      if (queued) {
+        *queued = result;
+      }
+
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_send_message_async(amod_t id, const char *buf, unsigned int n,
+                                   int *queued) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      bool result = instance->send_framed_msg_async(id, buf, n);
+
+      if (queued) {
+        *queued = result;
+      }
+
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_send_flush(amod_t id) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      instance->flush_send(id);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_set_send_policy(amod_t id, unsigned long long high_water_mark,
+                                adaptyst_send_policy policy) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      instance->set_send_policy(id, high_water_mark, policy);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_get_send_stats(amod_t id, adaptyst_send_stats *stats) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      *stats = instance->get_send_stats(id);
+      return ADAPTYST_INJECT_OK;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
+  int _adaptyst_get_channel(amod_t id, const char *name,
+                            adaptyst_channel_t *channel) {
+    if (!instance) {
+      return ADAPTYST_INJECT_ERR_NOT_INITIALISED;
+    }
+
+    try {
+      *channel = instance->get_channel(id, std::string(name));
+      return *channel ? ADAPTYST_INJECT_OK : ADAPTYST_INJECT_ERR_CHANNEL_NOT_FOUND;
+    } catch (std::exception &e) {
+      error_msg = (char *)e.what();
+      return ADAPTYST_INJECT_EXCEPTION;
+    }
+  }
+
   int adaptyst_send_data(amod_t id, char *buf, unsigned int n) {
     std::unique_lock lock(inject_mutex);
     return handle_error_if_any(_adaptyst_send_data(id, buf, n),
@@ -680,6 +1726,82 @@ extern "C" {
                                "receive_string_timeout_nl");
   }
 
+  int adaptyst_send_message(amod_t id, const char *buf, unsigned int n) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_message(id, buf, n),
+                               "send_message");
+  }
+
+  int adaptyst_receive_message(amod_t id, const char **buf, unsigned int *n) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_receive_message(id, buf, n),
+                               "receive_message");
+  }
+
+  int adaptyst_receive_message_timeout(amod_t id, const char **buf,
+                                       unsigned int *n, long timeout_seconds) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_receive_message_timeout(id, buf, n,
+                                                                 timeout_seconds),
+                               "receive_message_timeout");
+  }
+
+  int adaptyst_send_message_nl(amod_t id, const char *buf, unsigned int n) {
+    return handle_error_if_any(_adaptyst_send_message(id, buf, n),
+                               "send_message_nl");
+  }
+
+  int adaptyst_receive_message_nl(amod_t id, const char **buf, unsigned int *n) {
+    return handle_error_if_any(_adaptyst_receive_message(id, buf, n),
+                               "receive_message_nl");
+  }
+
+  int adaptyst_receive_message_timeout_nl(amod_t id, const char **buf,
+                                          unsigned int *n, long timeout_seconds) {
+    return handle_error_if_any(_adaptyst_receive_message_timeout(id, buf, n,
+                                                                 timeout_seconds),
+                               "receive_message_timeout_nl");
+  }
+
+  int adaptyst_send_file(amod_t id, const char *path) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_file(id, path),
+                               "send_file");
+  }
+
+  int adaptyst_receive_file(amod_t id, const char *path, unsigned long long n,
+                            unsigned long long *received) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_receive_file(id, path, n, received),
+                               "receive_file");
+  }
+
+  int adaptyst_receive_file_timeout(amod_t id, const char *path, unsigned long long n,
+                                    unsigned long long *received, long timeout_seconds) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_receive_file_timeout(id, path, n, received,
+                                                              timeout_seconds),
+                               "receive_file_timeout");
+  }
+
+  int adaptyst_send_file_nl(amod_t id, const char *path) {
+    return handle_error_if_any(_adaptyst_send_file(id, path),
+                               "send_file_nl");
+  }
+
+  int adaptyst_receive_file_nl(amod_t id, const char *path, unsigned long long n,
+                               unsigned long long *received) {
+    return handle_error_if_any(_adaptyst_receive_file(id, path, n, received),
+                               "receive_file_nl");
+  }
+
+  int adaptyst_receive_file_timeout_nl(amod_t id, const char *path, unsigned long long n,
+                                       unsigned long long *received, long timeout_seconds) {
+    return handle_error_if_any(_adaptyst_receive_file_timeout(id, path, n, received,
+                                                              timeout_seconds),
+                               "receive_file_timeout_nl");
+  }
+
   void adaptyst_set_print_errors(unsigned int print) {
     std::unique_lock lock(inject_mutex);
     print_errors = print;
@@ -696,18 +1818,162 @@ extern "C" {
                                "init_custom_buf_size");
   }
 
+  int adaptyst_region_register(const char *name, adaptyst_region_t *region) {
+    return handle_error_if_any(_adaptyst_region_register(name, region),
+                               "region_register");
+  }
+
+  int adaptyst_region_set_policy(adaptyst_region_t region,
+                                 const adaptyst_region_policy *policy) {
+    return handle_error_if_any(_adaptyst_region_set_policy(region, policy),
+                               "region_set_policy");
+  }
+
+  // Region switches lock inject_mutex only in shared mode, so that
+  // threads marking regions don't wait for each other
   int adaptyst_region_start(const char *name) {
-    std::unique_lock lock(inject_mutex);
+    int result = init_if_needed();
+
+    if (result != ADAPTYST_INJECT_OK) {
+      return handle_error_if_any(result, "region_start");
+    }
+
+    std::shared_lock lock(inject_mutex);
     return handle_error_if_any(_adaptyst_region_start(name),
                                "region_start");
   }
 
   int adaptyst_region_end(const char *name) {
-    std::unique_lock lock(inject_mutex);
+    std::shared_lock lock(inject_mutex);
     return handle_error_if_any(_adaptyst_region_end(name),
                                "region_end");
   }
 
+  int adaptyst_region_start_h(adaptyst_region_t region) {
+    int result = init_if_needed();
+
+    if (result != ADAPTYST_INJECT_OK) {
+      return handle_error_if_any(result, "region_start_h");
+    }
+
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_region_start_h(region),
+                               "region_start_h");
+  }
+
+  int adaptyst_region_end_h(adaptyst_region_t region) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_region_end_h(region),
+                               "region_end_h");
+  }
+
+  int adaptyst_get_channel(amod_t id, const char *name,
+                           adaptyst_channel_t *channel) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_get_channel(id, name, channel),
+                               "get_channel");
+  }
+
+  int adaptyst_get_channel_nl(amod_t id, const char *name,
+                              adaptyst_channel_t *channel) {
+    return handle_error_if_any(_adaptyst_get_channel(id, name, channel),
+                               "get_channel_nl");
+  }
+
+  // Asynchronous sends lock inject_mutex only in shared mode, so that
+  // threads queueing messages don't wait for each other
+  int adaptyst_send_data_async(amod_t id, const char *buf, unsigned int n,
+                               int *queued) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_data_async(id, buf, n, queued),
+                               "send_data_async");
+  }
+
+  int adaptyst_send_string_async(amod_t id, const char *str, int *queued) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_string_async(id, str, queued),
+                               "send_string_async");
+  }
+
+  int adaptyst_send_message_async(amod_t id, const char *buf, unsigned int n,
+                                  int *queued) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_message_async(id, buf, n, queued),
+                               "send_message_async");
+  }
+
+  int adaptyst_send_flush(amod_t id) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_send_flush(id), "send_flush");
+  }
+
+  int adaptyst_set_send_policy(amod_t id, unsigned long long high_water_mark,
+                               adaptyst_send_policy policy) {
+    std::unique_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_set_send_policy(id, high_water_mark,
+                                                         policy),
+                               "set_send_policy");
+  }
+
+  int adaptyst_get_send_stats(amod_t id, adaptyst_send_stats *stats) {
+    std::shared_lock lock(inject_mutex);
+    return handle_error_if_any(_adaptyst_get_send_stats(id, stats),
+                               "get_send_stats");
+  }
+
+  int adaptyst_send_data_async_nl(amod_t id, const char *buf, unsigned int n,
+                                  int *queued) {
+    return handle_error_if_any(_adaptyst_send_data_async(id, buf, n, queued),
+                               "send_data_async_nl");
+  }
+
+  int adaptyst_send_string_async_nl(amod_t id, const char *str, int *queued) {
+    return handle_error_if_any(_adaptyst_send_string_async(id, str, queued),
+                               "send_string_async_nl");
+  }
+
+  int adaptyst_send_message_async_nl(amod_t id, const char *buf, unsigned int n,
+                                     int *queued) {
+    return handle_error_if_any(_adaptyst_send_message_async(id, buf, n, queued),
+                               "send_message_async_nl");
+  }
+
+  int adaptyst_send_flush_nl(amod_t id) {
+    return handle_error_if_any(_adaptyst_send_flush(id), "send_flush_nl");
+  }
+
+  int adaptyst_set_send_policy_nl(amod_t id, unsigned long long high_water_mark,
+                                  adaptyst_send_policy policy) {
+    return handle_error_if_any(_adaptyst_set_send_policy(id, high_water_mark,
+                                                         policy),
+                               "set_send_policy_nl");
+  }
+
+  int adaptyst_get_send_stats_nl(amod_t id, adaptyst_send_stats *stats) {
+    return handle_error_if_any(_adaptyst_get_send_stats(id, stats),
+                               "get_send_stats_nl");
+  }
+
+  // Channel handles stay valid until adaptyst_close(), so the data
+  // path doesn't take any locks
+  bool adaptyst_channel_push(adaptyst_channel_t channel, const void *buf,
+                             unsigned int n) {
+    return channel->channel->push(buf, n);
+  }
+
+  bool adaptyst_channel_pop(adaptyst_channel_t channel, void *buf,
+                            unsigned int buf_size, unsigned int *n) {
+    return channel->channel->pop(buf, buf_size, n);
+  }
+
+  bool adaptyst_channel_wait(adaptyst_channel_t channel, long timeout_ms) {
+    return channel->channel->wait(timeout_ms);
+  }
+
+  unsigned int adaptyst_channel_slot_size(adaptyst_channel_t channel) {
+    return channel->channel->get_slot_size();
+  }
+
   void adaptyst_set_error(const char *msg) {
     std::unique_lock lock(inject_mutex);
     if (instance) {
@@ -722,6 +1988,13 @@ extern "C" {
   }
 
   unsigned long long adaptyst_get_timestamp(int *err) {
+    adaptyst::TscClock *clock = adaptyst::tsc_clock.load(std::memory_order_acquire);
+
+    if (clock) {
+      *err = 0;
+      return clock->now();
+    }
+
     struct timespec ts;
 
     if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
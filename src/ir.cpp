@@ -2,19 +2,90 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "ir.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 namespace adaptyst {
+  static size_t get_command_size(std::vector<std::string> &elements) {
+    size_t size = (elements.size() + 1) * sizeof(char *) + alignof(char *);
+
+    for (auto &element : elements) {
+      size += element.length() + 1;
+    }
+
+    return size;
+  }
+
+  static char **build_command(IRArena &arena, std::vector<std::string> &elements) {
+    char **command = arena.allocate_array<char *>(elements.size() + 1);
+
+    for (size_t i = 0; i < elements.size(); i++) {
+      command[i] = arena.copy(elements[i]);
+    }
+
+    command[elements.size()] = nullptr;
+    return command;
+  }
+
+  IRArena::IRArena() {
+    this->current = nullptr;
+    this->left = 0;
+  }
+
+  void IRArena::reserve(size_t size) {
+    if (this->left >= size) {
+      return;
+    }
+
+    this->blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+    this->current = this->blocks.back().get();
+    this->left = size;
+  }
+
+  void *IRArena::allocate(size_t size, size_t alignment) {
+    size_t padding = this->current ?
+      (alignment - (uintptr_t)this->current % alignment) % alignment : 0;
+
+    if (!this->current || padding + size > this->left) {
+      this->reserve(std::max<size_t>(size + alignment, IR_ARENA_BLOCK_SIZE));
+      padding = (alignment - (uintptr_t)this->current % alignment) % alignment;
+    }
+
+    void *result = this->current + padding;
+    this->current += padding + size;
+    this->left -= padding + size;
+    return result;
+  }
+
+  char *IRArena::copy(const std::string &str) {
+    char *result = (char *)this->allocate(str.length() + 1, 1);
+    std::memcpy(result, str.c_str(), str.length() + 1);
+    return result;
+  }
+
   IR::IR(unsigned int type) {
     this->type = type;
     this->compiled = false;
+    this->c_data = nullptr;
   }
 
   ir IR::to_c_type() {
-    return { this->type, this->get_c_data() };
+    this->compile();
+    return { this->type, this->c_data };
   }
 
   void IR::compile() {
+    // The same IR is shared by all entities, which may be processed
+    // concurrently.
+    std::unique_lock lock(this->compile_mutex);
+
+    if (this->compiled) {
+      return;
+    }
+
     this->_compile();
+    this->c_data = this->build_c_data(this->arena);
     this->compiled = true;
   }
 
@@ -23,16 +94,24 @@ namespace adaptyst {
       throw std::runtime_error("Compile first before calling execute()");
     }
 
-    return std::make_unique<Process>([this]() {
-      return this->_execute();
-    });
+    // The workflow command is executed by the process directly, without
+    // forking Adaptyst just to fork again
+    std::vector<std::string> command = this->get_command();
+    std::unique_ptr<Process> process = std::make_unique<Process>(command);
+    fs::path executable = this->get_executable();
+
+    if (!executable.empty()) {
+      process->set_executable(executable);
+    }
+
+    return process;
   }
 
   MLIR::MLIR(fs::path output_dir) : IR(ADAPTYST_IR_MLIR) {
     this->output_dir = std::make_unique<Path>(output_dir);
   }
 
-  void *MLIR::get_c_data() {
+  void *MLIR::build_c_data(IRArena &) {
     throw std::runtime_error("MLIR class is not implemented yet");
   }
 
@@ -40,71 +119,88 @@ namespace adaptyst {
     throw std::runtime_error("MLIR class is not implemented yet");
   }
 
-  int MLIR::_execute() {
+  std::vector<std::string> MLIR::get_command() {
+    return {"workflow"};
+  }
+
+  fs::path MLIR::get_executable() {
     Path exec_dir = *this->output_dir / "workflow";
-    char *const argv[] = {const_cast<char *>("workflow"), NULL};
-    execv(exec_dir.get_path_name(), argv);
-    return errno;
+    return fs::path(exec_dir.get_path_name());
   }
 
   SingleCmd::SingleCmd(std::vector<std::string> elements) : IR(ADAPTYST_IR_SINGLE_CMD) {
-    for (std::string &s : elements) {
-      this->element_sizes.push_back(s.length());
-    }
+    this->elements = elements;
+  }
 
-    this->cmd_copies.push_back(new char *[this->element_sizes.size() + 1]);
-    for (int i = 0; i < this->element_sizes.size(); i++) {
-      this->cmd_copies[0][i] = new char[this->element_sizes[i] + 1];
-      this->cmd_copies[0][i][this->element_sizes[i]] = 0;
-      strncpy(this->cmd_copies[0][i], elements[i].c_str(), this->element_sizes[i]);
-    }
+  void *SingleCmd::build_c_data(IRArena &arena) {
+    arena.reserve(get_command_size(this->elements));
+    return build_command(arena, this->elements);
+  }
+
+  void SingleCmd::_compile() {}
 
-    this->cmd_copies[0][this->element_sizes.size()] = 0;
+  std::vector<std::string> SingleCmd::get_command() {
+    return this->elements;
   }
 
-  SingleCmd::~SingleCmd() {
-    for (char **ptr : this->cmd_copies) {
-      for (int i = 0; ptr[i]; i++) {
-        delete [] ptr[i];
-      }
+  Pipeline::Pipeline(std::vector<std::vector<std::string> > commands) : IR(ADAPTYST_IR_PIPELINE) {
+    if (commands.empty()) {
+      throw std::runtime_error("The pipeline does not contain any commands");
+    }
 
-      delete [] ptr;
+    for (auto &command : commands) {
+      if (command.empty()) {
+        throw std::runtime_error("The pipeline contains an empty command");
+      }
     }
+
+    this->commands = commands;
   }
 
-  void *SingleCmd::get_c_data() {
-    this->cmd_copies.push_back(new char *[this->element_sizes.size() + 1]);
-    int index = this->cmd_copies.size() - 1;
-    for (int i = 0; i < this->element_sizes.size(); i++) {
-      this->cmd_copies[index][i] = new char[this->element_sizes[i] + 1];
-      this->cmd_copies[index][i][this->element_sizes[i]] = 0;
-      strncpy(this->cmd_copies[index][i], this->cmd_copies[0][i], this->element_sizes[i]);
+  void *Pipeline::build_c_data(IRArena &arena) {
+    size_t size = sizeof(adaptyst_ir_pipeline) + alignof(adaptyst_ir_pipeline) +
+      this->commands.size() * sizeof(char **) + alignof(char **);
+
+    for (auto &command : this->commands) {
+      size += get_command_size(command);
     }
 
-    this->cmd_copies[index][this->element_sizes.size()] = 0;
+    arena.reserve(size);
+
+    adaptyst_ir_pipeline *pipeline = arena.allocate_array<adaptyst_ir_pipeline>(1);
+    pipeline->command_count = this->commands.size();
+    pipeline->commands = arena.allocate_array<char **>(this->commands.size());
 
-    return this->cmd_copies[index];
+    for (size_t i = 0; i < this->commands.size(); i++) {
+      pipeline->commands[i] = build_command(arena, this->commands[i]);
+    }
+
+    return pipeline;
   }
 
-  void SingleCmd::_compile() {}
+  void Pipeline::_compile() {}
 
-  int SingleCmd::_execute() {
-    int forked = fork();
-
-    if (forked == 0) {
-      execvp(this->cmd_copies[0][0], this->cmd_copies[0]);
-      return errno;
-    } else {
-      int status;
-      int result = waitpid(forked, &status, 0);
-
-      if (result != forked) {
-        return 104;
-      } else if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-      } else {
-        return 210;
+  std::vector<std::string> Pipeline::get_command() {
+    std::string script;
+
+    for (auto &command : this->commands) {
+      if (!script.empty()) {
+        script += " | ";
+      }
+
+      for (size_t i = 0; i < command.size(); i++) {
+        // Everything is single-quoted, so that the shell only splits
+        // the pipeline and never interprets the elements themselves
+        std::string quoted = "'";
+
+        for (char c : command[i]) {
+          quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+        }
+
+        script += (i > 0 ? " " : "") + quoted + "'";
       }
     }
+
+    return {"/bin/sh", "-c", script};
   }
 };
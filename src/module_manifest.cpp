@@ -0,0 +1,444 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "module_manifest.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace adaptyst {
+  ModuleManifest ModuleManifest::get(std::string backend_name,
+                                     std::vector<fs::path> &library_paths) {
+    bool found = false;
+    fs::path lib_path, inject_lib_path;
+
+    for (fs::path &path : library_paths) {
+      lib_path = path / backend_name / ("lib" + backend_name + ".so");
+
+      if (fs::exists(lib_path)) {
+        found = true;
+        inject_lib_path = path / backend_name / ("lib" + backend_name + "_inject.so");
+
+        if (!fs::exists(inject_lib_path)) {
+          inject_lib_path.clear();
+        }
+
+        break;
+      }
+    }
+
+    if (!found) {
+      throw std::runtime_error("Module \"" + backend_name + "\": Could not find the module!");
+    }
+
+    nlohmann::json key = {{"manifest_version", MODULE_MANIFEST_VERSION},
+                          {"lib", ModuleManifest::get_file_key(lib_path)},
+                          {"inject_lib", ModuleManifest::get_file_key(inject_lib_path)}};
+
+    std::stringstream cache_name;
+    cache_name << std::hex << std::hash<std::string>{}(lib_path.string()) << ".json";
+    fs::path cache_dir = ModuleManifest::get_cache_dir();
+    fs::path cache_path = cache_dir / cache_name.str();
+
+    try {
+      std::ifstream cache_stream(cache_path);
+
+      if (cache_stream) {
+        nlohmann::json cached = nlohmann::json::parse(cache_stream);
+
+        if (cached["key"] == key) {
+          return ModuleManifest::from_json(cached["manifest"]);
+        }
+      }
+    } catch (...) {
+      // An unreadable cache entry is simply rebuilt
+    }
+
+    ModuleManifest manifest = ModuleManifest::build(backend_name, lib_path,
+                                                    inject_lib_path);
+
+    // Caching is best-effort, e.g. the home directory may be read-only.
+    // The entry is renamed into place so that concurrent runs never read
+    // a partially written one.
+    std::error_code err;
+    fs::create_directories(cache_dir, err);
+
+    if (!err) {
+      fs::path tmp_path = cache_path.string() + ".tmp" + std::to_string(getpid());
+      std::ofstream tmp_stream(tmp_path);
+
+      if (tmp_stream) {
+        tmp_stream << nlohmann::json({{"key", key},
+                                      {"manifest", manifest.to_json()}}).dump();
+        tmp_stream.close();
+
+        if (tmp_stream) {
+          fs::rename(tmp_path, cache_path, err);
+        }
+      }
+
+      if (!tmp_stream || err) {
+        fs::remove(tmp_path, err);
+      }
+    }
+
+    return manifest;
+  }
+
+  std::vector<ModuleManifest> ModuleManifest::get_all(std::vector<fs::path> &library_paths) {
+    std::vector<ModuleManifest> manifests;
+    std::unordered_set<std::string> module_names;
+
+    for (fs::path &library_path : library_paths) {
+      for (auto &entry : fs::directory_iterator(library_path)) {
+        if (!entry.is_directory()) {
+          continue;
+        }
+
+        std::string backend_name = entry.path().filename().string();
+
+        if (module_names.contains(backend_name) ||
+            !fs::exists(entry.path() / ("lib" + backend_name + ".so"))) {
+          continue;
+        }
+
+        manifests.push_back(ModuleManifest::get(backend_name, library_paths));
+        module_names.insert(backend_name);
+      }
+    }
+
+    std::sort(manifests.begin(), manifests.end(),
+              [](ModuleManifest &a, ModuleManifest &b) {
+                return a.get_name() < b.get_name();
+              });
+
+    return manifests;
+  }
+
+  fs::path ModuleManifest::get_cache_dir() {
+    if (getenv("ADAPTYST_MODULE_CACHE_DIR")) {
+      return fs::path(getenv("ADAPTYST_MODULE_CACHE_DIR"));
+    }
+
+    if (getenv("XDG_CACHE_HOME") && *getenv("XDG_CACHE_HOME")) {
+      return fs::path(getenv("XDG_CACHE_HOME")) / "adaptyst" / "modules";
+    }
+
+    return fs::path(getenv("HOME") ? getenv("HOME") : "/tmp") /
+      ".cache" / "adaptyst" / "modules";
+  }
+
+  void ModuleManifest::validate(std::unordered_map<std::string, std::string> &options,
+                                std::unordered_map<std::string,
+                                                   std::vector<std::string> > &array_options) {
+    for (auto &entry : this->options) {
+      const std::string &name = entry.first;
+      OptionInfo &info = entry.second;
+      auto value = options.find(name);
+      auto array_value = array_options.find(name);
+
+      if (value == options.end() && array_value == array_options.end()) {
+        if (info.default_value.is_null()) {
+          throw std::runtime_error("Module \"" + this->name + "\" requires option "
+                                   "\"" + name + "\" to be set!");
+        }
+
+        continue;
+      }
+
+      auto check = [&name](option_type type, std::string &value) {
+        switch (type) {
+        case INT:
+          std::stoi(value);
+          break;
+
+        case UNSIGNED_INT:
+          std::stoul(value);
+          break;
+
+        case STRING:
+        case BOOL:
+          break;
+
+        default:
+          throw std::runtime_error("Unsupported option type for \"" + name + "\"");
+        }
+      };
+
+      if (value != options.end()) {
+        try {
+          check(info.type, value->second);
+        } catch (std::invalid_argument &) {
+          throw std::runtime_error("Could not parse value of \"" + name + "\"");
+        } catch (std::out_of_range &) {
+          throw std::runtime_error("Could not parse value of \"" + name + "\"");
+        }
+      } else {
+        if (info.array_type == NONE) {
+          throw std::runtime_error("Unsupported option array type for \"" + name + "\"");
+        }
+
+        for (size_t i = 0; i < array_value->second.size(); i++) {
+          try {
+            check(info.array_type, array_value->second[i]);
+          } catch (std::invalid_argument &) {
+            throw std::runtime_error("Could not parse value of element of index " +
+                                     std::to_string(i) + " of \"" + name + "\"");
+          } catch (std::out_of_range &) {
+            throw std::runtime_error("Could not parse value of element of index " +
+                                     std::to_string(i) + " of \"" + name + "\"");
+          }
+        }
+      }
+    }
+  }
+
+  std::string &ModuleManifest::get_name() {
+    return this->name;
+  }
+
+  std::string &ModuleManifest::get_version() {
+    return this->version;
+  }
+
+  std::vector<int> &ModuleManifest::get_version_nums() {
+    return this->version_nums;
+  }
+
+  fs::path &ModuleManifest::get_lib_path() {
+    return this->lib_path;
+  }
+
+  fs::path &ModuleManifest::get_inject_lib_path() {
+    return this->inject_lib_path;
+  }
+
+  unsigned int ModuleManifest::get_max_count_per_entity() {
+    return this->max_count_per_entity;
+  }
+
+  std::unordered_set<std::string> &ModuleManifest::get_tags() {
+    return this->tags;
+  }
+
+  std::map<std::string, ModuleManifest::OptionInfo> &ModuleManifest::get_options() {
+    return this->options;
+  }
+
+  nlohmann::json ModuleManifest::get_file_key(fs::path path) {
+    if (path.empty()) {
+      return nullptr;
+    }
+
+    std::error_code err;
+    auto size = fs::file_size(path, err);
+    auto mtime = fs::last_write_time(path, err);
+
+    if (err) {
+      return nullptr;
+    }
+
+    return {{"path", path.string()},
+            {"size", size},
+            {"mtime", mtime.time_since_epoch().count()}};
+  }
+
+  static nlohmann::json get_option_value(option_type type, void *value) {
+    switch (type) {
+    case INT:
+      return *((int *)value);
+
+    case UNSIGNED_INT:
+      return *((unsigned int *)value);
+
+    case STRING:
+      return *((const char **)value) ? *((const char **)value) : "";
+
+    case BOOL:
+      return *((bool *)value);
+
+    default:
+      return nullptr;
+    }
+  }
+
+  static size_t get_option_size(option_type type) {
+    switch (type) {
+    case INT:
+      return sizeof(int);
+
+    case UNSIGNED_INT:
+      return sizeof(unsigned int);
+
+    case STRING:
+      return sizeof(const char *);
+
+    case BOOL:
+      return sizeof(bool);
+
+    default:
+      return 0;
+    }
+  }
+
+  ModuleManifest ModuleManifest::build(std::string backend_name, fs::path lib_path,
+                                       fs::path inject_lib_path) {
+    void *handle = dlopen(lib_path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+
+    if (!handle) {
+      throw std::runtime_error("Could not load module \"" + backend_name + "\"! " +
+                               std::string(dlerror()));
+    }
+
+    ModuleManifest manifest;
+    manifest.lib_path = lib_path;
+    manifest.inject_lib_path = inject_lib_path;
+
+    try {
+      const char **name = (const char **)dlsym(handle, "name");
+      const char **version = (const char **)dlsym(handle, "version");
+
+      if (!name || !(*name) || !(**name)) {
+        throw std::runtime_error("Module \"" + backend_name + "\" doesn't define "
+                                 "its name!");
+      }
+
+      if (!version || !(*version) || !(**version)) {
+        throw std::runtime_error("Module \"" + backend_name + "\" doesn't define "
+                                 "its version!");
+      }
+
+      manifest.name = *name;
+      manifest.version = *version;
+
+      int *version_nums = (int *)dlsym(handle, "version_nums");
+
+      for (int i = 0; version_nums && version_nums[i] >= 0; i++) {
+        manifest.version_nums.push_back(version_nums[i]);
+      }
+
+      unsigned int *max_count_per_entity = (unsigned int *)dlsym(handle,
+                                                                 "max_count_per_entity");
+      manifest.max_count_per_entity = max_count_per_entity ? *max_count_per_entity : 0;
+
+      const char **tags = (const char **)dlsym(handle, "tags");
+
+      if (!tags) {
+        throw std::runtime_error("Module \"" + backend_name + "\" doesn't define its tags!");
+      }
+
+      for (int i = 0; tags[i]; i++) {
+        manifest.tags.insert(std::string(tags[i]));
+      }
+
+      const char **options = (const char **)dlsym(handle, "options");
+
+      if (!options) {
+        throw std::runtime_error("Module \"" + backend_name + "\" doesn't define "
+                                 "what options are available!");
+      }
+
+      for (int i = 0; options[i]; i++) {
+        std::string option_name(options[i]);
+        OptionInfo info;
+
+        const char **help = (const char **)dlsym(handle, (option_name + "_help").c_str());
+
+        if (!help) {
+          throw std::runtime_error("Module \"" + backend_name + "\" doesn't define any "
+                                   "help message for option \"" + option_name + "\"!");
+        }
+
+        info.help = std::string(*help);
+
+        option_type *type = (option_type *)dlsym(handle, (option_name + "_type").c_str());
+        option_type *array_type = (option_type *)dlsym(handle,
+                                                       (option_name + "_array_type").c_str());
+        info.type = type ? *type : NONE;
+        info.array_type = array_type ? *array_type : NONE;
+
+        if (!type && !array_type) {
+          throw std::runtime_error("Module \"" + backend_name + "\" doesn't define any "
+                                   "type for option \"" + option_name + "\"!");
+        }
+
+        void *default_value = dlsym(handle, (option_name + "_default").c_str());
+        void *default_array_value = dlsym(handle, (option_name + "_array_default").c_str());
+        unsigned int *default_array_value_size =
+          (unsigned int *)dlsym(handle, (option_name + "_array_default_size").c_str());
+
+        // The same precedence as when the module is loaded
+        if (info.type != NONE && default_value) {
+          info.default_value = get_option_value(info.type, default_value);
+        } else if (info.array_type != NONE && default_array_value) {
+          char *elements = *((char **)default_array_value);
+          unsigned int size = default_array_value_size ? *default_array_value_size : 0;
+          info.default_value = nlohmann::json::array();
+
+          for (unsigned int j = 0; j < size && elements; j++) {
+            info.default_value.push_back(
+              get_option_value(info.array_type,
+                               elements + j * get_option_size(info.array_type)));
+          }
+        }
+
+        manifest.options[option_name] = info;
+      }
+    } catch (...) {
+      dlclose(handle);
+      throw;
+    }
+
+    dlclose(handle);
+    return manifest;
+  }
+
+  nlohmann::json ModuleManifest::to_json() {
+    nlohmann::json options = nlohmann::json::object();
+
+    for (auto &entry : this->options) {
+      options[entry.first] = {{"help", entry.second.help},
+                              {"type", (int)entry.second.type},
+                              {"array_type", (int)entry.second.array_type},
+                              {"default", entry.second.default_value}};
+    }
+
+    return {{"name", this->name},
+            {"version", this->version},
+            {"version_nums", this->version_nums},
+            {"lib_path", this->lib_path.string()},
+            {"inject_lib_path", this->inject_lib_path.string()},
+            {"max_count_per_entity", this->max_count_per_entity},
+            {"tags", std::vector<std::string>(this->tags.begin(), this->tags.end())},
+            {"options", options}};
+  }
+
+  ModuleManifest ModuleManifest::from_json(nlohmann::json &json) {
+    ModuleManifest manifest;
+    manifest.name = json["name"].get<std::string>();
+    manifest.version = json["version"].get<std::string>();
+    manifest.version_nums = json["version_nums"].get<std::vector<int> >();
+    manifest.lib_path = json["lib_path"].get<std::string>();
+    manifest.inject_lib_path = json["inject_lib_path"].get<std::string>();
+    manifest.max_count_per_entity = json["max_count_per_entity"].get<unsigned int>();
+
+    for (auto &tag : json["tags"]) {
+      manifest.tags.insert(tag.get<std::string>());
+    }
+
+    for (auto &entry : json["options"].items()) {
+      OptionInfo info;
+      info.help = entry.value()["help"].get<std::string>();
+      info.type = (option_type)entry.value()["type"].get<int>();
+      info.array_type = (option_type)entry.value()["array_type"].get<int>();
+      info.default_value = entry.value()["default"];
+      manifest.options[entry.key()] = info;
+    }
+
+    return manifest;
+  }
+};
@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "adaptyst/output.hpp"
+
+namespace adaptyst {
+  /**
+     Gets the process-wide instance of MetadataCache.
+
+     It's defined here so that there's exactly one instance shared by
+     libadaptyst and modules, regardless of how they have been built.
+  */
+  MetadataCache &MetadataCache::instance() {
+    static MetadataCache cache;
+    return cache;
+  }
+};
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "overhead.hpp"
+#include <unordered_map>
+
+namespace adaptyst {
+  static std::atomic<unsigned long long> next_counters_id = 1;
+
+  static const char *counter_names[] = {
+    "workflow_messages",
+    "workflow_message_ns",
+    "region_regex_ns",
+    "region_ring_records",
+    "region_ring_drain_ns",
+    "inject_region_switches",
+    "inject_wait_ns",
+    "src_archive_paths",
+    "src_archive_ns",
+    "init_ns",
+    "process_ns",
+    "close_ns",
+    "messages_sent",
+    "bytes_sent",
+    "messages_received",
+    "bytes_received",
+    "records_published",
+    "records_consumed",
+    "publish_wait_ns"
+  };
+
+  static_assert(sizeof(counter_names) / sizeof(counter_names[0]) ==
+                OverheadCounters::COUNTER_COUNT);
+
+  OverheadCounters::OverheadCounters() {
+    this->id = next_counters_id++;
+  }
+
+  OverheadCounters::Shard *OverheadCounters::find_shard() {
+    thread_local std::unordered_map<unsigned long long, Shard *> thread_shards;
+
+    auto elem = thread_shards.find(this->id);
+
+    if (elem != thread_shards.end()) {
+      return elem->second;
+    }
+
+    std::unique_lock lock(this->shards_mutex);
+    this->shards.push_back(std::make_unique<Shard>());
+
+    Shard *shard = this->shards.back().get();
+    thread_shards[this->id] = shard;
+    return shard;
+  }
+
+  unsigned long long OverheadCounters::get(Counter counter) {
+    std::unique_lock lock(this->shards_mutex);
+    unsigned long long sum = 0;
+
+    for (auto &shard : this->shards) {
+      sum += shard->values[counter].load(std::memory_order_relaxed);
+    }
+
+    return sum;
+  }
+
+  void OverheadCounters::reset() {
+    std::unique_lock lock(this->shards_mutex);
+
+    for (auto &shard : this->shards) {
+      for (auto &value : shard->values) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  nlohmann::json OverheadCounters::to_json() {
+    nlohmann::json result = nlohmann::json::object();
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+      unsigned long long value = this->get((Counter)i);
+
+      if (value > 0) {
+        result[counter_names[i]] = value;
+      }
+    }
+
+    return result;
+  }
+
+  const char *OverheadCounters::get_name(Counter counter) {
+    return counter_names[counter];
+  }
+};
@@ -2,10 +2,86 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "print.hpp"
+#include <chrono>
 #include <iostream>
 #include <mutex>
 
+#define LOG_WRITER_BATCH_SIZE 1024
+#define LOG_WRITER_INTERVAL_US 1000
+
 namespace adaptyst {
+  /**
+     A single-producer-single-consumer bounded queue of log messages.
+     Every thread logging asynchronously has its own queue, which is
+     consumed by the log writer thread.
+  */
+  class LogQueue {
+  private:
+    std::vector<std::pair<LogStream *, std::string> > entries;
+    std::atomic<unsigned long long> head;
+    std::atomic<unsigned long long> tail;
+
+  public:
+    std::atomic<bool> orphaned;
+
+    LogQueue(unsigned int size) : entries(size) {
+      this->head = 0;
+      this->tail = 0;
+      this->orphaned = false;
+    }
+
+    bool push(LogStream *stream, std::string &message) {
+      unsigned long long head = this->head.load(std::memory_order_relaxed);
+      unsigned long long tail = this->tail.load(std::memory_order_acquire);
+
+      if (head - tail >= this->entries.size()) {
+        return false;
+      }
+
+      auto &entry = this->entries[head % this->entries.size()];
+      entry.first = stream;
+      entry.second = std::move(message);
+      this->head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(std::pair<LogStream *, std::string> &entry) {
+      unsigned long long tail = this->tail.load(std::memory_order_relaxed);
+      unsigned long long head = this->head.load(std::memory_order_acquire);
+
+      if (tail == head) {
+        return false;
+      }
+
+      auto &slot = this->entries[tail % this->entries.size()];
+      entry.first = slot.first;
+      entry.second = std::move(slot.second);
+      this->tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool empty() {
+      return this->head.load(std::memory_order_acquire) ==
+        this->tail.load(std::memory_order_acquire);
+    }
+  };
+
+  namespace {
+    struct LogQueueHolder {
+      Terminal *owner = nullptr;
+      unsigned long long session = 0;
+      std::shared_ptr<LogQueue> queue;
+
+      ~LogQueueHolder() {
+        if (this->queue) {
+          this->queue->orphaned = true;
+        }
+      }
+    };
+
+    thread_local LogQueueHolder local_log_queue;
+  };
+
   std::unique_ptr<Terminal> Terminal::instance = nullptr;
 
   void Terminal::init(bool batch, bool formatted, std::string version,
@@ -24,6 +100,14 @@ namespace adaptyst {
     this->formatted = formatted;
     this->version = version;
     this->last_line_len = 0;
+    this->async_logging = false;
+    this->log_queue_size = LOG_QUEUE_SIZE;
+    this->log_session = 0;
+    this->log_writer_stop = false;
+    this->log_producers = 0;
+    this->dropped_logs = 0;
+    this->failed_logs = 0;
+    this->log_error = "";
 
     if (!fs::exists(log_dir)) {
       try {
@@ -51,53 +135,259 @@ namespace adaptyst {
     }
   }
 
+  Terminal::~Terminal() {
+    this->stop_async_logging();
+  }
+
+  /**
+     Gets the log stream of a given type for a given source, so that
+     messages can be logged later without looking it up again. The log
+     file is created only when the first message is written.
+
+     @param source   The source of messages.
+     @param log_type The type of the log.
+  */
+  LogStream *Terminal::get_log_stream(Identifiable *source,
+                                      std::string log_type) {
+    std::unique_lock lock(this->log_mutex);
+
+    auto &source_streams = this->log_streams[source];
+    auto stream = source_streams.find(log_type);
+
+    if (stream != source_streams.end()) {
+      return stream->second.get();
+    }
+
+    std::unique_ptr<LogStream> new_stream = std::make_unique<LogStream>();
+    new_stream->path = source->get_path(this->log_dir) / (log_type + ".log");
+    new_stream->description = log_type + " of " + source->get_name();
+    new_stream->opened = false;
+    new_stream->unflushed = false;
+
+    LogStream *ptr = new_stream.get();
+    source_streams[log_type] = std::move(new_stream);
+    return ptr;
+  }
+
+  void Terminal::write_log(LogStream &stream, std::string &message, bool flush) {
+    std::unique_lock lock(stream.mutex);
+
+    if (!stream.opened) {
+      fs::path dir = stream.path.parent_path();
+
+      if (!fs::exists(dir) && !fs::create_directories(dir)) {
+        throw std::runtime_error("Could not create " + dir.string());
+      }
+
+      stream.stream = std::ofstream(stream.path);
+      stream.opened = true;
+    }
+
+    if (!stream.stream) {
+      throw std::runtime_error("Logging " + stream.description + ": I/O error");
+    }
+
+    stream.stream << message << '\n';
+
+    if (flush) {
+      stream.stream.flush();
+      stream.unflushed = false;
+    } else {
+      stream.unflushed = true;
+    }
+  }
+
+  /**
+     Logs a message to a log stream obtained from get_log_stream().
+
+     In the asynchronous mode (see start_async_logging()), the message
+     is only queued and this never blocks. If the queue of the calling
+     thread is full, the message is dropped.
+
+     @param message The message to be logged.
+     @param stream  The log stream.
+  */
+  void Terminal::log(std::string message, LogStream *stream) {
+    if (this->async_logging) {
+      // stop_async_logging() waits for producers counted here before
+      // the final drain, so a message pushed after async_logging has
+      // been checked again is always written
+      this->log_producers++;
+
+      if (this->async_logging) {
+        if (!this->get_log_queue()->push(stream, message)) {
+          this->dropped_logs++;
+        }
+
+        this->log_producers--;
+        return;
+      }
+
+      this->log_producers--;
+    }
+
+    this->write_log(*stream, message, true);
+  }
+
   void Terminal::log(std::string message, Identifiable *source,
                      std::string log_type) {
-    std::ofstream *stream = nullptr;
-    std::shared_ptr<std::mutex> stream_mutex;
+    this->log(message, this->get_log_stream(source, log_type));
+  }
+
+  LogQueue *Terminal::get_log_queue() {
+    // log_session can be changed by start_async_logging() in another
+    // thread at the same time
+    unsigned long long session = this->log_session.load(std::memory_order_acquire);
+
+    if (local_log_queue.owner != this ||
+        local_log_queue.session != session ||
+        !local_log_queue.queue) {
+      if (local_log_queue.queue) {
+        local_log_queue.queue->orphaned = true;
+      }
+
+      local_log_queue.owner = this;
+      local_log_queue.session = session;
+      local_log_queue.queue = std::make_shared<LogQueue>(this->log_queue_size);
 
-    {
       std::unique_lock lock(this->log_mutex);
+      this->log_queues.push_back(local_log_queue.queue);
+    }
+
+    return local_log_queue.queue.get();
+  }
+
+  void Terminal::write_logs() {
+    std::vector<std::shared_ptr<LogQueue> > queues;
+    std::vector<LogStream *> unflushed;
+    std::pair<LogStream *, std::string> entry;
 
-      if (log_streams.find(source) == log_streams.end()) {
-        log_streams[source] = std::unordered_map<std::string,
-                                                 std::pair<std::shared_ptr<std::mutex>,
-                                                           std::ofstream> >();
+    auto drain = [&]() {
+      bool drained = false;
+
+      {
+        std::unique_lock lock(this->log_mutex);
+        queues = this->log_queues;
       }
 
-      if (log_streams[source].find(log_type) == log_streams[source].end()) {
-        fs::path path = source->get_path(this->log_dir);
+      for (auto &queue : queues) {
+        for (int i = 0; i < LOG_WRITER_BATCH_SIZE && queue->pop(entry); i++) {
+          try {
+            this->write_log(*entry.first, entry.second, false);
+            unflushed.push_back(entry.first);
+          } catch (std::exception &e) {
+            if (this->failed_logs++ == 0) {
+              this->log_error = e.what();
+            }
+          }
 
-        if (!fs::exists(path) && !fs::create_directories(path)) {
-          throw std::runtime_error("Could not create " + path.string());
+          drained = true;
         }
+      }
 
-        log_streams[source][log_type] = std::make_pair(std::make_shared<std::mutex>(),
-                                                       std::ofstream(path / (log_type + ".log")));
+      for (LogStream *stream : unflushed) {
+        std::unique_lock lock(stream->mutex);
+
+        if (stream->unflushed) {
+          stream->stream.flush();
+          stream->unflushed = false;
+        }
       }
 
-      stream_mutex = log_streams[source][log_type].first;
-      stream = &log_streams[source][log_type].second;
+      unflushed.clear();
+
+      {
+        std::unique_lock lock(this->log_mutex);
+        std::erase_if(this->log_queues, [](std::shared_ptr<LogQueue> &queue) {
+          return queue->orphaned && queue->empty();
+        });
+      }
+
+      return drained;
+    };
+
+    while (!this->log_writer_stop) {
+      if (!drain()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(LOG_WRITER_INTERVAL_US));
+      }
     }
 
-    if (!stream) {
-      throw std::runtime_error("Logging " + log_type + " of "
-                               + source->get_name() +
-                               ": no output stream found");
+    while (drain()) { }
+  }
+
+  /**
+     Switches logging to the asynchronous mode, where every thread puts
+     messages into its own bounded queue and a background thread writes
+     them to disk.
+
+     @param queue_size The maximum number of messages waiting in
+                       the queue of a single thread.
+  */
+  void Terminal::start_async_logging(unsigned int queue_size) {
+    if (this->async_logging) {
+      return;
     }
 
+    this->log_queue_size = queue_size > 0 ? queue_size : 1;
+    this->log_session.fetch_add(1, std::memory_order_release);
+    this->log_writer_stop = false;
+    this->log_writer = std::thread([this]() { this->write_logs(); });
+    this->async_logging = true;
+  }
+
+  /**
+     Switches logging back to the synchronous mode, waiting until all
+     queued messages have been written.
+  */
+  void Terminal::stop_async_logging() {
+    if (!this->async_logging) {
+      return;
+    }
+
+    this->async_logging = false;
+
+    while (this->log_producers > 0) {
+      std::this_thread::yield();
+    }
+
+    this->log_writer_stop = true;
+    this->log_writer.join();
+
     {
-      std::unique_lock lock(*stream_mutex);
+      std::unique_lock lock(this->log_mutex);
+      this->log_queues.clear();
+    }
 
-      if (!*stream) {
-        throw std::runtime_error("Logging " + log_type + " of "
-                                 + source->get_name() +
-                                 ": I/O error");
-      }
+    unsigned long long dropped = this->dropped_logs;
 
-      *stream << message << std::endl;
-      stream->flush();
+    if (dropped > 0) {
+      this->print(std::to_string(dropped) + " log message(s) could not be written "
+                  "because they were produced faster than they could be saved!",
+                  true, true);
     }
+
+    unsigned long long failed = this->failed_logs;
+
+    if (failed > 0) {
+      this->print(std::to_string(failed) + " log message(s) could not be written "
+                  "because of an error: " + this->log_error, true, true);
+    }
+  }
+
+  /**
+     Gets the number of log messages dropped so far in the asynchronous mode
+     because the queue of the logging thread was full.
+  */
+  unsigned long long Terminal::get_dropped_log_count() {
+    return this->dropped_logs;
+  }
+
+  /**
+     Gets the number of log messages which could not be written in
+     the asynchronous mode because writing them to their log files failed.
+  */
+  unsigned long long Terminal::get_failed_log_count() {
+    return this->failed_logs;
   }
 
   /**
@@ -155,7 +445,36 @@ namespace adaptyst {
     return this->log_dir.c_str();
   }
 
+  /**
+     Changes the directory where logs are saved. Log streams obtained
+     earlier stay valid and are moved to the new directory, with their
+     current files closed.
+
+     @param log_dir The new log directory.
+  */
   void Terminal::set_log_dir(fs::path log_dir) {
-    this->log_dir = log_dir;
+    if (!fs::exists(log_dir)) {
+      fs::create_directories(log_dir);
+    }
+
+    std::unique_lock lock(this->log_mutex);
+    fs::path new_log_dir = fs::canonical(log_dir);
+
+    for (auto &source_streams : this->log_streams) {
+      for (auto &entry : source_streams.second) {
+        LogStream &stream = *entry.second;
+        std::unique_lock stream_lock(stream.mutex);
+
+        if (stream.opened) {
+          stream.stream.close();
+          stream.opened = false;
+          stream.unflushed = false;
+        }
+
+        stream.path = new_log_dir / fs::relative(stream.path, this->log_dir);
+      }
+    }
+
+    this->log_dir = new_log_dir;
   }
 };
@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "region_stats.hpp"
+#include <cmath>
+
+#define SUB_BUCKETS (1U << REGION_STATS_SUB_BUCKET_BITS)
+#define BUCKETS ((64 - REGION_STATS_SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+namespace adaptyst {
+  // Values below SUB_BUCKETS have their own buckets. Above, every power
+  // of 2 is split into SUB_BUCKETS equal sub-buckets.
+  static inline unsigned int get_bucket(unsigned long long value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+
+    unsigned int exp = 63 - __builtin_clzll(value);
+    return ((exp - REGION_STATS_SUB_BUCKET_BITS + 1) << REGION_STATS_SUB_BUCKET_BITS) +
+      (value >> (exp - REGION_STATS_SUB_BUCKET_BITS)) - SUB_BUCKETS;
+  }
+
+  static inline unsigned long long get_bucket_start(unsigned int bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+
+    unsigned int major = bucket >> REGION_STATS_SUB_BUCKET_BITS;
+    unsigned long long sub = bucket & (SUB_BUCKETS - 1);
+    return (SUB_BUCKETS + sub) << (major - 1);
+  }
+
+  void RegionStats::Stats::add(unsigned long long duration,
+                               unsigned long long count) {
+    if (this->histogram.empty()) {
+      this->histogram.resize(BUCKETS);
+    }
+
+    if (this->count == 0 || duration < this->min_ns) {
+      this->min_ns = duration;
+    }
+
+    if (this->count == 0 || duration > this->max_ns) {
+      this->max_ns = duration;
+    }
+
+    this->count += count;
+    this->total_ns += duration * count;
+    this->histogram[get_bucket(duration)] += count;
+  }
+
+  void RegionStats::Stats::merge(const adaptyst_region_summary &summary) {
+    if (summary.count == 0) {
+      return;
+    }
+
+    if (this->histogram.empty()) {
+      this->histogram.resize(BUCKETS);
+    }
+
+    if (this->count == 0 || summary.min_ns < this->min_ns) {
+      this->min_ns = summary.min_ns;
+    }
+
+    if (this->count == 0 || summary.max_ns > this->max_ns) {
+      this->max_ns = summary.max_ns;
+    }
+
+    this->count += summary.count;
+    this->total_ns += summary.total_ns;
+
+    // The summary histogram has a bucket per power of 2 only, so
+    // its instances are assumed to be in the middle of their buckets
+    for (int i = 0; i < ADAPTYST_REGION_HISTOGRAM_BUCKETS; i++) {
+      if (summary.histogram[i] == 0) {
+        continue;
+      }
+
+      unsigned long long value = i == 0 ? 1 : (1ULL << i) + (1ULL << (i - 1));
+
+      if (value < summary.min_ns) {
+        value = summary.min_ns;
+      } else if (value > summary.max_ns) {
+        value = summary.max_ns;
+      }
+
+      this->histogram[get_bucket(value)] += summary.histogram[i];
+    }
+  }
+
+  unsigned long long RegionStats::Stats::percentile(double percentile) {
+    if (this->count == 0) {
+      return 0;
+    }
+
+    if (percentile <= 0) {
+      return this->min_ns;
+    }
+
+    if (percentile >= 100) {
+      return this->max_ns;
+    }
+
+    unsigned long long rank = std::ceil(percentile / 100 * this->count);
+    unsigned long long seen = 0;
+
+    for (unsigned int i = 0; i < BUCKETS; i++) {
+      seen += this->histogram[i];
+
+      if (seen >= rank) {
+        unsigned long long start = get_bucket_start(i);
+        unsigned long long end = i + 1 < BUCKETS ? get_bucket_start(i + 1) : ~0ULL;
+        unsigned long long value = start + (end - start) / 2;
+
+        if (value < this->min_ns) {
+          return this->min_ns;
+        }
+
+        return value > this->max_ns ? this->max_ns : value;
+      }
+    }
+
+    return this->max_ns;
+  }
+
+  void RegionStats::Stats::fill(adaptyst_region_stats &stats) {
+    stats.count = this->count;
+    stats.total_ns = this->total_ns;
+    stats.min_ns = this->min_ns;
+    stats.max_ns = this->max_ns;
+    stats.p50_ns = this->percentile(50);
+    stats.p90_ns = this->percentile(90);
+    stats.p99_ns = this->percentile(99);
+    stats.p999_ns = this->percentile(99.9);
+  }
+
+  nlohmann::json RegionStats::Stats::to_json() {
+    adaptyst_region_stats stats;
+    this->fill(stats);
+
+    return {{"count", stats.count},
+            {"total_ns", stats.total_ns},
+            {"min_ns", stats.min_ns},
+            {"max_ns", stats.max_ns},
+            {"p50_ns", stats.p50_ns},
+            {"p90_ns", stats.p90_ns},
+            {"p99_ns", stats.p99_ns},
+            {"p999_ns", stats.p999_ns}};
+  }
+
+  void RegionStats::add_switch(std::string &name, std::string &part_id,
+                               bool start, unsigned long long timestamp) {
+    std::unique_lock lock(this->mutex);
+    Region &region = this->regions[name];
+
+    if (start) {
+      if (!region.open.try_emplace(part_id, timestamp).second) {
+        region.unmatched++;
+        region.open[part_id] = timestamp;
+      }
+
+      return;
+    }
+
+    auto open = region.open.find(part_id);
+
+    if (open == region.open.end() || open->second > timestamp) {
+      region.unmatched++;
+      return;
+    }
+
+    unsigned long long duration = timestamp - open->second;
+    region.open.erase(open);
+    region.total.add(duration);
+    region.parts[part_id].add(duration);
+  }
+
+  void RegionStats::add_summary(std::string &name, std::string &part_id,
+                                const adaptyst_region_summary &summary) {
+    std::unique_lock lock(this->mutex);
+    Region &region = this->regions[name];
+    region.total.merge(summary);
+    region.parts[part_id].merge(summary);
+  }
+
+  RegionStats::Stats *RegionStats::find(std::string &name, std::string &part_id) {
+    auto region = this->regions.find(name);
+
+    if (region == this->regions.end()) {
+      return nullptr;
+    }
+
+    if (part_id.empty()) {
+      return &region->second.total;
+    }
+
+    auto part = region->second.parts.find(part_id);
+    return part == region->second.parts.end() ? nullptr : &part->second;
+  }
+
+  bool RegionStats::get(std::string &name, std::string &part_id,
+                        adaptyst_region_stats &stats) {
+    std::unique_lock lock(this->mutex);
+    Stats *found = this->find(name, part_id);
+
+    if (!found || found->count == 0) {
+      return false;
+    }
+
+    found->fill(stats);
+    return true;
+  }
+
+  bool RegionStats::get_percentile(std::string &name, std::string &part_id,
+                                   double percentile, unsigned long long &ns) {
+    std::unique_lock lock(this->mutex);
+    Stats *found = this->find(name, part_id);
+
+    if (!found || found->count == 0) {
+      return false;
+    }
+
+    ns = found->percentile(percentile);
+    return true;
+  }
+
+  void RegionStats::reset() {
+    std::unique_lock lock(this->mutex);
+    this->regions.clear();
+  }
+
+  bool RegionStats::empty() {
+    std::unique_lock lock(this->mutex);
+    return this->regions.empty();
+  }
+
+  nlohmann::json RegionStats::to_json() {
+    std::unique_lock lock(this->mutex);
+    nlohmann::json result = nlohmann::json::object();
+
+    for (auto &entry : this->regions) {
+      nlohmann::json region = entry.second.total.to_json();
+      nlohmann::json parts = nlohmann::json::object();
+
+      for (auto &part : entry.second.parts) {
+        parts[part.first] = part.second.to_json();
+      }
+
+      region["parts"] = parts;
+      region["unmatched"] = entry.second.unmatched;
+      region["unfinished"] = entry.second.open.size();
+      result[entry.first] = region;
+    }
+
+    return result;
+  }
+};
@@ -0,0 +1,769 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "remote.hpp"
+#include "entrypoint.hpp"
+#include "print.hpp"
+#include "system.hpp"
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <limits>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace adaptyst {
+  namespace ch = std::chrono;
+
+  static unsigned long long get_timestamp() {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
+      throw std::runtime_error("clock_gettime() failed, error " +
+                               std::to_string(errno));
+    }
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  static std::string get_hello() {
+    return "hello " + std::to_string(REMOTE_PROTOCOL_VERSION) + " " +
+      std::string(version);
+  }
+
+  static bool is_hello_compatible(std::string &msg) {
+    std::string expected = "hello " + std::to_string(REMOTE_PROTOCOL_VERSION) + " ";
+    return msg.starts_with(expected);
+  }
+
+  bool is_token_equal(std::string_view received, std::string &expected) {
+    unsigned char diff = received.size() != expected.size();
+
+    for (std::string::size_type i = 0; i < expected.size(); i++) {
+      diff |= (unsigned char)(i < received.size() ? received[i] : 0) ^
+        (unsigned char)expected[i];
+    }
+
+    return diff == 0;
+  }
+
+  // Names received from peers become single path components
+  static bool is_valid_name(std::string &name) {
+    return !name.empty() && name.find('/') == std::string::npos &&
+      name.find('\0') == std::string::npos &&
+      name.find("..") == std::string::npos;
+  }
+
+  std::string get_remote_token(fs::path token_file, std::string env_var) {
+    std::string token;
+
+    if (!token_file.empty()) {
+      std::ifstream stream(token_file);
+
+      if (!stream) {
+        throw std::runtime_error("Could not open " + token_file.string() + "!");
+      }
+
+      token = std::string((std::istreambuf_iterator<char>(stream)),
+                          std::istreambuf_iterator<char>());
+
+      while (!token.empty() && std::isspace((unsigned char)token.back())) {
+        token.pop_back();
+      }
+    } else if (getenv(env_var.c_str())) {
+      token = getenv(env_var.c_str());
+    }
+
+    if (token.empty()) {
+      throw std::runtime_error("No shared secret has been provided (set " +
+                               env_var + " or provide a token file)");
+    }
+
+    return token;
+  }
+
+  Multiplexer::Multiplexer(std::unique_ptr<Connection> conn) {
+    this->conn = std::move(conn);
+    this->conn->enable_framing();
+  }
+
+  void Multiplexer::send(unsigned int channel, const char *buf, unsigned int len) {
+    std::unique_lock lock(this->send_mutex);
+
+    this->send_buf.resize(4 + len);
+    this->send_buf[0] = (channel >> 24) & 0xff;
+    this->send_buf[1] = (channel >> 16) & 0xff;
+    this->send_buf[2] = (channel >> 8) & 0xff;
+    this->send_buf[3] = channel & 0xff;
+    std::memcpy(this->send_buf.data() + 4, buf, len);
+
+    this->conn->write_message(this->send_buf.data(), this->send_buf.size());
+  }
+
+  void Multiplexer::send_control(std::string msg) {
+    this->send(REMOTE_CHANNEL_CONTROL, msg.data(), msg.size());
+  }
+
+  void Multiplexer::receive(unsigned int &channel, std::string_view &payload,
+                            long timeout_seconds) {
+    std::string_view frame = this->conn->read_view(timeout_seconds);
+
+    if (frame.empty()) {
+      std::runtime_error err("The connection has been closed");
+      throw ConnectionException(err);
+    } else if (frame.size() < 4) {
+      std::runtime_error err("Malformed frame received");
+      throw ConnectionException(err);
+    }
+
+    const unsigned char *header = (const unsigned char *)frame.data();
+    channel = ((unsigned int)header[0] << 24) | ((unsigned int)header[1] << 16) |
+      ((unsigned int)header[2] << 8) | (unsigned int)header[3];
+    payload = frame.substr(4);
+  }
+
+  std::string Multiplexer::receive_control(long timeout_seconds) {
+    unsigned int channel;
+    std::string_view payload;
+
+    this->receive(channel, payload, timeout_seconds);
+
+    if (channel != REMOTE_CHANNEL_CONTROL) {
+      throw std::runtime_error("Unexpected data received from channel " +
+                               std::to_string(channel));
+    }
+
+    return std::string(payload);
+  }
+
+  void Multiplexer::set_max_receive_size(size_t max_size) {
+    this->conn->set_max_message_size(4 + max_size);
+  }
+
+  ResultStreamer::ResultStreamer(Multiplexer &mux) : mux(mux),
+                                                     buf(REMOTE_CHUNK_SIZE) {
+    this->next_channel = REMOTE_CHANNEL_FIRST_FILE;
+    this->stopping = false;
+  }
+
+  ResultStreamer::~ResultStreamer() {
+    {
+      std::unique_lock lock(this->stop_mutex);
+      this->stopping = true;
+      this->stop_cond.notify_all();
+    }
+
+    if (this->scanner.joinable()) {
+      this->scanner.join();
+    }
+  }
+
+  void ResultStreamer::add_root(std::string tag, fs::path path) {
+    std::unique_lock lock(this->scan_mutex);
+    this->roots.push_back(std::make_pair(tag, path));
+  }
+
+  void ResultStreamer::start(unsigned int interval_ms) {
+    this->scanner = std::thread([this, interval_ms]() {
+      while (true) {
+        {
+          std::unique_lock lock(this->stop_mutex);
+
+          if (this->stop_cond.wait_for(lock, ch::milliseconds(interval_ms),
+                                       [this]() { return this->stopping; })) {
+            return;
+          }
+        }
+
+        try {
+          this->scan();
+        } catch (...) {
+          this->error = std::current_exception();
+          return;
+        }
+      }
+    });
+  }
+
+  void ResultStreamer::finish() {
+    {
+      std::unique_lock lock(this->stop_mutex);
+      this->stopping = true;
+      this->stop_cond.notify_all();
+    }
+
+    if (this->scanner.joinable()) {
+      this->scanner.join();
+    }
+
+    if (this->error) {
+      std::rethrow_exception(this->error);
+    }
+
+    this->scan();
+  }
+
+  void ResultStreamer::scan() {
+    std::unique_lock lock(this->scan_mutex);
+
+    for (auto &root : this->roots) {
+      std::error_code err;
+
+      if (!fs::exists(root.second, err)) {
+        continue;
+      }
+
+      fs::recursive_directory_iterator it(root.second,
+                                          fs::directory_options::skip_permission_denied,
+                                          err);
+
+      for (; !err && it != fs::recursive_directory_iterator(); it.increment(err)) {
+        fs::path path = it->path();
+
+        // Temporary files are renamed to their final names
+        // shortly afterwards (see MetadataCache)
+        if (path.extension() == ".tmp") {
+          continue;
+        }
+
+        struct stat stat_buf;
+
+        if (stat(path.c_str(), &stat_buf) == -1 || !S_ISREG(stat_buf.st_mode)) {
+          continue;
+        }
+
+        std::string rel = fs::relative(path, root.second).string();
+        std::string key = root.first + "/" + rel;
+
+        auto elem = this->files.find(key);
+
+        if (elem == this->files.end()) {
+          FileState state;
+          state.channel = this->next_channel++;
+          state.inode = stat_buf.st_ino;
+          state.offset = 0;
+          state.mtime = {0, 0};
+
+          this->mux.send_control("file " + std::to_string(state.channel) + " " +
+                                 root.first + " " + rel);
+          elem = this->files.insert(std::make_pair(key, state)).first;
+        } else {
+          FileState &state = elem->second;
+          bool mtime_changed = state.mtime.tv_sec != stat_buf.st_mtim.tv_sec ||
+            state.mtime.tv_nsec != stat_buf.st_mtim.tv_nsec;
+
+          if (state.inode != stat_buf.st_ino || stat_buf.st_size < state.offset ||
+              (stat_buf.st_size == state.offset && mtime_changed)) {
+            this->mux.send_control("reset " + std::to_string(state.channel));
+            state.inode = stat_buf.st_ino;
+            state.offset = 0;
+          }
+        }
+
+        this->send_file(path, elem->second, stat_buf);
+      }
+    }
+  }
+
+  void ResultStreamer::send_file(fs::path &path, FileState &state,
+                                 struct stat &stat_buf) {
+    state.mtime = stat_buf.st_mtim;
+
+    if (stat_buf.st_size <= state.offset) {
+      return;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+      // The file may have been removed in the meantime
+      return;
+    }
+
+    while (state.offset < stat_buf.st_size) {
+      ssize_t bytes_read = ::pread(fd, this->buf.data(),
+                                   std::min<off_t>(this->buf.size(),
+                                                   stat_buf.st_size - state.offset),
+                                   state.offset);
+
+      if (bytes_read <= 0) {
+        break;
+      }
+
+      try {
+        this->mux.send(state.channel, this->buf.data(), bytes_read);
+      } catch (...) {
+        ::close(fd);
+        throw;
+      }
+
+      state.offset += bytes_read;
+    }
+
+    ::close(fd);
+  }
+
+  ResultReceiver::~ResultReceiver() {
+    for (auto &entry : this->fds) {
+      ::close(entry.second);
+    }
+  }
+
+  void ResultReceiver::add_root(std::string tag, fs::path path) {
+    this->roots[tag] = path;
+  }
+
+  bool ResultReceiver::handle(unsigned int channel, std::string_view payload) {
+    if (channel >= REMOTE_CHANNEL_FIRST_FILE) {
+      auto fd = this->fds.find(channel);
+
+      if (fd == this->fds.end()) {
+        throw std::runtime_error("Data received for unknown file channel " +
+                                 std::to_string(channel));
+      }
+
+      FileTransfer::write_all(fd->second, payload.data(), payload.size());
+      return true;
+    } else if (channel != REMOTE_CHANNEL_CONTROL) {
+      return false;
+    }
+
+    if (payload.starts_with("file ")) {
+      // "file <channel> <tag> <relative path>"
+      std::string::size_type sep1 = payload.find(' ', 5);
+      std::string::size_type sep2 = sep1 == std::string::npos ?
+        std::string::npos : payload.find(' ', sep1 + 1);
+
+      if (sep2 == std::string::npos) {
+        throw std::runtime_error("Malformed file announcement received");
+      }
+
+      unsigned int file_channel =
+        std::stoul(std::string(payload.substr(5, sep1 - 5)));
+      std::string tag(payload.substr(sep1 + 1, sep2 - sep1 - 1));
+      fs::path rel(payload.substr(sep2 + 1));
+
+      if (!this->roots.contains(tag)) {
+        throw std::runtime_error("Unknown result directory \"" + tag + "\"");
+      }
+
+      if (file_channel < REMOTE_CHANNEL_FIRST_FILE) {
+        throw std::runtime_error("Invalid file channel " +
+                                 std::to_string(file_channel));
+      }
+
+      if (rel.empty() || rel.is_absolute()) {
+        throw std::runtime_error("Invalid result file path " + rel.string());
+      }
+
+      for (auto &part : rel) {
+        if (part == "..") {
+          throw std::runtime_error("Invalid result file path " + rel.string());
+        }
+      }
+
+      fs::path path = this->roots[tag] / rel;
+      fs::create_directories(path.parent_path());
+
+      int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+      if (fd == -1) {
+        throw std::runtime_error("Could not open " + path.string() + ", error " +
+                                 std::to_string(errno));
+      }
+
+      if (this->fds.contains(file_channel)) {
+        ::close(this->fds[file_channel]);
+      }
+
+      this->fds[file_channel] = fd;
+      return true;
+    } else if (payload.starts_with("reset ")) {
+      unsigned int file_channel = std::stoul(std::string(payload.substr(6)));
+      auto fd = this->fds.find(file_channel);
+
+      if (fd == this->fds.end()) {
+        throw std::runtime_error("Reset received for unknown file channel " +
+                                 std::to_string(file_channel));
+      }
+
+      if (ftruncate(fd->second, 0) == -1 || lseek(fd->second, 0, SEEK_SET) == -1) {
+        throw std::runtime_error("Could not truncate a result file, error " +
+                                 std::to_string(errno));
+      }
+
+      return true;
+    }
+
+    return false;
+  }
+
+  RemoteController::RemoteController(std::string address, unsigned short port,
+                                     unsigned int buf_size, std::string token) {
+    net::StreamSocket socket;
+
+    try {
+      socket.connect(net::SocketAddress(address, port));
+      socket.setNoDelay(true);
+    } catch (net::NetException &e) {
+      throw ConnectionException(e);
+    }
+
+    this->mux = std::make_unique<Multiplexer>(std::make_unique<TCPSocket>(socket,
+                                                                          buf_size));
+    this->mux->send_control("auth " + token);
+    this->mux->send_control(get_hello());
+
+    std::string reply = this->mux->receive_control();
+
+    if (!is_hello_compatible(reply)) {
+      throw std::runtime_error("The remote agent at " + address + ":" +
+                               std::to_string(port) + " is incompatible "
+                               "with this version of Adaptyst");
+    }
+  }
+
+  void RemoteController::send_definition(fs::path def_file, std::string entity_name) {
+    std::ifstream stream(def_file);
+
+    if (!stream) {
+      throw std::runtime_error("Could not open " + def_file.string() + "!");
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+
+    this->mux->send_control("system " + entity_name + "\n" + contents);
+  }
+
+  void RemoteController::send_ir(ir workflow) {
+    if (workflow.type != ADAPTYST_IR_SINGLE_CMD) {
+      throw std::runtime_error("Only single commands can be run by remote "
+                               "entities at the moment");
+    }
+
+    std::string msg = "ir\n";
+
+    for (char **elem = (char **)workflow.data; *elem; elem++) {
+      msg += std::string(*elem);
+      msg += '\0';
+    }
+
+    this->mux->send_control(msg);
+  }
+
+  void RemoteController::send_src_compression(ArchiveCompression compression) {
+    std::string spec;
+
+    switch (compression.get_type()) {
+    case ArchiveCompression::STORE:
+      spec = "store";
+      break;
+
+    case ArchiveCompression::DEFLATE:
+      spec = "deflate:" + std::to_string(compression.get_level());
+      break;
+
+    case ArchiveCompression::ZSTD:
+      spec = "zstd:" + std::to_string(compression.get_level());
+      break;
+    }
+
+    this->mux->send_control("compression " + spec);
+  }
+
+  long long RemoteController::sync_clock(unsigned long long &rtt) {
+    long long offset = 0;
+    rtt = std::numeric_limits<unsigned long long>::max();
+
+    for (int i = 0; i < REMOTE_CLOCK_ROUNDS; i++) {
+      unsigned long long sent = get_timestamp();
+      this->mux->send_control("clock");
+      std::string reply = this->mux->receive_control();
+      unsigned long long received = get_timestamp();
+
+      if (!reply.starts_with("clock ")) {
+        throw std::runtime_error("Unexpected reply from the remote agent: " + reply);
+      }
+
+      unsigned long long remote = std::stoull(reply.substr(6));
+
+      if (received - sent < rtt) {
+        rtt = received - sent;
+        offset = (long long)remote - (long long)(sent + (received - sent) / 2);
+      }
+    }
+
+    return offset;
+  }
+
+  void RemoteController::run(ResultReceiver &receiver) {
+    this->mux->send_control("start");
+
+    while (true) {
+      unsigned int channel;
+      std::string_view payload;
+
+      this->mux->receive(channel, payload);
+
+      if (receiver.handle(channel, payload)) {
+        continue;
+      }
+
+      if (channel != REMOTE_CHANNEL_CONTROL) {
+        throw std::runtime_error("Unexpected data received from channel " +
+                                 std::to_string(channel));
+      }
+
+      if (payload == "done ok") {
+        return;
+      } else if (payload.starts_with("done error ")) {
+        throw std::runtime_error(std::string(payload.substr(11)));
+      } else {
+        throw std::runtime_error("Unexpected message from the remote agent: " +
+                                 std::string(payload));
+      }
+    }
+  }
+
+  void RemoteController::close() {
+    if (!this->mux) {
+      return;
+    }
+
+    try {
+      this->mux->send_control("close");
+    } catch (std::exception &) {
+      // The agent ends the session anyway when the connection is closed
+    }
+
+    this->mux.reset();
+  }
+
+  RemoteAgent::RemoteAgent(std::string address, unsigned short port,
+                           std::vector<fs::path> &library_paths,
+                           fs::path local_config_path, fs::path work_dir,
+                           unsigned int buf_size, bool formatted,
+                           std::string token) {
+    this->library_paths = library_paths;
+    this->local_config_path = local_config_path;
+    this->work_dir = work_dir;
+    this->buf_size = buf_size;
+    this->formatted = formatted;
+    this->token = token;
+    this->sessions = 0;
+
+    TCPAcceptor::Factory factory(address, port);
+    this->acceptor = factory.make_acceptor(UNLIMITED_ACCEPTED);
+  }
+
+  void RemoteAgent::serve() {
+    std::cout << "Listening for sessions at " <<
+      this->acceptor->get_connection_instructions() << std::endl;
+
+    while (true) {
+      // Finished sessions are reaped here rather than by ignoring SIGCHLD,
+      // as sessions wait for their own workflows and that would make
+      // waitpid() fail with ECHILD there
+      while (waitpid(-1, nullptr, WNOHANG) > 0) { }
+
+      std::unique_ptr<Connection> conn;
+
+      try {
+        conn = this->acceptor->accept(this->buf_size, REMOTE_REAP_INTERVAL);
+      } catch (TimeoutException &) {
+        continue;
+      }
+
+      // Authentication is done before forking so that only
+      // authenticated peers can make the agent start any processes.
+      // This serves peers one at a time, but for REMOTE_AUTH_TIMEOUT
+      // seconds at most.
+      std::unique_ptr<Multiplexer> mux;
+
+      try {
+        mux = std::make_unique<Multiplexer>(std::move(conn));
+
+        if (!this->authenticate(*mux)) {
+          std::cerr << "A peer has failed to authenticate" << std::endl;
+          continue;
+        }
+      } catch (std::exception &e) {
+        std::cerr << "A peer has failed to authenticate: " << e.what() << std::endl;
+        continue;
+      }
+
+      this->sessions++;
+
+      pid_t forked = fork();
+
+      if (forked == -1) {
+        std::cerr << "Could not start a new session, error " << errno << std::endl;
+      } else if (forked == 0) {
+        // The agent may have been started with SIGCHLD ignored, which
+        // must not leak into the session and the workflow it runs
+        signal(SIGCHLD, SIG_DFL);
+        this->acceptor.reset();
+        int code = 0;
+
+        try {
+          this->serve_session(*mux);
+        } catch (std::exception &e) {
+          std::cerr << "Session " << this->sessions << " has failed: " <<
+            e.what() << std::endl;
+          code = 2;
+        }
+
+        std::exit(code);
+      }
+    }
+  }
+
+  bool RemoteAgent::authenticate(Multiplexer &mux) {
+    // Nothing is answered to unauthenticated peers and they can
+    // neither send much data nor keep the agent waiting, as
+    // REMOTE_AUTH_TIMEOUT is the limit for the whole message
+    mux.set_max_receive_size(REMOTE_AUTH_MAX_SIZE);
+    std::string auth = mux.receive_control(REMOTE_AUTH_TIMEOUT);
+
+    if (!auth.starts_with("auth ") ||
+        !is_token_equal(std::string_view(auth).substr(5), this->token)) {
+      return false;
+    }
+
+    mux.set_max_receive_size(MAX_MESSAGE_SIZE);
+    return true;
+  }
+
+  void RemoteAgent::serve_session(Multiplexer &mux) {
+    std::string hello = mux.receive_control();
+
+    if (!is_hello_compatible(hello)) {
+      mux.send_control(get_hello());
+      throw std::runtime_error("Incompatible Adaptyst instance has connected");
+    }
+
+    mux.send_control(get_hello());
+
+    fs::path session_dir = this->work_dir /
+      ("session_" + std::to_string(getpid()));
+    fs::create_directories(session_dir);
+
+    Terminal::init(false, this->formatted, version, session_dir / "log");
+
+    fs::path def_file = session_dir / "system.yml";
+    std::string entity_name;
+    std::vector<std::string> command;
+    ArchiveCompression compression;
+    fs::path run_dir;
+    unsigned int runs = 0;
+
+    while (true) {
+      std::string msg = mux.receive_control();
+
+      if (msg.starts_with("system ")) {
+        std::string::size_type sep = msg.find('\n');
+
+        if (sep == std::string::npos) {
+          throw std::runtime_error("Malformed system definition received");
+        }
+
+        entity_name = msg.substr(7, sep - 7);
+
+        if (!is_valid_name(entity_name)) {
+          throw std::runtime_error("Invalid entity name received: " + entity_name);
+        }
+
+        std::ofstream stream(def_file);
+        stream << msg.substr(sep + 1);
+
+        if (!stream) {
+          throw std::runtime_error("Could not write " + def_file.string());
+        }
+      } else if (msg.starts_with("ir\n")) {
+        command.clear();
+        std::string::size_type start = 3;
+
+        while (start < msg.size()) {
+          std::string::size_type end = msg.find('\0', start);
+
+          if (end == std::string::npos) {
+            end = msg.size();
+          }
+
+          command.push_back(msg.substr(start, end - start));
+          start = end + 1;
+        }
+      } else if (msg.starts_with("compression ")) {
+        compression = ArchiveCompression::parse(msg.substr(12));
+      } else if (msg == "clock") {
+        mux.send_control("clock " + std::to_string(get_timestamp()));
+      } else if (msg == "start") {
+        if (entity_name.empty() || command.empty()) {
+          mux.send_control("done error The system definition or the workflow "
+                           "has not been received");
+          continue;
+        }
+
+        // Every run (e.g. one of many requested with --runs) gets its own
+        // directory, so that the files of the previous one are neither
+        // in the way of the new ones nor sent again. They have been
+        // sent already, so they are removed.
+        fs::path prev_run_dir = run_dir;
+        run_dir = session_dir / ("run_" + std::to_string(++runs));
+        fs::create_directories(run_dir / "system");
+        fs::create_directories(run_dir / "tmp");
+        Terminal::instance->set_log_dir(run_dir / "log");
+
+        if (!prev_run_dir.empty()) {
+          std::error_code err;
+          fs::remove_all(prev_run_dir, err);
+        }
+
+        Terminal::instance->print("Hosting entity " + entity_name + "...", false, false);
+
+        ResultStreamer streamer(mux);
+        streamer.add_root("system", run_dir / "system" / entity_name);
+        streamer.add_root("log", fs::path(Terminal::instance->get_log_dir()));
+        streamer.start();
+
+        std::string error;
+
+        try {
+          // The destructor of System saves all pending metadata, so it must
+          // run before the final scan of result files
+          System system(def_file, entity_name, run_dir / "system",
+                        this->library_paths, this->local_config_path,
+                        run_dir / "tmp", false, this->buf_size);
+          system.set_src_compression(compression);
+          system.set_ir(std::make_shared<SingleCmd>(command));
+          system.process();
+        } catch (std::exception &e) {
+          error = e.what();
+        }
+
+        streamer.finish();
+
+        if (error.empty()) {
+          mux.send_control("done ok");
+        } else {
+          Terminal::instance->print(error, true, true);
+          mux.send_control("done error " + error);
+        }
+      } else if (msg == "close") {
+        break;
+      } else {
+        throw std::runtime_error("Unexpected message received: " + msg);
+      }
+    }
+
+    std::error_code err;
+    fs::remove_all(session_dir, err);
+  }
+};
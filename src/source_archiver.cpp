@@ -0,0 +1,173 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "source_archiver.hpp"
+#include <cstring>
+#include <fstream>
+
+namespace adaptyst {
+  static bool has_contents(fs::path &path, std::string &data) {
+    std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+
+    if (!stream) {
+      return false;
+    }
+
+    std::string other(data.size() + 1, 0);
+    stream.read(other.data(), other.size());
+    return !stream.bad() && (size_t)stream.gcount() == data.size() &&
+      std::memcmp(other.data(), data.data(), data.size()) == 0;
+  }
+
+  SourceArchiver::SourceArchiver(fs::path path,
+                                 ArchiveCompression compression,
+                                 unsigned int threads) :
+    archive(path.string() + compression.get_extension(),
+            ARCHIVE_BUFFER_SIZE, compression) {
+    this->closing = false;
+    this->files_written = 0;
+    this->src_mapping = nlohmann::json::object();
+
+    if (threads == 0) {
+      threads = 1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+      this->workers.push_back(std::thread([this]() { this->work(); }));
+    }
+  }
+
+  void SourceArchiver::add_path(fs::path path) {
+    std::unique_lock lock(this->queue_mutex);
+
+    if (this->closing || this->scheduled.contains(path.string())) {
+      return;
+    }
+
+    this->scheduled.insert(path.string());
+    this->queue.push(path);
+    this->queue_cond.notify_one();
+  }
+
+  void SourceArchiver::work() {
+    while (true) {
+      fs::path path;
+
+      {
+        std::unique_lock lock(this->queue_mutex);
+        this->queue_cond.wait(lock, [this]() {
+          return !this->queue.empty() || this->closing;
+        });
+
+        if (this->queue.empty()) {
+          return;
+        }
+
+        path = this->queue.front();
+        this->queue.pop();
+      }
+
+      try {
+        std::error_code err;
+
+        if (!fs::is_regular_file(path, err)) {
+          continue;
+        }
+
+        std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+
+        if (!stream) {
+          continue;
+        }
+
+        std::string data(fs::file_size(path), 0);
+        stream.read(data.data(), data.size());
+
+        if (stream.bad()) {
+          throw Archive::FileIOException();
+        }
+
+        data.resize(stream.gcount());
+
+        // FNV-1a combined with the size only finds candidates, which
+        // are compared byte by byte with the files they have been archived
+        // from (read again instead of being kept in memory)
+        unsigned long long hash = 14695981039346656037ULL;
+
+        for (unsigned char c : data) {
+          hash ^= c;
+          hash *= 1099511628211ULL;
+        }
+
+        std::string key = std::to_string(hash) + ":" + std::to_string(data.size());
+        std::vector<std::pair<std::string, fs::path> > candidates;
+
+        {
+          std::unique_lock lock(this->archive_mutex);
+          auto entry = this->contents.find(key);
+
+          if (entry != this->contents.end()) {
+            candidates = entry->second;
+          }
+        }
+
+        std::string filename;
+
+        for (auto &candidate : candidates) {
+          if (has_contents(candidate.second, data)) {
+            filename = candidate.first;
+            break;
+          }
+        }
+
+        std::unique_lock lock(this->archive_mutex);
+
+        if (filename.empty()) {
+          filename = std::to_string(this->files_written) + path.extension().string();
+          this->archive.add_file_data(filename, data.data(), data.size());
+          this->contents[key].push_back(std::make_pair(filename, path));
+          this->files_written++;
+        }
+
+        this->src_mapping[path.string()] = filename;
+      } catch (...) {
+        std::unique_lock lock(this->archive_mutex);
+
+        if (!this->error) {
+          this->error = std::current_exception();
+        }
+      }
+    }
+  }
+
+  void SourceArchiver::stop_workers() {
+    {
+      std::unique_lock lock(this->queue_mutex);
+      this->closing = true;
+      this->queue_cond.notify_all();
+    }
+
+    for (auto &worker : this->workers) {
+      if (worker.joinable()) {
+        worker.join();
+      }
+    }
+  }
+
+  void SourceArchiver::close() {
+    this->stop_workers();
+
+    if (this->error) {
+      std::rethrow_exception(this->error);
+    }
+
+    std::string src_mapping_str = nlohmann::to_string(this->src_mapping) + '\n';
+    this->archive.add_file_data("index.json", src_mapping_str.c_str(),
+                                src_mapping_str.length());
+    this->archive.close();
+  }
+
+  SourceArchiver::~SourceArchiver() {
+    this->stop_workers();
+  }
+};
@@ -4,12 +4,24 @@
 #include "system.hpp"
 #include "print.hpp"
 #include "archive.hpp"
+#include "event_loop.hpp"
 #include "adaptyst/output.hpp"
 #include <ryml.hpp>
+#include <algorithm>
 #include <fstream>
 #include <dlfcn.h>
 #include <regex>
 #include <time.h>
+#include <thread>
+#include <climits>
+#include <cstring>
+#include <cstddef>
+
+#define REGION_RING_BATCH_SIZE 256
+#define REGION_RING_DRAIN_INTERVAL_US 1000
+#define REGION_RING_MAX_SIZE 1048576
+#define TSC_CLOCK_POLL_INTERVAL_MS 50
+#define TSC_CLOCK_RECALIBRATION_INTERVAL_MS 1000
 
 // The code segment below is for the C hardware module API.
 inline void set_error(adaptyst::Module *mod, int code) {
@@ -45,6 +57,14 @@ inline void set_error(adaptyst::Module *mod, int code) {
   case ADAPTYST_ERR_TIMEOUT:
     msg = "Timeout";
     break;
+
+  case ADAPTYST_ERR_CHANNEL_NOT_FOUND:
+    msg = "Channel not found";
+    break;
+
+  case ADAPTYST_ERR_REGION_NOT_FOUND:
+    msg = "Region not found";
+    break;
   }
 
   mod->set_api_error(msg, code);
@@ -69,6 +89,18 @@ inline adaptyst::Module *get(amod_t id, bool reset_error = true) {
   }
 }
 
+inline void count_sent(adaptyst::Module *mod, unsigned long long bytes) {
+  adaptyst::OverheadCounters &overhead = mod->get_overhead();
+  overhead.add(adaptyst::OverheadCounters::MESSAGES_SENT);
+  overhead.add(adaptyst::OverheadCounters::BYTES_SENT, bytes);
+}
+
+inline void count_received(adaptyst::Module *mod, unsigned long long bytes) {
+  adaptyst::OverheadCounters &overhead = mod->get_overhead();
+  overhead.add(adaptyst::OverheadCounters::MESSAGES_RECEIVED);
+  overhead.add(adaptyst::OverheadCounters::BYTES_RECEIVED, bytes);
+}
+
 extern "C" {
   const char *adaptyst_get_library_dir(amod_t id) {
     auto mod = get(id);
@@ -146,6 +178,7 @@ extern "C" {
 
     try {
       mod->get_fd()->write(n, buf);
+      count_sent(mod, n);
       return true;
     } catch (std::exception &e) {
       set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
@@ -163,6 +196,11 @@ extern "C" {
 
     try {
       *n = mod->get_fd()->read(buf, buf_size, NO_TIMEOUT);
+
+      if (*n > 0) {
+        count_received(mod, *n);
+      }
+
       return true;
     } catch (std::exception &e) {
       set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
@@ -180,6 +218,11 @@ extern "C" {
 
     try {
       *n = mod->get_fd()->read(buf, buf_size, timeout_seconds);
+
+      if (*n > 0) {
+        count_received(mod, *n);
+      }
+
       return true;
     } catch (adaptyst::TimeoutException &e) {
       set_error(mod, ADAPTYST_ERR_TIMEOUT);
@@ -198,7 +241,9 @@ extern "C" {
     }
 
     try {
-      mod->get_fd()->write(std::string(str), true);
+      std::string msg(str);
+      mod->get_fd()->write(msg, true);
+      count_sent(mod, msg.size() + 1);
       return true;
     } catch (std::exception &e) {
       set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
@@ -220,6 +265,7 @@ extern "C" {
         *str = NULL;
       } else {
         *str = received.c_str();
+        count_received(mod, received.size());
       }
 
       return true;
@@ -244,6 +290,7 @@ extern "C" {
         *str = NULL;
       } else {
         *str = received.c_str();
+        count_received(mod, received.size());
       }
 
       return true;
@@ -256,6 +303,128 @@ extern "C" {
     }
   }
 
+  bool adaptyst_send_message(amod_t id, const char *buf, unsigned int n) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      mod->get_fd()->write_message(buf, n);
+      count_sent(mod, n);
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_receive_message(amod_t id, const char **buf, unsigned int *n) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      std::string_view received = mod->get_fd()->read_view();
+      *buf = received.data();
+      *n = received.size();
+      count_received(mod, received.size());
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_receive_message_timeout(amod_t id, const char **buf,
+                                        unsigned int *n, long timeout_seconds) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      std::string_view received = mod->get_fd()->read_view(timeout_seconds);
+      *buf = received.data();
+      *n = received.size();
+      count_received(mod, received.size());
+      return true;
+    } catch (adaptyst::TimeoutException &e) {
+      set_error(mod, ADAPTYST_ERR_TIMEOUT);
+      return false;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_send_file(amod_t id, const char *path) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      std::filesystem::path file(path);
+      mod->get_fd()->write(file);
+
+      std::error_code err;
+      std::uintmax_t size = std::filesystem::file_size(file, err);
+      count_sent(mod, err ? 0 : size);
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_receive_file(amod_t id, const char *path,
+                             unsigned long long n,
+                             unsigned long long *received) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      *received = mod->get_fd()->read(std::filesystem::path(path), n);
+      count_received(mod, *received);
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_receive_file_timeout(amod_t id, const char *path,
+                                     unsigned long long n,
+                                     unsigned long long *received,
+                                     long timeout_seconds) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      *received = mod->get_fd()->read(std::filesystem::path(path), n, timeout_seconds);
+      count_received(mod, *received);
+      return true;
+    } catch (adaptyst::TimeoutException &e) {
+      set_error(mod, ADAPTYST_ERR_TIMEOUT);
+      return false;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
   const char *adaptyst_get_node_name(amod_t id) {
     auto mod = get(id);
 
@@ -279,8 +448,58 @@ extern "C" {
     }
 
     try {
-      adaptyst::Terminal::instance->log(std::string(msg), mod,
-                                        std::string(type));
+      adaptyst::Terminal::instance->log(std::string(msg),
+                                        mod->get_log_stream(mod->get_log_handle(type)));
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+
+    return true;
+  }
+
+  int adaptyst_get_log_handle(amod_t id, const char *type) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return -1;
+    }
+
+    if (!adaptyst::Terminal::instance) {
+      set_error(mod, ADAPTYST_ERR_TERMINAL_NOT_INITIALISED);
+      return -1;
+    }
+
+    try {
+      return mod->get_log_handle(std::string(type));
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return -1;
+    }
+  }
+
+  bool adaptyst_log_h(amod_t id, int handle, const char *msg) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    if (!adaptyst::Terminal::instance) {
+      set_error(mod, ADAPTYST_ERR_TERMINAL_NOT_INITIALISED);
+      return false;
+    }
+
+    adaptyst::LogStream *stream = mod->get_log_stream(handle);
+
+    if (!stream) {
+      set_error(mod, "Invalid log handle: " + std::to_string(handle),
+                ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+
+    try {
+      adaptyst::Terminal::instance->log(std::string(msg), stream);
     } catch (std::exception &e) {
       set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
       return false;
@@ -435,6 +654,16 @@ extern "C" {
     }
   }
 
+  bool adaptyst_is_memory_bound(amod_t id) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    return mod->is_memory_bound();
+  }
+
   const char *adaptyst_get_tmp_dir(amod_t id) {
     auto mod = get(id);
 
@@ -481,177 +710,362 @@ extern "C" {
     return true;
   }
 
-  bool adaptyst_has_in_tag(amod_t id, const char *tag) {
+  bool adaptyst_create_channel(amod_t id, const char *name,
+                               unsigned int slot_size,
+                               unsigned int slot_count) {
     auto mod = get(id);
 
     if (!mod) {
       return false;
     }
 
+    if (!mod->is_initialising()) {
+      set_error(mod, ADAPTYST_ERR_INIT_ONLY);
+      return false;
+    }
+
     try {
-      return mod->has_in_tag(std::string(tag));
+      mod->create_channel(std::string(name), slot_size, slot_count);
+      return true;
     } catch (std::exception &e) {
       set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
       return false;
     }
   }
 
-  bool adaptyst_has_out_tag(amod_t id, const char *tag) {
+  bool adaptyst_get_channel(amod_t id, const char *name,
+                            adaptyst_channel_t *channel) {
     auto mod = get(id);
 
     if (!mod) {
       return false;
     }
 
-    try {
-      return mod->has_out_tag(std::string(tag));
-    } catch (std::exception &e) {
-      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+    *channel = mod->get_channel(std::string(name));
+
+    if (!*channel) {
+      set_error(mod, ADAPTYST_ERR_CHANNEL_NOT_FOUND);
       return false;
     }
-  }
-
-  const char *adaptyst_get_internal_error_msg(amod_t id) {
-    auto mod = get(id, false);
 
-    if (!mod) {
-      return "Module not found";
-    }
+    return true;
+  }
 
-    return mod->get_api_error_msg().c_str();
+  bool adaptyst_channel_push(adaptyst_channel_t channel, const void *buf,
+                             unsigned int n) {
+    return channel->channel->push(buf, n);
   }
 
-  int adaptyst_get_internal_error_code(amod_t id) {
-    auto mod = get(id, false);
+  bool adaptyst_channel_pop(adaptyst_channel_t channel, void *buf,
+                            unsigned int buf_size, unsigned int *n) {
+    return channel->channel->pop(buf, buf_size, n);
+  }
 
-    if (!mod) {
-      return ADAPTYST_ERR_MODULE_NOT_FOUND;
-    }
+  bool adaptyst_channel_wait(adaptyst_channel_t channel, long timeout_ms) {
+    return channel->channel->wait(timeout_ms);
+  }
 
-    return mod->get_api_error_code();
+  unsigned int adaptyst_channel_slot_size(adaptyst_channel_t channel) {
+    return channel->channel->get_slot_size();
   }
 
-  unsigned long long adaptyst_get_timestamp(amod_t id) {
+  bool adaptyst_has_in_tag(amod_t id, const char *tag) {
     auto mod = get(id);
 
     if (!mod) {
-      return 0;
+      return false;
     }
 
-    struct timespec ts;
-
-    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
-      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
-      return 0;
+    try {
+      return mod->has_in_tag(std::string(tag));
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
     }
-
-    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
   }
 
-  unsigned long long adaptyst_get_workflow_start_time(amod_t id) {
+  bool adaptyst_has_out_tag(amod_t id, const char *tag) {
     auto mod = get(id);
 
     if (!mod) {
-      return 0;
-    }
-
-    if (!mod->is_workflow_ever_run()) {
-      set_error(mod, ADAPTYST_ERR_WORKFLOW_NOT_STARTED);
-      return 0;
+      return false;
     }
 
-    bool err;
-    unsigned long long timestamp = mod->get_workflow_start_time(err);
-
-    if (err) {
-      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
-      return 0;
+    try {
+      return mod->has_out_tag(std::string(tag));
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
     }
-
-    return timestamp;
   }
 
-  unsigned long long adaptyst_get_workflow_end_time(amod_t id) {
+  adaptyst_record_t adaptyst_record_alloc(amod_t id, unsigned int size) {
     auto mod = get(id);
 
     if (!mod) {
-      return 0;
+      return NULL;
     }
 
-    if (!mod->is_workflow_ever_run()) {
-      set_error(mod, ADAPTYST_ERR_WORKFLOW_NOT_STARTED);
-      return 0;
-    }
+    try {
+      auto record = std::make_shared<adaptyst::Record>();
+      record->data = std::make_unique<char[]>(size);
+      record->size = size;
 
-    if (mod->is_workflow_running()) {
-      set_error(mod, ADAPTYST_ERR_WORKFLOW_RUNNING);
-      return 0;
+      return new adaptyst_record{record};
+    } catch (std::bad_alloc &e) {
+      set_error(mod, ADAPTYST_ERR_OUT_OF_MEMORY);
+      return NULL;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return NULL;
     }
+  }
 
-    bool err;
-    unsigned long long timestamp = mod->get_workflow_end_time(err);
+  void *adaptyst_record_data(adaptyst_record_t record) {
+    return record->record->data.get();
+  }
 
-    if (err) {
-      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
-      return 0;
-    }
+  unsigned int adaptyst_record_size(adaptyst_record_t record) {
+    return record->record->size;
+  }
 
-    return timestamp;
+  const char *adaptyst_record_tag(adaptyst_record_t record) {
+    return record->record->tag.c_str();
   }
 
-  bool adaptyst_is_workflow_running(amod_t id) {
+  bool adaptyst_publish_record(amod_t id, const char *tag,
+                               adaptyst_record_t record) {
+    std::unique_ptr<adaptyst_record> handle(record);
     auto mod = get(id);
 
     if (!mod) {
       return false;
     }
 
-    return mod->is_workflow_running();
-  }
-}
-// The C hardware module API code segment ends here.
+    try {
+      handle->record->tag = std::string(tag);
+      mod->publish_record(std::move(handle->record));
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
 
-namespace adaptyst {
-  namespace ch = std::chrono;
+  bool adaptyst_publish(amod_t id, const char *tag, const void *buf,
+                        unsigned int n) {
+    adaptyst_record_t record = adaptyst_record_alloc(id, n);
 
-  std::unordered_map<amod_t, Module *> Module::all_modules;
-  amod_t Module::next_module_id = 1;
+    if (!record) {
+      return false;
+    }
 
-  std::vector<std::unique_ptr<Module> > Module::get_all_modules(std::vector<fs::path> &library_paths) {
-    std::vector<std::unique_ptr<Module> > modules;
-    std::unordered_set<std::string> module_names;
-    for (fs::path &library_path : library_paths) {
-      for (auto &entry : fs::directory_iterator(library_path)) {
-        if (!entry.is_directory()) {
-          continue;
-        }
+    std::memcpy(record->record->data.get(), buf, n);
+    return adaptyst_publish_record(id, tag, record);
+  }
 
-        fs::path mod_path = entry.path() / ("lib" + entry.path().filename().string() + ".so");
+  bool adaptyst_consume_record(amod_t id, adaptyst_record_t *record) {
+    return adaptyst_consume_record_timeout(id, record, NO_TIMEOUT);
+  }
 
-        if (!fs::exists(mod_path)) {
-          continue;
-        }
+  bool adaptyst_consume_record_timeout(amod_t id, adaptyst_record_t *record,
+                                       long timeout_seconds) {
+    auto mod = get(id);
 
-        if (module_names.contains(entry.path().filename().string())) {
-          continue;
-        }
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      std::shared_ptr<const adaptyst::Record> consumed;
+
+      switch (mod->consume_record(consumed, timeout_seconds)) {
+      case adaptyst::RecordQueue::RECORD:
+        // The data are read-only as documented in hw.h
+        *record = new adaptyst_record{std::const_pointer_cast<adaptyst::Record>(consumed)};
+        return true;
+
+      case adaptyst::RecordQueue::TIMEOUT:
+        set_error(mod, ADAPTYST_ERR_TIMEOUT);
+        return false;
+
+      default:
+        *record = NULL;
+        return true;
+      }
+    } catch (std::bad_alloc &e) {
+      set_error(mod, ADAPTYST_ERR_OUT_OF_MEMORY);
+      return false;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  void adaptyst_record_release(adaptyst_record_t record) {
+    delete record;
+  }
+
+  const char *adaptyst_get_internal_error_msg(amod_t id) {
+    auto mod = get(id, false);
+
+    if (!mod) {
+      return "Module not found";
+    }
+
+    return mod->get_api_error_msg().c_str();
+  }
+
+  int adaptyst_get_internal_error_code(amod_t id) {
+    auto mod = get(id, false);
+
+    if (!mod) {
+      return ADAPTYST_ERR_MODULE_NOT_FOUND;
+    }
+
+    return mod->get_api_error_code();
+  }
+
+  unsigned long long adaptyst_get_timestamp(amod_t id) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return 0;
+    }
+
+    bool err;
+    unsigned long long timestamp = mod->get_timestamp(err);
+
+    if (err) {
+      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
+      return 0;
+    }
+
+    return timestamp;
+  }
+
+  unsigned long long adaptyst_get_workflow_start_time(amod_t id) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return 0;
+    }
+
+    if (!mod->is_workflow_ever_run()) {
+      set_error(mod, ADAPTYST_ERR_WORKFLOW_NOT_STARTED);
+      return 0;
+    }
+
+    bool err;
+    unsigned long long timestamp = mod->get_workflow_start_time(err);
+
+    if (err) {
+      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
+      return 0;
+    }
+
+    return timestamp;
+  }
+
+  unsigned long long adaptyst_get_workflow_end_time(amod_t id) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return 0;
+    }
+
+    if (!mod->is_workflow_ever_run()) {
+      set_error(mod, ADAPTYST_ERR_WORKFLOW_NOT_STARTED);
+      return 0;
+    }
+
+    if (mod->is_workflow_running()) {
+      set_error(mod, ADAPTYST_ERR_WORKFLOW_RUNNING);
+      return 0;
+    }
+
+    bool err;
+    unsigned long long timestamp = mod->get_workflow_end_time(err);
+
+    if (err) {
+      set_error(mod, ADAPTYST_ERR_TIMESTAMP);
+      return 0;
+    }
+
+    return timestamp;
+  }
+
+  bool adaptyst_is_workflow_running(amod_t id) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    return mod->is_workflow_running();
+  }
+
+  bool adaptyst_get_region_stats(amod_t id, const char *name,
+                                 const char *part_id,
+                                 adaptyst_region_stats *stats) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
+    }
+
+    try {
+      std::string name_str(name);
+      std::string part_id_str(part_id ? part_id : "");
 
-        modules.push_back(std::make_unique<Module>(entry.path().filename().string(), library_paths));
-        module_names.insert(entry.path().filename().string());
+      if (!mod->get_region_stats().get(name_str, part_id_str, *stats)) {
+        set_error(mod, ADAPTYST_ERR_REGION_NOT_FOUND);
+        return false;
       }
+
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
+  }
+
+  bool adaptyst_get_region_percentile(amod_t id, const char *name,
+                                      const char *part_id, double percentile,
+                                      unsigned long long *ns) {
+    auto mod = get(id);
+
+    if (!mod) {
+      return false;
     }
 
-    std::sort(modules.begin(), modules.end(),
-              [](const std::unique_ptr<Module> &a,
-                 const std::unique_ptr<Module> &b) {
-                return a->get_name() < b->get_name();
-              });
+    try {
+      std::string name_str(name);
+      std::string part_id_str(part_id ? part_id : "");
+
+      if (!mod->get_region_stats().get_percentile(name_str, part_id_str,
+                                                  percentile, *ns)) {
+        set_error(mod, ADAPTYST_ERR_REGION_NOT_FOUND);
+        return false;
+      }
 
-    return modules;
+      return true;
+    } catch (std::exception &e) {
+      set_error(mod, std::string(e.what()), ADAPTYST_ERR_EXCEPTION);
+      return false;
+    }
   }
+}
+// The C hardware module API code segment ends here.
+
+namespace adaptyst {
+  namespace ch = std::chrono;
+
+  std::unordered_map<amod_t, Module *> Module::all_modules;
+  amod_t Module::next_module_id = 1;
 
   std::string Module::get_name() {
-    const char **name = (const char **)dlsym(this->handle, "name");
+    const char **name = this->name_sym;
 
     if (!name) {
       this->throw_error("No name is defined");
@@ -671,7 +1085,7 @@ namespace adaptyst {
   }
 
   std::string Module::get_version() {
-    const char **version = (const char **)dlsym(this->handle, "version");
+    const char **version = this->version_sym;
 
     if (!version) {
       this->throw_error("No version is defined");
@@ -691,7 +1105,7 @@ namespace adaptyst {
   }
 
   std::vector<int> Module::get_version_nums() {
-    int *version_nums = (int *)dlsym(this->handle, "version_nums");
+    int *version_nums = this->version_nums_sym;
 
     if (!version_nums) {
       this->throw_error("No version number array is defined");
@@ -745,6 +1159,10 @@ namespace adaptyst {
                          std::unordered_map<std::string, std::string> &options,
                          std::unordered_map<std::string, std::vector<std::string>> &array_options,
                          std::vector<fs::path> &library_paths, bool never_directing, bool no_inject) {
+    // no_inject is meant for the handling of injection parts below,
+    // which is disabled at the moment
+    (void)no_inject;
+
     this->api_error_code = ADAPTYST_OK;
     this->api_error_msg = "OK, no errors";
     bool found = false;
@@ -771,6 +1189,11 @@ namespace adaptyst {
       this->throw_error("Could not load the module! " + std::string(dlerror()));
     }
 
+    this->name_sym = (const char **)dlsym(this->handle, "name");
+    this->version_sym = (const char **)dlsym(this->handle, "version");
+    this->version_nums_sym = (int *)dlsym(this->handle, "version_nums");
+    this->resolve_vtable();
+
     unsigned int *max_count_per_entity = (unsigned int *)dlsym(this->handle,
                                                                "max_count_per_entity");
 
@@ -928,9 +1351,9 @@ namespace adaptyst {
             // This should have been caught in the previous "switch"
             break;
           }
-        } catch (std::invalid_argument) {
+        } catch (std::invalid_argument &) {
           throw std::runtime_error("Could not parse value of \"" + name + "\"");
-        } catch (std::out_of_range) {
+        } catch (std::out_of_range &) {
           throw std::runtime_error("Could not parse value of \"" + name + "\"");
         }
 
@@ -970,13 +1393,13 @@ namespace adaptyst {
         try {
           switch (metadata.array_type) {
           case INT:
-            for (i = 0; i < array_options[name].size(); i++) {
+            for (i = 0; i < (int)array_options[name].size(); i++) {
               ((int *)allocated)[i] = std::stoi(array_options[name][i]);
             }
             break;
 
           case STRING:
-            for (i = 0; i < array_options[name].size(); i++) {
+            for (i = 0; i < (int)array_options[name].size(); i++) {
               void *element = calloc(array_options[name][i].length() + 1,
                                      sizeof(char));
 
@@ -995,13 +1418,13 @@ namespace adaptyst {
             break;
 
           case UNSIGNED_INT:
-            for (i = 0; i < array_options[name].size(); i++) {
+            for (i = 0; i < (int)array_options[name].size(); i++) {
               ((unsigned int *)allocated)[i] = std::stoul(array_options[name][i]);
             }
             break;
 
           case BOOL:
-            for (i = 0; i < array_options[name].size(); i++) {
+            for (i = 0; i < (int)array_options[name].size(); i++) {
               std::istringstream(array_options[name][i]) >> std::boolalpha >>
                 ((bool *)allocated)[i];
             }
@@ -1011,10 +1434,10 @@ namespace adaptyst {
             // This should have been caught in the previous "switch"
             break;
           }
-        } catch (std::invalid_argument) {
+        } catch (std::invalid_argument &) {
           throw std::runtime_error("Could not parse value of element of index " +
                                    std::to_string(i) + " of \"" + name + "\"");
-        } catch (std::out_of_range) {
+        } catch (std::out_of_range &) {
           throw std::runtime_error("Could not parse value of element of index " +
                                    std::to_string(i) + " of \"" + name + "\"");
         }
@@ -1088,11 +1511,63 @@ namespace adaptyst {
     Module::all_modules[this->id] = this;
   }
 
+  void Module::resolve_vtable() {
+    const adaptyst_module_vtable *(*get_vtable)() =
+      (const adaptyst_module_vtable *(*)())dlsym(this->handle,
+                                                 "adaptyst_module_get_vtable");
+
+    if (get_vtable) {
+      const adaptyst_module_vtable *vtable = get_vtable();
+
+      if (vtable && vtable->version == ADAPTYST_MODULE_VTABLE_VERSION) {
+        this->vtable = *vtable;
+        return;
+      } else if (vtable && vtable->version >= 1 &&
+                 vtable->version < ADAPTYST_MODULE_VTABLE_VERSION) {
+        // Older tables are prefixes of the current one
+        static const std::size_t sizes[] = {
+          offsetof(adaptyst_module_vtable, region_summary),
+          offsetof(adaptyst_module_vtable, iteration)
+        };
+
+        this->vtable = adaptyst_module_vtable{};
+        std::memcpy(&this->vtable, vtable, sizes[vtable->version - 1]);
+        this->vtable.version = ADAPTYST_MODULE_VTABLE_VERSION;
+        return;
+      }
+    }
+
+    // Either the module doesn't provide its own table or the table
+    // is of a different version, so the entry points are looked up
+    // by their names instead
+    this->vtable.version = ADAPTYST_MODULE_VTABLE_VERSION;
+    this->vtable.init = (bool (*)(amod_t))dlsym(this->handle,
+                                                "adaptyst_module_init");
+    this->vtable.process = (bool (*)(amod_t, ir))dlsym(this->handle,
+                                                       "adaptyst_module_process");
+    this->vtable.close = (void (*)(amod_t))dlsym(this->handle,
+                                                 "adaptyst_module_close");
+    this->vtable.region_start =
+      (bool (*)(amod_t, const char *, const char *, const char *))dlsym(this->handle,
+                                                                        "adaptyst_region_start");
+    this->vtable.region_end =
+      (bool (*)(amod_t, const char *, const char *, const char *))dlsym(this->handle,
+                                                                        "adaptyst_region_end");
+    this->vtable.region_summary =
+      (bool (*)(amod_t, const char *, const char *,
+                const adaptyst_region_summary *))dlsym(this->handle,
+                                                       "adaptyst_region_summary");
+    this->vtable.iteration =
+      (bool (*)(amod_t, unsigned int, bool))dlsym(this->handle,
+                                                  "adaptyst_module_iteration");
+  }
+
   bool Module::init(unsigned int buf_size) {
+    OverheadCounters::Timer timer(this->overhead, OverheadCounters::INIT_NS);
+    auto start_time = ch::steady_clock::now();
     this->initialising = true;
 
-    bool (*init_func)(amod_t) =
-      (bool (*)(amod_t))dlsym(this->handle, "adaptyst_module_init");
+    bool (*init_func)(amod_t) = this->vtable.init;
 
     if (!init_func) {
       this->throw_error("Module \"" + this->get_name() + "\" doesn't define adaptyst_module_init()! "
@@ -1115,7 +1590,39 @@ namespace adaptyst {
 
     this->fd = std::make_shared<FileDescriptor>(read_fd, write_fd, buf_size);
 
-    bool result = init_func(this->id);
+    if (Terminal::instance) {
+      for (auto &log_type : this->log_types) {
+        this->get_log_handle(log_type);
+      }
+    }
+
+    bool result;
+
+    {
+      // Nodes are initialised concurrently, but instances of the same
+      // library share its global state and can't be initialised at once
+      static std::mutex lib_mutexes_mutex;
+      static std::unordered_map<std::string, std::mutex> lib_mutexes;
+      std::mutex *lib_mutex;
+
+      {
+        std::unique_lock lock(lib_mutexes_mutex);
+        lib_mutex = &lib_mutexes[this->lib_path.string()];
+      }
+
+      std::unique_lock lock(*lib_mutex);
+      result = init_func(this->id);
+    }
+
+    unsigned long long init_time =
+      ch::duration_cast<ch::nanoseconds>(ch::steady_clock::now() - start_time).count();
+
+    if (this->dir) {
+      this->dir->set_metadata<unsigned long long>("init_time_ns", init_time);
+    }
+
+    Terminal::instance->log("Module \"" + this->get_name() + "\" has been initialised in " +
+                            std::to_string(init_time / 1000000) + " ms", this, "General");
 
     if (result) {
       this->initialised = true;
@@ -1127,10 +1634,37 @@ namespace adaptyst {
     return result;
   }
 
+  namespace {
+    /**
+       Signals that a module has finished consuming and publishing
+       records when destroyed (unless dismissed), so that modules
+       waiting for each other are never left blocked, whichever
+       way processing ends.
+    */
+    class RecordsGuard {
+    private:
+      Module *mod;
+
+    public:
+      RecordsGuard(Module *mod) {
+        this->mod = mod;
+      }
+
+      ~RecordsGuard() {
+        if (this->mod) {
+          this->mod->records_done();
+        }
+      }
+
+      void dismiss() {
+        this->mod = nullptr;
+      }
+    };
+  };
+
   void Module::process(std::shared_ptr<IR> ir_obj) {
-    bool (*process_func)(amod_t, ir) =
-      (bool (*)(amod_t, ir))dlsym(this->handle,
-                                  "adaptyst_module_process");
+    RecordsGuard guard(this);
+    bool (*process_func)(amod_t, ir) = this->vtable.process;
 
     if (!process_func) {
       this->throw_error("Module \"" + this->get_name() + "\" doesn't define adaptyst_module_process()! "
@@ -1140,13 +1674,41 @@ namespace adaptyst {
     ir ir_info = ir_obj->to_c_type();
 
     this->process_future = std::async([this, process_func, ir_info]() {
+      RecordsGuard guard(this);
+      OverheadCounters::Timer timer(this->overhead, OverheadCounters::PROCESS_NS);
       return process_func(this->id, ir_info);
     });
+
+    guard.dismiss();
+  }
+
+  /**
+     Signals that neither this module nor its upstream modules can
+     wait for each other from now on. This is done when processing
+     finishes or fails, or instead of processing if it's never started.
+  */
+  void Module::records_done() {
+    this->records.consumer_done();
+    this->node->records_done();
   }
 
   bool Module::wait() {
     bool result = this->process_future.get();
 
+    if (this->dir) {
+      this->dir->set_metadata<nlohmann::json>("overhead", this->overhead.to_json());
+
+      if (!this->channels.empty()) {
+        nlohmann::json dropped = nlohmann::json::object();
+
+        for (auto &entry : this->channels) {
+          dropped[entry.first] = entry.second->channel->get_dropped();
+        }
+
+        this->dir->set_metadata<nlohmann::json>("channel_dropped_messages", dropped);
+      }
+    }
+
     if (!result && !this->error.empty()) {
       this->throw_error(this->error);
     }
@@ -1159,15 +1721,47 @@ namespace adaptyst {
       return;
     }
 
-    void (*close)(amod_t) = (void (*)(amod_t))dlsym(this->handle,
-                                                    "adaptyst_module_close");
+    void (*close)(amod_t) = this->vtable.close;
 
     if (!close) {
       this->throw_error("Module \"" + this->get_name() + "\" doesn't define adaptyst_module_close()! "
                         "Has it been compiled correctly?");
     }
 
-    close(this->id);
+    {
+      OverheadCounters::Timer timer(this->overhead, OverheadCounters::CLOSE_NS);
+      close(this->id);
+    }
+
+    if (this->dir) {
+      this->dir->set_metadata<nlohmann::json>("overhead", this->overhead.to_json());
+    }
+  }
+
+  void Module::reset() {
+    this->error.clear();
+    this->src_code_paths.clear();
+    this->overhead.reset();
+
+    // Messages left by the previous run of the workflow are stale
+    for (auto &entry : this->channels) {
+      entry.second->channel->reset();
+    }
+  }
+
+  void Module::start_iteration(unsigned int iteration, bool warmup) {
+    bool (*iteration_func)(amod_t, unsigned int, bool) = this->vtable.iteration;
+
+    if (!iteration_func) {
+      return;
+    }
+
+    if (!iteration_func(this->id, iteration, warmup)) {
+      this->throw_error("Module \"" + this->get_name() + "\" is not ready for " +
+                        std::string(warmup ? "warm-up run " : "run ") +
+                        std::to_string(iteration + 1) +
+                        (this->error.empty() ? "" : ": " + this->error));
+    }
   }
 
   void Module::set_will_profile(bool will_profile) {
@@ -1208,6 +1802,15 @@ namespace adaptyst {
   }
 
   void Module::profile_notify() {
+    if (Telemetry::instance) {
+      Telemetry::instance->publish({
+          {"type", "module"},
+          {"entity", this->node->get_parent_name()},
+          {"node", this->get_node_name()},
+          {"module", this->get_name()},
+          {"state", "ready"}});
+    }
+
     this->node->profile_notify();
   }
 
@@ -1251,6 +1854,10 @@ namespace adaptyst {
 
   void Module::add_src_code_path(fs::path path) {
     this->src_code_paths.insert(path);
+
+    if (this->node) {
+      this->node->archive_src_code_path(path);
+    }
   }
 
   fs::path &Module::get_tmp_dir() {
@@ -1285,6 +1892,10 @@ namespace adaptyst {
     return this->node->get_cpu_mask();
   }
 
+  bool Module::is_memory_bound() {
+    return this->node->is_memory_bound();
+  }
+
   std::unordered_set<fs::path> &Module::get_src_code_paths() {
     return this->src_code_paths;
   }
@@ -1305,6 +1916,34 @@ namespace adaptyst {
     return this->fd;
   }
 
+  OverheadCounters &Module::get_overhead() {
+    return this->overhead;
+  }
+
+  int Module::get_log_handle(std::string type) {
+    std::unique_lock lock(this->log_handles_mutex);
+    auto handle = this->log_handle_ids.find(type);
+
+    if (handle != this->log_handle_ids.end()) {
+      return handle->second;
+    }
+
+    int new_handle = this->log_handles.size();
+    this->log_handles.push_back(Terminal::instance->get_log_stream(this, type));
+    this->log_handle_ids[type] = new_handle;
+    return new_handle;
+  }
+
+  LogStream *Module::get_log_stream(int handle) {
+    std::unique_lock lock(this->log_handles_mutex);
+
+    if (handle < 0 || (size_t)handle >= this->log_handles.size()) {
+      return nullptr;
+    }
+
+    return this->log_handles[handle];
+  }
+
   std::string &Module::receive_string_inject(long timeout_seconds) {
     this->last_received_message_inject = this->fd->read(timeout_seconds);
     return this->last_received_message_inject;
@@ -1328,9 +1967,15 @@ namespace adaptyst {
 
   void Module::region_switch(std::string name, std::string part_id,
                              std::string state, std::string timestamp_str) {
-    bool (*func_switch)(amod_t, const char *, const char *, const char *) =
-      (bool (*)(amod_t, const char *, const char *, const char *))dlsym(this->handle,
-                                                                        ("adaptyst_region_" + state).c_str());
+    bool (*func_switch)(amod_t, const char *, const char *, const char *);
+
+    if (state == "start") {
+      func_switch = this->vtable.region_start;
+    } else if (state == "end") {
+      func_switch = this->vtable.region_end;
+    } else {
+      return;
+    }
 
     if (!func_switch) {
       return;
@@ -1342,6 +1987,88 @@ namespace adaptyst {
     }
   }
 
+  void Module::region_summary(std::string name, std::string part_id,
+                              const adaptyst_region_summary &summary) {
+    if (!this->vtable.region_summary) {
+      return;
+    }
+
+    if (!this->vtable.region_summary(this->id, name.c_str(), part_id.c_str(),
+                                     &summary)) {
+      Terminal::instance->print(this->error, true, true, this, "General");
+    }
+  }
+
+  void Module::open_records(unsigned int capacity, unsigned int producers) {
+    this->records.open(capacity, producers);
+  }
+
+  void Module::publish_record(std::shared_ptr<Record> record) {
+    OverheadCounters::Timer timer(this->overhead, OverheadCounters::PUBLISH_WAIT_NS);
+    std::shared_ptr<const Record> to_publish = std::move(record);
+    this->node->publish_record(to_publish);
+    this->overhead.add(OverheadCounters::RECORDS_PUBLISHED);
+  }
+
+  bool Module::push_record(std::shared_ptr<const Record> &record) {
+    return this->records.push(record);
+  }
+
+  RecordQueue::Status Module::consume_record(std::shared_ptr<const Record> &record,
+                                             long timeout_seconds) {
+    RecordQueue::Status status = this->records.pop(record, timeout_seconds);
+
+    if (status == RecordQueue::RECORD) {
+      this->overhead.add(OverheadCounters::RECORDS_CONSUMED);
+    }
+
+    return status;
+  }
+
+  void Module::producer_done() {
+    this->records.producer_done();
+  }
+
+  void Module::create_channel(std::string name, unsigned int slot_size,
+                              unsigned int slot_count) {
+    if (name.empty() || name.find_first_of(" \t\n") != std::string::npos) {
+      this->throw_error("Channel name \"" + name + "\" is empty or has whitespace "
+                        "characters");
+    }
+
+    if (this->channels.contains(name)) {
+      this->throw_error("Channel \"" + name + "\" already exists");
+    }
+
+    auto channel = std::make_unique<adaptyst_channel>();
+    channel->name = name;
+    channel->channel = ShmChannel::create(name, slot_size, slot_count);
+    this->channels[name] = std::move(channel);
+  }
+
+  adaptyst_channel *Module::get_channel(std::string name) {
+    auto channel = this->channels.find(name);
+    return channel == this->channels.end() ? nullptr : channel->second.get();
+  }
+
+  unsigned long long Module::get_timestamp(bool &err) {
+    return this->node->get_timestamp(err);
+  }
+
+  RegionStats &Module::get_region_stats() {
+    return this->node->get_region_stats();
+  }
+
+  std::vector<std::pair<std::string, int> > Module::get_channel_fds() {
+    std::vector<std::pair<std::string, int> > fds;
+
+    for (auto &entry : this->channels) {
+      fds.push_back(std::make_pair(entry.first, entry.second->channel->get_fd()));
+    }
+
+    return fds;
+  }
+
   Node::Node(std::string name,
              std::shared_ptr<Entity> &entity) : Identifiable(name) {
     this->entity = entity;
@@ -1349,6 +2076,8 @@ namespace adaptyst {
   }
 
   bool Node::init(unsigned int buf_size) {
+    OverheadCounters::Timer timer(this->overhead, OverheadCounters::INIT_NS);
+
     for (auto &mod : this->modules) {
       if (!mod->init(buf_size)) {
         return false;
@@ -1372,19 +2101,50 @@ namespace adaptyst {
   }
 
   void Node::process(std::shared_ptr<IR> ir_obj) {
+    auto mod = this->modules.begin();
+
+    try {
+      for (; mod != this->modules.end(); mod++) {
+        (*mod)->process(ir_obj);
+      }
+    } catch (...) {
+      // The failed module has signalled itself, the remaining ones
+      // must not be waited for by the modules already started
+      for (mod++; mod != this->modules.end(); mod++) {
+        (*mod)->records_done();
+      }
+
+      throw;
+    }
+  }
+
+  /**
+     Signals that the modules of the node are never going to
+     process anything, so that the other nodes don't wait for them.
+  */
+  void Node::skip_process() {
     for (auto &mod : this->modules) {
-      mod->process(ir_obj);
+      mod->records_done();
     }
   }
 
   bool Node::wait() {
     bool success = true;
-    for (auto &mod : this->modules) {
-      if (!mod->wait()) {
-        success = false;
+
+    {
+      OverheadCounters::Timer timer(this->overhead, OverheadCounters::PROCESS_NS);
+
+      for (auto &mod : this->modules) {
+        if (!mod->wait()) {
+          success = false;
+        }
       }
     }
 
+    if (this->dir) {
+      this->dir->set_metadata<nlohmann::json>("overhead", this->overhead.to_json());
+    }
+
     return success;
   }
 
@@ -1429,6 +2189,11 @@ namespace adaptyst {
   void Node::add_module(std::unique_ptr<Module> &mod) {
     mod->set_parent(this);
     mod->set_node(this);
+
+    for (auto &tag : mod->get_tags()) {
+      this->tags.insert(tag);
+    }
+
     this->modules.push_back(std::move(mod));
   }
 
@@ -1436,10 +2201,32 @@ namespace adaptyst {
     return this->modules_profiling;
   }
 
+  void Node::add_dependency(std::string node) {
+    this->dependencies.push_back(node);
+  }
+
+  std::vector<std::string> &Node::get_dependencies() {
+    return this->dependencies;
+  }
+
   void Node::inc_modules_profiling() {
     this->modules_profiling++;
   }
 
+  void Node::reset() {
+    this->overhead.reset();
+
+    for (auto &mod : this->modules) {
+      mod->reset();
+    }
+  }
+
+  void Node::start_iteration(unsigned int iteration, bool warmup) {
+    for (auto &mod : this->modules) {
+      mod->start_iteration(iteration, warmup);
+    }
+  }
+
   void Node::set_dir(fs::path path) {
     this->dir = std::make_unique<Path>(path);
 
@@ -1464,6 +2251,10 @@ namespace adaptyst {
     return this->entity->get_cpu_mask();
   }
 
+  bool Node::is_memory_bound() {
+    return this->entity->is_memory_bound();
+  }
+
   fs::path &Node::get_tmp_dir() {
     return this->entity->get_tmp_dir();
   }
@@ -1484,6 +2275,10 @@ namespace adaptyst {
     return paths;
   }
 
+  void Node::archive_src_code_path(fs::path path) {
+    this->entity->archive_src_code_path(path);
+  }
+
   std::vector<std::string> Node::get_log_types() {
     return {};
   }
@@ -1508,7 +2303,8 @@ namespace adaptyst {
         module->get_id(),
         {read_fd.first, read_fd.second},
         {write_fd.first, write_fd.second},
-        module->get_inject_lib_path()
+        module->get_inject_lib_path(),
+        module->get_channel_fds()
       };
 
       paths.push_back(path);
@@ -1540,11 +2336,108 @@ namespace adaptyst {
     }
   }
 
+  void Node::region_summary(std::string name, std::string part_id,
+                            const adaptyst_region_summary &summary) {
+    for (auto &mod : this->modules) {
+      mod->region_summary(name, part_id, summary);
+    }
+  }
+
+  void Node::add_outgoing(NodeConnection *connection) {
+    this->outgoing.push_back(connection);
+    this->add_out_tags(connection->get_arrival_node()->get_tags());
+
+    // Records go to every arrival node once, even if there are
+    // several edges to it
+    Node *arrival_node = connection->get_arrival_node().get();
+
+    if (std::find(this->arrival_nodes.begin(), this->arrival_nodes.end(),
+                  arrival_node) == this->arrival_nodes.end()) {
+      this->arrival_nodes.push_back(arrival_node);
+    }
+  }
+
+  void Node::add_incoming(NodeConnection *connection) {
+    this->incoming.push_back(connection);
+    this->add_in_tags(connection->get_departure_node()->get_tags());
+
+    Node *departure_node = connection->get_departure_node().get();
+
+    if (std::find(this->departure_nodes.begin(), this->departure_nodes.end(),
+                  departure_node) == this->departure_nodes.end()) {
+      this->departure_nodes.push_back(departure_node);
+    }
+  }
+
+  void Node::open_records() {
+    // Every module of a departure node of an incoming edge is
+    // a producer for every module of this node
+    unsigned int producers = 0;
+    unsigned int capacity = 0;
+
+    for (auto departure_node : this->departure_nodes) {
+      producers += departure_node->modules.size();
+    }
+
+    for (auto connection : this->incoming) {
+      capacity = std::max(capacity, connection->get_queue_capacity());
+    }
+
+    if (capacity == 0) {
+      capacity = DATAFLOW_DEFAULT_QUEUE_CAPACITY;
+    }
+
+    for (auto &mod : this->modules) {
+      mod->open_records(capacity, producers);
+    }
+  }
+
+  void Node::publish_record(std::shared_ptr<const Record> &record) {
+    for (auto arrival_node : this->arrival_nodes) {
+      for (auto &mod : arrival_node->modules) {
+        if (mod->get_tags().contains(record->tag)) {
+          mod->push_record(record);
+        }
+      }
+    }
+  }
+
+  unsigned long long Node::get_timestamp(bool &err) {
+    return this->entity->get_timestamp(err);
+  }
+
+  RegionStats &Node::get_region_stats() {
+    return this->entity->get_region_stats();
+  }
+
+  nlohmann::json Node::get_module_overhead() {
+    nlohmann::json result = nlohmann::json::object();
+
+    for (auto &mod : this->modules) {
+      result[mod->get_name()] = mod->get_overhead().to_json();
+    }
+
+    return result;
+  }
+
+  void Node::records_done() {
+    for (auto arrival_node : this->arrival_nodes) {
+      for (auto &mod : arrival_node->modules) {
+        mod->producer_done();
+      }
+    }
+  }
+
   NodeConnection::NodeConnection(std::string id,
                                  std::shared_ptr<Node> &departure_node,
-                                 std::shared_ptr<Node> &arrival_node) : Identifiable(id) {
+                                 std::shared_ptr<Node> &arrival_node,
+                                 unsigned int queue_capacity) : Identifiable(id) {
     this->departure_node = departure_node;
     this->arrival_node = arrival_node;
+    this->queue_capacity = queue_capacity;
+
+    departure_node->add_outgoing(this);
+    arrival_node->add_incoming(this);
   }
 
   std::shared_ptr<Node> &NodeConnection::get_departure_node() {
@@ -1555,6 +2448,10 @@ namespace adaptyst {
     return this->arrival_node;
   }
 
+  unsigned int NodeConnection::get_queue_capacity() {
+    return this->queue_capacity;
+  }
+
   std::vector<std::string> NodeConnection::get_log_types() {
     return {};
   }
@@ -1563,6 +2460,57 @@ namespace adaptyst {
     return "Connection";
   }
 
+  StartBarrier::StartBarrier() {
+    this->participants = 0;
+  }
+
+  void StartBarrier::add_participant() {
+    std::unique_lock lock(this->mutex);
+    this->participants++;
+  }
+
+  void StartBarrier::arrive(Entity *entity, std::function<void()> release,
+                            std::function<void()> announce) {
+    std::unique_lock lock(this->mutex);
+
+    if (this->finished.contains(entity)) {
+      return;
+    }
+
+    this->finished.insert(entity);
+    this->waiting.push_back(std::make_pair(release, announce));
+    this->release_if_complete();
+  }
+
+  void StartBarrier::withdraw(Entity *entity) {
+    std::unique_lock lock(this->mutex);
+
+    if (this->finished.contains(entity)) {
+      return;
+    }
+
+    this->finished.insert(entity);
+    this->release_if_complete();
+  }
+
+  void StartBarrier::release_if_complete() {
+    if (this->finished.size() < this->participants) {
+      return;
+    }
+
+    // All workflows are released first and only then is anything
+    // printed so that the release instants are as close as possible.
+    for (auto &callbacks : this->waiting) {
+      callbacks.first();
+    }
+
+    for (auto &callbacks : this->waiting) {
+      callbacks.second();
+    }
+
+    this->waiting.clear();
+  }
+
   Entity::Entity(std::string id, AccessMode access_mode,
                  unsigned int processing_threads,
                  fs::path local_config_path,
@@ -1585,6 +2533,21 @@ namespace adaptyst {
     this->process_finished = false;
     this->workflow_start_time = 0;
     this->workflow_start_time_set = false;
+    this->region_ring_size = 0;
+    this->region_drain_stop = false;
+    this->tsc_clock_enabled = false;
+    this->tsc_recalibration_stop = false;
+    this->general_log = nullptr;
+    this->remote_port = 0;
+    this->telemetry_source = 0;
+    this->telemetry_source_set = false;
+  }
+
+  Entity::~Entity() {
+    // The counters source refers to the entity
+    if (this->telemetry_source_set && Telemetry::instance) {
+      Telemetry::instance->remove_source(this->telemetry_source);
+    }
   }
 
   void Entity::add_node(std::shared_ptr<Node> &node) {
@@ -1594,14 +2557,16 @@ namespace adaptyst {
 
   void Entity::add_connection(std::string id,
                               std::string departure_node,
-                              std::string arrival_node) {
+                              std::string arrival_node,
+                              unsigned int queue_capacity) {
     if (this->connections.find(id) != this->connections.end()) {
       this->throw_error("A connection with ID \"" + id + "\" already exists!");
     }
 
     this->connections[id] =
       std::make_shared<NodeConnection>(id, this->get_node(departure_node),
-                                   this->get_node(arrival_node));
+                                       this->get_node(arrival_node),
+                                       queue_capacity);
   }
 
   std::shared_ptr<Node> &Entity::get_node(std::string id) {
@@ -1629,16 +2594,277 @@ namespace adaptyst {
   }
 
   void Entity::init() {
-    for (auto entry : this->nodes) {
-      entry.second->init(this->buf_size);
+    if (this->is_remote()) {
+      Terminal::instance->print("Connecting to the remote agent of entity " +
+                                this->get_name() + " at " + this->remote_address +
+                                ":" + std::to_string(this->remote_port) + "...",
+                                false, false);
+
+      try {
+        this->remote = std::make_unique<RemoteController>(this->remote_address,
+                                                          this->remote_port,
+                                                          this->buf_size,
+                                                          get_remote_token(this->remote_token_file));
+      } catch (std::exception &e) {
+        this->throw_error("Could not connect to the remote agent at " +
+                          this->remote_address + ":" +
+                          std::to_string(this->remote_port) + ": " +
+                          std::string(e.what()));
+      }
+
+      return;
+    }
+
+    if (this->tsc_clock_enabled && !this->tsc_clock) {
+      // Modules may obtain timestamps already when they are initialised
+      try {
+        this->tsc_clock = TscClock::create();
+
+        Terminal::instance->log("TSC clock has been calibrated at " +
+                                std::to_string((unsigned long long)this->tsc_clock->get_frequency()) +
+                                " Hz", this, "General");
+      } catch (std::exception &e) {
+        Terminal::instance->print("Note that the TSC clock can't be used in entity " +
+                                  this->get_name() + ", CLOCK_MONOTONIC will be used "
+                                  "instead: " + std::string(e.what()), true, false);
+      }
+    }
+
+    // A node is initialised only after the nodes it depends on, i.e.
+    // the ones declared in its "depends_on" and the departure nodes of
+    // edges arriving at it. All other nodes are initialised concurrently.
+    std::unordered_map<std::string, std::unordered_set<std::string> > dependencies;
+    std::unordered_map<std::string, std::vector<std::string> > dependents;
+
+    for (auto &entry : this->nodes) {
+      dependencies[entry.first];
+
+      for (auto &dependency : entry.second->get_dependencies()) {
+        this->get_node(dependency);
+
+        if (dependency == entry.first) {
+          this->throw_error("Node \"" + entry.first + "\" cannot depend on itself!");
+        }
+
+        dependencies[entry.first].insert(dependency);
+      }
+    }
+
+    for (auto &entry : this->connections) {
+      std::string from = entry.second->get_departure_node()->get_name();
+      std::string to = entry.second->get_arrival_node()->get_name();
+
+      if (from != to) {
+        dependencies[to].insert(from);
+      }
+    }
+
+    std::unordered_map<std::string, unsigned int> unresolved;
+    std::vector<std::string> order;
+
+    for (auto &entry : dependencies) {
+      unresolved[entry.first] = entry.second.size();
+
+      for (auto &dependency : entry.second) {
+        dependents[dependency].push_back(entry.first);
+      }
+
+      if (entry.second.empty()) {
+        order.push_back(entry.first);
+      }
+    }
+
+    for (size_t i = 0; i < order.size(); i++) {
+      for (auto &dependent : dependents[order[i]]) {
+        if (--unresolved[dependent] == 0) {
+          order.push_back(dependent);
+        }
+      }
+    }
+
+    if (order.size() < this->nodes.size()) {
+      // Nodes in cycles are initialised one after another once
+      // everything else is done, as before
+      std::vector<std::string> in_cycles;
+
+      for (auto &entry : unresolved) {
+        if (entry.second > 0) {
+          in_cycles.push_back(entry.first);
+        }
+      }
+
+      Terminal::instance->print("Dependencies between some nodes of entity " +
+                                this->get_name() + " form a cycle, so these nodes "
+                                "will be initialised sequentially.", true, false);
+
+      for (size_t i = 0; i < in_cycles.size(); i++) {
+        dependencies[in_cycles[i]] = i == 0 ?
+          std::unordered_set<std::string>(order.begin(), order.end()) :
+          std::unordered_set<std::string>({in_cycles[i - 1]});
+        order.push_back(in_cycles[i]);
+      }
+    }
+
+    auto start_time = ch::steady_clock::now();
+    std::unordered_map<std::string, std::shared_future<void> > futures;
+
+    for (auto &name : order) {
+      std::vector<std::shared_future<void> > to_wait;
+
+      for (auto &dependency : dependencies[name]) {
+        to_wait.push_back(futures[dependency]);
+      }
+
+      std::shared_ptr<Node> node = this->nodes[name];
+      unsigned int buf_size = this->buf_size;
+
+      futures[name] = std::async(std::launch::async, [node, to_wait, buf_size]() {
+        // This rethrows the exception of a failed dependency
+        for (auto &future : to_wait) {
+          future.get();
+        }
+
+        node->init(buf_size);
+      }).share();
+    }
+
+    std::exception_ptr node_exception;
+
+    for (auto &name : order) {
+      try {
+        futures[name].get();
+      } catch (...) {
+        if (!node_exception) {
+          node_exception = std::current_exception();
+        }
+      }
+    }
 
+    if (node_exception) {
+      std::rethrow_exception(node_exception);
+    }
+
+    unsigned long long init_time =
+      ch::duration_cast<ch::nanoseconds>(ch::steady_clock::now() - start_time).count();
+    this->entity_dir->set_metadata<unsigned long long>("init_time_ns", init_time);
+
+    Terminal::instance->log("All nodes have been initialised in " +
+                            std::to_string(init_time / 1000000) + " ms", this, "General");
+
+    for (auto entry : this->nodes) {
       this->modules_profiling += entry.second->get_modules_profiling();
     }
   }
 
+  bool Entity::is_remote() {
+    return this->access_mode == REMOTE || this->access_mode == CUSTOM_REMOTE;
+  }
+
+  void Entity::set_remote(std::string address, unsigned short port,
+                          fs::path def_file, fs::path token_file) {
+    this->remote_address = address;
+    this->remote_port = port;
+    this->remote_def_file = def_file;
+    this->remote_token_file = token_file;
+  }
+
+  bool Entity::will_run_workflow() {
+    // Remote entities are run by their agents, so the modules
+    // profiling them are not known here
+    return this->modules_profiling > 0 && this->access_mode != CUSTOM &&
+      this->access_mode != CUSTOM_REMOTE;
+  }
+
+  void Entity::set_start_barrier(std::shared_ptr<StartBarrier> barrier) {
+    this->start_barrier = barrier;
+  }
+
+  void Entity::set_src_compression(ArchiveCompression compression) {
+    this->src_compression = compression;
+  }
+
+  void Entity::archive_src_code_path(fs::path path) {
+    OverheadCounters::Timer timer(this->overhead, OverheadCounters::SRC_ARCHIVE_NS);
+    std::unique_lock lock(this->src_archiver_mutex);
+
+    if (this->src_archiver) {
+      this->src_archiver->add_path(path);
+      this->overhead.add(OverheadCounters::SRC_ARCHIVE_PATHS);
+    }
+  }
+
+  void Entity::process_remote() {
+    this->remote->send_definition(this->remote_def_file, this->get_name());
+    this->remote->send_ir(this->ir_obj->to_c_type());
+    this->remote->send_src_compression(this->src_compression);
+
+    unsigned long long rtt;
+    long long offset = this->remote->sync_clock(rtt);
+
+    this->entity_dir->set_metadata<long long>("remote_clock_offset_ns", offset);
+    this->entity_dir->set_metadata<unsigned long long>("remote_clock_rtt_ns", rtt);
+
+    Terminal::instance->print("Running performance analysis in remote entity " +
+                              this->get_name() + "...", true, false);
+
+    // Logs of the agent go to their own directory so that they never
+    // overwrite the local ones
+    ResultReceiver receiver;
+    receiver.add_root("system", this->entity_dir->get_path_name());
+    receiver.add_root("log", fs::path(Terminal::instance->get_log_dir()) /
+                      ("remote_" + this->get_name()));
+
+    try {
+      this->remote->run(receiver);
+    } catch (std::exception &e) {
+      this->throw_error("Performance analysis in the remote agent has failed: " +
+                        std::string(e.what()));
+    }
+
+    // The offset may drift during long analyses, so it is measured
+    // again at the end
+    offset = this->remote->sync_clock(rtt);
+    this->entity_dir->set_metadata<long long>("remote_clock_offset_end_ns", offset);
+
+    Terminal::instance->print("Results from remote entity " + this->get_name() +
+                              " have been received.", true, false);
+
+    MetadataCache::instance().sync();
+  }
+
   void Entity::process(bool save_src_code_paths) {
-    if (this->modules_profiling > 0 && this->access_mode != CUSTOM &&
-        this->access_mode != CUSTOM_REMOTE) {
+    if (this->is_remote()) {
+      this->process_remote();
+      return;
+    }
+
+    if (save_src_code_paths) {
+      // Paths reported while the workflow runs are archived straight away
+      std::unique_lock lock(this->src_archiver_mutex);
+      this->src_archiver =
+        std::make_unique<SourceArchiver>(fs::path(this->entity_dir->get_path_name()) / "src",
+                                         this->src_compression);
+    }
+
+    if (Telemetry::instance) {
+      this->telemetry_source = Telemetry::instance->add_source([this]() {
+        nlohmann::json modules = nlohmann::json::object();
+
+        for (auto &entry : this->nodes) {
+          modules[entry.first] = entry.second->get_module_overhead();
+        }
+
+        return nlohmann::json({
+            {"type", "counters"},
+            {"entity", this->get_name()},
+            {"overhead", this->overhead.to_json()},
+            {"modules", modules}});
+      });
+
+      this->telemetry_source_set = true;
+    }
+
+    if (this->will_run_workflow()) {
       ir_obj->compile();
 
       fs::path stdout_path =
@@ -1679,9 +2905,30 @@ namespace adaptyst {
         }
       }
 
+      const char *cpu_mask = this->get_cpu_mask();
+      CPUConfig cpu_config(cpu_mask ? cpu_mask : "");
+
+      if (this->cpu_policy.bind_memory) {
+        cpu_config.bind_memory();
+      }
+
       this->profiling_info.type = LINUX_PROCESS;
       this->profiling_info.data.pid = this->profiled_process->start(
-          true, CPUConfig(this->get_cpu_mask()), false);
+          true, cpu_config, false);
+
+      if (!this->cgroup_policy.parent.empty()) {
+        // The workflow waits for the notification before executing
+        // anything, so nothing of it runs outside its cgroup
+        try {
+          this->cgroup_isolation = std::make_unique<CgroupIsolation>(this->cgroup_policy,
+                                                                     this->get_name(),
+                                                                     cpu_config);
+          this->cgroup_isolation->add_workflow(this->profiling_info.data.pid);
+        } catch (std::exception &e) {
+          this->throw_error("Could not isolate the workflow with cgroups: " +
+                            std::string(e.what()));
+        }
+      }
 
       this->workflow_comm = std::async([this, read_fd1, read_fd2, write_fd1, write_fd2,
                                         module_inject_paths]() {
@@ -1689,24 +2936,38 @@ namespace adaptyst {
         int write_fd[2] = {write_fd1, write_fd2};
 
         FileDescriptor fd(read_fd, write_fd, this->buf_size);
-        std::string msg;
+        EventLoop loop;
 
-        auto get_msg = [this, &fd](std::string &msg) {
-          try {
-            msg = fd.read(1);
-            return !msg.empty();
-          } catch (TimeoutException) {
-            msg = "";
-            return this->is_workflow_running();
-          }
-        };
+        auto handle_msg = [this, &fd, &module_inject_paths](std::string msg) {
+          OverheadCounters::Timer timer(this->overhead, OverheadCounters::WORKFLOW_MESSAGE_NS);
+          this->overhead.add(OverheadCounters::WORKFLOW_MESSAGES);
+
+          if (msg == "init" || msg == "init ring") {
+            if (msg == "init ring" && this->region_ring_size > 0) {
+              fd.write("ack ring " + std::to_string(this->region_ring_size), true);
+            } else {
+              fd.write("ack", true);
+            }
+
+            if (this->tsc_clock) {
+              fd.write("clock " + std::to_string(this->tsc_clock->get_fd()), true);
+            }
+
+            for (auto &entry : this->region_policies) {
+              fd.write("policy " + std::to_string(entry.second.sample_every) + " " +
+                       std::to_string(entry.second.min_duration_ns) + " " +
+                       (entry.second.aggregate ? "1 " : "0 ") +
+                       std::to_string(entry.second.flush_interval_ms) + " " +
+                       entry.first, true);
+            }
 
-        while (get_msg(msg)) {
-          if (msg.empty()) {
-            continue;
-          } else if (msg == "init") {
-            fd.write("ack", true);
             for (auto &path : module_inject_paths) {
+              // "channel <module ID> <file descriptor> <channel name>"
+              for (auto &channel : path.channels) {
+                fd.write("channel " + std::to_string(path.id) + " " +
+                         std::to_string(channel.second) + " " + channel.first, true);
+              }
+
               fd.write(path.name + " " + std::to_string(path.id) + " " +
                        std::to_string(path.read_fd[0]) + " " +
                        std::to_string(path.read_fd[1]) + " " +
@@ -1715,79 +2976,403 @@ namespace adaptyst {
                        path.path, true);
             }
             fd.write("<STOP>", true);
-          } else {
-            std::smatch match;
+          } else if (msg.starts_with("ring ")) {
+            // "ring <workflow part ID> <shared memory name>"
+            std::string::size_type sep = msg.find(' ', 5);
 
-            if (std::regex_match(msg, match, std::regex("^(start|end) (.+) (-?\\d+) (.+)$"))) {
-              Terminal::instance->log("Region \"" + match[4].str() +
-                                      "\", workflow part ID " + match[2].str() + ": " +
-                                      match[1].str() + " at " + match[3].str() + " ns",
-                                      this, "General");
+            try {
+              if (sep == std::string::npos) {
+                throw std::runtime_error("No shared memory name");
+              }
+
+              std::string part_id = msg.substr(5, sep - 5);
+              std::unique_ptr<RegionRing> ring = RegionRing::open(msg.substr(sep + 1));
 
-              std::string timestamp_str = match[3].str();
+              {
+                std::unique_lock lock(this->region_rings_mutex);
+                this->region_rings.push_back(std::make_pair(part_id, std::move(ring)));
+              }
 
-              for (auto &entry : this->nodes) {
-                entry.second->region_switch(match[4].str(), match[2].str(), match[1].str(),
-                                            timestamp_str);
+              Terminal::instance->log("Region ring for workflow part ID " + part_id +
+                                      " has been registered", this, "General");
+              fd.write("ack", true);
+            } catch (std::exception &e) {
+              Terminal::instance->print("Could not register region ring, the pipe will be "
+                                        "used instead: " + std::string(e.what()),
+                                        true, true, this, "General");
+              fd.write("invalid", true);
+            }
+          } else if (msg.starts_with("overhead ")) {
+            // "overhead <region switches> <wait time in ns>", sent by
+            // the injection library when it is closed and not answered
+            std::stringstream stream(msg.substr(9));
+            unsigned long long switches, wait_ns;
+
+            if (stream >> switches >> wait_ns) {
+              this->overhead.add(OverheadCounters::INJECT_REGION_SWITCHES, switches);
+              this->overhead.add(OverheadCounters::INJECT_WAIT_NS, wait_ns);
+            }
+          } else if (msg.starts_with("summary ")) {
+            // "summary <workflow part ID> <count> <total ns> <min ns> <max ns>
+            // <comma-separated histogram> <region name>"
+            std::stringstream stream(msg.substr(8));
+            std::string part_id, histogram;
+            adaptyst_region_summary summary{};
+            bool valid = (bool)(stream >> part_id >> summary.count >> summary.total_ns >>
+                                summary.min_ns >> summary.max_ns >> histogram);
+
+            if (valid) {
+              std::stringstream histogram_stream(histogram);
+              std::string bucket;
+              int index = 0;
+
+              while (valid && std::getline(histogram_stream, bucket, ',')) {
+                if (index >= ADAPTYST_REGION_HISTOGRAM_BUCKETS) {
+                  valid = false;
+                } else {
+                  try {
+                    summary.histogram[index++] = std::stoull(bucket);
+                  } catch (std::exception &e) {
+                    valid = false;
+                  }
+                }
               }
+            }
+
+            std::string name;
+
+            if (valid && stream.get() == ' ' && std::getline(stream, name) &&
+                !name.empty()) {
+              this->region_summary(name, part_id, summary);
+              fd.write("ack", true);
+            } else {
+              fd.write("invalid", true);
+            }
+          } else {
+            std::smatch match;
+            bool matched;
+
+            {
+              OverheadCounters::Timer regex_timer(this->overhead,
+                                                  OverheadCounters::REGION_REGEX_NS);
+              matched = std::regex_match(msg, match,
+                                         std::regex("^(start|end) (.+) (-?\\d+) (.+)$"));
+            }
 
+            if (matched) {
+              this->region_switch(match[4].str(), match[2].str(), match[1].str(),
+                                  match[3].str());
               fd.write("ack", true);
             } else {
               fd.write("invalid", true);
             }
           }
+        };
+
+        // Returns false if the workflow has closed its end of the pipe
+        auto handle_available = [&fd, &handle_msg](long timeout_seconds) {
+          if (fd.fill(timeout_seconds) == 0) {
+            return false;
+          }
+
+          std::string_view msg;
+
+          while (fd.next_view(msg)) {
+            handle_msg(std::string(msg));
+          }
+
+          return true;
+        };
+
+        loop.add(read_fd1, [&loop, &handle_available]() {
+          if (!handle_available(NO_TIMEOUT)) {
+            loop.stop();
+            return false;
+          }
+
+          return true;
+        });
+
+        auto finish = [&loop, &handle_available]() {
+          // Messages sent just before the workflow exit must not be lost
+          try {
+            while (handle_available(0)) { }
+          } catch (TimeoutException &) { }
+
+          loop.stop();
+        };
+
+        if (loop.add_process(this->profiling_info.data.pid, finish)) {
+          loop.run();
+        } else {
+          // pidfds are not supported, the workflow exit needs to be
+          // checked periodically instead
+          loop.run(1000, [this, &finish]() {
+            if (!this->is_workflow_running()) {
+              finish();
+            }
+          });
         }
       });
 
+      if (this->tsc_clock) {
+        {
+          std::unique_lock lock(this->tsc_calibrations_mutex);
+          this->tsc_calibrations.clear();
+          this->tsc_calibrations.push_back(this->tsc_clock->get_calibration());
+        }
+
+        this->tsc_recalibration_stop = false;
+        this->tsc_recalibration = std::async(std::launch::async, [this]() {
+          auto last = ch::steady_clock::now();
+
+          while (!this->tsc_recalibration_stop) {
+            std::this_thread::sleep_for(ch::milliseconds(TSC_CLOCK_POLL_INTERVAL_MS));
+
+            if (ch::steady_clock::now() - last <
+                ch::milliseconds(TSC_CLOCK_RECALIBRATION_INTERVAL_MS)) {
+              continue;
+            }
+
+            TscCalibration calibration = this->tsc_clock->recalibrate();
+            last = ch::steady_clock::now();
+
+            std::unique_lock lock(this->tsc_calibrations_mutex);
+            this->tsc_calibrations.push_back(calibration);
+          }
+        });
+      }
+
+      if (this->region_ring_size > 0) {
+        this->region_drain = std::async(std::launch::async, [this]() {
+          while (!this->region_drain_stop) {
+            bool drained;
+
+            {
+              OverheadCounters::Timer timer(this->overhead,
+                                            OverheadCounters::REGION_RING_DRAIN_NS);
+              drained = this->drain_region_rings();
+            }
+
+            if (!drained) {
+              std::this_thread::sleep_for(ch::microseconds(REGION_RING_DRAIN_INTERVAL_US));
+            }
+          }
+
+          while (this->drain_region_rings()) { }
+        });
+      }
+
       Terminal::instance->print("Workflow is ready to run in entity " + this->get_name() + ". "
                                 "It will be started when modules indicate that they are ready to "
                                 "start performance analysis.", true, false);
+
+      if (Telemetry::instance) {
+        Telemetry::instance->publish({
+            {"type", "workflow"},
+            {"entity", this->get_name()},
+            {"state", "ready"}});
+      }
     }
 
+    // All queues must be ready before any module starts publishing
     for (auto entry : this->nodes) {
-      entry.second->process(this->ir_obj);
+      entry.second->open_records();
+    }
+
+    auto node = this->nodes.begin();
+
+    try {
+      for (; node != this->nodes.end(); node++) {
+        node->second->process(this->ir_obj);
+      }
+    } catch (...) {
+      for (node++; node != this->nodes.end(); node++) {
+        node->second->skip_process();
+      }
+
+      throw;
     }
 
     int exit_code = this->profile_wait();
     this->entity_dir->set_metadata<int>("exit_code", exit_code);
 
+    if (this->workflow_comm.valid()) {
+      // This returns straight away after the workflow exit as the
+      // communication loop watches the workflow process
+      this->workflow_comm.get();
+    }
+
+    if (this->cgroup_isolation) {
+      this->entity_dir->set_metadata<nlohmann::json>("cgroup",
+                                                     this->cgroup_isolation->get_stats());
+      this->cgroup_isolation.reset();
+    }
+
+    if (this->region_drain.valid()) {
+      this->region_drain_stop = true;
+      this->region_drain.get();
+    }
+
+    if (!this->region_stats.empty()) {
+      File stats_file(*this->entity_dir, "region_stats", ".json");
+      stats_file.get_ostream() << this->region_stats.to_json().dump();
+    }
+
+    if (this->tsc_recalibration.valid()) {
+      this->tsc_recalibration_stop = true;
+      this->tsc_recalibration.get();
+
+      // Raw counter values can be converted to nanoseconds with
+      // the calibration valid at the time, i.e. the last one with
+      // base_ticks not larger than the value
+      nlohmann::json calibrations = nlohmann::json::array();
+
+      for (auto &calibration : this->tsc_calibrations) {
+        calibrations.push_back({{"base_ticks", calibration.base_ticks},
+                                {"base_ns", calibration.base_ns},
+                                {"mult", calibration.mult},
+                                {"shift", calibration.shift}});
+      }
+
+      this->entity_dir->set_metadata<nlohmann::json>("tsc_clock", {
+          {"frequency_hz", this->tsc_clock->get_frequency()},
+          {"calibrations", calibrations}});
+    }
+
     for (auto entry : this->nodes) {
       entry.second->wait();
     }
 
     if (save_src_code_paths) {
-      Archive archive(fs::path(this->entity_dir->get_path_name()) / "src.zip");
-      nlohmann::json src_mapping = nlohmann::json::object();
+      std::unique_ptr<SourceArchiver> archiver;
+
+      {
+        std::unique_lock lock(this->src_archiver_mutex);
+        archiver = std::move(this->src_archiver);
+      }
+
+      OverheadCounters::Timer timer(this->overhead, OverheadCounters::SRC_ARCHIVE_NS);
 
       for (auto &node_elem : this->nodes) {
         for (auto &path : node_elem.second->get_src_code_paths()) {
-          if (!src_mapping.contains(path.string()) && fs::exists(path)) {
-            std::string filename =
-              std::to_string(src_mapping.size()) + path.extension().string();
-            src_mapping[path.string()] = filename;
-            archive.add_file(filename, path);
-          }
-
+          archiver->add_path(path);
           this->src_code_paths.insert(path);
+          this->overhead.add(OverheadCounters::SRC_ARCHIVE_PATHS);
         }
       }
 
-      std::string src_mapping_str = nlohmann::to_string(src_mapping) + '\n';
-      std::stringstream s;
-      s << src_mapping_str;
-      archive.add_file_stream("index.json", s, src_mapping_str.length());
-      archive.close();
+      archiver->close();
 
       this->src_code_paths_collected = true;
     }
+
+    this->entity_dir->set_metadata<nlohmann::json>("overhead", this->overhead.to_json());
+    MetadataCache::instance().sync();
+
+    if (this->telemetry_source_set && Telemetry::instance) {
+      Telemetry::instance->remove_source(this->telemetry_source);
+      this->telemetry_source_set = false;
+    }
+  }
+
+  bool Entity::drain_region_rings() {
+    std::unique_lock lock(this->region_rings_mutex);
+    bool drained = false;
+    RegionRecord record;
+
+    for (auto &ring : this->region_rings) {
+      for (int i = 0; i < REGION_RING_BATCH_SIZE && ring.second->pop(record); i++) {
+        this->region_switch(std::string(record.name,
+                                        std::min<unsigned short>(record.name_len,
+                                                                 REGION_RING_NAME_SIZE - 1)),
+                            ring.first,
+                            record.end ? "end" : "start",
+                            record.timestamp_valid ? std::to_string(record.timestamp) : "-1");
+        this->overhead.add(OverheadCounters::REGION_RING_RECORDS);
+        drained = true;
+      }
+    }
+
+    return drained;
   }
 
   void Entity::close() {
+    if (this->remote) {
+      this->remote->close();
+      this->remote.reset();
+    }
+
     for (auto entry : this->nodes) {
       entry.second->close();
     }
   }
 
+  void Entity::reset(fs::path entity_dir) {
+    // Everything set up by init() (e.g. the modules and the CPU mask)
+    // is kept, only the state of the last run is cleared
+    this->profiled_process.reset();
+    this->src_code_paths.clear();
+    this->src_code_paths_collected = false;
+    this->workflow_finish_printed = false;
+    this->modules_notified = 0;
+    this->workflow_timestamp = 0;
+    this->workflow_timestamp_error = false;
+    this->workflow_end_timestamp = 0;
+    this->workflow_end_timestamp_error = false;
+    this->process_notified = false;
+    this->process_finished = false;
+    this->process_exit_code = 0;
+    this->workflow_start_time = 0;
+    this->workflow_start_time_set = false;
+    this->region_drain_stop = false;
+    this->start_barrier.reset();
+    this->overhead.reset();
+    this->region_stats.reset();
+
+    {
+      std::unique_lock lock(this->region_rings_mutex);
+      this->region_rings.clear();
+    }
+
+    for (auto &node : this->nodes) {
+      node.second->reset();
+    }
+
+    this->set_entity_dir(entity_dir);
+  }
+
+  void Entity::start_iteration(fs::path iteration_dir, unsigned int iteration,
+                               bool warmup) {
+    this->reset(iteration_dir);
+
+    // Remote agents set up their modules for every run anyway
+    if (this->is_remote()) {
+      return;
+    }
+
+    for (auto &node : this->nodes) {
+      node.second->start_iteration(iteration, warmup);
+    }
+  }
+
+  nlohmann::json Entity::get_run_info() {
+    nlohmann::json info = nlohmann::json::object();
+
+    if (!this->profiled_process || !this->process_finished) {
+      return info;
+    }
+
+    info["exit_code"] = this->process_exit_code;
+
+    if (this->process_notified && !this->workflow_timestamp_error &&
+        !this->workflow_end_timestamp_error) {
+      info["wall_time_ns"] = this->workflow_end_timestamp - this->workflow_timestamp;
+    }
+
+    return info;
+  }
+
   void Entity::set_entity_dir(fs::path &entity_dir) {
     this->entity_dir = std::make_unique<Path>(entity_dir);
 
@@ -1804,37 +3389,49 @@ namespace adaptyst {
       this->modules_notified++;
 
       if (this->modules_notified == this->modules_profiling) {
-        this->profiled_process->notify();
-        this->process_notified = true;
-
-        struct timespec ts;
-
-        if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
-          this->workflow_timestamp = 0;
-          this->workflow_timestamp_error = true;
+        if (this->start_barrier) {
+          this->start_barrier->arrive(this,
+                                      [this]() { this->start_workflow(); },
+                                      [this]() { this->announce_workflow_start(); });
         } else {
-          this->workflow_timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-          this->workflow_timestamp_error = false;
+          this->start_workflow();
+          this->announce_workflow_start();
         }
+      }
+    }
+  }
 
-        this->workflow_start_time =
-            ch::duration_cast<ch::milliseconds>(
-                ch::system_clock::now().time_since_epoch())
-                .count();
-        this->workflow_start_time_set = true;
+  void Entity::start_workflow() {
+    this->profiled_process->notify();
+    this->process_notified = true;
+    this->workflow_timestamp = this->get_timestamp(this->workflow_timestamp_error);
 
-        Terminal::instance->print(
-            "Workflow has been started in entity " + this->get_name() +
-                ". "
-                "You can check its stdout and stderr in real time by looking "
-                "at:\n" +
-                this->workflow_stdout_path.string() + "\n" +
-                this->workflow_stderr_path.string(),
-            true, false);
-      }
+    this->workflow_start_time =
+        ch::duration_cast<ch::milliseconds>(
+            ch::system_clock::now().time_since_epoch())
+            .count();
+    this->workflow_start_time_set = true;
+
+    if (Telemetry::instance) {
+      Telemetry::instance->publish({
+          {"type", "workflow"},
+          {"entity", this->get_name()},
+          {"state", "started"},
+          {"time", this->workflow_start_time}});
     }
   }
 
+  void Entity::announce_workflow_start() {
+    Terminal::instance->print(
+        "Workflow has been started in entity " + this->get_name() +
+            ". "
+            "You can check its stdout and stderr in real time by looking "
+            "at:\n" +
+            this->workflow_stdout_path.string() + "\n" +
+            this->workflow_stderr_path.string(),
+        true, false);
+  }
+
   int Entity::profile_wait() {
     if (this->profiled_process) {
       std::unique_lock lock(this->profile_wait_mutex);
@@ -1846,19 +3443,19 @@ namespace adaptyst {
       int result = this->profiled_process->join();
       this->process_exit_code = result;
       this->process_finished = true;
+      this->workflow_end_timestamp = this->get_timestamp(this->workflow_end_timestamp_error);
 
-      struct timespec ts;
+      auto end_time = ch::duration_cast<ch::milliseconds>(ch::system_clock::now().time_since_epoch()).count();
 
-      if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
-        this->workflow_end_timestamp = 0;
-        this->workflow_end_timestamp_error = true;
-      } else {
-        this->workflow_end_timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-        this->workflow_end_timestamp_error = false;
+      if (Telemetry::instance) {
+        Telemetry::instance->publish({
+            {"type", "workflow"},
+            {"entity", this->get_name()},
+            {"state", "finished"},
+            {"exit_code", result},
+            {"time", end_time}});
       }
 
-      auto end_time = ch::duration_cast<ch::milliseconds>(ch::system_clock::now().time_since_epoch()).count();
-
       {
         std::unique_lock lock(this->workflow_finish_print_mutex);
 
@@ -1931,14 +3528,35 @@ namespace adaptyst {
   }
 
   const char *Entity::get_cpu_mask() {
+    // Modules of different nodes may ask for the mask at the same time
+    std::unique_lock lock(this->cpu_mask_mutex);
+
     if (!this->cpu_mask.empty()) {
       return this->cpu_mask.c_str();
     }
 
+    if (!this->cpu_policy.mask.empty()) {
+      Terminal::instance->print("The CPU mask from the system definition will be used.",
+                                false, false, this, "General");
+      this->cpu_mask = this->cpu_policy.mask;
+      return this->cpu_mask.c_str();
+    }
+
     Terminal::instance->print("The CPU mask has been requested, calculating it...", false,
                               false, this, "General");
 
-    int num_proc = std::thread::hardware_concurrency();
+    std::unique_ptr<CPUTopology> topology;
+
+    try {
+      topology = std::make_unique<CPUTopology>();
+    } catch (std::exception &e) {
+      Terminal::instance->print("Could not determine the topology of the "
+                                "allowed logical cores: " + std::string(e.what()),
+                                true, true, this, "General");
+      return nullptr;
+    }
+
+    int num_proc = topology->get_logical_core_count();
 
     if (num_proc == 0) {
       Terminal::instance->print("Could not determine the number "
@@ -1946,62 +3564,71 @@ namespace adaptyst {
       return nullptr;
     }
 
-    std::stringstream mask_stream;
-
-    if (processing_threads == 0) {
-      for (int i = 0; i < num_proc; i++) {
-        mask_stream << 'b';
-      }
+    try {
+      if (processing_threads == 0) {
+        if (this->cpu_policy.analysis_numa_node != -1) {
+          Terminal::instance->print("Performance analysis shares the cores of the workflow "
+                                    "because \"processing_threads\" is 0, so "
+                                    "\"analysis_numa_node\" will be ignored.", true, false,
+                                    this, "General");
+        }
 
-      this->cpu_mask = mask_stream.str();
-    } else if (processing_threads > num_proc - 3) {
-      Terminal::instance->print("The value of \"processing_threads\" must be less "
-                                "than or equal to the number of "
-                                "logical cores minus 3 (i.e. " +
-                                std::to_string(num_proc - 3) + ")!", true, true, this, "General");
-      return nullptr;
-    } else {
-      if (num_proc < 4) {
-        Terminal::instance->print("Because there are fewer than 4 logical cores, "
-                                  "the value of \"processing_threads\" will be ignored for the profiled "
-                                  "program unless it is 0.", true, false);
-      }
-
-      switch (num_proc) {
-      case 1:
-        Terminal::instance->print("Running analysis along with processing is *NOT* "
-                                  "recommended on a machine with only one logical core! "
-                                  "You are very likely to get inconsistent results due "
-                                  "to processing threads interfering with the analysed "
-                                  "program. If you want to proceed anyway, "
-                                  "set \"processing_threads\" to 0.", true, true, this, "General");
+        this->cpu_mask = topology->make_mask(0, -1, this->cpu_policy.workflow_numa_node);
+      } else if (num_proc >= 4 && processing_threads > (unsigned int)num_proc - 3) {
+        Terminal::instance->print("The value of \"processing_threads\" must be less "
+                                  "than or equal to the number of allowed "
+                                  "logical cores minus 3 (i.e. " +
+                                  std::to_string(num_proc - 3) + ")!", true, true, this, "General");
         return nullptr;
+      } else {
+        if (num_proc < 4) {
+          Terminal::instance->print("Because there are fewer than 4 allowed logical cores, "
+                                    "the value of \"processing_threads\" will be ignored for the profiled "
+                                    "program unless it is 0.", true, false);
+
+          if (this->cpu_policy.analysis_numa_node != -1 ||
+              this->cpu_policy.workflow_numa_node != -1) {
+            Terminal::instance->print("Because there are fewer than 4 allowed logical cores, "
+                                      "\"analysis_numa_node\" and \"workflow_numa_node\" "
+                                      "will be ignored.", true, false, this, "General");
+          }
+        }
 
-      case 2:
-        Terminal::instance->print("2 logical cores detected, running processing and "
-                                  "hardware modules on core #0 and the command on core #1.", true,
-                                  false, this, "General");
-        this->cpu_mask = "pc";
-        break;
+        switch (num_proc) {
+        case 1:
+          Terminal::instance->print("Running analysis along with processing is *NOT* "
+                                    "recommended on a machine with only one logical core! "
+                                    "You are very likely to get inconsistent results due "
+                                    "to processing threads interfering with the analysed "
+                                    "program. If you want to proceed anyway, "
+                                    "set \"processing_threads\" to 0.", true, true, this, "General");
+          return nullptr;
+
+        case 2:
+          Terminal::instance->print("2 allowed logical cores detected, running processing and "
+                                    "hardware modules on the first one and the command on the "
+                                    "second one.", true, false, this, "General");
+          this->cpu_mask = topology->make_mask("pc");
+          break;
 
-      case 3:
-        Terminal::instance->print("3 logical cores detected, running processing and "
-                                  "hardware modules on cores #0 and #1 and the command on core #2.",
-                                  true, false, this, "General");
-        this->cpu_mask = "ppc";
-        break;
+        case 3:
+          Terminal::instance->print("3 allowed logical cores detected, running processing and "
+                                    "hardware modules on the first two and the command on the "
+                                    "third one.", true, false, this, "General");
+          this->cpu_mask = topology->make_mask("ppc");
+          break;
 
-      default:
-        mask_stream << "  ";
-        for (int i = 2; i < 2 + processing_threads; i++) {
-          mask_stream << 'p';
-        }
-        for (int i = 2 + processing_threads; i < num_proc; i++) {
-          mask_stream << 'c';
+        default:
+          this->cpu_mask = topology->make_mask(processing_threads,
+                                               this->cpu_policy.analysis_numa_node,
+                                               this->cpu_policy.workflow_numa_node);
+          break;
         }
-        this->cpu_mask = mask_stream.str();
-        break;
       }
+    } catch (std::exception &e) {
+      Terminal::instance->print("Could not calculate the CPU mask: " + std::string(e.what()),
+                                true, true, this, "General");
+      return nullptr;
     }
 
     Terminal::instance->print("The CPU mask has been obtained.", false,
@@ -2009,6 +3636,19 @@ namespace adaptyst {
     return this->cpu_mask.c_str();
   }
 
+  bool Entity::is_memory_bound() {
+    return this->cpu_policy.bind_memory;
+  }
+
+  void Entity::set_cpu_policy(CPUPolicy policy) {
+    this->cpu_policy = policy;
+  }
+
+  void Entity::set_cgroup_policy(CgroupPolicy policy) {
+    this->cgroup_policy = policy;
+  }
+
+
   fs::path &Entity::get_tmp_dir() {
     return this->tmp_dir;
   }
@@ -2079,6 +3719,107 @@ namespace adaptyst {
     return this->workflow_end_timestamp;
   }
 
+  RegionStats &Entity::get_region_stats() {
+    return this->region_stats;
+  }
+
+  void Entity::set_tsc_clock(bool enabled) {
+    this->tsc_clock_enabled = enabled;
+  }
+
+  unsigned long long Entity::get_timestamp(bool &err) {
+    // The TSC clock is calibrated against CLOCK_MONOTONIC, so both give
+    // timestamps in the same time base
+    if (this->tsc_clock) {
+      err = false;
+      return this->tsc_clock->now();
+    }
+
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
+      err = true;
+      return 0;
+    }
+
+    err = false;
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  void Entity::set_region_ring_size(unsigned int size) {
+    if (size == 0) {
+      this->region_ring_size = 0;
+      return;
+    }
+
+    if (size > REGION_RING_MAX_SIZE) {
+      this->throw_error("\"region_ring_size\" must not be larger than " +
+                        std::to_string(REGION_RING_MAX_SIZE) + "!");
+    }
+
+    this->region_ring_size = 1;
+
+    while (this->region_ring_size < size) {
+      this->region_ring_size <<= 1;
+    }
+  }
+
+  void Entity::region_switch(std::string name, std::string part_id,
+                             std::string state, std::string timestamp_str) {
+    std::unique_lock lock(this->region_switch_mutex);
+
+    if (!this->general_log) {
+      this->general_log = Terminal::instance->get_log_stream(this, "General");
+    }
+
+    Terminal::instance->log("Region \"" + name + "\", workflow part ID " + part_id + ": " +
+                            state + " at " + timestamp_str + " ns", this->general_log);
+
+    if (Telemetry::instance) {
+      Telemetry::instance->add_region_event(this->get_name(), name, state == "start");
+    }
+
+    if (timestamp_str != "-1") {
+      try {
+        this->region_stats.add_switch(name, part_id, state == "start",
+                                      std::stoull(timestamp_str));
+      } catch (std::exception &) { }
+    }
+
+    for (auto &entry : this->nodes) {
+      entry.second->region_switch(name, part_id, state, timestamp_str);
+    }
+  }
+
+  void Entity::region_summary(std::string name, std::string part_id,
+                              const adaptyst_region_summary &summary) {
+    std::unique_lock lock(this->region_switch_mutex);
+
+    if (!this->general_log) {
+      this->general_log = Terminal::instance->get_log_stream(this, "General");
+    }
+
+    Terminal::instance->log("Region \"" + name + "\", workflow part ID " + part_id + ": " +
+                            std::to_string(summary.count) + " instances aggregated, " +
+                            std::to_string(summary.total_ns) + " ns in total",
+                            this->general_log);
+
+    this->region_stats.add_summary(name, part_id, summary);
+
+    if (Telemetry::instance) {
+      Telemetry::instance->add_region_summary(this->get_name(), name, summary.count);
+    }
+
+    for (auto &entry : this->nodes) {
+      entry.second->region_summary(name, part_id, summary);
+    }
+  }
+
+  void Entity::set_region_policies(std::unordered_map<std::string,
+                                   adaptyst_region_policy> policies) {
+    this->region_policies = policies;
+  }
+
   void System::init(fs::path def_file,
                     fs::path root_dir,
                     std::vector<fs::path> &library_paths,
@@ -2113,14 +3854,53 @@ namespace adaptyst {
                                "is not a map!");
     }
 
-    for (auto entity : entities.children()) {
-      std::unordered_map<std::string, unsigned int> mod_counts;
-      std::string name(entity.key().data(), entity.key().len);
+    this->start_barrier = false;
+    this->runs = 1;
+    this->warmup_runs = 0;
 
-      if (!entity.is_map()) {
-        throw std::runtime_error("\"" + name + "\" in \"entities\" in "
-                                 "the system YAML file is not a map!");
-      }
+    if (root.has_child("options")) {
+      auto options = root["options"];
+
+      if (!options.is_map()) {
+        throw std::runtime_error("\"options\" in the root of the system "
+                                 "YAML file is not a map!");
+      }
+
+      if (options.has_child("start_barrier")) {
+        auto barrier = options["start_barrier"];
+
+        if (!barrier.is_keyval()) {
+          throw std::runtime_error("\"start_barrier\" in \"options\" in "
+                                   "the root of the system YAML file is not "
+                                   "of simple key-value type!");
+        }
+
+        std::string barrier_str(barrier.val().data(), barrier.val().len);
+
+        if (barrier_str == "true") {
+          this->start_barrier = true;
+        } else if (barrier_str != "false") {
+          throw std::runtime_error("\"start_barrier\" in \"options\" in "
+                                   "the root of the system YAML file must be "
+                                   "either \"true\" or \"false\"!");
+        }
+      }
+    }
+
+    for (auto entity : entities.children()) {
+      std::unordered_map<std::string, unsigned int> mod_counts;
+      std::string name(entity.key().data(), entity.key().len);
+
+      if (!this->hosted_entity.empty() && name != this->hosted_entity) {
+        // Other entities are handled by the Adaptyst instance which
+        // has connected to this remote agent
+        continue;
+      }
+
+      if (!entity.is_map()) {
+        throw std::runtime_error("\"" + name + "\" in \"entities\" in "
+                                 "the system YAML file is not a map!");
+      }
 
       if (!entity.has_child("options")) {
         throw std::runtime_error("\"" + name + "\" in \"entities\" "
@@ -2175,19 +3955,256 @@ namespace adaptyst {
         }
       }
 
+      unsigned int region_ring_size = 0;
+
+      if (options.has_child("region_ring_size")) {
+        auto ring_size = options["region_ring_size"];
+        if (!ring_size.is_keyval()) {
+          throw std::runtime_error("\"region_ring_size\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not of "
+                                   "simple key-value type!");
+        }
+
+        std::string ring_size_str(ring_size.val().data(), ring_size.val().len);
+
+        try {
+          region_ring_size = std::stoul(ring_size_str);
+        } catch (...) {
+          throw std::runtime_error("\"region_ring_size\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a valid "
+                                   "unsigned integer!");
+        }
+      }
+
+      bool tsc_clock = false;
+
+      if (options.has_child("timestamp_source")) {
+        auto source = options["timestamp_source"];
+
+        if (!source.is_keyval()) {
+          throw std::runtime_error("\"timestamp_source\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not of "
+                                   "simple key-value type!");
+        }
+
+        std::string source_str(source.val().data(), source.val().len);
+
+        if (source_str == "tsc") {
+          tsc_clock = true;
+        } else if (source_str != "monotonic") {
+          throw std::runtime_error("\"timestamp_source\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file must be either "
+                                   "\"monotonic\" or \"tsc\"!");
+        }
+      }
+
+      std::unordered_map<std::string, adaptyst_region_policy> region_policies;
+
+      if (options.has_child("region_policies")) {
+        auto policies = options["region_policies"];
+
+        if (!policies.is_map()) {
+          throw std::runtime_error("\"region_policies\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a map!");
+        }
+
+        for (auto policy : policies.children()) {
+          std::string region_name(policy.key().data(), policy.key().len);
+
+          if (!policy.is_map()) {
+            throw std::runtime_error("Region \"" + region_name + "\" in "
+                                     "\"region_policies\" in \"options\" in "
+                                     "\"" + name + "\" in \"entities\" "
+                                     "in the system YAML file is not a map!");
+          }
+
+          // Aggregated regions are flushed every second by default
+          adaptyst_region_policy region_policy{0, 0, false, 1000};
+
+          if (policy.has_child("aggregate") &&
+              !c4::from_chars(policy["aggregate"].val(), &region_policy.aggregate)) {
+            throw std::runtime_error("\"aggregate\" in region \"" + region_name + "\" "
+                                     "in \"region_policies\" in \"options\" in "
+                                     "\"" + name + "\" in \"entities\" "
+                                     "in the system YAML file is not a valid "
+                                     "boolean!");
+          }
+
+          for (auto &key : {"sample_every", "min_duration_ns", "flush_interval_ms"}) {
+            std::string key_str(key);
+            c4::csubstr option_key(key_str.data(), key_str.length());
+
+            if (!policy.has_child(option_key)) {
+              continue;
+            }
+
+            auto value = policy[option_key];
+            bool valid = value.is_keyval();
+
+            if (valid) {
+              std::string value_str(value.val().data(), value.val().len);
+
+              try {
+                unsigned long long parsed = std::stoull(value_str);
+
+                if (key_str == "sample_every") {
+                  valid = parsed <= UINT_MAX;
+                  region_policy.sample_every = parsed;
+                } else if (key_str == "min_duration_ns") {
+                  region_policy.min_duration_ns = parsed;
+                } else {
+                  valid = parsed <= UINT_MAX;
+                  region_policy.flush_interval_ms = parsed;
+                }
+              } catch (...) {
+                valid = false;
+              }
+            }
+
+            if (!valid) {
+              throw std::runtime_error("\"" + key_str + "\" in region \"" +
+                                       region_name + "\" in \"region_policies\" "
+                                       "in \"options\" in \"" + name + "\" in "
+                                       "\"entities\" in the system YAML file is "
+                                       "not a valid unsigned integer!");
+            }
+          }
+
+          region_policies[region_name] = region_policy;
+        }
+      }
+
+      CPUPolicy cpu_policy;
+
+      if (options.has_child("cpu_mask")) {
+        auto mask = options["cpu_mask"];
+
+        if (!mask.is_keyval()) {
+          throw std::runtime_error("\"cpu_mask\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not of "
+                                   "simple key-value type!");
+        }
+
+        cpu_policy.mask = std::string(mask.val().data(), mask.val().len);
+
+        if (cpu_policy.mask.length() > CPU_SETSIZE ||
+            !CPUConfig(cpu_policy.mask).is_valid()) {
+          throw std::runtime_error("\"cpu_mask\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a valid "
+                                   "CPU mask! It must be a non-empty string "
+                                   "of ' ', 'p', 'c', and 'b' characters.");
+        }
+      }
+
+      for (auto &node_option : {std::make_pair("analysis_numa_node",
+                                               &cpu_policy.analysis_numa_node),
+                                std::make_pair("workflow_numa_node",
+                                               &cpu_policy.workflow_numa_node)}) {
+        std::string option_name(node_option.first);
+        c4::csubstr option_key(option_name.data(), option_name.length());
+
+        if (!options.has_child(option_key)) {
+          continue;
+        }
+
+        auto numa_node = options[option_key];
+
+        if (!numa_node.is_keyval()) {
+          throw std::runtime_error("\"" + option_name + "\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not of "
+                                   "simple key-value type!");
+        }
+
+        std::string numa_node_str(numa_node.val().data(), numa_node.val().len);
+
+        try {
+          *node_option.second = std::stoul(numa_node_str);
+        } catch (...) {
+          throw std::runtime_error("\"" + option_name + "\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a valid "
+                                   "unsigned integer!");
+        }
+      }
+
+      if (options.has_child("bind_memory")) {
+        if (!c4::from_chars(options["bind_memory"].val(), &cpu_policy.bind_memory)) {
+          throw std::runtime_error("\"bind_memory\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a valid "
+                                   "boolean!");
+        }
+      }
+
+      CgroupPolicy cgroup_policy;
+
+      if (options.has_child("cgroup")) {
+        auto cgroup = options["cgroup"];
+
+        if (!cgroup.is_map()) {
+          throw std::runtime_error("\"cgroup\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not a map!");
+        }
+
+        if (!cgroup.has_child("parent")) {
+          throw std::runtime_error("\"cgroup\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file does not have "
+                                   "\"parent\"!");
+        }
+
+        for (auto &key : {"parent", "memory_max", "io_max"}) {
+          std::string key_str(key);
+          c4::csubstr option_key(key_str.data(), key_str.length());
+
+          if (!cgroup.has_child(option_key)) {
+            continue;
+          }
+
+          auto value = cgroup[option_key];
+
+          if (!value.is_keyval() || value.val().len == 0) {
+            throw std::runtime_error("\"" + key_str + "\" in \"cgroup\" in "
+                                     "\"options\" in \"" + name + "\" in "
+                                     "\"entities\" in the system YAML file "
+                                     "is not a non-empty string!");
+          }
+
+          std::string value_str(value.val().data(), value.val().len);
+
+          if (key_str == "parent") {
+            cgroup_policy.parent = value_str;
+          } else if (key_str == "memory_max") {
+            cgroup_policy.memory_max = value_str;
+          } else {
+            cgroup_policy.io_max = value_str;
+          }
+        }
+      }
+
       std::string access_mode_val(access_mode.val().data(), access_mode.val().len);
       Entity::AccessMode access_mode_final;
 
       if (access_mode_val == "local") {
         access_mode_final = Entity::LOCAL;
       } else if (access_mode_val == "remote") {
-        throw std::runtime_error("Remote access to entities is not "
-                                 "yet supported! (entity \"" + name + "\")");
+        // A remote agent hosts the entity as a local one
+        access_mode_final = this->hosted_entity.empty() ?
+          Entity::REMOTE : Entity::LOCAL;
       } else if (access_mode_val == "custom") {
         access_mode_final = Entity::CUSTOM;
       } else if (access_mode_val == "custom_remote") {
-        throw std::runtime_error("Remote access to entities is not "
-                                 "yet supported! (entity \"" + name + "\")");
+        access_mode_final = this->hosted_entity.empty() ?
+          Entity::CUSTOM_REMOTE : Entity::CUSTOM;
       } else {
         throw std::runtime_error("\"handle_mode\" in \"options\" in "
                                  "\"" + name + "\" in \"entities\" "
@@ -2200,6 +4217,84 @@ namespace adaptyst {
                                  processing_threads,
                                  local_config_path,
                                  tmp_dir, no_inject, buf_size);
+      entity_obj->set_region_ring_size(region_ring_size);
+      entity_obj->set_tsc_clock(tsc_clock);
+      entity_obj->set_region_policies(region_policies);
+      entity_obj->set_cpu_policy(cpu_policy);
+      entity_obj->set_cgroup_policy(cgroup_policy);
+
+      if (access_mode_final == Entity::REMOTE ||
+          access_mode_final == Entity::CUSTOM_REMOTE) {
+        if (!options.has_child("address")) {
+          throw std::runtime_error("\"options\" in \"" + name + "\" in "
+                                   "\"entities\" in the system YAML file "
+                                   "does not have \"address\" required by "
+                                   "remote entities!");
+        }
+
+        auto address = options["address"];
+
+        if (!address.is_keyval()) {
+          throw std::runtime_error("\"address\" in \"options\" in "
+                                   "\"" + name + "\" in \"entities\" "
+                                   "in the system YAML file is not of "
+                                   "simple key-value type!");
+        }
+
+        unsigned short port = REMOTE_DEFAULT_PORT;
+
+        if (options.has_child("port")) {
+          auto port_node = options["port"];
+
+          if (!port_node.is_keyval()) {
+            throw std::runtime_error("\"port\" in \"options\" in "
+                                     "\"" + name + "\" in \"entities\" "
+                                     "in the system YAML file is not of "
+                                     "simple key-value type!");
+          }
+
+          std::string port_str(port_node.val().data(), port_node.val().len);
+
+          try {
+            unsigned long port_val = std::stoul(port_str);
+
+            if (port_val == 0 || port_val > 65535) {
+              throw std::out_of_range(port_str);
+            }
+
+            port = port_val;
+          } catch (...) {
+            throw std::runtime_error("\"port\" in \"options\" in "
+                                     "\"" + name + "\" in \"entities\" "
+                                     "in the system YAML file is not a valid "
+                                     "port number!");
+          }
+        }
+
+        // Without "token_file", the shared secret is taken from
+        // the environment when connecting
+        fs::path token_file;
+
+        if (options.has_child("token_file")) {
+          auto token_file_node = options["token_file"];
+
+          if (!token_file_node.is_keyval()) {
+            throw std::runtime_error("\"token_file\" in \"options\" in "
+                                     "\"" + name + "\" in \"entities\" "
+                                     "in the system YAML file is not of "
+                                     "simple key-value type!");
+          }
+
+          token_file = fs::path(std::string(token_file_node.val().data(),
+                                            token_file_node.val().len));
+        }
+
+        // Nodes and modules are set up by the remote agent
+        entity_obj->set_remote(std::string(address.val().data(), address.val().len),
+                               port, def_file, token_file);
+        this->entities[name] = entity_obj;
+        continue;
+      }
 
       if (!entity.has_child("nodes")) {
         throw std::runtime_error("\"" + name + "\" in \"entities\" in "
@@ -2255,6 +4350,32 @@ namespace adaptyst {
         std::shared_ptr<Node> node_obj = std::make_shared<Node>(node_name,
                                                                 entity_obj);
 
+        if (node.has_child("depends_on")) {
+          auto depends_on = node["depends_on"];
+
+          if (depends_on.is_keyval()) {
+            node_obj->add_dependency(std::string(depends_on.val().data(),
+                                                 depends_on.val().len));
+          } else if (depends_on.is_seq()) {
+            for (auto dependency : depends_on.children()) {
+              if (!dependency.is_val()) {
+                throw std::runtime_error("Element with index " +
+                                         std::to_string(node_obj->get_dependencies().size()) +
+                                         " in \"depends_on\" in node \"" + node_name + "\" "
+                                         "in entity \"" + name + "\" in the system YAML file "
+                                         "is not a simple value!");
+              }
+
+              node_obj->add_dependency(std::string(dependency.val().data(),
+                                                   dependency.val().len));
+            }
+          } else {
+            throw std::runtime_error("\"depends_on\" in node \"" + node_name + "\" in "
+                                     "entity \"" + name + "\" in the system YAML file "
+                                     "is neither a node name nor a sequence of them!");
+          }
+        }
+
         int index = 0;
         for (auto mod : modules.children()) {
           auto module_name = mod["name"];
@@ -2321,9 +4442,9 @@ namespace adaptyst {
             }
           }
 
-          std::unique_ptr<Module> mod_obj = std::make_unique<Module>(
-                module_name_str, options_map, array_options_map, library_paths,
-                never_directing, no_inject);
+          // The module definition is checked against its cached manifest
+          // first, so that the library is loaded only if it can be used
+          ModuleManifest manifest = ModuleManifest::get(module_name_str, library_paths);
 
           if (mod_counts.contains(module_name_str)) {
             mod_counts[module_name_str]++;
@@ -2331,15 +4452,21 @@ namespace adaptyst {
             mod_counts[module_name_str] = 1;
           }
 
-          if (mod_obj->get_max_count_per_entity() > 0 &&
+          if (manifest.get_max_count_per_entity() > 0 &&
               mod_counts[module_name_str] >
-              mod_obj->get_max_count_per_entity()) {
+              manifest.get_max_count_per_entity()) {
             throw std::runtime_error("Too many module instances of " +
                                      module_name_str + " are declared! "
                                      "The maximum allowed number is " +
-                                     std::to_string(mod_obj->get_max_count_per_entity()) + ".");
+                                     std::to_string(manifest.get_max_count_per_entity()) + ".");
           }
 
+          manifest.validate(options_map, array_options_map);
+
+          std::unique_ptr<Module> mod_obj = std::make_unique<Module>(
+                module_name_str, options_map, array_options_map, library_paths,
+                never_directing, no_inject);
+
           node_obj->add_module(mod_obj);
 
           index++;
@@ -2396,20 +4523,88 @@ namespace adaptyst {
                                      "key-value type!");
           }
 
-          std::shared_ptr<NodeConnection> connection =
-            std::make_shared<
-              NodeConnection>(edge_name, entity_obj->get_node(std::string(node1.val().data(), node1.val().len)),
-                              entity_obj->get_node(std::string(node2.val().data(), node2.val().len)));
+          unsigned int queue_capacity = DATAFLOW_DEFAULT_QUEUE_CAPACITY;
+
+          if (edge.has_child("queue_capacity")) {
+            auto capacity = edge["queue_capacity"];
+
+            if (!capacity.is_keyval()) {
+              throw std::runtime_error("\"queue_capacity\" in edge \"" +
+                                       edge_name + "\" in entity \"" + name + "\" "
+                                       "in the system YAML file is not of a simple "
+                                       "key-value type!");
+            }
+
+            std::string capacity_str(capacity.val().data(), capacity.val().len);
+
+            try {
+              queue_capacity = std::stoul(capacity_str);
+            } catch (...) {
+              throw std::runtime_error("\"queue_capacity\" in edge \"" +
+                                       edge_name + "\" in entity \"" + name + "\" "
+                                       "in the system YAML file is not a valid "
+                                       "unsigned integer!");
+            }
+
+            if (queue_capacity == 0) {
+              throw std::runtime_error("\"queue_capacity\" in edge \"" +
+                                       edge_name + "\" in entity \"" + name + "\" "
+                                       "in the system YAML file must be positive!");
+            }
+          }
+
+          entity_obj->add_connection(edge_name,
+                                     std::string(node1.val().data(), node1.val().len),
+                                     std::string(node2.val().data(), node2.val().len),
+                                     queue_capacity);
         }
       }
 
       this->entities[name] = entity_obj;
     }
 
+    if (!this->hosted_entity.empty() && this->entities.empty()) {
+      throw std::runtime_error("Entity \"" + this->hosted_entity + "\" is not "
+                               "defined in the system YAML file!");
+    }
+
     this->root_dir = std::make_unique<Path>(root_dir);
+    this->def_file = def_file;
+    this->copy_definition();
+
+    std::vector<std::future<void> > entity_futures;
+
+    for (auto &entity : this->entities) {
+      fs::path entity_dir = root_dir / entity.first;
+      entity.second->set_entity_dir(entity_dir);
+
+      std::shared_ptr<Entity> entity_obj = entity.second;
+      entity_futures.push_back(std::async(std::launch::async,
+                                          [entity_obj]() { entity_obj->init(); }));
+    }
+
+    std::exception_ptr entity_exception;
+
+    for (auto &future : entity_futures) {
+      try {
+        future.get();
+      } catch (...) {
+        if (!entity_exception) {
+          entity_exception = std::current_exception();
+        }
+      }
+    }
+
+    if (entity_exception) {
+      std::rethrow_exception(entity_exception);
+    }
+  }
+
+  void System::copy_definition() {
+    fs::path dst = fs::path(this->root_dir->get_path_name()) / "system.yml";
 
     try {
-      if (!fs::copy_file(def_file, root_dir / "system.yml")) {
+      if (!fs::copy_file(this->def_file, dst)) {
         throw std::runtime_error("Could not copy the system definition file "
                                  "to the output directory!");
       }
@@ -2418,12 +4613,6 @@ namespace adaptyst {
                                "to the output directory! Error details: " +
                                std::string(e.what()));
     }
-
-    for (auto &entity : this->entities) {
-      fs::path entity_dir = root_dir / entity.first;
-      entity.second->set_entity_dir(entity_dir);
-      entity.second->init();
-    }
   }
 
   System::System(fs::path def_file,
@@ -2452,10 +4641,42 @@ namespace adaptyst {
     this->codes_dst = codes_dst;
   }
 
+  System::System(fs::path def_file,
+                 std::string hosted_entity,
+                 fs::path root_dir,
+                 std::vector<fs::path> &library_paths,
+                 fs::path local_config_path,
+                 fs::path tmp_dir,
+                 bool no_inject,
+                 unsigned int buf_size) {
+    this->hosted_entity = hosted_entity;
+    this->init(def_file, root_dir, library_paths,
+               local_config_path, tmp_dir, no_inject, buf_size);
+    this->custom_src_code_paths_save = false;
+  }
+
   System::~System() {
     for (auto &entity : this->entities) {
       entity.second->close();
     }
+
+    try {
+      MetadataCache::instance().sync();
+    } catch (std::exception &e) {
+      Terminal::instance->print("Could not save metadata: " + std::string(e.what()),
+                                true, true);
+    }
+  }
+
+  void System::reset(fs::path root_dir) {
+    MetadataCache::instance().sync();
+
+    this->root_dir = std::make_unique<Path>(root_dir);
+    this->copy_definition();
+
+    for (auto &entity : this->entities) {
+      entity.second->reset(root_dir / entity.first);
+    }
   }
 
   void System::set_ir(std::shared_ptr<IR> ir_obj) {
@@ -2464,9 +4685,126 @@ namespace adaptyst {
     }
   }
 
+  void System::set_src_compression(ArchiveCompression compression) {
+    for (auto &entity : this->entities) {
+      entity.second->set_src_compression(compression);
+    }
+  }
+
+  void System::set_runs(unsigned int runs, unsigned int warmup_runs) {
+    this->runs = std::max(runs, 1U);
+    this->warmup_runs = warmup_runs;
+  }
+
   void System::process() {
+    if (this->runs == 1 && this->warmup_runs == 0) {
+      this->process_once();
+      return;
+    }
+
+    // Modules stay initialised between the runs, only the per-run
+    // state is reset. Every run has its own directory in the entity
+    // directory and the warm-up ones are removed after they finish.
+    fs::path root_dir(this->root_dir->get_path_name());
+    std::unordered_map<std::string, nlohmann::json> run_infos;
+
     for (auto &entity : this->entities) {
-      entity.second->process(!this->custom_src_code_paths_save);
+      run_infos[entity.first] = {{"runs", nlohmann::json::array()},
+                                 {"warmup_runs", nlohmann::json::array()}};
+    }
+
+    for (unsigned int i = 0; i < this->warmup_runs + this->runs; i++) {
+      bool warmup = i < this->warmup_runs;
+      unsigned int iteration = warmup ? i : i - this->warmup_runs;
+      std::string run_dir_name = (warmup ? "warmup_" : "run_") + std::to_string(iteration + 1);
+
+      Terminal::instance->print("Starting " + std::string(warmup ? "warm-up run " : "run ") +
+                                std::to_string(iteration + 1) + " of " +
+                                std::to_string(warmup ? this->warmup_runs : this->runs) + "...",
+                                false, false);
+
+      for (auto &entity : this->entities) {
+        entity.second->start_iteration(root_dir / entity.first / run_dir_name,
+                                       iteration, warmup);
+      }
+
+      this->process_once();
+
+      for (auto &entity : this->entities) {
+        nlohmann::json info = entity.second->get_run_info();
+        info["run"] = iteration + 1;
+        run_infos[entity.first][warmup ? "warmup_runs" : "runs"].push_back(info);
+
+        Path entity_dir(root_dir / entity.first);
+
+        for (auto &item : run_infos[entity.first].items()) {
+          entity_dir.set_metadata<nlohmann::json>(item.key(), item.value(), false);
+        }
+
+        entity_dir.save_metadata();
+      }
+
+      MetadataCache::instance().sync();
+
+      if (warmup) {
+        for (auto &entity : this->entities) {
+          std::error_code err;
+          fs::remove_all(root_dir / entity.first / run_dir_name, err);
+        }
+      }
+    }
+  }
+
+  void System::process_once() {
+    std::shared_ptr<StartBarrier> barrier;
+
+    if (this->start_barrier) {
+      barrier = std::make_shared<StartBarrier>();
+
+      for (auto &entity : this->entities) {
+        if (entity.second->will_run_workflow()) {
+          barrier->add_participant();
+          entity.second->set_start_barrier(barrier);
+        }
+      }
+    }
+
+    std::vector<std::future<void> > entity_futures;
+
+    for (auto &entity : this->entities) {
+      std::shared_ptr<Entity> entity_obj = entity.second;
+      bool save_src_code_paths = !this->custom_src_code_paths_save;
+
+      entity_futures.push_back(std::async(std::launch::async,
+                                          [entity_obj, barrier,
+                                           save_src_code_paths]() {
+        try {
+          entity_obj->process(save_src_code_paths);
+        } catch (...) {
+          // Other entities must not wait for this one forever
+          if (barrier) {
+            barrier->withdraw(entity_obj.get());
+          }
+
+          throw;
+        }
+      }));
+    }
+
+    std::exception_ptr entity_exception;
+
+    for (auto &future : entity_futures) {
+      try {
+        future.get();
+      } catch (...) {
+        if (!entity_exception) {
+          entity_exception = std::current_exception();
+        }
+      }
+    }
+
+    if (entity_exception) {
+      std::rethrow_exception(entity_exception);
     }
 
     if (this->custom_src_code_paths_save) {
@@ -0,0 +1,265 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "telemetry.hpp"
+#include <chrono>
+
+namespace adaptyst {
+  namespace ch = std::chrono;
+
+  std::unique_ptr<Telemetry> Telemetry::instance = nullptr;
+
+  Telemetry::Telemetry(std::string address, unsigned short port,
+                       unsigned int buf_size, unsigned int interval_ms,
+                       unsigned int queue_size) {
+    this->buf_size = buf_size;
+    this->interval_ms = interval_ms;
+    this->queue_size = queue_size;
+    this->stop = false;
+    this->next_source_id = 0;
+
+    TCPAcceptor::Factory factory(address, port);
+    this->acceptor = factory.make_acceptor(UNLIMITED_ACCEPTED);
+
+    this->accept_thread = std::thread([this]() { this->accept_loop(); });
+    this->flush_thread = std::thread([this]() { this->flush_loop(); });
+  }
+
+  Telemetry::~Telemetry() {
+    {
+      std::unique_lock lock(this->flush_mutex);
+      this->stop = true;
+    }
+
+    this->flush_cv.notify_all();
+    this->flush_thread.join();
+    this->accept_thread.join();
+
+    // Whatever has been published by now (including the final flush)
+    // is still sent, each subscriber being bounded by the send timeout
+    std::unique_lock lock(this->subscribers_mutex);
+
+    for (auto &subscriber : this->subscribers) {
+      {
+        std::unique_lock subscriber_lock(subscriber->mutex);
+      }
+
+      subscriber->cv.notify_all();
+    }
+
+    for (auto &subscriber : this->subscribers) {
+      subscriber->thread.join();
+    }
+  }
+
+  std::string Telemetry::get_connection_instructions() {
+    return this->acceptor->get_connection_instructions();
+  }
+
+  void Telemetry::publish(nlohmann::json message) {
+    if (!message.contains("time")) {
+      message["time"] =
+        ch::duration_cast<ch::milliseconds>(ch::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string serialised = message.dump() + "\n";
+    std::unique_lock lock(this->subscribers_mutex);
+
+    for (auto &subscriber : this->subscribers) {
+      {
+        std::unique_lock subscriber_lock(subscriber->mutex);
+
+        if (subscriber->finished) {
+          continue;
+        }
+
+        if (subscriber->queue.size() >= this->queue_size) {
+          subscriber->queue.pop_front();
+          subscriber->dropped++;
+        }
+
+        subscriber->queue.push_back(serialised);
+      }
+
+      subscriber->cv.notify_one();
+    }
+  }
+
+  void Telemetry::add_region_event(std::string entity, std::string region, bool start) {
+    std::unique_lock lock(this->regions_mutex);
+    RegionCounts &counts = this->regions[entity][region];
+
+    if (start) {
+      counts.starts++;
+    } else {
+      counts.ends++;
+    }
+  }
+
+  void Telemetry::add_region_summary(std::string entity, std::string region,
+                                     unsigned long long count) {
+    std::unique_lock lock(this->regions_mutex);
+    this->regions[entity][region].aggregated += count;
+  }
+
+  unsigned long long Telemetry::add_source(std::function<nlohmann::json()> source) {
+    std::unique_lock lock(this->sources_mutex);
+    unsigned long long id = this->next_source_id++;
+    this->sources[id] = source;
+    return id;
+  }
+
+  void Telemetry::remove_source(unsigned long long id) {
+    std::unique_lock lock(this->sources_mutex);
+    this->sources.erase(id);
+  }
+
+  void Telemetry::accept_loop() {
+    while (!this->stop) {
+      std::unique_ptr<Connection> connection;
+
+      try {
+        // The timeout lets the loop notice that it should stop
+        connection = this->acceptor->accept(this->buf_size, 1);
+      } catch (TimeoutException &) {
+        this->prune_subscribers();
+        continue;
+      } catch (ConnectionException &) {
+        continue;
+      }
+
+      TCPSocket *socket = dynamic_cast<TCPSocket *>(connection.get());
+
+      if (socket) {
+        socket->set_send_timeout(TELEMETRY_SEND_TIMEOUT);
+      }
+
+      auto subscriber = std::make_unique<Subscriber>();
+      subscriber->connection = std::move(connection);
+      subscriber->dropped = 0;
+      subscriber->finished = false;
+
+      Subscriber *subscriber_ptr = subscriber.get();
+      subscriber->thread = std::thread([this, subscriber_ptr]() {
+        this->send_loop(*subscriber_ptr);
+      });
+
+      std::unique_lock lock(this->subscribers_mutex);
+      this->subscribers.push_back(std::move(subscriber));
+    }
+  }
+
+  void Telemetry::flush_loop() {
+    std::unique_lock lock(this->flush_mutex);
+
+    while (!this->stop) {
+      this->flush_cv.wait_for(lock, ch::milliseconds(this->interval_ms),
+                              [this]() { return this->stop.load(); });
+
+      lock.unlock();
+      this->flush();
+      lock.lock();
+    }
+  }
+
+  void Telemetry::flush() {
+    std::map<std::string, std::map<std::string, RegionCounts> > regions;
+
+    {
+      std::unique_lock lock(this->regions_mutex);
+      regions.swap(this->regions);
+    }
+
+    for (auto &entity : regions) {
+      nlohmann::json message = {
+        {"type", "regions"},
+        {"entity", entity.first},
+        {"interval_ms", this->interval_ms},
+        {"regions", nlohmann::json::object()}
+      };
+
+      for (auto &region : entity.second) {
+        message["regions"][region.first] = {
+          {"starts", region.second.starts},
+          {"ends", region.second.ends},
+          {"aggregated", region.second.aggregated}
+        };
+      }
+
+      this->publish(message);
+    }
+
+    std::unique_lock lock(this->sources_mutex);
+
+    for (auto &source : this->sources) {
+      nlohmann::json message = source.second();
+
+      if (!message.is_null()) {
+        this->publish(message);
+      }
+    }
+  }
+
+  void Telemetry::send_loop(Subscriber &subscriber) {
+    std::unique_lock lock(subscriber.mutex);
+
+    while (true) {
+      subscriber.cv.wait(lock, [this, &subscriber]() {
+        return !subscriber.queue.empty() || this->stop;
+      });
+
+      if (subscriber.queue.empty()) {
+        break;
+      }
+
+      std::string msg;
+
+      if (subscriber.dropped > 0) {
+        msg = nlohmann::json({
+            {"type", "dropped"},
+            {"count", subscriber.dropped}
+          }).dump() + "\n";
+        subscriber.dropped = 0;
+      } else {
+        msg = std::move(subscriber.queue.front());
+        subscriber.queue.pop_front();
+      }
+
+      lock.unlock();
+
+      try {
+        subscriber.connection->write(msg.size(), msg.data());
+      } catch (std::exception &) {
+        // Covers both disconnected and stuck subscribers
+        lock.lock();
+        subscriber.finished = true;
+        subscriber.queue.clear();
+        break;
+      }
+
+      lock.lock();
+    }
+
+    subscriber.finished = true;
+  }
+
+  void Telemetry::prune_subscribers() {
+    std::unique_lock lock(this->subscribers_mutex);
+
+    for (auto it = this->subscribers.begin(); it != this->subscribers.end();) {
+      bool finished;
+
+      {
+        std::unique_lock subscriber_lock((*it)->mutex);
+        finished = (*it)->finished;
+      }
+
+      if (finished) {
+        (*it)->thread.join();
+        it = this->subscribers.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+};
@@ -34,4 +34,18 @@ namespace adaptyst {
   std::unique_ptr<IR> WorkflowCompilerSingleCmd::compile(Workflow &workflow) {
     return std::make_unique<SingleCmd>(workflow.get_command_elements());
   }
+
+  std::unique_ptr<IR> WorkflowCompilerPipeline::compile(Workflow &workflow) {
+    std::vector<std::vector<std::string> > commands(1);
+
+    for (auto &element : workflow.get_command_elements()) {
+      if (element == "|") {
+        commands.emplace_back();
+      } else {
+        commands.back().push_back(element);
+      }
+    }
+
+    return std::make_unique<Pipeline>(commands);
+  }
 };
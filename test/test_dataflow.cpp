@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "dataflow.hpp"
+#include "adaptyst/socket.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace adaptyst;
+
+static std::shared_ptr<const Record> make_record(unsigned int value) {
+  std::shared_ptr<Record> record = std::make_shared<Record>();
+  record->tag = "test";
+  record->size = sizeof(value);
+  record->data = std::make_unique<char[]>(sizeof(value));
+  std::memcpy(record->data.get(), &value, sizeof(value));
+  return record;
+}
+
+static unsigned int get_value(std::shared_ptr<const Record> &record) {
+  unsigned int value;
+  std::memcpy(&value, record->data.get(), sizeof(value));
+  return value;
+}
+
+TEST(RecordQueueTest, KeepsOrderAndEndsAfterProducers) {
+  RecordQueue queue;
+  queue.open(8, 1);
+
+  for (unsigned int i = 0; i < 5; i++) {
+    std::shared_ptr<const Record> record = make_record(i);
+    ASSERT_TRUE(queue.push(record));
+  }
+
+  queue.producer_done();
+
+  // Records pushed before the last producer has finished are still
+  // consumed before the end
+  std::shared_ptr<const Record> record;
+
+  for (unsigned int i = 0; i < 5; i++) {
+    ASSERT_EQ(queue.pop(record, NO_TIMEOUT), RecordQueue::RECORD);
+    EXPECT_EQ(get_value(record), i);
+  }
+
+  EXPECT_EQ(queue.pop(record, NO_TIMEOUT), RecordQueue::END);
+  EXPECT_EQ(queue.pop(record, 0), RecordQueue::END);
+}
+
+TEST(RecordQueueTest, TimesOutWhileProducersAreActive) {
+  RecordQueue queue;
+  queue.open(8, 1);
+  std::shared_ptr<const Record> record;
+
+  EXPECT_EQ(queue.pop(record, 0), RecordQueue::TIMEOUT);
+  EXPECT_EQ(queue.pop(record, 1), RecordQueue::TIMEOUT);
+}
+
+TEST(RecordQueueTest, EndsStraightAwayWithoutProducers) {
+  RecordQueue queue;
+  queue.open(8, 0);
+  std::shared_ptr<const Record> record;
+
+  EXPECT_EQ(queue.pop(record, NO_TIMEOUT), RecordQueue::END);
+}
+
+TEST(RecordQueueTest, ProducersWaitForSpace) {
+  RecordQueue queue;
+  queue.open(2, 1);
+  std::atomic<unsigned int> pushed = 0;
+
+  std::thread producer([&]() {
+    for (unsigned int i = 0; i < 3; i++) {
+      std::shared_ptr<const Record> record = make_record(i);
+      queue.push(record);
+      pushed++;
+    }
+
+    queue.producer_done();
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(pushed, 2);
+
+  std::shared_ptr<const Record> record;
+  ASSERT_EQ(queue.pop(record, NO_TIMEOUT), RecordQueue::RECORD);
+  EXPECT_EQ(get_value(record), 0);
+
+  producer.join();
+  EXPECT_EQ(pushed, 3);
+}
+
+TEST(RecordQueueTest, ConsumerDoneReleasesProducers) {
+  RecordQueue queue;
+  queue.open(1, 1);
+  std::shared_ptr<const Record> first = make_record(0);
+  ASSERT_TRUE(queue.push(first));
+
+  std::atomic<int> result = -1;
+
+  std::thread producer([&]() {
+    std::shared_ptr<const Record> record = make_record(1);
+    result = queue.push(record) ? 1 : 0;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(result, -1);
+
+  queue.consumer_done();
+  producer.join();
+  EXPECT_EQ(result, 0);
+
+  std::shared_ptr<const Record> record = make_record(2);
+  EXPECT_FALSE(queue.push(record));
+}
+
+TEST(RecordQueueTest, CapacityOfZeroMeansOne) {
+  RecordQueue queue;
+  queue.open(0, 1);
+
+  std::shared_ptr<const Record> record = make_record(0);
+  ASSERT_TRUE(queue.push(record));
+
+  std::atomic<bool> blocked = true;
+
+  std::thread producer([&]() {
+    std::shared_ptr<const Record> second = make_record(1);
+    queue.push(second);
+    blocked = false;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(blocked);
+
+  ASSERT_EQ(queue.pop(record, 0), RecordQueue::RECORD);
+  producer.join();
+  EXPECT_FALSE(blocked);
+}
+
+TEST(RecordQueueTest, OpenDropsLeftovers) {
+  RecordQueue queue;
+  queue.open(4, 1);
+
+  std::shared_ptr<const Record> record = make_record(0);
+  ASSERT_TRUE(queue.push(record));
+
+  queue.open(4, 1);
+  EXPECT_EQ(queue.pop(record, 0), RecordQueue::TIMEOUT);
+}
+
+TEST(RecordQueueTest, DeliversEverythingFromManyProducers) {
+  const unsigned int producers = 4;
+  const unsigned int per_producer = 10000;
+  RecordQueue queue;
+  queue.open(16, producers);
+  std::vector<std::thread> threads;
+
+  for (unsigned int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      for (unsigned int i = 0; i < per_producer; i++) {
+        std::shared_ptr<const Record> record = make_record(p * per_producer + i);
+        queue.push(record);
+      }
+
+      queue.producer_done();
+    });
+  }
+
+  std::vector<unsigned int> next(producers, 0);
+  std::shared_ptr<const Record> record;
+  unsigned int received = 0;
+  bool ordered = true;
+
+  while (queue.pop(record, NO_TIMEOUT) == RecordQueue::RECORD) {
+    unsigned int value = get_value(record);
+    unsigned int producer = value / per_producer;
+
+    // Records of every producer arrive in the order it has pushed them
+    if (value % per_producer != next[producer]) {
+      ordered = false;
+    }
+
+    next[producer]++;
+    received++;
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(received, producers * per_producer);
+}
+
+TEST(RecordQueueTest, SharesRecordsBetweenQueues) {
+  RecordQueue first;
+  RecordQueue second;
+  first.open(4, 1);
+  second.open(4, 1);
+
+  std::shared_ptr<const Record> record = make_record(42);
+  ASSERT_TRUE(first.push(record));
+  ASSERT_TRUE(second.push(record));
+
+  std::shared_ptr<const Record> from_first;
+  std::shared_ptr<const Record> from_second;
+  ASSERT_EQ(first.pop(from_first, 0), RecordQueue::RECORD);
+  ASSERT_EQ(second.pop(from_second, 0), RecordQueue::RECORD);
+
+  EXPECT_EQ(from_first.get(), record.get());
+  EXPECT_EQ(from_second.get(), record.get());
+}
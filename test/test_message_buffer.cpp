@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "adaptyst/socket.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace adaptyst;
+
+/**
+   Appends data to a MessageBuffer as if they were received through
+   a connection.
+*/
+static void receive(MessageBuffer &buffer, std::string data) {
+  std::memcpy(buffer.reserve(data.size()), data.data(), data.size());
+  buffer.commit(data.size());
+}
+
+static std::string frame(std::string msg) {
+  std::string framed(FRAME_HEADER_SIZE, 0);
+  MessageBuffer::make_header(framed.data(), msg.size());
+  return framed + msg;
+}
+
+TEST(MessageBufferTest, SplitsLines) {
+  MessageBuffer buffer(4);
+  std::string_view msg;
+
+  receive(buffer, "first\n\nsec");
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "first");
+  EXPECT_FALSE(buffer.next(msg));
+
+  receive(buffer, "ond\n");
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "second");
+  EXPECT_FALSE(buffer.next(msg));
+}
+
+TEST(MessageBufferTest, SwitchesToFrames) {
+  MessageBuffer buffer(4);
+  std::string_view msg;
+
+  receive(buffer, "line\n" FRAMING_REQUEST "\n" + frame("a\nb"));
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "line");
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "a\nb");
+  EXPECT_FALSE(buffer.next(msg));
+}
+
+TEST(MessageBufferTest, RejectsTooLongFrames) {
+  MessageBuffer buffer(16, 32);
+  std::string_view msg;
+
+  receive(buffer, FRAMING_REQUEST "\n" + frame(std::string(32, 'a')));
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, std::string(32, 'a'));
+
+  // Only the header is needed to reject a frame
+  receive(buffer, frame(std::string(33, 'a')).substr(0, FRAME_HEADER_SIZE));
+  EXPECT_THROW(buffer.next(msg), MessageTooLongException);
+}
+
+TEST(MessageBufferTest, RejectsTooLongLines) {
+  MessageBuffer buffer(16, 8);
+  std::string_view msg;
+
+  receive(buffer, "12345678\n");
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "12345678");
+
+  receive(buffer, "1234");
+  EXPECT_FALSE(buffer.next(msg));
+
+  // No newline is needed to reject a line
+  receive(buffer, "56789");
+  EXPECT_THROW(buffer.next(msg), MessageTooLongException);
+}
+
+TEST(MessageBufferTest, LimitCanBeChanged) {
+  MessageBuffer buffer(16, 4);
+  std::string_view msg;
+
+  buffer.set_max_message_size(8);
+  receive(buffer, "12345678\n");
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "12345678");
+}
+
+TEST(MessageBufferTest, TakeRemainingStripsFrameHeader) {
+  MessageBuffer buffer(16);
+  std::string_view msg;
+
+  receive(buffer, FRAMING_REQUEST "\n" + frame("complete") +
+          frame("incomplete").substr(0, FRAME_HEADER_SIZE + 3));
+  ASSERT_TRUE(buffer.next(msg));
+  EXPECT_EQ(msg, "complete");
+  EXPECT_FALSE(buffer.next(msg));
+  EXPECT_EQ(buffer.take_remaining(), "inc");
+}
+
+TEST(MessageBufferTest, TakeRemainingReturnsPartialLine) {
+  MessageBuffer buffer(16);
+  std::string_view msg;
+
+  receive(buffer, "partial");
+  EXPECT_FALSE(buffer.next(msg));
+  EXPECT_EQ(buffer.take_remaining(), "partial");
+}
+
+TEST(MessageBufferTest, ReadTimeoutAppliesToWholeMessage) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  FileDescriptor fd(fds, nullptr, 16);
+  std::atomic_bool stop = false;
+
+  // A byte every 200 ms keeps every single read within the timeout,
+  // but the newline never arrives
+  std::thread writer([&]() {
+    while (!stop) {
+      ASSERT_EQ(::write(fds[1], "a", 1), 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_THROW(fd.read_view(1), TimeoutException);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+
+  stop = true;
+  writer.join();
+}
@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// The metadata of a module without any entry points, read by
+// the module manifest tests.
+
+#include <adaptyst/hw.h>
+
+extern "C" {
+  const char *name = "testmod";
+  const char *version = "1.2.3";
+  int version_nums[] = {1, 2, 3, -1};
+  unsigned int max_count_per_entity = 2;
+  const char *tags[] = {"test", "other", nullptr};
+  const char *options[] = {"count", "label", "sizes", nullptr};
+
+  const char *count_help = "Number of things";
+  option_type count_type = UNSIGNED_INT;
+  unsigned int count_default = 4;
+
+  const char *label_help = "Label of things, required";
+  option_type label_type = STRING;
+
+  int sizes_elements[] = {16, 32};
+  const char *sizes_help = "Sizes of things";
+  option_type sizes_array_type = INT;
+  int *sizes_array_default = sizes_elements;
+  unsigned int sizes_array_default_size = 2;
+}
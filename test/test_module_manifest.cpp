@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "module_manifest.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+using namespace adaptyst;
+
+class ModuleManifestTest : public testing::Test {
+protected:
+  fs::path dir;
+  fs::path cache_dir;
+  fs::path lib_path;
+  std::vector<fs::path> library_paths;
+
+  void SetUp() override {
+    this->dir = fs::temp_directory_path() /
+      ("adaptyst_test_manifest_" + std::to_string(getpid()) + "_" +
+       testing::UnitTest::GetInstance()->current_test_info()->name());
+    fs::remove_all(this->dir);
+
+    this->cache_dir = this->dir / "cache";
+    setenv("ADAPTYST_MODULE_CACHE_DIR", this->cache_dir.c_str(), 1);
+
+    this->library_paths = {this->dir / "modules"};
+    this->lib_path = this->install("testmod", this->library_paths[0]);
+  }
+
+  void TearDown() override {
+    unsetenv("ADAPTYST_MODULE_CACHE_DIR");
+    fs::remove_all(this->dir);
+  }
+
+  fs::path install(std::string backend_name, fs::path library_path) {
+    fs::path path = library_path / backend_name / ("lib" + backend_name + ".so");
+    fs::create_directories(path.parent_path());
+    fs::copy_file(ADAPTYST_TEST_MODULE_LIB, path);
+    return path;
+  }
+
+  fs::path get_cache_file() {
+    std::vector<fs::path> files;
+
+    for (auto &entry : fs::directory_iterator(this->cache_dir)) {
+      files.push_back(entry.path());
+    }
+
+    EXPECT_EQ(files.size(), 1);
+    return files.empty() ? fs::path() : files[0];
+  }
+
+  // Changes the cached manifest without touching its key, so that
+  // a manifest returned from the cache can be told apart
+  void tamper_cache() {
+    fs::path cache_file = this->get_cache_file();
+    std::ifstream in(cache_file);
+    nlohmann::json cached = nlohmann::json::parse(in);
+    in.close();
+
+    cached["manifest"]["version"] = "cached";
+    std::ofstream(cache_file) << cached.dump();
+  }
+};
+
+TEST_F(ModuleManifestTest, ReadsModuleMetadata) {
+  ModuleManifest manifest = ModuleManifest::get("testmod", this->library_paths);
+
+  EXPECT_EQ(manifest.get_name(), "testmod");
+  EXPECT_EQ(manifest.get_version(), "1.2.3");
+  EXPECT_EQ(manifest.get_version_nums(), (std::vector<int>{1, 2, 3}));
+  EXPECT_EQ(manifest.get_lib_path(), this->lib_path);
+  EXPECT_TRUE(manifest.get_inject_lib_path().empty());
+  EXPECT_EQ(manifest.get_max_count_per_entity(), 2);
+  EXPECT_EQ(manifest.get_tags(), (std::unordered_set<std::string>{"test", "other"}));
+
+  auto &options = manifest.get_options();
+  ASSERT_EQ(options.size(), 3);
+  EXPECT_EQ(options["count"].type, UNSIGNED_INT);
+  EXPECT_EQ(options["count"].default_value, 4);
+  EXPECT_EQ(options["label"].type, STRING);
+  EXPECT_TRUE(options["label"].default_value.is_null());
+  EXPECT_EQ(options["sizes"].type, NONE);
+  EXPECT_EQ(options["sizes"].array_type, INT);
+  EXPECT_EQ(options["sizes"].default_value, nlohmann::json::array({16, 32}));
+}
+
+TEST_F(ModuleManifestTest, UsesCacheUntilLibraryChanges) {
+  ModuleManifest::get("testmod", this->library_paths);
+  this->tamper_cache();
+
+  EXPECT_EQ(ModuleManifest::get("testmod", this->library_paths).get_version(), "cached");
+
+  // A different modification time invalidates the entry
+  fs::last_write_time(this->lib_path, fs::last_write_time(this->lib_path) +
+                      std::chrono::seconds(10));
+
+  ModuleManifest rebuilt = ModuleManifest::get("testmod", this->library_paths);
+  EXPECT_EQ(rebuilt.get_version(), "1.2.3");
+
+  // The rebuilt manifest is cached again
+  this->tamper_cache();
+  EXPECT_EQ(ModuleManifest::get("testmod", this->library_paths).get_version(), "cached");
+}
+
+TEST_F(ModuleManifestTest, NewInjectionLibraryInvalidatesCache) {
+  ModuleManifest::get("testmod", this->library_paths);
+  this->tamper_cache();
+
+  fs::path inject_lib_path = this->lib_path.parent_path() / "libtestmod_inject.so";
+  std::ofstream(inject_lib_path) << "not really a library";
+
+  ModuleManifest manifest = ModuleManifest::get("testmod", this->library_paths);
+  EXPECT_EQ(manifest.get_version(), "1.2.3");
+  EXPECT_EQ(manifest.get_inject_lib_path(), inject_lib_path);
+}
+
+TEST_F(ModuleManifestTest, RebuildsCorruptedCache) {
+  ModuleManifest::get("testmod", this->library_paths);
+  std::ofstream(this->get_cache_file()) << "{ not json";
+
+  EXPECT_EQ(ModuleManifest::get("testmod", this->library_paths).get_version(), "1.2.3");
+}
+
+TEST_F(ModuleManifestTest, WorksWithoutWritableCache) {
+  setenv("ADAPTYST_MODULE_CACHE_DIR", "/proc/adaptyst_no_such_dir", 1);
+
+  EXPECT_EQ(ModuleManifest::get("testmod", this->library_paths).get_version(), "1.2.3");
+}
+
+TEST_F(ModuleManifestTest, MissingModule) {
+  EXPECT_THROW(ModuleManifest::get("nomod", this->library_paths), std::runtime_error);
+}
+
+TEST_F(ModuleManifestTest, GetAllUsesFirstPath) {
+  this->library_paths.push_back(this->dir / "other_modules");
+  this->install("testmod", this->library_paths[1]);
+  this->install("another", this->library_paths[1]);
+  fs::create_directories(this->library_paths[1] / "empty");
+
+  std::vector<ModuleManifest> manifests = ModuleManifest::get_all(this->library_paths);
+
+  // Directories are told apart by their names, not by the names
+  // the libraries define
+  ASSERT_EQ(manifests.size(), 2);
+  std::vector<fs::path> lib_paths = {manifests[0].get_lib_path(),
+                                     manifests[1].get_lib_path()};
+  std::sort(lib_paths.begin(), lib_paths.end());
+
+  EXPECT_EQ(lib_paths[0], this->lib_path);
+  EXPECT_EQ(lib_paths[1], this->library_paths[1] / "another" / "libanother.so");
+}
+
+TEST_F(ModuleManifestTest, ValidatesOptions) {
+  ModuleManifest manifest = ModuleManifest::get("testmod", this->library_paths);
+  std::unordered_map<std::string, std::string> options;
+  std::unordered_map<std::string, std::vector<std::string> > array_options;
+
+  EXPECT_THROW(manifest.validate(options, array_options), std::runtime_error);
+
+  options["label"] = "anything";
+  EXPECT_NO_THROW(manifest.validate(options, array_options));
+
+  options["count"] = "many";
+  EXPECT_THROW(manifest.validate(options, array_options), std::runtime_error);
+
+  options["count"] = "8";
+  array_options["sizes"] = {"1", "x"};
+  EXPECT_THROW(manifest.validate(options, array_options), std::runtime_error);
+
+  array_options["sizes"] = {"1", "-2"};
+  EXPECT_NO_THROW(manifest.validate(options, array_options));
+}
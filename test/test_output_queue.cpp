@@ -0,0 +1,248 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "output_queue.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+using namespace adaptyst;
+
+/**
+   A pipe whose buffer is made as small as possible and can be filled up,
+   so that the thread of an OutputQueue blocks in writev() and keeps
+   its entries queued.
+*/
+class OutputQueueTest : public testing::Test {
+protected:
+  int fds[2];
+  int pipe_size;
+
+  void SetUp() override {
+    signal(SIGPIPE, SIG_IGN);
+    ASSERT_EQ(pipe(this->fds), 0);
+    fcntl(this->fds[1], F_SETPIPE_SZ, 4096);
+    this->pipe_size = fcntl(this->fds[1], F_GETPIPE_SZ);
+    ASSERT_GT(this->pipe_size, 0);
+  }
+
+  void TearDown() override {
+    if (this->fds[0] != -1) {
+      ::close(this->fds[0]);
+    }
+
+    ::close(this->fds[1]);
+  }
+
+  void fill_pipe() {
+    std::string data(this->pipe_size, 'F');
+    ASSERT_EQ(::write(this->fds[1], data.data(), data.size()), this->pipe_size);
+  }
+
+  std::string read_pipe(size_t size) {
+    std::string data(size, 0);
+    size_t received = 0;
+
+    while (received < size) {
+      ssize_t result = ::read(this->fds[0], data.data() + received, size - received);
+
+      if (result <= 0) {
+        break;
+      }
+
+      received += result;
+    }
+
+    data.resize(received);
+    return data;
+  }
+
+  // Gives the thread of a queue time to start writing what it has
+  static void settle() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+};
+
+TEST_F(OutputQueueTest, WritesInOrder) {
+  std::string expected;
+
+  {
+    OutputQueue queue(this->fds[1]);
+
+    for (int i = 0; i < 1000; i++) {
+      std::string message = "message " + std::to_string(i) + ";";
+      expected += message;
+      ASSERT_TRUE(queue.push(message));
+    }
+
+    std::string received = this->read_pipe(expected.size());
+    queue.flush();
+    EXPECT_EQ(received, expected);
+
+    adaptyst_send_stats stats = queue.get_stats();
+    EXPECT_EQ(stats.sent_messages, 1000);
+    EXPECT_EQ(stats.sent_bytes, expected.size());
+    EXPECT_EQ(stats.queued_messages, 0);
+    EXPECT_EQ(stats.queued_bytes, 0);
+    EXPECT_EQ(stats.dropped_messages, 0);
+  }
+}
+
+TEST_F(OutputQueueTest, BatchesSmallMessages) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1]);
+
+  ASSERT_TRUE(queue.push("first"));
+  this->settle();
+
+  for (int i = 0; i < 50; i++) {
+    ASSERT_TRUE(queue.push("m" + std::to_string(i % 10)));
+  }
+
+  std::string received = this->read_pipe(this->pipe_size + 5 + 100);
+  queue.flush();
+
+  EXPECT_EQ(received.substr(this->pipe_size, 7), "firstm0");
+  EXPECT_LT(queue.get_stats().write_calls, 10);
+}
+
+TEST_F(OutputQueueTest, DropPolicy) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 10, ADAPTYST_SEND_DROP);
+
+  // An empty queue accepts a message larger than the high-water mark
+  ASSERT_TRUE(queue.push("0123456789ABCDEF"));
+  this->settle();
+
+  EXPECT_FALSE(queue.push("dropped"));
+  EXPECT_FALSE(queue.push("x"));
+
+  adaptyst_send_stats stats = queue.get_stats();
+  EXPECT_EQ(stats.dropped_messages, 2);
+  EXPECT_EQ(stats.dropped_bytes, 8);
+  EXPECT_EQ(stats.queued_messages, 1);
+
+  std::string received = this->read_pipe(this->pipe_size + 16);
+  queue.flush();
+  EXPECT_EQ(received.substr(this->pipe_size), "0123456789ABCDEF");
+}
+
+TEST_F(OutputQueueTest, CoalescePolicyKeepsLatest) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 8, ADAPTYST_SEND_COALESCE);
+
+  ASSERT_TRUE(queue.push("AAAA"));
+  this->settle();
+
+  // "AAAA" is being written, so only the messages after it can
+  // be replaced
+  ASSERT_TRUE(queue.push("BBBB"));
+  ASSERT_TRUE(queue.push("CCCC"));
+  ASSERT_TRUE(queue.push("DDDD"));
+
+  adaptyst_send_stats stats = queue.get_stats();
+  EXPECT_EQ(stats.dropped_messages, 2);
+  EXPECT_EQ(stats.dropped_bytes, 8);
+  EXPECT_EQ(stats.queued_messages, 2);
+  EXPECT_EQ(stats.queued_bytes, 8);
+
+  std::string received = this->read_pipe(this->pipe_size + 8);
+  queue.flush();
+  EXPECT_EQ(received.substr(this->pipe_size), "AAAADDDD");
+}
+
+TEST_F(OutputQueueTest, CoalesceDropsWhenOnlyInFlight) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 4, ADAPTYST_SEND_COALESCE);
+
+  ASSERT_TRUE(queue.push("AAAA"));
+  this->settle();
+  EXPECT_FALSE(queue.push("BBBB"));
+
+  std::string received = this->read_pipe(this->pipe_size + 4);
+  queue.flush();
+  EXPECT_EQ(received.substr(this->pipe_size), "AAAA");
+}
+
+TEST_F(OutputQueueTest, ControlBytesBypassHighWaterMark) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 4, ADAPTYST_SEND_COALESCE);
+
+  ASSERT_TRUE(queue.push("AAAA"));
+  this->settle();
+  ASSERT_TRUE(queue.push("<control>", true));
+
+  // The control entry is the newest one, but it's never replaced
+  EXPECT_FALSE(queue.push("BBBB"));
+
+  adaptyst_send_stats stats = queue.get_stats();
+  EXPECT_EQ(stats.queued_messages, 1);
+  EXPECT_EQ(stats.queued_bytes, 13);
+
+  std::string received = this->read_pipe(this->pipe_size + 13);
+  queue.flush();
+  EXPECT_EQ(received.substr(this->pipe_size), "AAAA<control>");
+  EXPECT_EQ(queue.get_stats().sent_messages, 1);
+}
+
+TEST_F(OutputQueueTest, BlockPolicyWaitsForSpace) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 4, ADAPTYST_SEND_BLOCK);
+  std::atomic<bool> pushed = false;
+
+  ASSERT_TRUE(queue.push("AAAA"));
+  this->settle();
+
+  std::thread producer([&]() {
+    queue.push("BBBB");
+    pushed = true;
+  });
+
+  this->settle();
+  EXPECT_FALSE(pushed);
+
+  std::string received = this->read_pipe(this->pipe_size + 8);
+  producer.join();
+  queue.flush();
+
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(received.substr(this->pipe_size), "AAAABBBB");
+  EXPECT_EQ(queue.get_stats().dropped_messages, 0);
+}
+
+TEST_F(OutputQueueTest, SetPolicyReleasesBlockedProducers) {
+  this->fill_pipe();
+  OutputQueue queue(this->fds[1], 4, ADAPTYST_SEND_BLOCK);
+  std::atomic<int> result = -1;
+
+  ASSERT_TRUE(queue.push("AAAA"));
+  this->settle();
+
+  std::thread producer([&]() {
+    result = queue.push("BBBB") ? 1 : 0;
+  });
+
+  this->settle();
+  EXPECT_EQ(result, -1);
+
+  queue.set_policy(4, ADAPTYST_SEND_DROP);
+  producer.join();
+  EXPECT_EQ(result, 0);
+
+  this->read_pipe(this->pipe_size + 4);
+  queue.flush();
+}
+
+TEST_F(OutputQueueTest, ReportsWriteErrors) {
+  OutputQueue queue(this->fds[1]);
+
+  ::close(this->fds[0]);
+  this->fds[0] = -1;
+
+  ASSERT_TRUE(queue.push("lost"));
+  EXPECT_THROW(queue.flush(), ConnectionException);
+  EXPECT_THROW(queue.push("more"), ConnectionException);
+  EXPECT_EQ(queue.get_stats().dropped_messages, 1);
+}
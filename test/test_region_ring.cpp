@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "region_ring.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace adaptyst;
+
+static std::string ring_name(std::string suffix) {
+  return "/adaptyst_test_ring_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+static RegionRecord make_record(unsigned long long timestamp) {
+  RegionRecord record;
+  std::memset(&record, 0, sizeof(RegionRecord));
+  record.timestamp = timestamp;
+  record.timestamp_valid = true;
+  record.end = timestamp % 2 == 1;
+  record.name_len = std::snprintf(record.name, REGION_RING_NAME_SIZE, "region_%llu",
+                                  timestamp);
+  return record;
+}
+
+TEST(RegionRingTest, RejectsCapacityNotPowerOf2) {
+  EXPECT_THROW(RegionRing::create(ring_name("cap0"), 0), std::runtime_error);
+  EXPECT_THROW(RegionRing::create(ring_name("cap3"), 3), std::runtime_error);
+}
+
+TEST(RegionRingTest, OpenRequiresExistingRing) {
+  EXPECT_THROW(RegionRing::open(ring_name("missing")), std::runtime_error);
+}
+
+TEST(RegionRingTest, OpenUnlinksName) {
+  std::string name = ring_name("unlink");
+  std::unique_ptr<RegionRing> producer = RegionRing::create(name, 4);
+  std::unique_ptr<RegionRing> consumer = RegionRing::open(name);
+
+  EXPECT_THROW(RegionRing::open(name), std::runtime_error);
+}
+
+TEST(RegionRingTest, FullAndEmpty) {
+  std::string name = ring_name("full");
+  std::unique_ptr<RegionRing> producer = RegionRing::create(name, 4);
+  std::unique_ptr<RegionRing> consumer = RegionRing::open(name);
+  RegionRecord record;
+
+  EXPECT_TRUE(consumer->empty());
+  EXPECT_FALSE(consumer->pop(record));
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(producer->push(make_record(i)));
+  }
+
+  EXPECT_FALSE(producer->push(make_record(4)));
+  EXPECT_FALSE(consumer->empty());
+
+  ASSERT_TRUE(consumer->pop(record));
+  EXPECT_EQ(record.timestamp, 0);
+  EXPECT_TRUE(producer->push(make_record(4)));
+}
+
+TEST(RegionRingTest, KeepsOrderAcrossWrapAround) {
+  std::string name = ring_name("wrap");
+  std::unique_ptr<RegionRing> producer = RegionRing::create(name, 8);
+  std::unique_ptr<RegionRing> consumer = RegionRing::open(name);
+  unsigned long long next_push = 0;
+  unsigned long long next_pop = 0;
+  RegionRecord record;
+
+  // Pushing and popping in uneven batches moves head and tail
+  // around the ring many times
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 5 && producer->push(make_record(next_push)); i++) {
+      next_push++;
+    }
+
+    for (int i = 0; i < 3 && consumer->pop(record); i++) {
+      EXPECT_EQ(record.timestamp, next_pop);
+      next_pop++;
+    }
+  }
+
+  while (consumer->pop(record)) {
+    EXPECT_EQ(record.timestamp, next_pop);
+    next_pop++;
+  }
+
+  EXPECT_EQ(next_pop, next_push);
+  EXPECT_TRUE(consumer->empty());
+}
+
+TEST(RegionRingTest, ConcurrentProducerAndConsumer) {
+  const unsigned long long count = 200000;
+  std::string name = ring_name("concurrent");
+  std::unique_ptr<RegionRing> producer = RegionRing::create(name, 64);
+  std::unique_ptr<RegionRing> consumer = RegionRing::open(name);
+
+  std::thread producer_thread([&]() {
+    for (unsigned long long i = 0; i < count; i++) {
+      RegionRecord record = make_record(i);
+
+      while (!producer->push(record)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  unsigned long long expected = 0;
+  bool intact = true;
+  RegionRecord record;
+
+  while (expected < count) {
+    if (!consumer->pop(record)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    RegionRecord reference = make_record(expected);
+
+    if (record.timestamp != expected || record.end != reference.end ||
+        record.name_len != reference.name_len ||
+        std::strcmp(record.name, reference.name) != 0) {
+      intact = false;
+      break;
+    }
+
+    expected++;
+  }
+
+  producer_thread.join();
+  EXPECT_TRUE(intact) << "record " << expected << " is out of order or torn";
+  EXPECT_EQ(expected, count);
+}
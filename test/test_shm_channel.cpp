@@ -0,0 +1,231 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "shm_channel.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+
+using namespace adaptyst;
+
+TEST(ShmChannelTest, RejectsInvalidGeometry) {
+  EXPECT_THROW(ShmChannel::create("test", 16, 0), std::runtime_error);
+  EXPECT_THROW(ShmChannel::create("test", 16, 6), std::runtime_error);
+  EXPECT_THROW(ShmChannel::create("test", 0, 8), std::runtime_error);
+}
+
+TEST(ShmChannelTest, OpenRejectsOtherFiles) {
+  int fd = memfd_create("adaptyst_test_not_channel", 0);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(ftruncate(fd, 4096), 0);
+
+  EXPECT_THROW(ShmChannel::open(fd), std::runtime_error);
+  ::close(fd);
+}
+
+TEST(ShmChannelTest, DropsWhenFullOrTooLarge) {
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 2);
+  char buf[8];
+  unsigned int n;
+
+  EXPECT_EQ(channel->get_slot_size(), 8);
+  EXPECT_TRUE(channel->empty());
+  EXPECT_FALSE(channel->pop(buf, sizeof(buf), &n));
+
+  EXPECT_FALSE(channel->push("too large", 9));
+  EXPECT_TRUE(channel->push("a", 1));
+  EXPECT_TRUE(channel->push("b", 1));
+  EXPECT_FALSE(channel->push("c", 1));
+  EXPECT_EQ(channel->get_dropped(), 2);
+
+  ASSERT_TRUE(channel->pop(buf, sizeof(buf), &n));
+  EXPECT_EQ(n, 1);
+  EXPECT_EQ(buf[0], 'a');
+  EXPECT_TRUE(channel->push("d", 1));
+
+  channel->reset();
+  EXPECT_TRUE(channel->empty());
+  EXPECT_EQ(channel->get_dropped(), 0);
+}
+
+TEST(ShmChannelTest, TruncatesIntoSmallBuffer) {
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 16, 4);
+  char buf[4] = {0, 0, 0, 0};
+  unsigned int n;
+
+  ASSERT_TRUE(channel->push("abcdefgh", 8));
+  ASSERT_TRUE(channel->pop(buf, 3, &n));
+  EXPECT_EQ(n, 8);
+  EXPECT_EQ(std::string(buf, 4), std::string("abc\0", 4));
+  EXPECT_TRUE(channel->empty());
+}
+
+TEST(ShmChannelTest, IgnoresOverwrittenGeometry) {
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 2);
+  std::unique_ptr<ShmChannel> opened = ShmChannel::open(channel->get_fd());
+  ASSERT_TRUE(opened->push("abc", 3));
+
+  // What a misbehaving workflow could do: mess up the geometry in
+  // the header and the size of the pushed message
+  struct stat stat_buf;
+  ASSERT_EQ(fstat(channel->get_fd(), &stat_buf), 0);
+  char *mem = (char *)mmap(nullptr, stat_buf.st_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, channel->get_fd(), 0);
+  ASSERT_NE(mem, MAP_FAILED);
+  std::memset(mem + sizeof(unsigned int), 0xff, 3 * sizeof(unsigned int));
+
+  char *data = (char *)memmem(mem, stat_buf.st_size, "abc", 3);
+  ASSERT_NE(data, nullptr);
+  std::memset(data - sizeof(unsigned int), 0xff, sizeof(unsigned int));
+
+  std::vector<char> buf(64);
+  unsigned int n;
+
+  ASSERT_TRUE(channel->pop(buf.data(), buf.size(), &n));
+  // The message is clamped to its slot rather than read past the mapping
+  EXPECT_LT(n, 64u);
+  EXPECT_EQ(std::string(buf.data(), 3), "abc");
+  EXPECT_EQ(channel->get_slot_size(), 8);
+
+  EXPECT_FALSE(channel->push("too large", 9));
+  ASSERT_TRUE(channel->push("def", 3));
+  ASSERT_TRUE(opened->pop(buf.data(), buf.size(), &n));
+  EXPECT_EQ(n, 3);
+  EXPECT_EQ(std::string(buf.data(), n), "def");
+
+  munmap(mem, stat_buf.st_size);
+}
+
+TEST(ShmChannelTest, KeepsOrderAcrossWrapAround) {
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 4);
+  unsigned long long next_push = 0;
+  unsigned long long next_pop = 0;
+
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 3; i++) {
+      ASSERT_TRUE(channel->push(&next_push, sizeof(next_push)));
+      next_push++;
+    }
+
+    unsigned long long value;
+    unsigned int n;
+
+    for (int i = 0; i < 3; i++) {
+      ASSERT_TRUE(channel->pop(&value, sizeof(value), &n));
+      EXPECT_EQ(n, sizeof(value));
+      EXPECT_EQ(value, next_pop);
+      next_pop++;
+    }
+  }
+}
+
+TEST(ShmChannelTest, DeliversEveryMessageOnceToManyConsumers) {
+  const unsigned int producers = 4;
+  const unsigned int consumers = 4;
+  const unsigned int per_producer = 50000;
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 64);
+
+  std::vector<std::atomic<unsigned char> > seen(producers * per_producer);
+  std::atomic<unsigned int> received = 0;
+  std::atomic<bool> duplicated = false;
+  std::vector<std::thread> threads;
+
+  for (unsigned int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      for (unsigned int i = 0; i < per_producer; i++) {
+        unsigned int value = p * per_producer + i;
+
+        while (!channel->push(&value, sizeof(value))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (unsigned int c = 0; c < consumers; c++) {
+    threads.emplace_back([&]() {
+      unsigned int value;
+      unsigned int n;
+
+      while (received < producers * per_producer) {
+        if (!channel->pop(&value, sizeof(value), &n)) {
+          channel->wait(1);
+          continue;
+        }
+
+        if (seen[value].fetch_add(1) != 0) {
+          duplicated = true;
+        }
+
+        received++;
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_FALSE(duplicated);
+  EXPECT_EQ(received, producers * per_producer);
+  EXPECT_TRUE(channel->empty());
+}
+
+TEST(ShmChannelTest, WaitTimesOutAndWakesUp) {
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 4);
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(channel->wait(50));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+
+  std::thread producer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    channel->push("x", 1);
+  });
+
+  start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(channel->wait(10000));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  producer.join();
+}
+
+TEST(ShmChannelTest, SharedWithChildProcess) {
+  const unsigned int count = 1000;
+  std::unique_ptr<ShmChannel> channel = ShmChannel::create("test", 8, 16);
+  int fd = channel->get_fd();
+
+  pid_t pid = fork();
+  ASSERT_NE(pid, -1);
+
+  if (pid == 0) {
+    std::unique_ptr<ShmChannel> child_channel = ShmChannel::open(fd);
+
+    for (unsigned int i = 0; i < count; i++) {
+      while (!child_channel->push(&i, sizeof(i))) {
+        sched_yield();
+      }
+    }
+
+    _exit(0);
+  }
+
+  unsigned int expected = 0;
+  unsigned int value;
+  unsigned int n;
+
+  while (expected < count) {
+    if (!channel->pop(&value, sizeof(value), &n)) {
+      channel->wait(1000);
+      continue;
+    }
+
+    ASSERT_EQ(value, expected);
+    expected++;
+  }
+
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
@@ -0,0 +1,281 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "adaptyst/output.hpp"
+#include <gtest/gtest.h>
+#include <climits>
+#include <thread>
+
+using namespace adaptyst;
+
+/**
+   A minimal reader of Table files following the layout described by
+   their metadata, independent of the writer.
+*/
+class TableReader {
+private:
+  std::string contents;
+
+  static unsigned long long get_varint(const std::string &block, size_t &pos) {
+    unsigned long long value = 0;
+    int shift = 0;
+
+    while (true) {
+      unsigned char byte = block.at(pos++);
+      value |= (unsigned long long)(byte & 0x7f) << shift;
+
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+
+      shift += 7;
+    }
+  }
+
+public:
+  nlohmann::json metadata;
+
+  TableReader(fs::path dir, std::string name) {
+    MetadataCache::instance().sync();
+
+    std::ifstream meta_stream(dir / ("meta_" + name + ".json"));
+    this->metadata = nlohmann::json::parse(meta_stream);
+
+    std::ifstream stream(dir / (name + ".tbl"), std::ios_base::binary);
+    this->contents = std::string((std::istreambuf_iterator<char>(stream)),
+                                 std::istreambuf_iterator<char>());
+  }
+
+  std::string get_block(nlohmann::json &column) {
+    std::string block = this->contents.substr(column["offset"].get<size_t>(),
+                                              column["size"].get<size_t>());
+
+#ifdef ADAPTYST_TABLE_ZSTD
+    std::string raw(column["raw_size"].get<size_t>(), '\0');
+    size_t size = ZSTD_decompress(raw.data(), raw.size(), block.data(), block.size());
+
+    if (ZSTD_isError(size) || size != raw.size()) {
+      throw std::runtime_error("Invalid compressed column");
+    }
+
+    block.swap(raw);
+#endif
+
+    EXPECT_EQ(block.size(), column["raw_size"].get<size_t>());
+    return block;
+  }
+
+  // Decodes zigzag varints of differences
+  std::vector<unsigned long long> get_integers(size_t index) {
+    std::vector<unsigned long long> values;
+
+    for (auto &chunk : this->metadata["chunks"]) {
+      std::string block = this->get_block(chunk["columns"][index]);
+      unsigned long long prev = 0;
+      size_t pos = 0;
+
+      for (unsigned int i = 0; i < chunk["rows"].get<unsigned int>(); i++) {
+        unsigned long long zigzag = TableReader::get_varint(block, pos);
+        unsigned long long delta = (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+        prev += delta;
+        values.push_back(prev);
+      }
+
+      EXPECT_EQ(pos, block.size());
+    }
+
+    return values;
+  }
+
+  std::vector<double> get_doubles(size_t index) {
+    std::vector<double> values;
+
+    for (auto &chunk : this->metadata["chunks"]) {
+      std::string block = this->get_block(chunk["columns"][index]);
+      size_t count = block.size() / sizeof(double);
+      EXPECT_EQ(count, chunk["rows"].get<size_t>());
+
+      for (size_t i = 0; i < count; i++) {
+        double value;
+        std::memcpy(&value, block.data() + i * sizeof(double), sizeof(double));
+        values.push_back(value);
+      }
+    }
+
+    return values;
+  }
+
+  std::vector<std::string> get_strings(size_t index) {
+    std::vector<std::string> values;
+
+    for (auto &chunk : this->metadata["chunks"]) {
+      std::string block = this->get_block(chunk["columns"][index]);
+      size_t pos = 0;
+
+      for (unsigned int i = 0; i < chunk["rows"].get<unsigned int>(); i++) {
+        size_t size = TableReader::get_varint(block, pos);
+        values.push_back(block.substr(pos, size));
+        pos += size;
+      }
+
+      EXPECT_EQ(pos, block.size());
+    }
+
+    return values;
+  }
+};
+
+class TableTest : public testing::Test {
+protected:
+  fs::path dir;
+  std::vector<Table::Column> schema;
+
+  void SetUp() override {
+    this->dir = fs::temp_directory_path() /
+      ("adaptyst_test_table_" + std::to_string(getpid()) + "_" +
+       testing::UnitTest::GetInstance()->current_test_info()->name());
+    fs::remove_all(this->dir);
+
+    this->schema = {{"time", Table::INT64},
+                    {"address", Table::UINT64},
+                    {"value", Table::DOUBLE},
+                    {"label", Table::STRING}};
+  }
+
+  void TearDown() override {
+    MetadataCache::instance().sync();
+    fs::remove_all(this->dir);
+  }
+};
+
+TEST_F(TableTest, EncodesColumns) {
+  std::vector<long long> times = {5, 3, -7, LLONG_MIN, LLONG_MAX, 0, 1000000};
+  std::vector<unsigned long long> addresses = {0, ULLONG_MAX, 1, 0x7fff0000,
+                                               0x10, ULLONG_MAX - 1, 42};
+  std::vector<double> values = {0.5, -1e100, 3.25, 0, 1e-300, 7, -0.0};
+  std::vector<std::string> labels = {"", "a", std::string(300, 'x'),
+                                     std::string("nul\0byte", 8), "last", "é", "z"};
+
+  {
+    Path path(this->dir);
+    Table table(path, "test", this->schema, 3);
+
+    for (size_t i = 0; i < times.size(); i++) {
+      table.append(times[i], addresses[i], values[i], labels[i]);
+    }
+  }
+
+  TableReader reader(this->dir, "test");
+
+  EXPECT_EQ(reader.metadata["format_version"], TABLE_FORMAT_VERSION);
+  EXPECT_EQ(reader.metadata["rows"], times.size());
+  ASSERT_EQ(reader.metadata["chunks"].size(), 3);
+  EXPECT_EQ(reader.metadata["chunks"][0]["rows"], 3);
+  EXPECT_EQ(reader.metadata["chunks"][2]["rows"], 1);
+  EXPECT_EQ(reader.metadata["columns"][3]["type"], "string");
+
+  std::vector<unsigned long long> read_times = reader.get_integers(0);
+  ASSERT_EQ(read_times.size(), times.size());
+
+  for (size_t i = 0; i < times.size(); i++) {
+    EXPECT_EQ((long long)read_times[i], times[i]);
+  }
+
+  EXPECT_EQ(reader.get_integers(1), addresses);
+  EXPECT_EQ(reader.get_doubles(2), values);
+  EXPECT_EQ(reader.get_strings(3), labels);
+
+  nlohmann::json &first = reader.metadata["chunks"][0]["columns"];
+  EXPECT_EQ(first[0]["min"], -7);
+  EXPECT_EQ(first[0]["max"], 5);
+  EXPECT_EQ(first[1]["min"], 0);
+  EXPECT_EQ(first[1]["max"], ULLONG_MAX);
+  EXPECT_EQ(first[2]["min"], -1e100);
+  EXPECT_EQ(first[2]["max"], 3.25);
+  EXPECT_FALSE(first[3].contains("min"));
+}
+
+TEST_F(TableTest, RejectsValuesNotMatchingSchema) {
+  Path path(this->dir);
+  Table table(path, "test", this->schema);
+
+  EXPECT_THROW(table.append(1, 2, 3.0), std::runtime_error);
+  EXPECT_THROW(table.append(1, 2, 3.0, 4), std::runtime_error);
+  EXPECT_THROW(table.append("1", 2, 3.0, "4"), std::runtime_error);
+  EXPECT_NO_THROW(table.append(1, 2, 3, "4"));
+}
+
+TEST_F(TableTest, AppendsToExistingTable) {
+  {
+    Path path(this->dir);
+    Table table(path, "test", this->schema, 2);
+    table.append(1, 1, 1.0, "one");
+    table.append(2, 2, 2.0, "two");
+    table.append(3, 3, 3.0, "three");
+  }
+
+  MetadataCache::instance().sync();
+
+  {
+    Path path(this->dir);
+    Table table(path, "test", this->schema, 2);
+    table.append(4, 4, 4.0, "four");
+  }
+
+  TableReader reader(this->dir, "test");
+  EXPECT_EQ(reader.metadata["rows"], 4);
+  EXPECT_EQ(reader.get_integers(0), (std::vector<unsigned long long>{1, 2, 3, 4}));
+  EXPECT_EQ(reader.get_strings(3),
+            (std::vector<std::string>{"one", "two", "three", "four"}));
+}
+
+TEST_F(TableTest, RejectsDifferentSchema) {
+  {
+    Path path(this->dir);
+    Table table(path, "test", this->schema);
+    table.append(1, 1, 1.0, "one");
+  }
+
+  MetadataCache::instance().sync();
+
+  Path path(this->dir);
+  std::vector<Table::Column> other = {{"time", Table::UINT64}};
+  EXPECT_THROW(Table(path, "test", other), std::runtime_error);
+}
+
+TEST_F(TableTest, KeepsRowsOfEveryThread) {
+  const unsigned int threads = 4;
+  const unsigned int per_thread = 5000;
+
+  {
+    Path path(this->dir);
+    Table table(path, "test", {{"thread", Table::UINT64}, {"index", Table::UINT64}},
+                256);
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < threads; t++) {
+      workers.emplace_back([&, t]() {
+        for (unsigned int i = 0; i < per_thread; i++) {
+          table.append(t, i);
+        }
+      });
+    }
+
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  TableReader reader(this->dir, "test");
+  std::vector<unsigned long long> thread_ids = reader.get_integers(0);
+  std::vector<unsigned long long> indices = reader.get_integers(1);
+  std::vector<unsigned long long> next(threads, 0);
+
+  ASSERT_EQ(thread_ids.size(), threads * per_thread);
+  EXPECT_EQ(reader.metadata["rows"], threads * per_thread);
+
+  for (size_t i = 0; i < thread_ids.size(); i++) {
+    ASSERT_LT(thread_ids[i], threads);
+    EXPECT_EQ(indices[i], next[thread_ids[i]]++);
+  }
+}
@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: 2026 CERN
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "tsc_clock.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+using namespace adaptyst;
+
+static unsigned long long monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool is_same(const TscCalibration &first, const TscCalibration &second) {
+  return first.base_ticks == second.base_ticks && first.base_ns == second.base_ns &&
+    first.mult == second.mult && first.shift == second.shift;
+}
+
+TEST(TscCalibrationTest, ConvertsTicksLinearly) {
+  // 2 ticks per nanosecond
+  TscCalibration calibration = {1000, 5000, 1ULL << 31, 32};
+
+  EXPECT_EQ(calibration.to_ns(1000), 5000);
+  EXPECT_EQ(calibration.to_ns(1002), 5001);
+  EXPECT_EQ(calibration.to_ns(3000), 6000);
+}
+
+TEST(TscCalibrationTest, NeverGoesBeforeBase) {
+  TscCalibration calibration = {1000, 5000, 1ULL << 31, 32};
+
+  EXPECT_EQ(calibration.to_ns(999), 5000);
+  EXPECT_EQ(calibration.to_ns(0), 5000);
+
+  // Unsigned subtraction would make this centuries ahead
+  calibration.base_ticks = ~0ULL - 10;
+  EXPECT_EQ(calibration.to_ns(~0ULL - 20), 5000);
+}
+
+TEST(TscCalibrationTest, DoesNotOverflowLongDeltas) {
+  // 1 tick per nanosecond, a day after the base
+  TscCalibration calibration = {0, 0, 1ULL << 32, 32};
+  unsigned long long day_ns = 86400ULL * 1000000000ULL;
+
+  EXPECT_EQ(calibration.to_ns(day_ns), day_ns);
+}
+
+class TscClockTest : public testing::Test {
+protected:
+  void SetUp() override {
+    if (!TscClock::is_available()) {
+      GTEST_SKIP() << "No invariant timestamp counter is available";
+    }
+  }
+};
+
+TEST_F(TscClockTest, FollowsMonotonicClock) {
+  std::unique_ptr<TscClock> clock = TscClock::create();
+
+  EXPECT_GT(clock->get_frequency(), 0);
+
+  for (int i = 0; i < 10; i++) {
+    unsigned long long before = monotonic_ns();
+    unsigned long long now = clock->now();
+    unsigned long long after = monotonic_ns();
+
+    // Calibration over TSC_CLOCK_CALIBRATION_US is accurate well
+    // within a millisecond here
+    EXPECT_GE(now + 1000000, before);
+    EXPECT_LE(now, after + 1000000);
+  }
+}
+
+TEST_F(TscClockTest, OpenSharesCalibration) {
+  std::unique_ptr<TscClock> clock = TscClock::create();
+  std::unique_ptr<TscClock> mapped = TscClock::open(clock->get_fd());
+
+  EXPECT_TRUE(is_same(mapped->get_calibration(), clock->get_calibration()));
+
+  TscCalibration calibration = clock->recalibrate();
+  EXPECT_TRUE(is_same(mapped->get_calibration(), calibration));
+}
+
+TEST_F(TscClockTest, OpenRejectsOtherFiles) {
+  int fd = memfd_create("adaptyst_test_not_clock", 0);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(ftruncate(fd, 4096), 0);
+
+  EXPECT_THROW(TscClock::open(fd), std::runtime_error);
+  ::close(fd);
+}
+
+TEST_F(TscClockTest, RecalibrationNeverMovesBackwards) {
+  std::unique_ptr<TscClock> clock = TscClock::create();
+
+  for (int i = 0; i < 100; i++) {
+    TscCalibration before = clock->get_calibration();
+    TscCalibration after = clock->recalibrate();
+
+    EXPECT_GE(after.base_ns, before.to_ns(after.base_ticks));
+  }
+}
+
+TEST_F(TscClockTest, ReadersNeverSeeTornCalibration) {
+  const int readers = 4;
+  const int recalibrations = 2000;
+  std::unique_ptr<TscClock> clock = TscClock::create();
+  std::vector<TscCalibration> published = {clock->get_calibration()};
+  std::vector<std::vector<TscCalibration> > seen(readers);
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < readers; i++) {
+    threads.emplace_back([&, i]() {
+      std::unique_ptr<TscClock> mapped = TscClock::open(clock->get_fd());
+
+      while (!stop) {
+        TscCalibration calibration = mapped->get_calibration();
+
+        if (seen[i].empty() || !is_same(seen[i].back(), calibration)) {
+          seen[i].push_back(calibration);
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < recalibrations; i++) {
+    published.push_back(clock->recalibrate());
+  }
+
+  stop = true;
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto &calibrations : seen) {
+    for (auto &calibration : calibrations) {
+      EXPECT_TRUE(std::any_of(published.begin(), published.end(),
+                              [&](TscCalibration &other) {
+                                return is_same(other, calibration);
+                              })) << "torn calibration with base_ticks " <<
+        calibration.base_ticks;
+    }
+  }
+}